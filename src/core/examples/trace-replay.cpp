@@ -0,0 +1,117 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  Replay of the command trace recorded with compute_flag (commandrecord.bin or commandrecord.csv)
+  on the accelerator timing model (utils/replay.h), C++ version of replay.py
+
+  usage: trace-replay [--profile file] [--config file] [--set key=value]... [--in-order] trace
+  trace : commandrecord.bin of device 0, the streams of the other devices next to it (commandrecord.dev<d>.bin)
+          are merged in seq order, so the devices share the D2D link
+  --profile : hardware profile (utils/hw_profile.h) of the sweep point, links and op times of the config come
+              from it, later --config / --set override them
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "utils/hw_profile.h"
+#include "utils/replay.h"
+
+static void usage(const char* prog) {
+    std::cerr << "usage: " << prog << " [--profile file] [--config file] [--set key=value]... [--in-order] trace" << std::endl;
+    std::cerr << "  keys: ntt_time intt_time auto_time add_time mult_time sub_time bconv_up_time bconv_down_time (ns)"
+              << std::endl;
+    std::cerr << "        pcie_time hbm_time sram_time d2d_time (ns per polynomial) or pcie_bw hbm_bw sram_bw d2d_bw (GB/s)"
+              << std::endl;
+    std::cerr << "        pcie_latency hbm_latency sram_latency d2d_latency (ns) ref_poly_bytes sram_on_hbm reorder max_gaps"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    ReplayConfig config;
+    const char* trace = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+            HardwareProfile profile;
+            if (!profile.load(argv[++i])) {
+                std::cerr << "cannot load hardware profile " << argv[i] << std::endl;
+                return 1;
+            }
+            profile.apply_to(config);
+        }
+        else if (!strcmp(argv[i], "--config") && i + 1 < argc) {
+            if (!config.load(argv[++i])) {
+                std::cerr << "cannot load config " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--set") && i + 1 < argc) {
+            std::string kv(argv[++i]);
+            size_t eq = kv.find('=');
+            if (eq == std::string::npos || !config.set(kv.substr(0, eq), atof(kv.c_str() + eq + 1))) {
+                std::cerr << "invalid setting " << kv << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--in-order")) {
+            config.reorder = false;
+        }
+        else if (argv[i][0] != '-' && !trace) {
+            trace = argv[i];
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!trace) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    TraceReplay replay(config);
+    if (!replay.replay_file(trace)) {
+        std::cerr << "cannot replay " << trace << std::endl;
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    replay.print(std::cout);
+    std::cout << "replayed in " << std::setprecision(3) << elapsed.count() << " s" << std::endl;
+    return 0;
+}
@@ -53,6 +53,9 @@
 #include <utility>
 #include <vector>
 
+/* source limbs per base conversion task (set_bconv_batch_width), 0 : all of them */
+extern uint32_t bconv_batch_width;
+
 namespace lbcrypto {
 
 template <typename VecType>
@@ -285,7 +288,7 @@ std::vector<DCRTPolyImpl<VecType>> DCRTPolyImpl<VecType>::CRTDecompose(uint32_t
     if (baseBits == 0) {
         std::vector<DCRTPolyType> result(size, *eval);
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
         for (size_t i = 0; i < size; ++i) {
             for (size_t k = 0; k < size; ++k) {
                 if (i != k) {
@@ -313,7 +316,7 @@ std::vector<DCRTPolyImpl<VecType>> DCRTPolyImpl<VecType>::CRTDecompose(uint32_t
     }
     std::vector<DCRTPolyType> result(nWindows);
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i) {
         auto decomposed = (*coef).m_vectors[i].BaseDecompose(baseBits, false);
         for (size_t j = 0; j < decomposed.size(); j++) {
@@ -377,9 +380,11 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::AutomorphismTransform(uint32_t i, c
     DCRTPolyImpl<VecType> result;
     result.m_format = m_format;
     result.m_params = m_params;
-    result.m_vectors.reserve(m_vectors.size());
-    for (auto& v : m_vectors)
-        result.m_vectors.emplace_back(v.AutomorphismTransform(i, vec));
+    size_t size{m_vectors.size()};
+    result.m_vectors.resize(size);
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
+    for (size_t j = 0; j < size; ++j)
+        result.m_vectors[j] = m_vectors[j].AutomorphismTransform(i, vec);
     return result;
 }
 
@@ -400,7 +405,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Negate() const {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Negate();
     return tmp;
@@ -419,7 +424,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Minus(const DCRTPolyImpl& rhs) cons
         OPENFHE_THROW(math_error, "tower size mismatch; cannot subtract");
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Minus(rhs.m_vectors[i]);
     return tmp;
@@ -429,7 +434,7 @@ template <typename VecType>
 DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator+=(const DCRTPolyImpl& rhs) {
     // std::cout << "DCRTPolyImpl::operator+=1" << std::endl; //use 789
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] += rhs.m_vectors[i];
     return *this;
@@ -440,7 +445,7 @@ DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator+=(const Integer& rhs) {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     NativeInteger val{rhs};
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] += val;
     return *this;
@@ -450,7 +455,7 @@ template <typename VecType>
 DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator+=(const NativeInteger& rhs) {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] += rhs;
     return *this;
@@ -460,7 +465,7 @@ template <typename VecType>
 DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator-=(const DCRTPolyImpl& rhs) {
     // std::cout << "DCRTPolyImpl::operator-=1" << std::endl; // use 12
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] -= rhs.m_vectors[i];
     return *this;
@@ -471,7 +476,7 @@ DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator-=(const Integer& rhs) {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     NativeInteger val{rhs};
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] -= val;
     return *this;
@@ -481,7 +486,7 @@ template <typename VecType>
 DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator-=(const NativeInteger& rhs) {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] -= rhs;
     return *this;
@@ -578,7 +583,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Plus(const Integer& rhs) const {
     NativeInteger val{rhs};
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Plus(val);
     return tmp;
@@ -589,7 +594,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Plus(const std::vector<Integer>& cr
     // std::cout << "DCRTPolyImpl::Plus2" << std::endl; // use 8
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Plus(NativeInteger(crtElement[i]));
     return tmp;
@@ -601,7 +606,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Minus(const Integer& rhs) const {
     NativeInteger val{rhs};
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Minus(val);
     return tmp;
@@ -612,7 +617,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Minus(const std::vector<Integer>& c
     // std::cout << "DCRTPolyImpl::Minus2" << std::endl; // use 19
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Minus(NativeInteger(crtElement[i]));
     return tmp;
@@ -624,7 +629,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Times(const Integer& rhs) const {
     NativeInteger val{rhs};
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Times(val);
     return tmp;
@@ -635,7 +640,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Times(NativeInteger::SignedNativeIn
     // std::cout << "DCRTPolyImpl::Times2" << std::endl; // use
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Times(rhs);
     return tmp;
@@ -646,7 +651,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Times(const std::vector<Integer>& c
     // std::cout << "DCRTPolyImpl::Times3" << std::endl; // use 212
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Times(NativeInteger(crtElement[i]));
     return tmp;
@@ -659,7 +664,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::Times(const std::vector<NativeInteg
         OPENFHE_THROW(math_error, "tower size mismatch; cannot multiply");
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         tmp.m_vectors[i] = m_vectors[i].Times(rhs[i]);
     return tmp;
@@ -670,7 +675,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::TimesNoCheck(const std::vector<Nati
     // std::cout << "DCRTPolyImpl::TimesNoCheck" << std::endl; // use 112
     size_t vecSize = m_vectors.size() < rhs.size() ? m_vectors.size() : rhs.size();
     DCRTPolyImpl<VecType> tmp(m_params, m_format);
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(vecSize))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(vecSize)) if(limb_parallel)
     for (size_t i = 0; i < vecSize; ++i)
         tmp.m_vectors[i] = m_vectors[i].Times(rhs[i]);
     return tmp;
@@ -681,7 +686,7 @@ DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator*=(const Integer& rhs) {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     NativeInteger val{rhs};
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] *= val;
     return *this;
@@ -691,7 +696,7 @@ template <typename VecType>
 DCRTPolyImpl<VecType>& DCRTPolyImpl<VecType>::operator*=(const NativeInteger& rhs) {
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i] *= rhs;
     return *this;
@@ -746,7 +751,7 @@ void DCRTPolyImpl<VecType>::AddILElementOne() {
     if (m_format != Format::EVALUATION)
         OPENFHE_THROW(not_available_error, "Cannot call AddILElementOne() on DCRTPoly in COEFFICIENT format.");
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i].AddILElementOne();
 }
@@ -802,7 +807,7 @@ void DCRTPolyImpl<VecType>::DropLastElementAndScale(const std::vector<NativeInte
     this->DropLastElement();
     size_t size{m_vectors.size()};
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i) {
         auto tmp = lastPoly;
         tmp.SwitchModulus(m_vectors[i].GetModulus(), m_vectors[i].GetRootOfUnity(), 0, 0);
@@ -850,7 +855,7 @@ void DCRTPolyImpl<VecType>::ModReduce(const NativeInteger& t, const std::vector<
     this->DropLastElement();
     size_t size{m_vectors.size()};
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i) {
         auto tmp{delta};
         tmp.SwitchModulus(m_vectors[i].GetModulus(), m_vectors[i].GetRootOfUnity(), 0, 0);
@@ -1078,7 +1083,7 @@ void DCRTPolyImpl<VecType>::TimesQovert(const std::shared_ptr<Params>& paramsQ,
         OPENFHE_THROW(math_error, "Sizes of vectors do not match.");
     uint32_t size(m_vectors.size());
     uint32_t ringDim(m_params->GetRingDimension());
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i) {
         for (uint32_t ri = 0; ri < ringDim; ++ri) {
             NativeInteger& xi = m_vectors[i][ri];
@@ -1126,199 +1131,42 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::ApproxSwitchCRTBasis(
     usint sizeQ = (m_vectors.size() > paramsQ->GetParams().size()) ? paramsQ->GetParams().size() : m_vectors.size();
     usint sizeP = ans.m_vectors.size();
 
-    // for (usint i = 0; i < sizeQ; i++) {
-    //     auto xQHatInvModqi = m_vectors[i] * QHatInvModq[i];
-    //     for (usint j = 0; j < sizeP; j++) {
-    //         xQHatInvModqi.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[i][j], ans.m_vectors[j]);
-    //     }
-    // }
-
-    // bconv parallel
-    // double bconv_parallel = sizeP/3;
-    
-    // usint ceil_value;
-    // if(sizeP%3 == 0) ceil_value = sizeP/3;
-    // else ceil_value = sizeP/3 + 1;
-    // for (usint i = 0; i < sizeQ; i++) {
-    //     auto xQHatInvModqi_0 = m_vectors[i] * QHatInvModq[i];
-    //     for (usint j = 0; j < ceil_value; j++) {
-    //         if(compute_flag){
-    //             std::ofstream file("commandrecord.csv", std::ios::app);
-    //             if (file.is_open()) {
-    //                 file << "parallel----- 3 bconv " << std::endl;
-    //                 file.close();
-    //             }
-    //         }
-    //         if((j < ceil_value - 1) 
-    //         || ((j == ceil_value - 1) && ((j + 1) * 3 <= sizeP + 2))
-    //         || ((sizeP%3 == 0))) 
-    //         {
-    //             xQHatInvModqi_0.bconv_pipe(ans.m_vectors[3*j].GetModulus(), ans.m_vectors[3*j].GetRootOfUnity(), 0, 0, QHatModp[i][3*j], ans.m_vectors[3*j]);
-    //         }
-    //         if((j < ceil_value - 1) 
-    //         || ((j == ceil_value - 1) && ((j + 1) * 3 <= sizeP + 1))
-    //         || ((sizeP%3 == 0)))
-    //         {
-    //             xQHatInvModqi_0.bconv_pipe(ans.m_vectors[3*j+1].GetModulus(), ans.m_vectors[3*j+1].GetRootOfUnity(), 0, 0, QHatModp[i][3*j+1], ans.m_vectors[3*j+1]);
-    //         }
-    //         if((j < ceil_value - 1) 
-    //         || ((j == ceil_value - 1) && ((j + 1) * 3 <= sizeP))
-    //         || ((sizeP%3 == 0)))
-    //         {
-    //             xQHatInvModqi_0.bconv_pipe(ans.m_vectors[3*j+2].GetModulus(), ans.m_vectors[3*j+2].GetRootOfUnity(), 0, 0, QHatModp[i][3*j+2], ans.m_vectors[3*j+2]);
-    //         }
-    //     }
-    // }
-
-    // usint ceil_value;
-    // if(sizeQ%3 == 0) ceil_value = sizeQ/3;
-    // else ceil_value = sizeQ/3 + 1;
-    // // std::cout << "sizeQ : " << sizeQ << std::endl;
-    // // std::cout << "ceil(sizeQ/3) : " << ceil_value << std::endl;
-    // PolyImpl<NativeVector> xQHatInvModqi_0;
-    // PolyImpl<NativeVector> xQHatInvModqi_1;
-    // PolyImpl<NativeVector> xQHatInvModqi_2;
-    // for (usint i = 0; i < ceil_value; i++) {
-    //     if((i < ceil_value - 1) 
-    //         || ((i == ceil_value - 1) && ((i + 1) * 3 <= sizeQ + 2))
-    //         || ((sizeQ%3 == 0))) 
-    //         {
-    //             // std::cout << "Q -- 3*i : " << 3*i << std::endl;
-    //             xQHatInvModqi_0 = m_vectors[3*i] * QHatInvModq[3*i];
-    //         }
-
-    //     if((i < ceil_value - 1) 
-    //         || ((i == ceil_value - 1) && ((i + 1) * 3 <= sizeQ + 1))
-    //         || ((sizeQ%3 == 0)))
-    //         {
-    //             // std::cout << "Q -- 3*i + 1: " << 3*i + 1 << std::endl;
-    //             xQHatInvModqi_1 = m_vectors[3*i+1] * QHatInvModq[3*i+1];
-    //         }
-
-    //     if((i < ceil_value - 1) 
-    //         || ((i == ceil_value - 1) && ((i + 1) * 3 <= sizeQ))
-    //         || ((sizeQ%3 == 0)))
-    //         {
-    //             // std::cout << "Q -- 3*i + 2 : " << 3*i + 2 << std::endl;
-    //             xQHatInvModqi_2 = m_vectors[3*i+2] * QHatInvModq[3*i+2];
-    //         }
-
-        
-    //     for (usint j = 0; j < sizeP; j++) {
-    //             // std::cout << "P loop in " << j << std::endl;
-    //             if((i < ceil_value - 1) 
-    //                 || ((i == ceil_value - 1) && ((i + 1) * 3 <= sizeQ + 2))
-    //                 || ((sizeQ%3 == 0))) 
-    //                 {
-    //                     // std::cout << "P -- 3*i : " << 3*i << "   "<< j <<std::endl;
-    //                     xQHatInvModqi_0.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[3*i][j], ans.m_vectors[j]);
-    //                 }
-    //             if((i < ceil_value - 1) 
-    //                 || ((i == ceil_value - 1) && ((i + 1) * 3 <= sizeQ + 1))
-    //                 || ((sizeQ%3 == 0)))
-    //                 {
-    //                     // std::cout << "P -- 3*i + 1 : " << 3*i + 1 << "   "<< j << std::endl;
-    //                     xQHatInvModqi_1.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[3*i+1][j], ans.m_vectors[j]);
-    //                 }
-    //             if((i < ceil_value - 1) 
-    //                 || ((i == ceil_value - 1) && ((i + 1) * 3 <= sizeQ))
-    //                 || ((sizeQ%3 == 0)))
-    //                 {
-    //                     // std::cout << "P -- 3*i + 2 : " << 3*i + 2 << "   "<< j << std::endl;
-    //                     xQHatInvModqi_2.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[3*i+2][j], ans.m_vectors[j]);
-    //                 }
-    //     }
-    // }
-    
-    usint ceil_value;
-    if(sizeQ%5 == 0) ceil_value = sizeQ/5;
-    else ceil_value = sizeQ/5 + 1;
-    std::cout << "sizeQ : " << sizeQ << std::endl;
-    std::cout << "ceil(sizeQ/5) : " << ceil_value << std::endl;
-    PolyImpl<NativeVector> xQHatInvModqi_0;
-    PolyImpl<NativeVector> xQHatInvModqi_1;
-    PolyImpl<NativeVector> xQHatInvModqi_2;
-    PolyImpl<NativeVector> xQHatInvModqi_3;
-    PolyImpl<NativeVector> xQHatInvModqi_4;
-    for (usint i = 0; i < ceil_value; i++) {
-        if((i < ceil_value - 1) 
-            || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 4))
-            || ((sizeQ%5 == 0))) 
-            {
-                // std::cout << "Q -- 3*i : " << 3*i << std::endl;
-                xQHatInvModqi_0 = m_vectors[5*i] * QHatInvModq[5*i];
-            }
-
-        if((i < ceil_value - 1) 
-            || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 3))
-            || ((sizeQ%5 == 0)))
-            {
-                // std::cout << "Q -- 3*i + 1: " << 3*i + 1 << std::endl;
-                xQHatInvModqi_1 = m_vectors[5*i+1] * QHatInvModq[5*i+1];
-            }
-
-        if((i < ceil_value - 1) 
-            || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ +2))
-            || ((sizeQ%5 == 0)))
-            {
-                // std::cout << "Q -- 3*i + 2 : " << 3*i + 2 << std::endl;
-                xQHatInvModqi_2 = m_vectors[5*i+2] * QHatInvModq[5*i+2];
-            }
-        
-        if((i < ceil_value - 1) 
-            || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 1))
-            || ((sizeQ%5 == 0)))
-            {
-                // std::cout << "Q -- 3*i + 1: " << 3*i + 1 << std::endl;
-                xQHatInvModqi_3 = m_vectors[5*i+3] * QHatInvModq[5*i+3];
-            }
-
-        if((i < ceil_value - 1) 
-            || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ))
-            || ((sizeQ%5 == 0)))
-            {
-                // std::cout << "Q -- 3*i + 2 : " << 3*i + 2 << std::endl;
-                xQHatInvModqi_4 = m_vectors[5*i+4] * QHatInvModq[5*i+4];
+    /* Batched base conversion (TASK_TYPE_BCONV_BATCH)
+        [x_i * (Q/q_i)^-1]_{q_i} of bconv_batch_width source limbs are kept on the shadow,
+        then every target limb gets one task accumulating the whole batch (bconv_batch).
+        Width 0 (or larger than sizeQ) : all source limbs in one batch, one task per target limb */
+    usint width = (bconv_batch_width == 0 || bconv_batch_width > sizeQ) ? sizeQ : bconv_batch_width;
+    std::vector<PolyImpl<NativeVector>> xQHatInvModq(width);
+    std::vector<const PolyImpl<NativeVector>*> sources;
+
+    /* multi-device mode : every source limb is needed on every device of the target limbs (all-gather),
+        one transfer per source limb and target device (ModUp and ModDown) */
+    uint32_t target_devices = 0; // bit per device
+    if (num_devices > 1) {
+        for (usint j = 0; j < sizeP; j++)
+            target_devices |= 1u << ans.m_vectors[j].GetDevice();
+    }
+
+    for (usint i0 = 0; i0 < sizeQ; i0 += width) {
+        usint batch = std::min<usint>(width, sizeQ - i0);
+        sources.resize(batch);
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(batch)) if(limb_parallel)
+        for (usint k = 0; k < batch; k++) {
+            xQHatInvModq[k] = m_vectors[i0 + k] * QHatInvModq[i0 + k];
+            sources[k] = &xQHatInvModq[k];
+        }
+        for (usint k = 0; target_devices && k < batch; k++) {
+            for (uint32_t d = 0; d < num_devices; d++) {
+                if ((target_devices >> d) & 1)
+                    xQHatInvModq[k].TransferToDevice(d);
             }
-
-        
+        }
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP)) if(limb_parallel)
         for (usint j = 0; j < sizeP; j++) {
-                // std::cout << "P loop in " << j << std::endl;
-                if((i < ceil_value - 1) 
-                    || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 4))
-                    || ((sizeQ%5 == 0))) 
-                    {
-                        // std::cout << "P -- 3*i : " << 3*i << "   "<< j <<std::endl;
-                        xQHatInvModqi_0.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[5*i][j], ans.m_vectors[j]);
-                    }
-                if((i < ceil_value - 1) 
-                    || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 3))
-                    || ((sizeQ%5 == 0)))
-                    {
-                        // std::cout << "P -- 3*i + 1 : " << 3*i + 1 << "   "<< j << std::endl;
-                        xQHatInvModqi_1.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[5*i+1][j], ans.m_vectors[j]);
-                    }
-                if((i < ceil_value - 1) 
-                    || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 2))
-                    || ((sizeQ%5 == 0)))
-                    {
-                        // std::cout << "P -- 3*i + 2 : " << 3*i + 2 << "   "<< j << std::endl;
-                        xQHatInvModqi_2.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[5*i+2][j], ans.m_vectors[j]);
-                    }
-                if((i < ceil_value - 1) 
-                    || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ + 1))
-                    || ((sizeQ%5 == 0)))
-                    {
-                        // std::cout << "P -- 3*i + 2 : " << 3*i + 2 << "   "<< j << std::endl;
-                        xQHatInvModqi_3.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[5*i+3][j], ans.m_vectors[j]);
-                    }
-                if((i < ceil_value - 1) 
-                    || ((i == ceil_value - 1) && ((i + 1) * 5 <= sizeQ))
-                    || ((sizeQ%5 == 0)))
-                    {
-                        // std::cout << "P -- 3*i + 2 : " << 3*i + 2 << "   "<< j << std::endl;
-                        xQHatInvModqi_4.bconv_pipe(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0, QHatModp[5*i+4][j], ans.m_vectors[j]);
-                    }
+            std::vector<NativeInteger> scalars(batch);
+            for (usint k = 0; k < batch; k++)
+                scalars[k] = QHatModp[i0 + k][j];
+            ans.m_vectors[j].bconv_batch(sources, scalars);
         }
     }
     return ans;
@@ -1332,7 +1180,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::ApproxSwitchCRTBasis(
 
     for (usint i = 0; i < sizeQ; i++) {
         auto xQHatInvModqi = m_vectors[i] * QHatInvModq[i];
-    // // #pragma omp parallel for
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP)) if(limb_parallel)
         for (usint j = 0; j < sizeP; j++) {
             auto temp = xQHatInvModqi;
             temp.SwitchModulus(ans.m_vectors[j].GetModulus(), ans.m_vectors[j].GetRootOfUnity(), 0, 0);
@@ -1368,7 +1216,7 @@ void DCRTPolyImpl<VecType>::ApproxModUp(const std::shared_ptr<Params>& paramsQ,
 
     m_vectors.resize(sizeQP);
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP)) if(limb_parallel)
     // populate the towers corresponding to CRT basis P and convert them to
     // evaluation representation
     for (size_t j = 0; j < sizeP; j++) {
@@ -1384,7 +1232,7 @@ void DCRTPolyImpl<VecType>::ApproxModUp(const std::shared_ptr<Params>& paramsQ,
     }
     else {
 // else call NTT for the towers for Q
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ)) if(limb_parallel)
         for (size_t i = 0; i < sizeQ; ++i) {
             m_vectors[i].SwitchFormat();
         }
@@ -1408,7 +1256,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::ApproxModDown(
 
     DCRTPolyImpl<VecType> partP(paramsP, m_format, true);
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP)) if(limb_parallel)
     for (usint j = 0; j < sizeP; ++j) {
         partP.m_vectors[j] = m_vectors[sizeQ + j];
         partP.m_vectors[j].SetFormat(Format::COEFFICIENT);
@@ -1427,7 +1275,7 @@ DCRTPolyImpl<VecType> DCRTPolyImpl<VecType>::ApproxModDown(
     if (diffQ > 0)
         ans.DropLastElements(diffQ);
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ)) if(limb_parallel)
     for (usint i = 0; i < sizeQ; ++i) {
         // Multiply everything by t mod Q (BGVrns only)
         if (t > 0)
@@ -1597,7 +1445,7 @@ void DCRTPolyImpl<VecType>::ExpandCRTBasis(
 
     m_vectors.resize(sizeQP);
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeP)) if(limb_parallel)
     // populate the towers corresponding to CRT basis P and convert them to
     // evaluation representation
     for (size_t j = 0; j < sizeP; j++) {
@@ -1614,7 +1462,7 @@ void DCRTPolyImpl<VecType>::ExpandCRTBasis(
         }
         else {
             // else call NTT for the towers for Q
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ)) if(limb_parallel)
             for (size_t i = 0; i < sizeQ; i++)
                 m_vectors[i].SetFormat(Format::EVALUATION);
         }
@@ -1652,7 +1500,7 @@ void DCRTPolyImpl<VecType>::ExpandCRTBasisReverseOrder(
                 std::make_move_iterator(partP.m_vectors.end()));
     temp.insert(temp.end(), std::make_move_iterator(m_vectors.begin()), std::make_move_iterator(m_vectors.end()));
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQP))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQP)) if(limb_parallel)
     for (size_t i = 0; i < sizeQP; i++) {
         temp[i].SetFormat(resultFormat);
     }
@@ -1666,7 +1514,7 @@ void DCRTPolyImpl<VecType>::ExpandCRTBasisReverseOrder(
         }
         else {
             // else call NTT for the towers for Q
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQ)) if(limb_parallel)
             for (size_t i = 0; i < sizeQ; i++)
                 temp[sizeP + i].SetFormat(Format::EVALUATION);
         }
@@ -1785,7 +1633,7 @@ void DCRTPolyImpl<VecType>::ExpandCRTBasisQlHat(const std::shared_ptr<Params>& p
     OPENFHE_THROW(not_implemented_error, "yt: not use");
     size_t sizeQl(m_vectors.size());
     usint ringDim(m_params->GetRingDimension());
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQl))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(sizeQl)) if(limb_parallel)
     for (size_t i = 0; i < sizeQl; i++) {
         const NativeInteger& qi               = m_vectors[i].GetModulus();
         const NativeInteger& QlHatModqi       = QlHatModq[i];
@@ -2468,12 +2316,12 @@ void DCRTPolyImpl<VecType>::FastBaseConvqToBskMontgomery(
             m_vectors[i] = polyInNTT[i];
     }
     else {  // else call NTT for the towers for q
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(numQ))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(numQ)) if(limb_parallel)
         for (size_t i = 0; i < numQ; i++)
             m_vectors[i].SwitchFormat();
     }
 
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(numBsk))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(numBsk)) if(limb_parallel)
     for (uint32_t i = 0; i < numBsk; i++)
         m_vectors[numQ + i].SwitchFormat();
 
@@ -2606,26 +2454,19 @@ void DCRTPolyImpl<VecType>::FastBaseConvSK(
 
     uint32_t n = this->GetLength();
 
+    std::vector<const PolyType*> sources;
     for (uint32_t i = 0; i < sizeBsk - 1; i++) {  // exclude msk residue
-        const NativeInteger& currentBDivBiModBi       = BHatInvModb[i];
-        const NativeInteger& currentBDivBiModBiPrecon = BHatInvModbPrecon[i];
-    // // #pragma omp parallel for
-        for (uint32_t k = 0; k < n; k++) {
-            m_vectors[sizeQ + i][k].ModMulFastConstEq(currentBDivBiModBi, moduliBsk[i], currentBDivBiModBiPrecon);
-        }
+        m_vectors[sizeQ + i] *= BHatInvModb[i];
+        sources.push_back(&m_vectors[sizeQ + i]);
     }
 
+    /* batched base conversion B -> q (bconv_batch, residues are not centered) */
+    std::vector<NativeInteger> scalars(sizeBsk - 1);
     for (uint32_t j = 0; j < sizeQ; j++) {
-    // // #pragma omp parallel for
-        for (uint32_t k = 0; k < n; k++) {
-            DoubleNativeInt result = 0;
-            for (uint32_t i = 0; i < sizeBsk - 1; i++) {  // exclude msk residue
-                const NativeInteger& currentBDivBiModqj = BHatModq[i][j];
-                const NativeInteger& xi                 = m_vectors[sizeQ + i][k];
-                result += Mul128(xi.ConvertToInt(), currentBDivBiModqj.ConvertToInt());
-            }
-            m_vectors[j][k] = BarrettUint128ModUint64(result, moduliQ[j].ConvertToInt(), modqBarrettMu[j]);
-        }
+        for (uint32_t i = 0; i < sizeBsk - 1; i++)
+            scalars[i] = BHatModq[i][j];
+        m_vectors[j] = PolyType(m_vectors[j].GetParams(), m_vectors[j].GetFormat(), true);
+        m_vectors[j].bconv_batch(sources, scalars, false);
     }
 
     // calculate alphaskx
@@ -2796,7 +2637,7 @@ void DCRTPolyImpl<VecType>::SwitchFormat() {
     // std::cout << "DCRTPolyImpl::SwitchFormat" << std::endl; // use 298
     m_format = (m_format == Format::COEFFICIENT) ? Format::EVALUATION : Format::COEFFICIENT;
     size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
     for (size_t i = 0; i < size; ++i)
         m_vectors[i].SwitchFormat();
 }
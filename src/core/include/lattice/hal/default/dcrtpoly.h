@@ -53,6 +53,13 @@
 #include <utility>
 #include <vector>
 
+/* Limb-parallel DCRTPoly operations (set_limb_parallel, needs WITH_OPENMP)
+    Limbs of one op are posted from several OpenMP threads (#pragma omp ... if(limb_parallel)).
+    Each iteration touches only its own limbs, the shared operands are only read, shadow tracking is sharded
+    and WorkQueue takes several producers, so the limbs run on the consumer workers at the same time.
+    Off : limbs are posted in order by the calling thread (same command trace and eviction access trace every run) */
+extern bool limb_parallel;
+
 namespace lbcrypto {
 
 template <typename VecType>
@@ -139,7 +146,7 @@ public:
     DCRTPolyType& operator-=(const NativeInteger& rhs) override;
     DCRTPolyType& operator*=(const DCRTPolyType& rhs) override {
         size_t size{m_vectors.size()};
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
         for (size_t i = 0; i < size; ++i)
             m_vectors[i] *= rhs.m_vectors[i];
         return *this;
@@ -170,7 +177,7 @@ public:
         if (m_vectors[0].GetModulus() != rhs.m_vectors[0].GetModulus())
             OPENFHE_THROW(math_error, "Modulus missmatch");
         DCRTPolyType tmp(m_params, m_format);
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
         for (size_t i = 0; i < size; ++i)
             tmp.m_vectors[i] = m_vectors[i].PlusNoCheck(rhs.m_vectors[i]);
         return tmp;
@@ -191,7 +198,7 @@ public:
         if (m_vectors[0].GetModulus() != rhs.m_vectors[0].GetModulus())
             OPENFHE_THROW(math_error, "Modulus missmatch");
         DCRTPolyType tmp(m_params, m_format);
-// // #pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size))
+#pragma omp parallel for num_threads(OpenFHEParallelControls.GetThreadLimit(size)) if(limb_parallel)
         for (size_t i = 0; i < size; ++i)
             tmp.m_vectors[i] = m_vectors[i].TimesNoCheck(rhs.m_vectors[i]);
         return tmp;
@@ -211,6 +218,13 @@ public:
     bool InverseExists() const override;
     bool IsEmpty() const override;
 
+    /* Prefetch hint of every limb (PolyImpl::PrefetchToDevice), limbs are staged on the on-chip buffer
+        by the consumer while the host posts the tasks before their use */
+    void PrefetchToDevice() const {
+        for (const auto& v : m_vectors)
+            v.PrefetchToDevice();
+    }
+
     void SetValuesToZero() override;
     void AddILElementOne() override;
     void DropLastElement() override;
@@ -58,16 +58,17 @@ void inc_copy_from_inv_root_shadow_hbm_real();
 
 /* function for fhe unit operation (utils/math_utils.cpp)*/
 extern void PlainModMul(uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size);
+extern void PlainModMulAdd(uint64_t* acc, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size);
 extern void PlainModMulScalar(uint64_t* res, const uint64_t* op1, uint64_t modulus, uint64_t scalar, size_t size);
 extern void PlainModMulEqScalar(uint64_t* op1, uint64_t modulus, uint64_t scalar, size_t size);
-extern void PlainModMulEqScalar_one(uint64_t* op1, uint64_t modulus, uint64_t scalar, uint64_t pq0, uint64_t pq1);
-extern void divide_uint192_inplace(uint64_t *numerator, uint64_t denominator, uint64_t *quotient);
+extern void PlainSeededUniform(uint64_t* res, const uint32_t* seed, uint64_t stream, uint64_t modulus, size_t size);
 
 extern std::chrono::duration<double, std::milli> elapsed_getwork;
 extern std::chrono::duration<double, std::milli> elapsed_work;
 
 #include "utils/custom_task.h"
 #include "utils/memory_tracking.h"
+#include "utils/mod_kernels.h"
 #include "utils/logger.h"
 extern WorkQueue work_queue;
 
@@ -114,43 +115,25 @@ PolyImpl<VecType>::PolyImpl(const TugType& tug, const std::shared_ptr<PolyImpl::
     copy polynomial rhs -> this */
 template <typename VecType>
 PolyImpl<VecType>& PolyImpl<VecType>::operator=(const PolyImpl& rhs) noexcept {
+    rhs.wait_shadow();
+    this->wait_shadow();
     m_format = rhs.m_format;
     m_params = rhs.m_params;
-    ocb_entries_m.lock();
-    rhs.m_values_shadow.ongoing_flag = true;
-    ocb_entries_m.unlock();
+    rhs.m_values_shadow.pin();
     if (!rhs.m_values) {
         m_values = nullptr;
-        if(rhs.m_values_shadow.m_values){
-            this->create_shadow();
-            this->copy_from_other_shadow(rhs.m_values_shadow);
-            ocb_entries_m.lock();
-            rhs.m_values_shadow.ongoing_flag = false;
-            ocb_entries_m.unlock();
-
-        }
-        return *this;
     }
-    if (m_values) {
+    else if (m_values) {
         *m_values = *rhs.m_values;
-        if(rhs.m_values_shadow.m_values){
-            this->create_shadow();
-            this->copy_from_other_shadow(rhs.m_values_shadow);
-            ocb_entries_m.lock();
-            rhs.m_values_shadow.ongoing_flag = false;
-            ocb_entries_m.unlock();
-
-        }
-        return *this;
     }
-    m_values = std::make_unique<VecType>(*rhs.m_values);
+    else {
+        m_values = std::make_unique<VecType>(*rhs.m_values);
+    }
     if(rhs.m_values_shadow.m_values){
         this->create_shadow();
         this->copy_from_other_shadow(rhs.m_values_shadow);
-        ocb_entries_m.lock();
-        rhs.m_values_shadow.ongoing_flag = false;
-        ocb_entries_m.unlock();
     }
+    rhs.m_values_shadow.unpin();
     return *this;
 }
 
@@ -253,6 +236,7 @@ void PolyImpl<VecType>::SetValues(const VecType& values, Format format) {
         OPENFHE_THROW(type_error, "Polynomial has a 0 root of unity");
     if (m_params->GetRingDimension() != values.GetLength() || m_params->GetModulus() != values.GetModulus())
         OPENFHE_THROW(type_error, "Parameter mismatch on SetValues for Polynomial");
+    this->wait_shadow();
     m_format = format;
     m_values = std::make_unique<VecType>(values);
     this->indicate_modified_orig();
@@ -264,6 +248,7 @@ void PolyImpl<VecType>::SetValues(VecType&& values, Format format) {
         OPENFHE_THROW(type_error, "Polynomial has a 0 root of unity");
     if (m_params->GetRingDimension() != values.GetLength() || m_params->GetModulus() != values.GetModulus())
         OPENFHE_THROW(type_error, "Parameter mismatch on SetValues for Polynomial");
+    this->wait_shadow();
     m_format = format;
     m_values = std::make_unique<VecType>(std::move(values));
     this->indicate_modified_orig();
@@ -275,6 +260,7 @@ void PolyImpl<VecType>::SetValuesShadow(const VecType& values, Format format) {
         OPENFHE_THROW(type_error, "Polynomial has a 0 root of unity");
     if (m_params->GetRingDimension() != values.GetLength() || m_params->GetModulus() != values.GetModulus())
         OPENFHE_THROW(type_error, "Parameter mismatch on SetValues for Polynomial");
+    this->wait_shadow();
     m_format = format;
     m_values = std::make_unique<VecType>(values);
     if(m_values_shadow.shadow_sync_state == SHADOW_NOTEXIST) this->create_shadow();
@@ -285,11 +271,7 @@ void PolyImpl<VecType>::SetValuesShadow(const VecType& values, Format format) {
     m_values_shadow.shadow_sync_state = SHADOW_SYNCHED;
     if(compute_flag){
         // std::cout << "ORIGIN --> OCB(SetValuesShadow)" << std::endl;
-        std::ofstream file("commandrecord.csv", std::ios::app);
-        if (file.is_open()) {
-            file << "D, " << "PCIE, " << (uint64_t)m_values_shadow.get_ptr() << ", " << (uint64_t)&m_values->m_data[0] << std::endl;
-            file.close();
-        }
+        this->trace_transfer(TRACE_LINK_PCIE, (uint64_t)m_values_shadow.get_ptr(), (uint64_t)&m_values->m_data[0]);
     }
 }
 
@@ -299,6 +281,7 @@ void PolyImpl<VecType>::SetValuesShadow(VecType&& values, Format format) {
         OPENFHE_THROW(type_error, "Polynomial has a 0 root of unity");
     if (m_params->GetRingDimension() != values.GetLength() || m_params->GetModulus() != values.GetModulus())
         OPENFHE_THROW(type_error, "Parameter mismatch on SetValues for Polynomial");
+    this->wait_shadow();
     m_format = format;
     m_values = std::make_unique<VecType>(values);
     if(m_values_shadow.shadow_sync_state == SHADOW_NOTEXIST) this->create_shadow();
@@ -309,11 +292,7 @@ void PolyImpl<VecType>::SetValuesShadow(VecType&& values, Format format) {
     m_values_shadow.shadow_sync_state = SHADOW_SYNCHED;
     if(compute_flag){
         // std::cout << "ORIGIN --> OCB(SetValuesShadow)" << std::endl;
-        std::ofstream file("commandrecord.csv", std::ios::app);
-        if (file.is_open()) {
-            file << "D, " << "PCIE, " << (uint64_t)m_values_shadow.get_ptr() << ", " << (uint64_t)&m_values->m_data[0] << std::endl;
-            file.close();
-        }
+        this->trace_transfer(TRACE_LINK_PCIE, (uint64_t)m_values_shadow.get_ptr(), (uint64_t)&m_values->m_data[0]);
     }
 }
 
@@ -335,16 +314,14 @@ template <>
 PolyImpl<NativeVector> PolyImpl<NativeVector>::Plus(const typename NativeVector::Integer& element) const {
     PolyImpl<NativeVector> tmp(m_params, m_format);
 
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_PlusScalar);
+    TASK_ITEM(item, TASK_TYPE_PlusScalar);
 
     item->poly = (void*)this;
     item->poly2 = (void*)&tmp;
     item->param1 = element.ConvertToInt();
     item->modulus = m_params->GetModulus().m_value;
 
-    work_queue.addWork(item);
-
-    delete item;
+    offload(item);
 
     return tmp;
 }
@@ -363,16 +340,14 @@ template <>
 PolyImpl<NativeVector> PolyImpl<NativeVector>::Minus(const typename NativeVector::Integer& element) const {
     PolyImpl<NativeVector> tmp(m_params, m_format);
     
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_MinusScalar);
+    TASK_ITEM(item, TASK_TYPE_MinusScalar);
 
     item->poly = (void*)this;
     item->poly2 = (void*)&tmp;
     item->param1 = element.ConvertToInt();
     item->modulus = m_params->GetModulus().m_value;
 
-    work_queue.addWork(item);
-
-    delete item;
+    offload(item);
 
     return tmp;
 }
@@ -391,16 +366,14 @@ template <>
 PolyImpl<NativeVector> PolyImpl<NativeVector>::Times(const typename NativeVector::Integer& element) const {
     PolyImpl<NativeVector> tmp(m_params, m_format);    
     
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_PlainModMulScalar);
+    TASK_ITEM(item, TASK_TYPE_PlainModMulScalar);
 
     item->poly = (void*)this;
     item->poly2 = (void*)&tmp;
     item->param1 = element.m_value;
     item->modulus = m_params->GetModulus().m_value;
 
-    work_queue.addWork(item);
-    
-    delete item;
+    offload(item);
 
     return tmp;
 }
@@ -440,16 +413,14 @@ PolyImpl<NativeVector> PolyImpl<NativeVector>::Times(NativeInteger::SignedNative
         if (elementReduced > q)
             elementReduced.ModEq(q);
         
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_PlainModMulScalar);
+        TASK_ITEM(item, TASK_TYPE_PlainModMulScalar);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&tmp;
         item->param1 = -element;
         item->modulus = m_params->GetModulus().m_value;
 
-        work_queue.addWork(item);
-        
-        delete item;
+        offload(item);
 
     }
     else {
@@ -457,16 +428,14 @@ PolyImpl<NativeVector> PolyImpl<NativeVector>::Times(NativeInteger::SignedNative
         if (elementReduced > q)
             elementReduced.ModEq(q);
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_PlainModMulScalar);
+        TASK_ITEM(item, TASK_TYPE_PlainModMulScalar);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&tmp;
         item->param1 = elementReduced.m_value;
         item->modulus = m_params->GetModulus().m_value;
 
-        work_queue.addWork(item);
-        
-        delete item;
+        offload(item);
     }
     return tmp;
 }
@@ -483,15 +452,13 @@ PolyImpl<VecType>& PolyImpl<VecType>::operator*=(const Integer& element) {
 template <>
 PolyImpl<NativeVector>& PolyImpl<NativeVector>::operator*=(const Integer& element) { 
            
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_PlainModMulEqScalar);
+    TASK_ITEM(item, TASK_TYPE_PlainModMulEqScalar);
 
     item->poly = this;
     item->param1 = element.m_value;
     item->modulus = m_params->GetModulus().m_value;
 
-    work_queue.addWork(item);
-
-    delete item;
+    offload(item);
 
     return *this;
 }
@@ -512,16 +479,14 @@ template <>
 PolyImpl<NativeVector> PolyImpl<NativeVector>::Minus(const PolyImpl& rhs) const {
     PolyImpl<NativeVector> tmp(m_params, m_format);
     
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_Minus);
+    TASK_ITEM(item, TASK_TYPE_Minus);
 
     item->poly = (void*)this;
     item->poly2 = (void*)&tmp;
     item->poly3 = (void*)&rhs;
     item->modulus = m_params->GetModulus().m_value;
 
-    work_queue.addWork(item);
-    
-    delete item;
+    offload(item);
 
     return tmp;
 }
@@ -566,14 +531,12 @@ PolyImpl<VecType>& PolyImpl<VecType>::operator+=(const PolyImpl& element) {
 
 template <>
 PolyImpl<NativeVector>& PolyImpl<NativeVector>::operator+=(const PolyImpl& element) {
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_PlusInPlace);
+    TASK_ITEM(item, TASK_TYPE_PlusInPlace);
 
     item->poly = (void*)this;
     item->poly2 = (void*)&element;
-    work_queue.addWork(item);
     item->modulus = m_params->GetModulus().m_value;
-    
-    delete item;
+    offload(item);
    
     return *this;
 }
@@ -594,14 +557,12 @@ PolyImpl<VecType>& PolyImpl<VecType>::operator-=(const PolyImpl& element) {
 
 template <>
 PolyImpl<NativeVector>& PolyImpl<NativeVector>::operator-=(const PolyImpl& element) {
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_MinusInPlace);
+    TASK_ITEM(item, TASK_TYPE_MinusInPlace);
 
     item->poly = (void*)this;
     item->poly2 = (void*)&element;
     item->modulus = m_params->GetModulus().m_value;
-    work_queue.addWork(item);
-    
-    delete item;
+    offload(item);
 
     return *this;
 }
@@ -691,6 +652,24 @@ PolyImpl<VecType> PolyImpl<VecType>::AutomorphismTransform(uint32_t k, const std
 }
 
 
+template <>
+void PolyImpl<NativeVector>::TransferToDevice(uint32_t device, bool migrate) const {
+    uint32_t from = GetDevice();
+    if (num_devices <= 1 || device == from)
+        return;
+
+    TASK_ITEM(item, TASK_TYPE_DeviceTransfer);
+
+    item->poly = (void*)this;
+    item->param1 = m_params->GetRingDimension();
+    item->param2 = device;
+    item->param3 = migrate;
+    item->modulus = m_params->GetModulus().m_value;
+    item->device = from;
+
+    offload(item);
+}
+
 template <>
 PolyImpl<NativeVector> PolyImpl<NativeVector>::AutomorphismTransform(uint32_t k, const std::vector<uint32_t>& precomp) const {
     if ((m_format != Format::EVALUATION) || (m_params->GetRingDimension() != (m_params->GetCyclotomicOrder() >> 1)))
@@ -700,16 +679,16 @@ PolyImpl<NativeVector> PolyImpl<NativeVector>::AutomorphismTransform(uint32_t k,
     PolyImpl<NativeVector> tmp(m_params, m_format, true);
     uint32_t n = m_params->GetRingDimension();
     
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_AutomorphismTransform);
+    CustomTaskItem item(TASK_TYPE_AutomorphismTransform);
 
-    item->poly = (void*)this;
-    item->poly2 = (void*)&tmp;
-    item->ptr32_1 = (uint32_t*)&precomp[0];
-    item->param1 = n;
-    item->modulus = m_params->GetModulus().m_value;
-    work_queue.addWork(item);
-    
-    delete item;
+    item.poly = (void*)this;
+    item.poly2 = (void*)&tmp;
+    item.ptr32_1 = (uint32_t*)&precomp[0];
+    item.param1 = n;
+    item.modulus = m_params->GetModulus().m_value;
+    /* precomp table is owned by the caller and can be released right after this call,
+        so automorphism is always posted synchronously */
+    device_queues[task_device(&item)]->addWork(&item, async_offload);
 
     return tmp;
 }
@@ -756,7 +735,9 @@ void PolyImpl<VecType>::SwitchModulus(const Integer& modulus, const Integer& roo
 template <>
 void PolyImpl<NativeVector>::SwitchModulus(const Integer& modulus, const Integer& rootOfUnity, const Integer& modulusArb,
                                       const Integer& rootOfUnityArb) {
-    auto size{m_values_shadow.m_values->size()};
+    /* m_params is changed below, and consumer reads m_params of the posted tasks */
+    this->wait_shadow();
+    auto size{m_params->GetRingDimension()};
     auto halfQ{m_params->GetModulus().m_value >> 1};
     auto om{m_params->GetModulus().m_value};
     if (m_values != nullptr) { 
@@ -764,7 +745,7 @@ void PolyImpl<NativeVector>::SwitchModulus(const Integer& modulus, const Integer
     }
     auto nm{modulus.m_value};
 
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_SwitchModulus);
+    TASK_ITEM(item, TASK_TYPE_SwitchModulus);
 
     item->poly = (void*)this;
     item->param1 = size;
@@ -772,9 +753,14 @@ void PolyImpl<NativeVector>::SwitchModulus(const Integer& modulus, const Integer
     item->param3 = om;
     item->param4 = nm;
     item->modulus = m_params->GetModulus().m_value;
-    work_queue.addWork(item);
-    
-    delete item;
+    offload(item);
+
+    /* new modulus on another device : the limb moves there, tasks of the old device finish before m_params is changed */
+    uint32_t to = device_of_modulus(nm);
+    if (to != GetDevice()) {
+        TransferToDevice(to, true);
+        this->wait_shadow();
+    }
 
     auto c{m_params->GetCyclotomicOrder()};
     m_params = std::make_shared<PolyImpl::Params>(c, modulus, rootOfUnity, modulusArb, rootOfUnityArb);
@@ -786,7 +772,7 @@ void PolyImpl<NativeVector>::bconv_pipe(const Integer& modulus, const Integer& r
                                       const Integer& element,
                                       PolyImpl& element2
                                       ) {
-    auto size{m_values_shadow.m_values->size()};
+    auto size{m_params->GetRingDimension()};
     auto halfQ{m_params->GetModulus().m_value >> 1};
     auto om{m_params->GetModulus().m_value};
     if (m_values != nullptr) { 
@@ -794,7 +780,7 @@ void PolyImpl<NativeVector>::bconv_pipe(const Integer& modulus, const Integer& r
     }
     auto nm{modulus.m_value};
 
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_BCONV_PIPE);
+    TASK_ITEM(item, TASK_TYPE_BCONV_PIPE);
 
     // switch
     item->poly = (void*)&element2;
@@ -806,10 +792,78 @@ void PolyImpl<NativeVector>::bconv_pipe(const Integer& modulus, const Integer& r
     item->poly2 = (void*)this;
     // mult_scalar
     item->param5 = element.m_value;
+    item->modulus = nm;
 
-    work_queue.addWork(item);
-    
-    delete item; // Clean up
+    offload(item);
+}
+
+template <>
+void PolyImpl<NativeVector>::bconv_batch(const std::vector<const PolyImpl*>& sources,
+                                         const std::vector<NativeInteger>& scalars, bool centered) {
+    if (sources.empty())
+        return;
+    if (sources.size() != scalars.size())
+        OPENFHE_THROW(math_error, "bconv_batch: number of sources and scalars mismatch");
+    auto nm{m_params->GetModulus().m_value};
+
+    TASK_ITEM(item, TASK_TYPE_BCONV_BATCH);
+
+    item->poly = (void*)this;
+    item->param1 = m_params->GetRingDimension();
+    item->param4 = nm;
+    item->modulus = nm;
+    // (source modulus, halfQ, scalar) of every source, halfQ = om : no centered lift (residues are below om)
+    item->inputs.reserve(sources.size());
+    item->input_params.reserve(3 * sources.size());
+    for (size_t k = 0; k < sources.size(); k++) {
+        auto om{sources[k]->m_params->GetModulus().m_value};
+        item->inputs.push_back((void*)sources[k]);
+        item->input_params.push_back(om);
+        item->input_params.push_back(centered ? (om >> 1) : om);
+        item->input_params.push_back(scalars[k].m_value);
+    }
+
+    offload(item);
+}
+
+template <>
+void PolyImpl<NativeVector>::PrefetchToDevice() const {
+    if (!prefetch_enabled)
+        return;
+    if (!async_offload) {
+        // the task would run inline : host waits for the transfer and nothing overlaps it
+        inc_prefetch_dropped();
+        return;
+    }
+    uint32_t expected = SHADOW_PREFETCH_NONE;
+    if (!m_values_shadow.prefetch_state.compare_exchange_strong(expected, SHADOW_PREFETCH_POSTED))
+        return;
+    inc_prefetch_posted();
+
+    TASK_ITEM(item, TASK_TYPE_Prefetch);
+
+    item->poly = (void*)this;
+    item->param1 = m_params->GetRingDimension();
+    item->device = device_of_modulus(m_params->GetModulus().m_value);
+
+    offload(item);
+}
+
+template <>
+void PolyImpl<NativeVector>::GenerateSeeded(const std::vector<uint32_t>& seed, uint64_t stream) {
+    if (seed.size() != 16)
+        OPENFHE_THROW(math_error, "GenerateSeeded: seed must have 16 words");
+
+    TASK_ITEM(item, TASK_TYPE_SeededUniform);
+
+    item->poly = (void*)this;
+    item->param1 = m_params->GetRingDimension();
+    item->modulus = m_params->GetModulus().m_value;
+    // seed words, then the stream
+    item->input_params.assign(seed.begin(), seed.end());
+    item->input_params.push_back(stream);
+
+    offload(item);
 }
 
 template <typename VecType>
@@ -854,32 +908,28 @@ void PolyImpl<NativeVector>::SwitchFormat() {
     if (m_format != Format::COEFFICIENT) {   
         m_format = Format::COEFFICIENT;
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_SwitchFormatInverseTransform);
+        TASK_ITEM(item, TASK_TYPE_SwitchFormatInverseTransform);
 
         item->poly = (void*)this;
         item->param1 = co;
         item->param2 = ru.ConvertToInt();
         item->param3 = m_params->GetModulus().m_value;
         item->modulus = m_params->GetModulus().m_value;
-        work_queue.addWork(item);
-
-        delete item;
+        offload(item);
 
         return;
     }
 
     m_format = Format::EVALUATION;
 
-    CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_SwitchFormatForwardTransform);
+    TASK_ITEM(item, TASK_TYPE_SwitchFormatForwardTransform);
 
     item->poly = (void*)this;
     item->param1 = co;
     item->param2 = ru.ConvertToInt();
     item->param3 = m_params->GetModulus().m_value;
     item->modulus = m_params->GetModulus().m_value;
-    work_queue.addWork(item);
-    
-    delete item;
+    offload(item);
 }
 
 template <typename VecType>
@@ -1045,14 +1095,20 @@ inline PolyImpl<NativeVector> PolyImpl<NativeVector>::ToNativePoly() const {
 */
 #include <chrono>
 
-void consumer(WorkQueue& queue) {
+/* Several consumers (workers) can run at the same time (set_num_consumer_workers).
+    WorkQueue gives a worker only tasks whose polynomials are not used by the other workers,
+    so independent limbs are processed in parallel.
+    Root table (ntt_mod_set) is modeled per worker. */
+void consumer(WorkQueue& queue, uint32_t worker_id) {
     std::vector<CustomTaskItem*> items;
     
-    std::cout << "consumer thread: started" << std::endl;
+    std::cout << "consumer thread " << worker_id << ": started" << std::endl;
+    queue.markConsumerThread();
+    WorkerStat& stat = queue.getWorkerStat(worker_id);
     
     auto start = std::chrono::high_resolution_clock::now();
 
-    bool success = queue.getWork(items) ;
+    bool success = queue.getWork(items, worker_id) ;
 
     // Logger logger("log.csv");
     // logger.logFunctionStart("exampleFunction");
@@ -1070,17 +1126,18 @@ void consumer(WorkQueue& queue) {
         for(auto item:items)
         {
             // Process the item
+            auto start_task = std::chrono::steady_clock::now();
 
             PolyImpl<NativeVector>* poly = (PolyImpl<NativeVector>*)item->poly;
             PolyImpl<NativeVector>* poly2 = (PolyImpl<NativeVector>*)item->poly2;
             PolyImpl<NativeVector>* poly3 = (PolyImpl<NativeVector>*)item->poly3;
+            PolyImpl<NativeVector>* poly4 = (PolyImpl<NativeVector>*)item->poly4;
+            PolyImpl<NativeVector>* poly5 = (PolyImpl<NativeVector>*)item->poly5;
 
             switch(item->task_type) {
                 case TASK_TYPE_PlainModMulEqScalar: {
                         // if(compute_flag) std::cout << "TASK_TYPE_PlainModMulEqScalar" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                     
@@ -1092,28 +1149,19 @@ void consumer(WorkQueue& queue) {
                         );    
 
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                 
                         inc_compute_implemented();
                         inc_mult();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Mult, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                << "0" << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)poly->m_values_shadow.get_ptr(), 0, 0);
                         }
+                        poly->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_PlusScalar: {
                         // if(compute_flag) std::cout << "TASK_TYPE_PlusScalar" << std::endl;
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly2->m_values_shadow.pin();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
                         poly2->create_shadow();
                         // if(compute_flag) std::cout << "poly" << std::endl;
@@ -1123,36 +1171,23 @@ void consumer(WorkQueue& queue) {
                         uint64_t* result    = poly2->m_values_shadow.get_ptr();
                         uint64_t modulus    = poly->m_params->GetModulus().m_value;
 
-                        for(size_t i=0; i<poly->m_values_shadow.m_values->size(); i++){
-                            uint64_t x = op1[i];
-                            x += item->param1;
-                            result[i] = x >= modulus ? x - modulus : x;
-                        }
+                        mod_add_scalar(result, op1, item->param1, modulus, poly->m_values_shadow.m_values->size());
 
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         
                         inc_compute_implemented();
                         inc_add();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Add, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_ADD, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly->m_values_shadow.get_ptr(), 0);
                         }
+                        poly2->m_values_shadow.unpin();
+                        poly->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_MinusScalar: {
                         // if(compute_flag) std::cout << "TASK_TYPE_MinusScalar" << std::endl;
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly2->m_values_shadow.pin();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
                         poly2->create_shadow();
                         // if(compute_flag) std::cout << "poly" << std::endl;
@@ -1162,37 +1197,23 @@ void consumer(WorkQueue& queue) {
                         uint64_t* result    = poly2->m_values_shadow.get_ptr();
                         uint64_t modulus    = poly->m_params->GetModulus().m_value;
 
-                        for(size_t i=0; i<poly->m_values_shadow.m_values->size(); i++){
-                            uint64_t x = op1[i];
-                            unsigned long long temp = x - item->param1;
-                            std::int64_t borrow = (temp > x);
-                            result[i] = static_cast<std::uint64_t>(temp) + (modulus & static_cast<std::uint64_t>(-borrow));
-                        }
+                        mod_sub_scalar(result, op1, item->param1, modulus, poly->m_values_shadow.m_values->size());
 
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         
                         inc_compute_implemented();
                         inc_sub();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Sub, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_SUB, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly->m_values_shadow.get_ptr(), 0);
                         }
+                        poly2->m_values_shadow.unpin();
+                        poly->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_PlainModMulScalar:   {
                         // if(compute_flag) std::cout << "TASK_TYPE_PlainModMulScalar" << std::endl;
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly2->m_values_shadow.pin();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
                         poly2->create_shadow();
                         // if(compute_flag) std::cout << "poly" << std::endl;
@@ -1207,29 +1228,20 @@ void consumer(WorkQueue& queue) {
                         );
                         
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_mult();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Mult, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly->m_values_shadow.get_ptr(), 0);
                         }
+                        poly2->m_values_shadow.unpin();
+                        poly->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_Minus: {
                         // if(compute_flag) std::cout << "TASK_TYPE_Minus" << std::endl;
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        poly->m_values_shadow.ongoing_flag = true;
-                        poly3->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly2->m_values_shadow.pin();
+                        poly->m_values_shadow.pin();
+                        poly3->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
                         poly2->create_shadow();
                         // if(compute_flag) std::cout << "poly" << std::endl;
@@ -1242,37 +1254,23 @@ void consumer(WorkQueue& queue) {
                         uint64_t* result    = poly2->m_values_shadow.get_ptr();
                         uint64_t modulus    = poly->m_params->GetModulus().m_value;
 
-                        for(size_t i=0; i<poly->m_values_shadow.m_values->size(); i++){
-                            uint64_t x = op1[i];
-                            unsigned long long temp = x - op2[i];
-                            std::int64_t borrow = (temp > x);
-                            result[i] = static_cast<std::uint64_t>(temp) + (modulus & static_cast<std::uint64_t>(-borrow));
-                        }
+                        mod_sub(result, op1, op2, modulus, poly->m_values_shadow.m_values->size());
 
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        poly->m_values_shadow.ongoing_flag = false;
-                        poly3->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_sub();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Sub, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly->m_values_shadow.get_ptr() << ", " << (uint64_t)poly3->m_values_shadow.get_ptr() << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_SUB, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly3->m_values_shadow.get_ptr());
                         }   
+                        poly2->m_values_shadow.unpin();
+                        poly->m_values_shadow.unpin();
+                        poly3->m_values_shadow.unpin();
                     }   
                     break;
                 case TASK_TYPE_PlusInPlace: {
                         // if(compute_flag) std::cout << "TASK_TYPE_PlusInPlace" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
@@ -1283,35 +1281,23 @@ void consumer(WorkQueue& queue) {
                         
                         uint64_t modulus = poly->m_params->GetModulus().m_value;
 
-                        for(size_t i=0; i<poly->m_values_shadow.m_values->size(); i++){
-                            uint64_t sum = op1[i] + op2[i];
-                            op1[i] = sum >= modulus ? sum - modulus : sum;
-                        }
+                        mod_add(op1, op1, op2, modulus, poly->m_values_shadow.m_values->size());
                         
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
 
                         inc_compute_implemented();
                         inc_add();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Add, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly2->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_ADD, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly2->m_values_shadow.get_ptr(), 0);
                         }
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_MinusInPlace: {
                         // if(compute_flag) std::cout << "TASK_TYPE_MinusInPlace" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
@@ -1321,37 +1307,23 @@ void consumer(WorkQueue& queue) {
                         const uint64_t* op2 = poly2->m_values_shadow.get_ptr();
                         uint64_t modulus = poly->m_params->GetModulus().m_value;
 
-                        unsigned long long temp_result;
-                        for(size_t i=0; i<poly->m_values_shadow.m_values->size(); i++){
-                            temp_result = op1[i] - op2[i];
-                            std::int64_t borrow = static_cast<unsigned char>(op2[i] > op1[i]);
-                            op1[i] = temp_result + (modulus & static_cast<std::uint64_t>(-borrow));
-                        }
+                        mod_sub(op1, op1, op2, modulus, poly->m_values_shadow.m_values->size());
 
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
 
                         inc_compute_implemented();
                         inc_sub();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Sub, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly2->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_SUB, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly2->m_values_shadow.get_ptr(), 0);
                         }
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_AutomorphismTransform: {
                         // if(compute_flag) std::cout << "TASK_TYPE_AutomorphismTransform" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
@@ -1361,28 +1333,19 @@ void consumer(WorkQueue& queue) {
                             (*poly2->m_values_shadow.m_values)[j] = (*poly->m_values_shadow.m_values)[item->ptr32_1[j]];
 
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
 
                         inc_compute_implemented();
                         inc_auto();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Auto, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_AUTO, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly->m_values_shadow.get_ptr(), 0);
                         }
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_SwitchModulus: {
                         // if(compute_flag) std::cout << "TASK_TYPE_SwitchModulus" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
 
@@ -1403,12 +1366,7 @@ void consumer(WorkQueue& queue) {
                             }
                             inc_add();
                             if(compute_flag){
-                                std::ofstream file("commandrecord.csv", std::ios::app);
-                                if (file.is_open()) {
-                                    file << "C, " << "Add, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                    << "0" << ", " << "0" << std::endl;
-                                        file.close();
-                                }
+                                poly->trace_compute(TRACE_OP_ADD, (uint64_t)poly->m_values_shadow.get_ptr(), 0, 0);
                             }
                         }
                         else {
@@ -1422,19 +1380,12 @@ void consumer(WorkQueue& queue) {
                             }
                             inc_mult();
                             if(compute_flag){
-                                std::ofstream file("commandrecord.csv", std::ios::app);
-                                if (file.is_open()) {
-                                    file << "C, " << "Mult, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                    << "0" << ", " << "0" << std::endl;
-                                    file.close();
-                                }
+                                poly->trace_compute(TRACE_OP_MULT, (uint64_t)poly->m_values_shadow.get_ptr(), 0, 0);
                             }
                         }
 
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.unpin();
 
                         inc_compute_implemented();
                     }
@@ -1457,26 +1408,17 @@ void consumer(WorkQueue& queue) {
                             inc_copy_from_inv_root_shadow_hbm_real();
                         }
 
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                         ChineseRemainderTransformFTT<NativeVector>().InverseTransformFromBitReverseInPlace(NativeInteger::Integer(ru), co, poly->m_values_shadow.get_ptr(),poly->m_values_shadow.m_values->size(),modulus);
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_intt();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "INTT, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                    << "0" << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_INTT, (uint64_t)poly->m_values_shadow.get_ptr(), 0, 0);
                         }
+                        poly->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_SwitchFormatForwardTransform: {
@@ -1497,34 +1439,23 @@ void consumer(WorkQueue& queue) {
                             inc_copy_from_root_shadow_hbm_real();
                         }
 
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                         ChineseRemainderTransformFTT<NativeVector>().ForwardTransformToBitReverseInPlace(NativeInteger::Integer(ru), co, poly->m_values_shadow.get_ptr(),poly->m_values_shadow.m_values->size(),modulus);
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_ntt();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "NTT, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                    << "0" << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_NTT, (uint64_t)poly->m_values_shadow.get_ptr(), 0, 0);
                         }
+                        poly->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_Plus: {
                         // if(compute_flag) std::cout << "TASK_TYPE_Plus" << std::endl;
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        poly3->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly2->m_values_shadow.pin();
+                        poly3->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
                         poly2->copy_to_shadow(); /////////////////////
                         // if(compute_flag) std::cout << "poly3" << std::endl;
@@ -1535,35 +1466,23 @@ void consumer(WorkQueue& queue) {
 
                         uint64_t modulus = poly->m_params->GetModulus().ConvertToInt();
 
-                        for(size_t i=0; i<poly2->m_values_shadow.m_values->size(); i++){
-                            uint64_t sum = op1[i] + op2[i];
-                            op1[i] = sum >= modulus ? sum - modulus : sum;
-                        }
+                        mod_add(op1, op1, op2, modulus, poly2->m_values_shadow.m_values->size());
 
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        poly3->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_add();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Add, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                    << (uint64_t)poly3->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_ADD, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly3->m_values_shadow.get_ptr(), 0);
                         }
+                        poly2->m_values_shadow.unpin();
+                        poly3->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_Times: 
                 case TASK_TYPE_TimesNoCheck: {
                         // if(compute_flag) std::cout << "TASK_TYPE_TimesNoCheck" << std::endl;
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        poly3->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly2->m_values_shadow.pin();
+                        poly3->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
                         poly2->copy_to_shadow();
                         // if(compute_flag) std::cout << "poly3" << std::endl;
@@ -1582,28 +1501,19 @@ void consumer(WorkQueue& queue) {
                         );
                         
                         poly2->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        poly3->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_mult();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Mult, " << (uint64_t)poly2->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly3->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly3->m_values_shadow.get_ptr(), 0);
                         }         
+                        poly2->m_values_shadow.unpin();
+                        poly3->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_TimesInPlace: {
                         // if(compute_flag) std::cout << "TASK_TYPE_TimesInPlace" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow();
                         // if(compute_flag) std::cout << "poly2" << std::endl;
@@ -1622,28 +1532,92 @@ void consumer(WorkQueue& queue) {
                         );
                         
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
                         inc_compute_implemented();
                         inc_mult();
                         if(compute_flag){
-                            std::ofstream file("commandrecord.csv", std::ios::app);
-                            if (file.is_open()) {
-                                file << "C, " << "Mult, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                << (uint64_t)poly2->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                file.close();
-                            }
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly2->m_values_shadow.get_ptr(), 0);
+                        }
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
+                    }
+                    break;
+                case TASK_TYPE_MulAddInPlace: {
+                        // if(compute_flag) std::cout << "TASK_TYPE_MulAddInPlace" << std::endl;
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
+                        poly3->m_values_shadow.pin();
+                        poly->copy_to_shadow();
+                        poly2->copy_to_shadow();
+                        poly3->copy_to_shadow();
+
+                        PlainModMulAdd(
+                            poly->m_values_shadow.get_ptr(),
+                            poly2->m_values_shadow.get_ptr(),
+                            poly3->m_values_shadow.get_ptr(),
+                            poly->m_params->GetModulus().ConvertToInt(),
+                            poly->m_values_shadow.m_values->size()
+                        );
+
+                        poly->indicate_modified_shadow();
+                        inc_compute_implemented();
+                        inc_mult();
+                        inc_add();
+                        /* multiplier and adder of the hardware, the product stays in the pipeline */
+                        if(compute_flag){
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly2->m_values_shadow.get_ptr(), (uint64_t)poly3->m_values_shadow.get_ptr());
+                            poly->trace_compute(TRACE_OP_ADD, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly->m_values_shadow.get_ptr(), 0);
+                        }
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
+                        poly3->m_values_shadow.unpin();
+                    }
+                    break;
+                case TASK_TYPE_MulAddDual: {
+                        // if(compute_flag) std::cout << "TASK_TYPE_MulAddDual" << std::endl;
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
+                        poly3->m_values_shadow.pin();
+                        poly4->m_values_shadow.pin();
+                        poly5->m_values_shadow.pin();
+                        poly->copy_to_shadow();
+                        poly2->copy_to_shadow();
+                        poly3->copy_to_shadow();
+                        poly4->copy_to_shadow();
+                        poly5->copy_to_shadow();
+
+                        uint64_t* acc0 = poly->m_values_shadow.get_ptr();
+                        uint64_t* acc1 = poly2->m_values_shadow.get_ptr();
+                        const uint64_t* c = poly3->m_values_shadow.get_ptr();
+                        uint64_t modulus = poly->m_params->GetModulus().ConvertToInt();
+                        size_t size = poly->m_values_shadow.m_values->size();
+
+                        PlainModMulAdd(acc0, c, poly4->m_values_shadow.get_ptr(), modulus, size);
+                        PlainModMulAdd(acc1, c, poly5->m_values_shadow.get_ptr(), modulus, size);
+
+                        poly->indicate_modified_shadow();
+                        poly2->indicate_modified_shadow();
+                        inc_compute_implemented();
+                        inc_mult();
+                        inc_mult();
+                        inc_add();
+                        inc_add();
+                        if(compute_flag){
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)acc0, (uint64_t)c, (uint64_t)poly4->m_values_shadow.get_ptr());
+                            poly->trace_compute(TRACE_OP_ADD, (uint64_t)acc0, (uint64_t)acc0, 0);
+                            poly->trace_compute(TRACE_OP_MULT, (uint64_t)acc1, (uint64_t)c, (uint64_t)poly5->m_values_shadow.get_ptr());
+                            poly->trace_compute(TRACE_OP_ADD, (uint64_t)acc1, (uint64_t)acc1, 0);
                         }
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
+                        poly3->m_values_shadow.unpin();
+                        poly4->m_values_shadow.unpin();
+                        poly5->m_values_shadow.unpin();
                     }
                     break;
                 case TASK_TYPE_BCONV_PIPE: {
                         // if(compute_flag) std::cout << "TASK_TYPE_BCONV_PIPE" << std::endl;
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = true;
-                        poly2->m_values_shadow.ongoing_flag = true;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.pin();
+                        poly2->m_values_shadow.pin();
                         // if(compute_flag) std::cout << "poly" << std::endl;
                         poly->copy_to_shadow_(); /////////////
                         // if(compute_flag) std::cout << "poly2" << std::endl;
@@ -1660,108 +1634,171 @@ void consumer(WorkQueue& queue) {
 
                         uint64_t modulus = poly->m_params->GetModulus().m_value;
 
-                        uint64_t numerator[3]{ 0, 0, 1 };
-                        uint64_t quotient[3]{ 0, 0, 0 };
-                        divide_uint192_inplace(numerator, nm, quotient);
-                        uint64_t pq0 = quotient[0];
-                        uint64_t pq1 = quotient[1];
-
+                        /* centered lift of the source residue (om) to nm, then acc += v * mult_scalar.
+                            up : nm > om, down : nm <= om (v % nm is not needed, Shoup reduces any 64-bit v) */
                         if (nm > om) {
-                            auto diff{nm - om};
-                            for (size_t i = 0; i < size; ++i) {
-                                uint64_t v[2];
-                                v[0] = data[i];
-                                v[1] = data[i];
-                                if (v[0] > halfQ)
-                                    v[0] = v[0] + diff;
-                                PlainModMulEqScalar_one(
-                                    &v[0],
-                                    nm,
-                                    mult_scalar,
-                                    pq0,
-                                    pq1
-                                );    
-                                uint64_t sum = op1[i] + v[0];
-                                op1[i] = sum >= modulus ? sum - modulus : sum;
-                            }
+                            bconv_mac(op1, data, size, halfQ, nm - om, nm, mult_scalar, modulus);
                             inc_bconv_up();
                             if(compute_flag){
-                                std::ofstream file("commandrecord.csv", std::ios::app);
-                                if (file.is_open()) {
-                                    file << "C, " << "Bconvup, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                    << (uint64_t)poly2->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                    file.close();
-                                }
+                                poly->trace_compute(TRACE_OP_BCONVUP, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly2->m_values_shadow.get_ptr(), 0);
                             }
                         }
                         else {
-                            auto diff{nm - (om % nm)};
-                            for (size_t i = 0; i < size; ++i) {
-                                uint64_t v[2];
-                                v[0] = data[i];
-                                v[1] = data[i];
-                                if (v[0] > halfQ)
-                                    v[0] = v[0] + diff;
-                                if (v[0] >= nm)
-                                    v[0] = v[0] % nm;
-                                PlainModMulEqScalar_one(
-                                    &v[0],
-                                    nm,
-                                    mult_scalar,
-                                    pq0,
-                                    pq1
-                                );    
-                                uint64_t sum = op1[i] + v[0];
-                                op1[i] = sum >= modulus ? sum - modulus : sum;
-                            }
+                            bconv_mac(op1, data, size, halfQ, nm - (om % nm), nm, mult_scalar, modulus);
                             inc_bconv_down();
                             if(compute_flag){
-                                std::ofstream file("commandrecord.csv", std::ios::app);
-                                if (file.is_open()) {
-                                    file << "C, " << "Bconvdown, " << (uint64_t)poly->m_values_shadow.get_ptr() << ", "
-                                    << (uint64_t)poly2->m_values_shadow.get_ptr() << ", " << "0" << std::endl;
-                                    file.close();
-                                }
+                                poly->trace_compute(TRACE_OP_BCONVDOWN, (uint64_t)poly->m_values_shadow.get_ptr(), (uint64_t)poly2->m_values_shadow.get_ptr(), 0);
                             }
                         }
                         
                         poly->indicate_modified_shadow();
-                        ocb_entries_m.lock();
-                        poly->m_values_shadow.ongoing_flag = false;
-                        poly2->m_values_shadow.ongoing_flag = false;
-                        ocb_entries_m.unlock();
+                        poly->m_values_shadow.unpin();
+                        poly2->m_values_shadow.unpin();
 
                         inc_compute_implemented(); 
                     }
                     break;
+                case TASK_TYPE_BCONV_BATCH: {
+                        poly->m_values_shadow.pin();
+                        poly->copy_to_shadow_();
+                        uint64_t* acc = poly->m_values_shadow.get_ptr();
+
+                        uint64_t size = item->param1;
+                        uint64_t nm = item->param4;
+                        uint64_t modulus = poly->m_params->GetModulus().m_value;
+
+                        /* every source is streamed through the accumulator one by one (only one source is pinned),
+                            the accumulator stays on the shadow for the whole batch */
+                        for(size_t k = 0; k < item->inputs.size(); k++) {
+                            auto src = (PolyImpl<NativeVector>*)item->inputs[k];
+                            uint64_t om = item->input_params[3 * k];
+                            uint64_t halfQ = item->input_params[3 * k + 1];
+                            uint64_t mult_scalar = item->input_params[3 * k + 2];
+
+                            src->m_values_shadow.pin();
+                            src->copy_to_shadow();
+                            const uint64_t* data = src->m_values_shadow.get_ptr();
+
+                            if (nm > om) {
+                                bconv_mac(acc, data, size, halfQ, nm - om, nm, mult_scalar, modulus);
+                                inc_bconv_up();
+                                if(compute_flag){
+                                    poly->trace_compute(TRACE_OP_BCONVUP, (uint64_t)acc, (uint64_t)data, 0);
+                                }
+                            }
+                            else {
+                                bconv_mac(acc, data, size, halfQ, nm - (om % nm), nm, mult_scalar, modulus);
+                                inc_bconv_down();
+                                if(compute_flag){
+                                    poly->trace_compute(TRACE_OP_BCONVDOWN, (uint64_t)acc, (uint64_t)data, 0);
+                                }
+                            }
+                            src->m_values_shadow.unpin();
+                        }
+
+                        poly->indicate_modified_shadow();
+                        poly->m_values_shadow.unpin();
+
+                        inc_compute_implemented();
+                    }
+                    break;
+                case TASK_TYPE_Prefetch: {
+                        uint32_t expected = SHADOW_PREFETCH_POSTED;
+                        if(!poly->m_values_shadow.prefetch_state.compare_exchange_strong(expected, SHADOW_PREFETCH_STAGING)) {
+                            break; // a task already used the polynomial (late)
+                        }
+                        /* nothing to move (already on the on-chip buffer) : wasted
+                            too many staged shadows (prefetch_pin_acquire) : dropped, demand loads must be able to evict */
+                        bool on_ocb = poly->m_values_shadow.m_values && poly->m_values_shadow.shadow_location == SHADOW_ON_OCB
+                                      && poly->m_values_shadow.shadow_sync_state != SHADOW_IS_BEHIND;
+                        if(on_ocb || !prefetch_pin_acquire(item->device < 0 ? 0 : item->device)) {
+                            if(on_ocb) inc_prefetch_wasted();
+                            else inc_prefetch_dropped();
+                            poly->m_values_shadow.prefetch_state.store(SHADOW_PREFETCH_NONE, std::memory_order_release);
+                            break;
+                        }
+
+                        poly->m_values_shadow.pin(); // prefetch pin, given back at the first use (consume_prefetch)
+                        poly->copy_to_shadow();
+                        poly->m_values_shadow.prefetch_state.store(SHADOW_PREFETCH_STAGED, std::memory_order_release);
+                    }
+                    break;
+                case TASK_TYPE_DeviceTransfer: {
+                        /* param2 : destination device, param3 : migrate (the limb moves, not a copy)
+                            the transfer is recorded on the stream of the destination */
+                        uint32_t to = (uint32_t)item->param2;
+                        poly->m_values_shadow.pin();
+                        poly->copy_to_shadow();
+                        uint32_t from = poly->m_values_shadow.device;
+                        if(from != to) {
+                            inc_d2d_transfer(from, to);
+                            if(compute_flag) {
+                                uint64_t addr = shadow_trace_addr((uint64_t)poly->m_values_shadow.get_ptr());
+                                trace_record(TRACE_KIND_DATA, TRACE_LINK_D2D, addr, addr, 0, item->modulus,
+                                             hw_profile.limb_bytes(item->param1), to);
+                            }
+                            if(item->param3) {
+                                migrate_shadow_tracking_array((uint64_t)&poly->m_values_shadow, from, to);
+                                poly->m_values_shadow.device = to;
+                            }
+                        }
+                        poly->m_values_shadow.unpin();
+                    }
+                    break;
+                case TASK_TYPE_SeededUniform: {
+                        poly->m_values_shadow.pin();
+                        poly->copy_to_shadow_(); // every coefficient is written, no host copy
+                        uint64_t* res = poly->m_values_shadow.get_ptr();
+
+                        uint32_t seed[16];
+                        for(size_t k = 0; k < 16; k++) seed[k] = (uint32_t)item->input_params[k];
+                        PlainSeededUniform(res, seed, item->input_params[16], item->modulus, item->param1);
+                        inc_prng();
+                        if(compute_flag){
+                            poly->trace_compute(TRACE_OP_PRNG, (uint64_t)res, 0, 0);
+                        }
+
+                        poly->indicate_modified_shadow();
+                        poly->m_values_shadow.unpin();
+
+                        inc_compute_implemented();
+                    }
+                    break;
                 default:
                     break;
             }
 
             // std::cout << item->task_type << " ";
+            perf_task_time(item->task_type, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                std::chrono::steady_clock::now() - start_task).count());
             // Mark as processed and notify the producer
             queue.workProcessed(item);
         }
 
         auto end_work = std::chrono::high_resolution_clock::now();
-        elapsed_work += end_work - start_work;        
+        stat.elapsed_work += end_work - start_work;        
 
         auto start_getwork = std::chrono::high_resolution_clock::now();
         items.clear();
-        success = queue.getWork(items) ;        
+        success = queue.getWork(items, worker_id) ;        
         auto end_getwork = std::chrono::high_resolution_clock::now();
-        elapsed_getwork += end_getwork - start_getwork;
+        stat.elapsed_getwork += end_getwork - start_getwork;
         if(!success) break;
     }
 
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> elapsed = end - start;
+
+    static std::mutex elapsed_m;
+    std::lock_guard<std::mutex> lock(elapsed_m);
+    elapsed_work += stat.elapsed_work;
+    elapsed_getwork += stat.elapsed_getwork;
     
-    std::cout << "consumer thread: queue.getWork returned False" << std::endl;
+    std::cout << "consumer thread " << worker_id << ": queue.getWork returned False" << std::endl;
 
     std::cout << "Elapsed time: " << elapsed.count() << " ms\n";
-    std::cout << "Elapsed time (getwork): " << elapsed_getwork.count() << " ms\n";
-    std::cout << "Elapsed time (work): " << elapsed_work.count() << " ms\n";
+    std::cout << "Elapsed time (getwork): " << stat.elapsed_getwork.count() << " ms\n";
+    std::cout << "Elapsed time (work): " << stat.elapsed_work.count() << " ms\n";
     
 }
 
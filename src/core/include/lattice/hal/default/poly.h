@@ -56,6 +56,7 @@
 #include <fstream>
 
 #include "utils/memory_tracking.h"
+#include "utils/shadow_pool.h"
 
 /* function for recording memory transfer stats (utils/math_utils.cpp)*/
 void inc_copy_from_shadow();
@@ -81,30 +82,48 @@ void inc_sub();
 void inc_mult();
 void inc_bconv_up();
 void inc_bconv_down();
+void inc_prng();
+void inc_prefetch_posted();
+void inc_prefetch_hit();
+void inc_prefetch_late();
+void inc_prefetch_wasted();
+void inc_prefetch_dropped();
 
 /* fucntion for managing memory tracking (for recognizing buffer locations) (utils/memory_tracking.cpp) */
-bool check_full_ocb_entries();
-bool check_full_hbm_entries();
-void insert_shadow_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, bool &ongoing_flag);
-void insert_shadow_hbm_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, bool &ongoing_flag);
-std::tuple<uint64_t,uint64_t,bool*> evict_shadow_tracking_array();
-std::tuple<uint64_t,uint64_t,bool*> evict_shadow_hbm_tracking_array();
-std::tuple<uint64_t,uint64_t,bool*> select_shadow_tracking_array(uint64_t m_values_shadow_addr);
-std::tuple<uint64_t,uint64_t,bool*> select_shadow_hbm_tracking_array(uint64_t m_values_shadow_addr);
-void clean_shadow_tracking_array(uint64_t m_values_shadow_addr);
+/* device : emulated device of the shadow (utils/multi_device.h), every device has its own tracking structure */
+bool check_full_ocb_entries(uint32_t device);
+bool check_full_hbm_entries(uint32_t device);
+void insert_shadow_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency, uint32_t device);
+void insert_shadow_hbm_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency, uint32_t device);
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> evict_shadow_tracking_array(uint32_t device);
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> evict_shadow_hbm_tracking_array(uint32_t device);
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> select_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device);
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> select_shadow_hbm_tracking_array(uint64_t m_values_shadow_addr, uint32_t device);
+void clean_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device);
+void move_shadow_tracking_array(uint64_t from_shadow_addr, uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency, uint32_t device);
+void migrate_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t from_device, uint32_t to_device);
+void access_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device);
+bool prefetch_pin_acquire(uint32_t device);
+void prefetch_pin_release(uint32_t device);
 
 bool check_evk_set(uint64_t evk_addr);
 void check_evk_map(uint64_t evk_addr); 
 
 /* working queue for off-load FHE tasks */
 #include "utils/custom_task.h"
+#include "utils/trace.h"
+#include "utils/multi_device.h"
+#include "utils/perf_counters.h"
 extern WorkQueue work_queue;
+/* working queue of every device, device_queues[0] is work_queue (utils/math_utils.cpp) */
+extern WorkQueue* device_queues[MAX_DEVICES];
 
-extern std::mutex ocb_entries_m;
 extern uint32_t ROOT_ENTRIES_NUM;
 extern uint32_t IROOT_ENTRIES_NUM;
 
 extern bool compute_flag;
+extern bool async_offload;
+extern bool prefetch_enabled;
 
 namespace lbcrypto {
 
@@ -122,6 +141,22 @@ namespace lbcrypto {
 #define SHADOW_ON_OCB 1
 #define SHADOW_ON_HBM 2
 
+/* Prefetch state of a shadow (PrefetchToDevice)
+    POSTED : prefetch task is in the working queue
+    STAGING : prefetch task is moving the shadow to the on-chip buffer
+    STAGED : shadow is on the on-chip buffer and pinned by the prefetch until the first task using it */
+#define SHADOW_PREFETCH_NONE 0
+#define SHADOW_PREFETCH_POSTED 1
+#define SHADOW_PREFETCH_STAGING 2
+#define SHADOW_PREFETCH_STAGED 3
+
+/* Task descriptor of a unit op.
+    sync offload : descriptor lives on the stack of the unit op, no heap traffic
+    async offload : descriptor comes from the per-thread pool (CustomTaskItem::operator new), consumer gives it back */
+#define TASK_ITEM(name, type) \
+    CustomTaskItem name##_stack(type); \
+    CustomTaskItem* name = async_offload ? new CustomTaskItem(type) : &name##_stack
+
 /**
  * @class PolyImpl
  * @file poly.h
@@ -129,14 +164,19 @@ namespace lbcrypto {
  */
 
 /* The class below is the polynomial's shadow (off-load buffer) class to be used for the fhe operation.
-    m_values : Polynomial data in on-chip buffer
-    m_values_hbm : Polynomial data in HBM
+    m_values : Polynomial data in on-chip buffer (slot of the OCB shadow pool, utils/shadow_pool.h)
+    m_values_hbm : Polynomial data in HBM (slot of the HBM shadow pool, released when the shadow comes back to OCB)
     shadow_sync_state : SHADOW_NOTEXIST, SHADOW_SYNCHED,
                         SHADOW_IS_AHEAD(need to transfer Host <- Shadow),
                         SHADOW_IS_BEHIND (need to transfer Host -> Shadow)
     shadow_location : SHADOW_ON_OCB, SHADOW_ON_HBM
-    ongoing_flag : Flag that indicate whether the polinomial is currently being used for fhe operation.
-                   To prevent memory from being moved by the evict policy when it is being used for fhe operation.
+    residency : Number of users (fhe operations) of the shadow and SHADOW_EVICTING bit (utils/memory_tracking.h).
+                A pinned shadow is not moved by the evict policy, pin waits while an eviction is moving the shadow.
+    pending_ticket : Completion token of the last offloaded task that uses this polynomial (async_offload mode).
+                     Host must wait for it before touching the polynomial data.
+                     The device of the queue is in the top bits (device_ticket, utils/multi_device.h)
+    device : device holding the shadow (tracking structure, trace stream), set when the shadow is made
+    prefetch_state : SHADOW_PREFETCH_*, a copy is not prefetched
     get_ptr : Method to get a on-chip shadow address
     get_hbm_ptr : Method to get a HBM shadow address
 */
@@ -144,13 +184,51 @@ namespace lbcrypto {
 template <typename VecType>
 class ShadowType {
     public:
-        mutable std::shared_ptr<std::vector<uint64_t>> m_values{nullptr};
-        mutable std::shared_ptr<std::vector<uint64_t>> m_values_hbm{nullptr};
+        ShadowType() = default;
+        ShadowType(const ShadowType& o)
+            : m_values{o.m_values}, m_values_hbm{o.m_values_hbm}, shadow_sync_state{o.shadow_sync_state},
+              shadow_location{o.shadow_location},
+              pending_ticket{o.pending_ticket.load(std::memory_order_acquire)}, device{o.device} {}
+        ShadowType& operator=(const ShadowType& o) {
+            m_values = o.m_values;
+            m_values_hbm = o.m_values_hbm;
+            shadow_sync_state = o.shadow_sync_state;
+            shadow_location = o.shadow_location;
+            pending_ticket.store(o.pending_ticket.load(std::memory_order_acquire), std::memory_order_release);
+            device = o.device;
+            return *this;
+        }
+
+        mutable std::shared_ptr<ShadowBuffer> m_values{nullptr};
+        mutable std::shared_ptr<ShadowBuffer> m_values_hbm{nullptr};
         mutable usint shadow_sync_state{SHADOW_NOTEXIST};  
         mutable usint shadow_location{SHADOW_NOTEXIST};
-        mutable bool ongoing_flag{false};
+        mutable std::atomic<uint32_t> residency{0}; // a copy is not used by anyone yet
+        mutable std::atomic<uint64_t> pending_ticket{0};
+        mutable std::atomic<uint32_t> prefetch_state{SHADOW_PREFETCH_NONE};
+        mutable uint32_t device{0};
         uint64_t* get_ptr() {return &(*m_values)[0];}
         uint64_t* get_hbm_ptr() {return &(*m_values_hbm)[0];}
+
+        void pin() const { pin_shadow(residency); }
+        void unpin() const { unpin_shadow(residency); }
+
+        /* Several producer threads can post tasks using the same polynomial, keep the latest token.
+            A token of another device replaces the old one, the old one is finished (wait_other_device) */
+        void set_pending(uint64_t ticket) const {
+            uint64_t cur = pending_ticket.load(std::memory_order_relaxed);
+            while (1) {
+                if (ticket_device(cur) == ticket_device(ticket) && cur >= ticket) return;
+                if (pending_ticket.compare_exchange_weak(cur, ticket, std::memory_order_acq_rel)) return;
+            }
+        }
+
+        /* a task of device is going to use the shadow, tasks of the other devices using it must finish first */
+        void wait_other_device(uint32_t device) const {
+            uint64_t cur = pending_ticket.load(std::memory_order_acquire);
+            if (cur && ticket_device(cur) != device)
+                device_queues[ticket_device(cur)]->waitFor(cur & DEVICE_TICKET_MASK);
+        }
 }; 
 
 template <typename VecType>
@@ -175,18 +253,124 @@ public:
         Remove the memory information from the memory tracking data structure
         ( clean_shadow_tracking_array ) */
     ~PolyImpl() noexcept{
-        clean_shadow_tracking_array((uint64_t)&m_values_shadow);
+        this->wait_shadow();
+        // staged but never used
+        if(m_values_shadow.prefetch_state.exchange(SHADOW_PREFETCH_NONE) == SHADOW_PREFETCH_STAGED) {
+            inc_prefetch_wasted();
+            m_values_shadow.unpin();
+            prefetch_pin_release(m_values_shadow.device);
+        }
+        m_values_shadow.pin(); // wait for an eviction moving the shadow
+        clean_shadow_tracking_array((uint64_t)&m_values_shadow, m_values_shadow.device);
+    }
+
+    /* In async_offload mode, tasks are only posted to the working queue.
+        Wait until every posted task using this polynomial is finished,
+        it is called only when host really needs the polynomial (data access, copy, release) */
+    void wait_shadow() const {
+        uint64_t ticket = m_values_shadow.pending_ticket.load(std::memory_order_acquire);
+        if(ticket) {
+            device_queues[ticket_device(ticket)]->waitFor(ticket & DEVICE_TICKET_MASK);
+        }
+    }
+
+    /* Post the task to the working queue.
+        sync mode : wait until the consumer finishes the task (busy waiting in addWork),
+                    item is on the caller's stack (TASK_ITEM)
+        async mode : return right after posting, consumer releases the task item
+                     and polynomials in the task remember the completion token (pending_ticket) */
+    static void offload(CustomTaskItem* item) {
+        uint32_t device = task_device(item);
+        if(!async_offload) {
+            device_queues[device]->addWork(item);
+            return;
+        }
+
+        const PolyImpl* polys[TASK_MAX_POLYS] = {(const PolyImpl*)item->poly, (const PolyImpl*)item->poly2, (const PolyImpl*)item->poly3,
+                                                 (const PolyImpl*)item->poly4, (const PolyImpl*)item->poly5};
+        item->release_on_done = true;
+        uint64_t ticket = device_ticket(device, device_queues[device]->submitWork(item));
+        for(auto p : polys) {
+            if(p) p->m_values_shadow.set_pending(ticket);
+        }
+        for(auto p : item->inputs) {
+            ((const PolyImpl*)p)->m_values_shadow.set_pending(ticket);
+        }
+    }
+
+    /* Device running the task : the device of the limb modulus (item->device when it is given).
+        Queues of different devices are not ordered, in async mode the tasks of the other devices
+        using the same polynomials are waited for before posting (multi-device mode only) */
+    static uint32_t task_device(CustomTaskItem* item) {
+        if(num_devices <= 1) return 0;
+        uint32_t device = item->device >= 0 ? (uint32_t)item->device : device_of_modulus(item->modulus);
+        if(async_offload) {
+            void* polys[TASK_MAX_POLYS] = {item->poly, item->poly2, item->poly3, item->poly4, item->poly5};
+            for(auto p : polys) {
+                if(p) ((const PolyImpl*)p)->m_values_shadow.wait_other_device(device);
+            }
+            for(auto p : item->inputs) {
+                ((const PolyImpl*)p)->m_values_shadow.wait_other_device(device);
+            }
+        }
+        return device;
+    }
+
+    /* Prefetch hint : stage the polynomial on the on-chip buffer ahead of its use (TASK_TYPE_Prefetch).
+        Only when prefetch_enabled (set_prefetch), a polynomial already posted or staged is not posted again.
+        Only with async offload (set_async_offload), in synchronous mode the hint is counted as dropped and ignored.
+        Staged shadow is pinned until the first task using it (consume_prefetch) */
+    void PrefetchToDevice() const;
+
+    /* Multi-device mode : device of the limb (device of its modulus, utils/multi_device.h) */
+    uint32_t GetDevice() const {
+        return device_of_modulus(m_params->GetModulus().template ConvertToInt<uint64_t>());
+    }
+
+    /* Copy of the limb to another device (TASK_TYPE_DeviceTransfer), posted on the device of the limb.
+        migrate : the limb itself moves, its tracking entry goes to the tracking structure of device (SwitchModulus) */
+    void TransferToDevice(uint32_t device, bool migrate = false) const;
+
+    /* first use of the shadow after a prefetch hint, called by copy_to_shadow of the task using it
+        STAGED : hit, the prefetch pin is given back (the task has its own pin)
+        POSTED : late, the task came before the prefetch task (shadow is moved on demand) */
+    void consume_prefetch() const {
+        uint32_t state = m_values_shadow.prefetch_state.load(std::memory_order_acquire);
+        if(state != SHADOW_PREFETCH_POSTED && state != SHADOW_PREFETCH_STAGED) return;
+        if(!m_values_shadow.prefetch_state.compare_exchange_strong(state, SHADOW_PREFETCH_NONE)) return;
+        if(state == SHADOW_PREFETCH_STAGED) {
+            inc_prefetch_hit();
+            m_values_shadow.unpin();
+            prefetch_pin_release(m_values_shadow.device);
+        }
+        else {
+            inc_prefetch_late();
+        }
+    }
+
+    /* Command trace (compute_flag), one binary record per op or transfer (utils/trace.h)
+        bytes of the record are the device size of the limb (word size of the hardware profile) */
+    void trace_compute(uint8_t op, uint64_t res, uint64_t op1, uint64_t op2) const {
+        trace_record(TRACE_KIND_COMPUTE, op, shadow_trace_addr(res), shadow_trace_addr(op1), shadow_trace_addr(op2), m_params->GetModulus().template ConvertToInt<uint64_t>(),
+                     hw_profile.limb_bytes(m_params->GetRingDimension()), m_values_shadow.device);
+    }
+
+    void trace_transfer(uint8_t link, uint64_t dst, uint64_t src) const {
+        trace_record(TRACE_KIND_DATA, link, shadow_trace_addr(dst), shadow_trace_addr(src), 0, m_params->GetModulus().template ConvertToInt<uint64_t>(),
+                     hw_profile.limb_bytes(m_params->GetRingDimension()), m_values_shadow.device);
     }
 
     /* Data trasfer : Host(Origin) <- Hardware(on-chip buffer or HBM)
         Check the shadoww_sync_state and shadow_location
         and transfer data to the host if you need to move the data */
     void copy_from_shadow() const {
+        this->wait_shadow();
         inc_copy_from_shadow();
         if(m_values == nullptr) {
             usint r{m_params->GetRingDimension()};
             m_values = std::make_unique<VecType>(r, m_params->GetModulus());
         }
+        m_values_shadow.pin();
 
         if(m_values_shadow.shadow_location==SHADOW_ON_OCB && m_values_shadow.shadow_sync_state == SHADOW_IS_AHEAD) {
             inc_copy_from_shadow_ocb_real();
@@ -194,11 +378,7 @@ public:
             m_values_shadow.shadow_sync_state = SHADOW_SYNCHED;
             if(compute_flag){
                 // std::cout << "ORIGIN <-- OCB" << std::endl;
-                std::ofstream file("commandrecord.csv", std::ios::app);
-                if (file.is_open()) {
-                    file << "D, " << "PCIE, " << (uint64_t)&m_values->m_data[0] << ", " << (uint64_t)m_values_shadow.get_ptr() << std::endl;
-                    file.close();
-                }
+                this->trace_transfer(TRACE_LINK_PCIE, (uint64_t)&m_values->m_data[0], (uint64_t)m_values_shadow.get_ptr());
             }
         }
 
@@ -208,13 +388,10 @@ public:
             m_values_shadow.shadow_sync_state = SHADOW_SYNCHED;
             if(compute_flag){
                 // std::cout << "ORIGIN     <--     HBM" << std::endl;
-                std::ofstream file("commandrecord.csv", std::ios::app);
-                if (file.is_open()) {
-                    file << "D, " << "PCIE, " << (uint64_t)&m_values->m_data[0] << ", " << (uint64_t)m_values_shadow.get_hbm_ptr() << std::endl;
-                    file.close();
-                }
+                this->trace_transfer(TRACE_LINK_PCIE, (uint64_t)&m_values->m_data[0], (uint64_t)m_values_shadow.get_hbm_ptr());
             }
         }
+        m_values_shadow.unpin();
     }
 
     /* Data trasfer : Host(Origin) <- Hardware(on-chip buffer or HBM)
@@ -236,11 +413,7 @@ public:
                 ::memcpy((char*)&tmp_m_values->m_data[0],tmp_m_values_shadow.get_hbm_ptr(),sizeof(uint64_t)*m_params->GetRingDimension());
                 if(compute_flag){
                     // std::cout << "ORIGIN     <--     HBM" << std::endl;
-                    std::ofstream file("commandrecord.csv", std::ios::app);
-                    if (file.is_open()) {
-                        file << "D, " << "PCIE, " << (uint64_t)&tmp_m_values->m_data[0] << ", " << (uint64_t)tmp_m_values_shadow.get_hbm_ptr() <<  std::endl;
-                        file.close();
-                    }
+                    this->trace_transfer(TRACE_LINK_PCIE, (uint64_t)&tmp_m_values->m_data[0], (uint64_t)tmp_m_values_shadow.get_hbm_ptr());
                 }
             }
 
@@ -249,7 +422,6 @@ public:
             tmp_m_values_shadow.m_values_hbm = nullptr;
             tmp_m_values_shadow.shadow_sync_state = SHADOW_NOTEXIST;
             tmp_m_values_shadow.shadow_location = SHADOW_NOTEXIST;
-            tmp_m_values_shadow.ongoing_flag = false;
         }
     }
 
@@ -261,30 +433,34 @@ public:
         select hbm shadow buffer, swap hbm shadow & victim on-chip buffer shadow
     */
     void copy_to_shadow() const {
+        this->consume_prefetch();
         inc_copy_to_shadow();
-        ocb_entries_m.lock();
+        m_values_shadow.pin();
         if(m_values_shadow.shadow_location==SHADOW_ON_HBM){ // When shadow in HBM, need to swap OCB <-> HBM
-            std::tuple<uint64_t,uint64_t,bool*> hbm_tmp = select_shadow_hbm_tracking_array(uint64_t(&m_values_shadow));
-            if(check_full_ocb_entries()){
-                std::tuple<uint64_t,uint64_t,bool*> tmp = evict_shadow_tracking_array();
-                if(std::get<1>(hbm_tmp)) insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp));
-                if(std::get<1>(tmp)) insert_shadow_hbm_tracking_array(std::get<0>(tmp),std::get<1>(tmp),*std::get<2>(tmp));
+            uint32_t device = m_values_shadow.device;
+            std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> hbm_tmp = select_shadow_hbm_tracking_array(uint64_t(&m_values_shadow), device);
+            if(check_full_ocb_entries(device)){
+                std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> tmp = evict_shadow_tracking_array(device);
+                if(std::get<1>(hbm_tmp)) insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp),device);
+                if(std::get<1>(tmp)) insert_shadow_hbm_tracking_array(std::get<0>(tmp),std::get<1>(tmp),*std::get<2>(tmp),device);
                 
                 // inc_copy_from_other_shadow1(); // OCB -> OCB (tmp)
                 if(std::get<1>(hbm_tmp)) copy_from_hbm_shadow(m_values_shadow);
                 if(std::get<1>(tmp)){
                     ShadowType<VecType>* tmp_m_values_shadow_addr = (ShadowType<VecType>*)std::get<1>(tmp);
                     copy_to_hbm_shadow(*tmp_m_values_shadow_addr);
+                    release_shadow(*std::get<2>(tmp));
                 }
             }
             else{
                 if(std::get<1>(hbm_tmp)){
-                    insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp));
+                    insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp),device);
                     copy_from_hbm_shadow(m_values_shadow);
                 }
             }
         }
-        ocb_entries_m.unlock();
+        if(m_values_shadow.m_values) access_shadow_tracking_array(uint64_t(&m_values_shadow), m_values_shadow.device);
+        m_values_shadow.unpin();
         if(m_values == nullptr) {
             if(m_values_shadow.shadow_sync_state != SHADOW_IS_AHEAD) {
                 OPENFHE_THROW(not_available_error, "m_values not created");
@@ -293,7 +469,7 @@ public:
         }
 
         if(m_values_shadow.shadow_sync_state == SHADOW_NOTEXIST) {
-            create_shadow();   
+            create_shadow(m_values->m_data[0] == 0); // zero host data is not copied below
         }            
         if(m_values_shadow.shadow_sync_state == SHADOW_IS_BEHIND && m_values->m_data[0]!=0) {   
             /*if(!check_evk_set((uint64_t)&m_values))*/ inc_copy_to_shadow_real((uint64_t)&m_values);
@@ -301,40 +477,40 @@ public:
             m_values_shadow.shadow_sync_state = SHADOW_SYNCHED;
             if(compute_flag){
                 // std::cout << "ORIGIN --> OCB" << std::endl;
-                std::ofstream file("commandrecord.csv", std::ios::app);
-                if (file.is_open()) {
-                    file << "D, " << "PCIE, " << (uint64_t)m_values_shadow.get_ptr() << ", " << (uint64_t)&m_values->m_data[0] << std::endl;
-                    file.close();
-                }
+                this->trace_transfer(TRACE_LINK_PCIE, (uint64_t)m_values_shadow.get_ptr(), (uint64_t)&m_values->m_data[0]);
             }
         }
     }
 
     void copy_to_shadow_() const {
+        this->consume_prefetch();
         inc_copy_to_shadow();
-        ocb_entries_m.lock();
+        m_values_shadow.pin();
         if(m_values_shadow.shadow_location==SHADOW_ON_HBM){ // When shadow in HBM, need to swap OCB <-> HBM
-            std::tuple<uint64_t,uint64_t,bool*> hbm_tmp = select_shadow_hbm_tracking_array(uint64_t(&m_values_shadow));
-            if(check_full_ocb_entries()){
-                std::tuple<uint64_t,uint64_t,bool*> tmp = evict_shadow_tracking_array();
-                if(std::get<1>(hbm_tmp)) insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp));
-                if(std::get<1>(tmp)) insert_shadow_hbm_tracking_array(std::get<0>(tmp),std::get<1>(tmp),*std::get<2>(tmp));
+            uint32_t device = m_values_shadow.device;
+            std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> hbm_tmp = select_shadow_hbm_tracking_array(uint64_t(&m_values_shadow), device);
+            if(check_full_ocb_entries(device)){
+                std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> tmp = evict_shadow_tracking_array(device);
+                if(std::get<1>(hbm_tmp)) insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp),device);
+                if(std::get<1>(tmp)) insert_shadow_hbm_tracking_array(std::get<0>(tmp),std::get<1>(tmp),*std::get<2>(tmp),device);
                 
                 // inc_copy_from_other_shadow1(); // OCB -> OCB (tmp)
                 if(std::get<1>(hbm_tmp)) copy_from_hbm_shadow(m_values_shadow);
                 if(std::get<1>(tmp)){
                     ShadowType<VecType>* tmp_m_values_shadow_addr = (ShadowType<VecType>*)std::get<1>(tmp);
                     copy_to_hbm_shadow(*tmp_m_values_shadow_addr);
+                    release_shadow(*std::get<2>(tmp));
                 }
             }
             else{
                 if(std::get<1>(hbm_tmp)){
-                    insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp));
+                    insert_shadow_tracking_array(std::get<0>(hbm_tmp),std::get<1>(hbm_tmp),*std::get<2>(hbm_tmp),device);
                     copy_from_hbm_shadow(m_values_shadow);
                 }
             }
         }
-        ocb_entries_m.unlock();
+        if(m_values_shadow.m_values) access_shadow_tracking_array(uint64_t(&m_values_shadow), m_values_shadow.device);
+        m_values_shadow.unpin();
         if(m_values == nullptr) {
             if(m_values_shadow.shadow_sync_state != SHADOW_IS_AHEAD) {
                 OPENFHE_THROW(not_available_error, "m_values not created");
@@ -343,7 +519,7 @@ public:
         }
 
         if(m_values_shadow.shadow_sync_state == SHADOW_NOTEXIST) {
-            create_shadow();   
+            create_shadow(true); // no host copy, the shadow starts from zero (BCONV accumulator)
         }            
     }
 
@@ -366,11 +542,7 @@ public:
                 m_values_shadow.shadow_sync_state = other.shadow_sync_state;
                 if(compute_flag){
                    //  std::cout << "           OCB" << std::endl;
-                    std::ofstream file("commandrecord.csv", std::ios::app);
-                    if (file.is_open()) {
-                        file << "D, " << "SRAM, " << (uint64_t)m_values_shadow.get_ptr() << ", " << (uint64_t)other.get_ptr() << std::endl;
-                        file.close();
-                    }
+                    this->trace_transfer(TRACE_LINK_SRAM, (uint64_t)m_values_shadow.get_ptr(), (uint64_t)other.get_ptr());
                 }
             }
             else if(m_values_shadow.shadow_location==SHADOW_ON_OCB && other.shadow_location==SHADOW_ON_HBM){
@@ -379,11 +551,7 @@ public:
                 m_values_shadow.shadow_sync_state = other.shadow_sync_state;
                 if(compute_flag){
                     // std::cout << "           OCB <-- HBM" << std::endl;
-                    std::ofstream file("commandrecord.csv", std::ios::app);
-                    if (file.is_open()) {
-                        file << "D, " << "HBM, " << (uint64_t)m_values_shadow.get_ptr() << ", " << (uint64_t)other.get_hbm_ptr() << std::endl;
-                        file.close();
-                    }
+                    this->trace_transfer(TRACE_LINK_HBM, (uint64_t)m_values_shadow.get_ptr(), (uint64_t)other.get_hbm_ptr());
                 }
             }
             else if(m_values_shadow.shadow_location==SHADOW_ON_HBM && other.shadow_location==SHADOW_ON_OCB){
@@ -392,11 +560,7 @@ public:
                 m_values_shadow.shadow_sync_state = other.shadow_sync_state;
                 if(compute_flag){
                     // std::cout << "           OCB --> HBM" << std::endl;
-                    std::ofstream file("commandrecord.csv", std::ios::app);
-                    if (file.is_open()) {
-                        file << "D, " << "HBM, " << (uint64_t)m_values_shadow.get_hbm_ptr() << ", " << (uint64_t)other.get_ptr() << std::endl;
-                        file.close();
-                    }
+                    this->trace_transfer(TRACE_LINK_HBM, (uint64_t)m_values_shadow.get_hbm_ptr(), (uint64_t)other.get_ptr());
                 }
             }
             else if(m_values_shadow.shadow_location==SHADOW_ON_HBM && other.shadow_location==SHADOW_ON_HBM){
@@ -405,11 +569,7 @@ public:
                 m_values_shadow.shadow_sync_state = other.shadow_sync_state;
                 if(compute_flag){
                     // std::cout << "           HBM <-- HBM" << std::endl;
-                    std::ofstream file("commandrecord.csv", std::ios::app);
-                    if (file.is_open()) {
-                        file << "D, " << "HBM, " << (uint64_t)m_values_shadow.get_hbm_ptr() << ", " << (uint64_t)other.get_hbm_ptr() << std::endl;
-                        file.close();
-                    }
+                    this->trace_transfer(TRACE_LINK_HBM, (uint64_t)m_values_shadow.get_hbm_ptr(), (uint64_t)other.get_hbm_ptr());
                 }
             }
             else{
@@ -427,18 +587,14 @@ public:
         }
         else{
             if(!tmp_m_values_shadow.m_values_hbm){
-                tmp_m_values_shadow.m_values_hbm = std::make_shared<std::vector<uint64_t>>(m_params->GetRingDimension());
+                tmp_m_values_shadow.m_values_hbm = make_shadow_buffer(SHADOW_POOL_HBM, m_params->GetRingDimension());
             }
             inc_copy_from_other_shadow3();
             ::memcpy(tmp_m_values_shadow.get_hbm_ptr(),tmp_m_values_shadow.get_ptr(),sizeof(uint64_t)*m_params->GetRingDimension());
             tmp_m_values_shadow.shadow_location = SHADOW_ON_HBM;
             if(compute_flag){
                 // std::cout << "           OCB --> HBM" << std::endl;
-                std::ofstream file("commandrecord.csv", std::ios::app);
-                if (file.is_open()) {
-                    file << "D, " << "HBM, " << (uint64_t)tmp_m_values_shadow.get_hbm_ptr() << ", " << (uint64_t)tmp_m_values_shadow.get_ptr() << std::endl;
-                    file.close();
-                }
+                this->trace_transfer(TRACE_LINK_HBM, (uint64_t)tmp_m_values_shadow.get_hbm_ptr(), (uint64_t)tmp_m_values_shadow.get_ptr());
             }
         }
     }
@@ -456,12 +612,9 @@ public:
             tmp_m_values_shadow.shadow_location = SHADOW_ON_OCB;
             if(compute_flag){
                 // std::cout << "           OCB <-- HBM" << std::endl;
-                std::ofstream file("commandrecord.csv", std::ios::app);
-                if (file.is_open()) {
-                    file << "D, " << "HBM, " << (uint64_t)tmp_m_values_shadow.get_ptr() << ", " << (uint64_t)tmp_m_values_shadow.get_hbm_ptr() << std::endl;
-                    file.close();
-                }
+                this->trace_transfer(TRACE_LINK_HBM, (uint64_t)tmp_m_values_shadow.get_ptr(), (uint64_t)tmp_m_values_shadow.get_hbm_ptr());
             }
+            tmp_m_values_shadow.m_values_hbm = nullptr; // HBM slot goes back to the pool
         }
     }
 
@@ -470,20 +623,26 @@ public:
         By default, the created shadow is located in an on-chip buffer because it was created for use right now.
         If the on-chip buffer is full,
         discard_shadow is used by the evict policy to manage additional data transfers
+        zero : clear the shadow, only when the caller does not fill it from the host (pool slots are not cleared)
     */
-    void create_shadow() const {
-        if(m_values_shadow.m_values || m_values_shadow.shadow_sync_state != SHADOW_NOTEXIST) return;
+    void create_shadow(bool zero = false) const {
+        if(m_values_shadow.m_values || m_values_shadow.shadow_sync_state != SHADOW_NOTEXIST){
+            if(m_values_shadow.m_values){ // used as a result of the operation, tell the eviction policy
+                access_shadow_tracking_array(uint64_t(&m_values_shadow), m_values_shadow.device);
+            }
+            return;
+        }
 
-        ocb_entries_m.lock();
-        if(/*!check_evk_set((uint64_t)&m_values) &&*/ check_full_ocb_entries()) discard_shadow();
+        m_values_shadow.device = device_of_modulus(m_params->GetModulus().template ConvertToInt<uint64_t>());
+        if(/*!check_evk_set((uint64_t)&m_values) &&*/ check_full_ocb_entries(m_values_shadow.device)) discard_shadow();
 
         inc_create_shadow();
-        m_values_shadow.m_values = std::make_shared<std::vector<uint64_t>>(m_params->GetRingDimension());
+        m_values_shadow.m_values = make_shadow_buffer(SHADOW_POOL_OCB, m_params->GetRingDimension(), zero);
         m_values_shadow.shadow_sync_state = SHADOW_IS_BEHIND;
         m_values_shadow.shadow_location = SHADOW_ON_OCB;
 
-        /*if(!check_evk_set((uint64_t)&m_values))*/ insert_shadow_tracking_array((uint64_t)&m_values,(uint64_t)&m_values_shadow,m_values_shadow.ongoing_flag);
-        ocb_entries_m.unlock();
+        /*if(!check_evk_set((uint64_t)&m_values))*/ insert_shadow_tracking_array((uint64_t)&m_values,(uint64_t)&m_values_shadow,m_values_shadow.residency,m_values_shadow.device);
+        access_shadow_tracking_array((uint64_t)&m_values_shadow, m_values_shadow.device);
     }
 
     /* Discard shadow is a function created to manage situations where on-chip buffers and HBMs will be full.
@@ -491,21 +650,24 @@ public:
         Move the buffer occupying the space to the HBM or import it back to the host according to the evict policy.
     */
     void discard_shadow() const{        
-        if(check_full_hbm_entries()){ // When HBM is full
-            std::tuple<uint64_t,uint64_t,bool*> tmp = evict_shadow_hbm_tracking_array();
+        uint32_t device = m_values_shadow.device;
+        if(check_full_hbm_entries(device)){ // When HBM is full
+            std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> tmp = evict_shadow_hbm_tracking_array(device);
             if(std::get<0>(tmp)!=0){
                 std::unique_ptr<VecType>* tmp_m_values_addr = (std::unique_ptr<VecType>*)std::get<0>(tmp);
                 ShadowType<VecType>* tmp_m_values_shadow_addr = (ShadowType<VecType>*)std::get<1>(tmp);
                 copy_from_shadow_for_discard(*tmp_m_values_addr,*tmp_m_values_shadow_addr);
+                release_shadow(*std::get<2>(tmp));
             }
         }
-        std::tuple<uint64_t,uint64_t,bool*> tmp = evict_shadow_tracking_array();
+        std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> tmp = evict_shadow_tracking_array(device);
         if(std::get<0>(tmp)!=0){ // When OCB is full
             ShadowType<VecType>* tmp_m_values_shadow_addr = (ShadowType<VecType>*)std::get<1>(tmp);
             copy_to_hbm_shadow(*tmp_m_values_shadow_addr);
             if((*tmp_m_values_shadow_addr).m_values){
-                insert_shadow_hbm_tracking_array(std::get<0>(tmp),std::get<1>(tmp),*std::get<2>(tmp));
+                insert_shadow_hbm_tracking_array(std::get<0>(tmp),std::get<1>(tmp),*std::get<2>(tmp),device);
             }
+            release_shadow(*std::get<2>(tmp));
         }
     }
 
@@ -596,10 +758,8 @@ public:
     PolyImpl(const PolyType& p) noexcept
         : m_format{p.m_format},
           m_params{p.m_params},
-          m_values{p.m_values ? std::make_unique<VecType>(*p.m_values) : nullptr} {
-            ocb_entries_m.lock();
-            p.m_values_shadow.ongoing_flag = true;
-            ocb_entries_m.unlock();
+          m_values{(p.wait_shadow(), p.m_values ? std::make_unique<VecType>(*p.m_values) : nullptr)} {
+            p.m_values_shadow.pin();
             if(p.m_values_shadow.shadow_sync_state != SHADOW_NOTEXIST) {
                 this->create_shadow();
                 this->copy_from_other_shadow(p.m_values_shadow);
@@ -607,22 +767,69 @@ public:
             else {
                 this->m_values_shadow.shadow_sync_state = SHADOW_NOTEXIST;
             }
-            ocb_entries_m.lock();
-            p.m_values_shadow.ongoing_flag = false;
-            ocb_entries_m.unlock();
+            p.m_values_shadow.unpin();
           }
 
+    /* Move keeps the data where it is : the shadow (and its tracking entry) goes to this polynomial,
+        no host write-back and no device copy (take_shadow) */
     PolyImpl(PolyType&& p) noexcept
-        : m_format{p.m_format}, m_params{std::move(p.m_params)}, m_values{std::move(p.m_values)}, m_values_shadow{p.m_values_shadow} {}
+        : m_format{(p.wait_shadow(), p.m_format)}, m_params{std::move(p.m_params)}, m_values{std::move(p.m_values)} {
+        this->take_shadow(p);
+    }
 
     PolyType& operator=(const PolyType& rhs) noexcept override;
     PolyType& operator=(PolyType&& rhs) noexcept override {
+        if (this == &rhs)
+            return *this;
+        rhs.wait_shadow();
+        this->wait_shadow();
+        this->drop_shadow();
         m_format = std::move(rhs.m_format);
         m_params = std::move(rhs.m_params);
         m_values = std::move(rhs.m_values);
-        m_values_shadow = rhs.m_values_shadow;
+        this->take_shadow(rhs);
         return *this;
     }
+
+    /* Ownership of the shadow of p goes to this (this has no shadow).
+        Tracking entry of p is moved to this (move_shadow_tracking_array), a prefetch pin goes with the shadow,
+        p is left without a shadow */
+    void take_shadow(PolyImpl& p) {
+        p.m_values_shadow.pin(); // wait for an eviction moving the shadow
+        m_values_shadow.pin();
+        m_values_shadow = p.m_values_shadow;
+        if(p.m_values_shadow.m_values) {
+            move_shadow_tracking_array((uint64_t)&p.m_values_shadow, (uint64_t)&m_values, (uint64_t)&m_values_shadow, m_values_shadow.residency, m_values_shadow.device);
+        }
+        uint32_t prefetch = p.m_values_shadow.prefetch_state.exchange(SHADOW_PREFETCH_NONE);
+        if(prefetch == SHADOW_PREFETCH_STAGED) {
+            p.m_values_shadow.unpin();
+            m_values_shadow.pin();
+        }
+        m_values_shadow.prefetch_state.store(prefetch == SHADOW_PREFETCH_STAGED ? prefetch : SHADOW_PREFETCH_NONE);
+        p.m_values_shadow.m_values = nullptr;
+        p.m_values_shadow.m_values_hbm = nullptr;
+        p.m_values_shadow.shadow_sync_state = SHADOW_NOTEXIST;
+        p.m_values_shadow.shadow_location = SHADOW_NOTEXIST;
+        m_values_shadow.unpin();
+        p.m_values_shadow.unpin();
+    }
+
+    /* Shadow of this is not needed anymore (it is overwritten by a move), same as the destructor */
+    void drop_shadow() {
+        if(m_values_shadow.prefetch_state.exchange(SHADOW_PREFETCH_NONE) == SHADOW_PREFETCH_STAGED) {
+            inc_prefetch_wasted();
+            m_values_shadow.unpin();
+            prefetch_pin_release(m_values_shadow.device);
+        }
+        m_values_shadow.pin(); // wait for an eviction moving the shadow
+        clean_shadow_tracking_array((uint64_t)&m_values_shadow, m_values_shadow.device);
+        m_values_shadow.m_values = nullptr;
+        m_values_shadow.m_values_hbm = nullptr;
+        m_values_shadow.shadow_sync_state = SHADOW_NOTEXIST;
+        m_values_shadow.shadow_location = SHADOW_NOTEXIST;
+        m_values_shadow.unpin();
+    }
     PolyType& operator=(const std::vector<int32_t>& rhs);
     PolyType& operator=(const std::vector<int64_t>& rhs);
     PolyType& operator=(std::initializer_list<uint64_t> rhs) override;
@@ -651,12 +858,14 @@ public:
     void SetValuesShadow(VecType&& values, Format format);
 
     void SetValuesToZero() override {
+        this->wait_shadow();
         usint r{m_params->GetRingDimension()};
         m_values = std::make_unique<VecType>(r, m_params->GetModulus());
         this->indicate_modified_orig();
     }
 
     void SetValuesToMax() override {
+        this->wait_shadow();
         usint r{m_params->GetRingDimension()};
         auto max{m_params->GetModulus() - Integer(1)};
         m_values = std::make_unique<VecType>(r, m_params->GetModulus(), max);
@@ -731,32 +940,28 @@ public:
         
         auto tmp(*this);
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_Plus);
+        TASK_ITEM(item, TASK_TYPE_Plus);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&tmp;
         item->poly3 = (void*)&rhs;
         item->modulus = m_params->GetModulus().ConvertToInt();
 
-        work_queue.addWork(item);
-
-        delete item;
+        offload(item);
 
         return tmp;
     }
     PolyImpl PlusNoCheck(const PolyImpl& rhs) const {
         auto tmp(*this);
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_Plus);
+        TASK_ITEM(item, TASK_TYPE_Plus);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&tmp;
         item->poly3 = (void*)&rhs;
         item->modulus = m_params->GetModulus().ConvertToInt();
 
-        work_queue.addWork(item);
-
-        delete item;
+        offload(item);
 
         return tmp;
     }
@@ -789,32 +994,28 @@ public:
         // std::cout << "PolyImpl Times(const PolyImpl& rhs)" << std::endl;
         auto tmp(*this);
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_Times);
+        TASK_ITEM(item, TASK_TYPE_Times);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&tmp;
         item->poly3 = (void*)&rhs;
         item->modulus = m_params->GetModulus().ConvertToInt();
 
-        work_queue.addWork(item);
-
-        delete item;
+        offload(item);
 
         return tmp;
     }
     PolyImpl TimesNoCheck(const PolyImpl& rhs) const {
         auto tmp(*this);
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_TimesNoCheck);
+        TASK_ITEM(item, TASK_TYPE_TimesNoCheck);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&tmp;
         item->poly3 = (void*)&rhs;
         item->modulus = m_params->GetModulus().ConvertToInt();
 
-        work_queue.addWork(item);
-
-        delete item;
+        offload(item);
 
         return tmp;
     }
@@ -829,15 +1030,66 @@ public:
         if (!m_values)
             m_values = std::make_unique<VecType>(m_params->GetRingDimension(), m_params->GetModulus());
 
-        CustomTaskItem* item = new CustomTaskItem(TASK_TYPE_TimesInPlace);
+        TASK_ITEM(item, TASK_TYPE_TimesInPlace);
 
         item->poly = (void*)this;
         item->poly2 = (void*)&rhs;
         item->modulus = m_params->GetModulus().ConvertToInt();
 
-        work_queue.addWork(item);
+        offload(item);
+
+        return *this;
+    }
 
-        delete item;
+    /* Fused multiply-accumulate on the shadows : this += a * b (TASK_TYPE_MulAddInPlace)
+        Same as *this += a * b without the temporary product polynomial and its shadow */
+    PolyImpl& MulAddInPlace(const PolyImpl& a, const PolyImpl& b) {
+        if (m_params->GetModulus() != a.m_params->GetModulus() || m_params->GetModulus() != b.m_params->GetModulus())
+            OPENFHE_THROW(math_error, "Modulus mismatch");
+        if (m_format != Format::EVALUATION || a.m_format != Format::EVALUATION || b.m_format != Format::EVALUATION)
+            OPENFHE_THROW(not_implemented_error, "MulAddInPlace for PolyImpl supported only in Format::EVALUATION");
+
+        if (!m_values)
+            m_values = std::make_unique<VecType>(m_params->GetRingDimension(), m_params->GetModulus());
+
+        TASK_ITEM(item, TASK_TYPE_MulAddInPlace);
+
+        item->poly = (void*)this;
+        item->poly2 = (void*)&a;
+        item->poly3 = (void*)&b;
+        item->modulus = m_params->GetModulus().ConvertToInt();
+
+        offload(item);
+
+        return *this;
+    }
+
+    /* Two accumulators sharing the multiplicand (TASK_TYPE_MulAddDual) : this += c * b, acc1 += c * a
+        c is brought to the shadow once for both products (key switching inner product) */
+    PolyImpl& MulAddDualInPlace(PolyImpl& acc1, const PolyImpl& c, const PolyImpl& b, const PolyImpl& a) {
+        const auto& q = m_params->GetModulus();
+        if (q != acc1.m_params->GetModulus() || q != c.m_params->GetModulus() || q != b.m_params->GetModulus() ||
+            q != a.m_params->GetModulus())
+            OPENFHE_THROW(math_error, "Modulus mismatch");
+        if (m_format != Format::EVALUATION || acc1.m_format != Format::EVALUATION || c.m_format != Format::EVALUATION ||
+            b.m_format != Format::EVALUATION || a.m_format != Format::EVALUATION)
+            OPENFHE_THROW(not_implemented_error, "MulAddDualInPlace for PolyImpl supported only in Format::EVALUATION");
+
+        if (!m_values)
+            m_values = std::make_unique<VecType>(m_params->GetRingDimension(), q);
+        if (!acc1.m_values)
+            acc1.m_values = std::make_unique<VecType>(m_params->GetRingDimension(), q);
+
+        TASK_ITEM(item, TASK_TYPE_MulAddDual);
+
+        item->poly = (void*)this;
+        item->poly2 = (void*)&acc1;
+        item->poly3 = (void*)&c;
+        item->poly4 = (void*)&b;
+        item->poly5 = (void*)&a;
+        item->modulus = q.ConvertToInt();
+
+        offload(item);
 
         return *this;
     }
@@ -879,6 +1131,16 @@ public:
                     const Integer& element,
                     PolyImpl& element2
                     );
+    /* Base conversion of several source limbs into this limb at once (TASK_TYPE_BCONV_BATCH)
+        this += sum_k (sources[k] lifted from its modulus to this modulus) * scalars[k]
+        Same as bconv_pipe of every source, but this is loaded and stored once for the batch.
+        centered : centered lift like bconv_pipe, otherwise residues are taken as they are (FastBaseConvSK) */
+    void bconv_batch(const std::vector<const PolyImpl*>& sources, const std::vector<NativeInteger>& scalars,
+                     bool centered = true);
+    /* Uniform limb expanded from a seed on the device (TASK_TYPE_SeededUniform, seeded evaluation key)
+        seed : 16 words of BLAKE2 seed, stream : limb index in the seed (same seed and stream, same limb)
+        only the seed crosses PCIe, the limb is made on the shadow */
+    void GenerateSeeded(const std::vector<uint32_t>& seed, uint64_t stream);
     void SwitchFormat() override;
     void MakeSparse(uint32_t wFactor) override;
     bool InverseExists() const override;
@@ -888,6 +1150,7 @@ public:
 
     template <class Archive>
     void save(Archive& ar, std::uint32_t const version) const {
+        this->copy_from_shadow(); // device-resident data is pulled back only here (and explicit host access)
         ar(::cereal::make_nvp("v", m_values));
         ar(::cereal::make_nvp("f", m_format));
         ar(::cereal::make_nvp("p", m_params));
@@ -902,6 +1165,7 @@ public:
         ar(::cereal::make_nvp("v", m_values));
         ar(::cereal::make_nvp("f", m_format));
         ar(::cereal::make_nvp("p", m_params));
+        this->indicate_modified_orig();
     }
 
     static const std::string GetElementName() {
@@ -8,6 +8,16 @@
 #include <thread>
 #include <unistd.h>
 #include <chrono>
+#include <vector>
+#include <set>
+#include <unordered_set>
+#include <unordered_map>
+#include <list>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include "utils/blockAllocator/blockAllocator.h"
 
 /* FHE Unit operation numbering */
 #define TASK_TYPE_PlainModMulEqScalar 1
@@ -26,6 +36,103 @@
 #define TASK_TYPE_TimesNoCheck 14
 #define TASK_TYPE_TimesInPlace 15
 #define TASK_TYPE_BCONV_PIPE 16
+#define TASK_TYPE_MulAddInPlace 17 // poly += poly2 * poly3
+#define TASK_TYPE_MulAddDual 18 // poly += poly3 * poly4, poly2 += poly3 * poly5 (key switching inner product)
+#define TASK_TYPE_BCONV_BATCH 19 // poly += sum of lifted inputs[k] * scalar (base conversion of several source limbs)
+#define TASK_TYPE_SeededUniform 20 // poly = uniform limb expanded from a seed (input_params : seed words, stream)
+#define TASK_TYPE_Prefetch 21 // stage poly on the on-chip buffer before it is used (only data movement)
+#define TASK_TYPE_DeviceTransfer 22 // copy (or move) poly to another device (multi-device mode, utils/multi_device.h)
+#define TASK_TYPE_MAX 22
+
+/* most polynomials used by a task (poly .. poly5) */
+#define TASK_MAX_POLYS 5
+
+/* Pool of task descriptors, so that offloading a unit op does not go to the heap.
+    Every thread allocates descriptors from its own free-list (utils/blockAllocator, not thread-safe by itself).
+    A descriptor released by other thread (consumer releases async tasks) is pushed to the remote list of its owner pool,
+    owner takes them back to its free-list at the next allocation.
+    Pools are never destroyed, a descriptor can be still in the queue when its owner thread exits. */
+class TaskItemPool {
+private:
+    struct alignas(16) Header {
+        TaskItemPool* owner;
+        Header* next_remote;
+    };
+
+    Allocator allocator;
+    std::atomic<Header*> remote_head{nullptr};
+    std::atomic<uint64_t> remote_frees{0};
+
+    explicit TaskItemPool(size_t object_size) : allocator(sizeof(Header) + object_size, 0, nullptr, "CustomTaskItem") {}
+
+    static std::mutex& registry_mtx() {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::vector<TaskItemPool*>& registry() {
+        static std::vector<TaskItemPool*> pools;
+        return pools;
+    }
+
+    void drain_remote() {
+        Header* h = remote_head.exchange(nullptr, std::memory_order_acquire);
+        while (h) {
+            Header* next = h->next_remote;
+            allocator.Deallocate(h);
+            h = next;
+        }
+    }
+
+public:
+    static TaskItemPool& local(size_t object_size) {
+        static thread_local TaskItemPool* pool = nullptr;
+        if (!pool) {
+            pool = new TaskItemPool(object_size);
+            std::unique_lock<std::mutex> lock(registry_mtx());
+            registry().push_back(pool);
+        }
+        return *pool;
+    }
+
+    void* allocate(size_t size) {
+        if (remote_head.load(std::memory_order_relaxed)) drain_remote();
+        Header* h = reinterpret_cast<Header*>(allocator.Allocate(sizeof(Header) + size));
+        h->owner = this;
+        h->next_remote = nullptr;
+        return reinterpret_cast<void*>(h + 1);
+    }
+
+    static void deallocate(void* ptr, size_t object_size) {
+        if (!ptr) return;
+        Header* h = reinterpret_cast<Header*>(ptr) - 1;
+        TaskItemPool* owner = h->owner;
+        if (owner == &local(object_size)) {
+            owner->allocator.Deallocate(h);
+            return;
+        }
+        // released by other thread, give it back to the owner
+        Header* head = owner->remote_head.load(std::memory_order_relaxed);
+        do {
+            h->next_remote = head;
+        } while (!owner->remote_head.compare_exchange_weak(head, h, std::memory_order_release, std::memory_order_relaxed));
+        owner->remote_frees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /* sum of every thread's pool (read them when the queue is drained) */
+    static void get_stats(uint64_t& pools, uint64_t& allocations, uint64_t& deallocations, uint64_t& heap_blocks,
+                          uint64_t& remote) {
+        std::unique_lock<std::mutex> lock(registry_mtx());
+        pools = registry().size();
+        allocations = deallocations = heap_blocks = remote = 0;
+        for (auto pool : registry()) {
+            allocations += pool->allocator.GetAllocations();
+            deallocations += pool->allocator.GetDeallocations();
+            heap_blocks += pool->allocator.GetBlockCount();
+            remote += pool->remote_frees.load(std::memory_order_relaxed);
+        }
+    }
+};
 
 struct CustomTaskItem {
   int task_type;
@@ -33,6 +140,8 @@ struct CustomTaskItem {
   void* poly;
   void* poly2;
   void* poly3;
+  void* poly4;
+  void* poly5;
 
   uint64_t param1;
   uint64_t param2;
@@ -41,138 +150,749 @@ struct CustomTaskItem {
   uint64_t param5;
   uint64_t modulus;
   uint32_t* ptr32_1;
+  int32_t device; // device running the task, -1 : device of modulus (device_of_modulus)
+
+  /* read-only polynomials beyond poly .. poly5 and their parameters (TASK_TYPE_BCONV_BATCH),
+     dependencies of the scheduler cover them too (for_each_task_poly) */
+  std::vector<void*> inputs;
+  std::vector<uint64_t> input_params;
 
   std::atomic<bool> processed;
 
-  CustomTaskItem(int t) : task_type(t), poly(NULL), poly2(NULL), poly3(NULL), param1(0), param2(0), param3(0), param4(0), param5(0), ptr32_1(NULL), processed(false){}
+  /* completion token given by WorkQueue::submitWork
+     release_on_done : item posted asynchronously, consumer deletes it after processing */
+  uint64_t ticket;
+  bool release_on_done;
+  bool inflight_tracked; // dispatched through the dependency window (WorkQueue::takeReadyWork)
+
+  CustomTaskItem(int t) : task_type(t), poly(NULL), poly2(NULL), poly3(NULL), poly4(NULL), poly5(NULL), param1(0), param2(0), param3(0), param4(0), param5(0), modulus(0), ptr32_1(NULL), device(-1), processed(false), ticket(0), release_on_done(false), inflight_tracked(false){}
+
+  /* heap descriptors (async offload) come from the per-thread pool,
+     synchronous offload puts the descriptor on the stack (TASK_ITEM in poly.h) */
+  void* operator new(size_t size) {
+    return TaskItemPool::local(sizeof(CustomTaskItem)).allocate(size);
+  }
+  void operator delete(void* ptr) {
+    TaskItemPool::deallocate(ptr, sizeof(CustomTaskItem));
+  }
+};
+
+/* Per-worker statistics of the consumer pool */
+struct WorkerStat {
+    uint64_t num_tasks = 0;
+    uint64_t num_batches = 0;
+    uint64_t num_dep_stalls = 0; // getWork found tasks, but all of them wait for other workers
+    uint64_t task_type_cnt[TASK_TYPE_MAX + 1] = {0};
+    std::chrono::duration<double, std::milli> elapsed_work = std::chrono::duration<double, std::milli>(0.0);
+    std::chrono::duration<double, std::milli> elapsed_getwork = std::chrono::duration<double, std::milli>(0.0);
+};
+
+/* Polynomials of a task (poly .. poly5) which the consumer modifies, the others are only read
+    (see consumer in lattice/hal/default/poly-impl.h) */
+#define TASK_POLY1 1
+#define TASK_POLY2 2
+#define TASK_POLY3 4
+#define TASK_POLY4 8
+#define TASK_POLY5 16
+
+static inline uint32_t task_write_mask(int task_type) {
+    switch(task_type) {
+        case TASK_TYPE_PlusScalar:
+        case TASK_TYPE_MinusScalar:
+        case TASK_TYPE_PlainModMulScalar:
+        case TASK_TYPE_Minus:
+        case TASK_TYPE_AutomorphismTransform:
+        case TASK_TYPE_Plus:
+        case TASK_TYPE_Times:
+        case TASK_TYPE_TimesNoCheck:
+            return TASK_POLY2;
+        case TASK_TYPE_MulAddDual:
+            return TASK_POLY1 | TASK_POLY2;
+        case TASK_TYPE_Prefetch:
+        case TASK_TYPE_DeviceTransfer:
+            return 0; // values are not changed, only the location
+        default: // in-place operations, NTT, SwitchModulus, BCONV_PIPE, BCONV_BATCH, SeededUniform
+            return TASK_POLY1;
+    }
+}
+
+/* f(poly, written) for every polynomial of the task : poly .. poly5, then the inputs (only read) */
+template <typename F>
+static inline void for_each_task_poly(const CustomTaskItem* item, F f) {
+    void* polys[TASK_MAX_POLYS] = {item->poly, item->poly2, item->poly3, item->poly4, item->poly5};
+    uint32_t wmask = task_write_mask(item->task_type);
+    for(int k = 0; k < TASK_MAX_POLYS; k++) {
+        if(polys[k]) f(polys[k], ((wmask >> k) & 1) != 0);
+    }
+    for(auto p : item->inputs) {
+        f(p, false);
+    }
+}
+
+static inline bool task_is_ntt(int task_type) {
+    return task_type == TASK_TYPE_SwitchFormatForwardTransform || task_type == TASK_TYPE_SwitchFormatInverseTransform;
+}
+
+/* Reorder scheduler (WorkQueue::setScheduler)
+    SCHED_NTT_BATCH : NTTs with the same modulus (same twiddle table) given to a worker at once
+    SCHED_RESIDENT_POLYS : default size of the residency model, init_stat sets it to the OCB entries */
+#define SCHED_NTT_BATCH 8
+#define SCHED_RESIDENT_POLYS 64
+
+/* Model of the on-chip buffer for the scheduler : LRU set of the polynomials used by the recently dispatched tasks */
+class PolyResidency {
+private:
+    std::list<void*> lru; // front : most recent
+    std::unordered_map<void*, std::list<void*>::iterator> position;
+    size_t capacity = SCHED_RESIDENT_POLYS;
+
+public:
+    void reset(size_t _capacity) {
+        lru.clear();
+        position.clear();
+        capacity = _capacity ? _capacity : 1;
+    }
+
+    bool contains(void* p) const {
+        return position.count(p) != 0;
+    }
+
+    /* use p, returns whether p was resident */
+    bool touch(void* p) {
+        auto it = position.find(p);
+        if(it != position.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return true;
+        }
+        lru.push_front(p);
+        position[p] = lru.begin();
+        if(lru.size() > capacity) {
+            position.erase(lru.back());
+            lru.pop_back();
+        }
+        return false;
+    }
+};
+
+struct SchedulerStat {
+    uint64_t decisions = 0;   // scheduling rounds (getWork)
+    uint64_t window_sum = 0;  // queued tasks seen by the rounds
+    uint64_t ready_sum = 0;   // tasks without hazard in the rounds
+    uint64_t tasks = 0;
+    uint64_t reordered = 0;   // tasks dispatched before an older queued task
+    uint64_t max_distance = 0;
+    uint64_t forced = 0;      // oldest task taken because it was bypassed too long
+    uint64_t ntt_batches = 0; // rounds which gave more than one NTT
+    uint64_t ntt_batched = 0;
+    uint64_t poly_uses = 0;
+    uint64_t resident_hits = 0; // polynomial found in the residency model, dispatched order
+    uint64_t inorder_hits = 0;  // same, posted order
+};
+
+/* Bounded lock-free multi-producer/multi-consumer ring of task pointers (Vyukov style).
+    Slots are allocated once. Every slot has a sequence number which tells
+    whether the slot is ready to be written (seq == pos) or to be read (seq == pos + 1). */
+class TaskRing {
+private:
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        CustomTaskItem* data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> enqueue_pos{0};
+    alignas(64) std::atomic<uint64_t> dequeue_pos{0};
+
+public:
+    explicit TaskRing(uint64_t capacity) {
+        uint64_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (uint64_t i = 0; i < size; i++) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+            cells[i].data = NULL;
+        }
+    }
+
+    bool push(CustomTaskItem* data) {
+        Cell* cell;
+        uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (1) {
+            cell = &cells[pos & mask];
+            uint64_t seq = cell->seq.load(std::memory_order_acquire);
+            int64_t dif = (int64_t)seq - (int64_t)pos;
+            if (dif == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (dif < 0) {
+                return false; // full
+            }
+            else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = data;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(CustomTaskItem*& data) {
+        Cell* cell;
+        uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (1) {
+            cell = &cells[pos & mask];
+            uint64_t seq = cell->seq.load(std::memory_order_acquire);
+            int64_t dif = (int64_t)seq - (int64_t)(pos + 1);
+            if (dif == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (dif < 0) {
+                return false; // empty
+            }
+            else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        data = cell->data;
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t size_approx() const {
+        uint64_t enq = enqueue_pos.load(std::memory_order_acquire);
+        uint64_t deq = dequeue_pos.load(std::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    bool empty() const {
+        return size_approx() == 0;
+    }
+
+    uint64_t capacity() const {
+        return mask + 1;
+    }
 };
 
+/* Backoff for spinning threads : pause -> yield, and tells when the thread better parks */
+struct Backoff {
+    uint32_t spins = 0;
+
+    void pause() {
+        if (spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#else
+            std::this_thread::yield();
+#endif
+        }
+        else {
+            std::this_thread::yield();
+        }
+        spins++;
+    }
+
+    bool should_park() const {
+        return spins >= 256;
+    }
+
+    void reset() {
+        spins = 0;
+    }
+};
+
+#define WORK_QUEUE_RING_SIZE (1 << 14)
+
 class WorkQueue {
 private:
-    std::deque<CustomTaskItem*> queue;
+    /* Producers post to the lock-free ring.
+       window : tasks moved out of the ring by consumers, which wait for dependency or batching.
+                Only consumers use it (mtx), producers never take a lock */
+    TaskRing ring{WORK_QUEUE_RING_SIZE};
+    std::deque<CustomTaskItem*> window;
     std::mutex mtx;
 
-    bool finished = false;
+    std::atomic<bool> finished{false};
 
-    uint32_t num_parallel_jobs = 1;
+    std::atomic<uint32_t> num_parallel_jobs{1};
     uint32_t num_parallel_jobs_synched = 0;
-    std::chrono::duration<double, std::milli> elapsed_busywaiting = std::chrono::duration<double, std::milli>(0.0);
+    std::atomic<uint64_t> busywaiting_ns{0}; // consumer time spent waiting for tasks
+
+    /* Completion tokens (tickets) are given in submission order.
+       done_ticket : every ticket <= done_ticket is processed
+       done_out_of_order : processed tickets above done_ticket (batching can take tasks out of order)
+       flush_waiters : number of producers waiting on a ticket,
+                       consumer should not hold tasks for num_parallel_jobs batching while it is not zero */
+    std::atomic<uint64_t> next_ticket{0};
+    std::atomic<uint64_t> done_ticket{0};
+    std::set<uint64_t> done_out_of_order;
+    std::mutex done_mtx;
+    std::atomic<uint32_t> flush_waiters{0};
+
+    uint32_t num_workers = 1;
+    std::vector<WorkerStat> worker_stats = std::vector<WorkerStat>(1);
+    std::unordered_map<void*, uint32_t> inflight;
+
+    /* Reorder scheduler, sched_window = 0 : tasks are dispatched in posted order (see scheduleReadyWork) */
+    std::atomic<uint32_t> sched_window{0};
+    PolyResidency sched_resident;   // polynomials of the dispatched tasks
+    PolyResidency inorder_resident; // the same model fed in posted order, hit rate without reordering
+    SchedulerStat sched_stat;
+    CustomTaskItem* sched_head = NULL;
+    uint32_t sched_head_bypassed = 0;
+    uint64_t sched_last_ntt_modulus = 0;
+
+    /* Parking of idle consumers
+       wake_seq is increased whenever a parked consumer may have something to do */
+    std::mutex park_mtx;
+    std::condition_variable park_cv;
+    std::atomic<uint32_t> sleepers{0};
+    std::atomic<uint64_t> wake_seq{0};
+
+    static bool& consumer_thread_flag() {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    void wake_consumers() {
+        wake_seq.fetch_add(1, std::memory_order_seq_cst);
+        if(sleepers.load(std::memory_order_seq_cst)) {
+            std::unique_lock<std::mutex> lock(park_mtx);
+            park_cv.notify_all();
+        }
+    }
+
+    void park(uint64_t seen_wake_seq) {
+        std::unique_lock<std::mutex> lock(park_mtx);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        park_cv.wait_for(lock, std::chrono::microseconds(200), [&] {
+            return wake_seq.load(std::memory_order_seq_cst) != seen_wake_seq || !ring.empty() ||
+                   finished.load(std::memory_order_acquire);
+        });
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    /* one worker without batching : take tasks right from the ring in posted order, no dispatch lock */
+    bool fast_path() {
+        return num_workers == 1 && num_parallel_jobs.load(std::memory_order_relaxed) == 1 &&
+               sched_window.load(std::memory_order_relaxed) == 0;
+    }
 
 public:
     void print_elapsed_busywaiting() {
-        std::cout << "elapsed_busywaiting: " << elapsed_busywaiting.count() << " ms" << std::endl;
+        std::cout << "elapsed_busywaiting: " << busywaiting_ns.load() / 1e6 << " ms" << std::endl;
     }
 
     void init_elapsed_busywaiting(){
-        elapsed_busywaiting = std::chrono::duration<double, std::milli>(0.0);
+        busywaiting_ns.store(0);
+    }
+
+    /* Post the task and return right away with its completion token.
+       Caller must not touch item after this call when item->release_on_done is set. */
+    uint64_t submitWork(CustomTaskItem* item) {
+        uint64_t ticket = next_ticket.fetch_add(1, std::memory_order_acq_rel) + 1;
+        item->ticket = ticket;
+        Backoff backoff;
+        while (!ring.push(item)) {
+            backoff.pause(); // ring full, wait for consumers
+        }
+        if(sleepers.load(std::memory_order_seq_cst)) wake_consumers();
+        return ticket;
+    }
+
+    bool isDone(uint64_t ticket) {
+        return ticket <= done_ticket.load(std::memory_order_acquire);
     }
 
-    void addWork(CustomTaskItem* item) {
-        {
-            std::unique_lock<std::mutex> lock(mtx);        
-            queue.push_back(item);
+    /* Wait until the task with the given token is processed.
+       Token 0 means nothing is pending. Consumer thread never waits (it is the one who finishes the work). */
+    void waitFor(uint64_t ticket) {
+        if(ticket == 0 || isDone(ticket) || consumer_thread_flag()) return;
+
+        flush_waiters.fetch_add(1, std::memory_order_acq_rel);
+        wake_consumers();
+        Backoff backoff;
+        while (!isDone(ticket)) {
+            backoff.pause();
         }
+        flush_waiters.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void waitAll() {
+        waitFor(next_ticket.load(std::memory_order_acquire));
+    }
+
+    /* consumer calls this once, so that a wait in the consumer thread does not deadlock */
+    void markConsumerThread() {
+        consumer_thread_flag() = true;
+    }
+
+    /* Post the task and busy-wait until it is processed.
+       flush : do not let consumer hold the task for num_parallel_jobs batching
+               (async mode, no other producer may fill the batch) */
+    void addWork(CustomTaskItem* item, bool flush = false) {
+        if(flush) flush_waiters.fetch_add(1, std::memory_order_acq_rel);
+        submitWork(item);
+        if(flush) wake_consumers();
     
         //Busy waiting until the work finishes..
+        Backoff backoff;
         while (!item->processed.load(std::memory_order_acquire)) {
-            std::this_thread::yield(); // Yield to reduce CPU usage
+            backoff.pause();
         }
+        if(flush) flush_waiters.fetch_sub(1, std::memory_order_acq_rel);
     }
 
     void setNumParallelJobs(uint32_t _num_parallel_jobs) {
         std::unique_lock<std::mutex> lock(mtx);
-        num_parallel_jobs = _num_parallel_jobs;
+        num_parallel_jobs.store(_num_parallel_jobs ? _num_parallel_jobs : 1);
+        wake_consumers();
     }
 
-    bool getWork(std::vector<CustomTaskItem*>& items) {
+    /* Multi-worker consumer pool
+       Tasks using the same polynomial (poly .. poly5) must keep their posted order
+       and must not run on two workers at the same time (shadow state is not thread-safe).
+       inflight : polynomials used by the tasks currently processed by workers */
+    void setNumWorkers(uint32_t _num_workers) {
         std::unique_lock<std::mutex> lock(mtx);
-        
-        //Busy waiting until a job posted.
-        //If num_parallel_jobs is greater than 1, wait for at least num_parallel_jobs tasks.
-        while(1) {
-            bool queue_ready = !queue.empty() && (num_parallel_jobs==1 || (num_parallel_jobs_synched!=0 || queue.size()>=num_parallel_jobs )); 
-            
-            if(queue_ready ||  finished) break;
+        num_workers = _num_workers ? _num_workers : 1;
+        worker_stats.assign(num_workers, WorkerStat());
+    }
+
+    uint32_t getNumWorkers() {
+        return num_workers;
+    }
 
-            // auto start_work = std::chrono::high_resolution_clock::now();
+    WorkerStat& getWorkerStat(uint32_t worker_id) {
+        return worker_stats[worker_id];
+    }
 
-            lock.unlock();
-            // std::this_thread::yield(); // Yield to reduce CPU usage
-            lock.lock();
+    /* Reorder tasks within the first window tasks of the queue (0 : posted order) */
+    void setScheduler(uint32_t window) {
+        std::unique_lock<std::mutex> lock(mtx);
+        sched_window.store(window);
+        sched_stat = SchedulerStat();
+        wake_consumers();
+    }
+
+    /* size of the residency model (on-chip buffer entries), clears the scheduler statistics */
+    void setSchedulerResidentPolys(uint32_t resident_polys) {
+        std::unique_lock<std::mutex> lock(mtx);
+        sched_resident.reset(resident_polys);
+        inorder_resident.reset(resident_polys);
+        sched_stat = SchedulerStat();
+    }
+
+    const SchedulerStat& getSchedulerStat() {
+        return sched_stat;
+    }
 
-            // auto end_work = std::chrono::high_resolution_clock::now();
-            // elapsed_busywaiting += end_work - start_work;
-            // std::cout << "elapsed_busywaiting: " << elapsed_busywaiting.count() << " ms" << std::endl;
+    void print_scheduler_stats() {
+        uint32_t window = sched_window.load();
+        if(window == 0) return;
+        SchedulerStat& st = sched_stat;
+        double rounds = st.decisions ? (double)st.decisions : 1;
+        double tasks = st.tasks ? (double)st.tasks : 1;
+        double uses = st.poly_uses ? (double)st.poly_uses : 1;
+        std::cout << "scheduler: window " << window << ", rounds " << st.decisions
+                  << ", avg queued " << st.window_sum / rounds << ", avg ready " << st.ready_sum / rounds << std::endl;
+        std::cout << "    reordered " << st.reordered << " / " << st.tasks << " (" << 100.0 * st.reordered / tasks
+                  << "%), max distance " << st.max_distance << ", forced " << st.forced << std::endl;
+        std::cout << "    NTT batches " << st.ntt_batches << " (" << st.ntt_batched << " tasks)" << std::endl;
+        std::cout << "    residency hit rate " << 100.0 * st.resident_hits / uses << "% (in order "
+                  << 100.0 * st.inorder_hits / uses << "%)" << std::endl;
+    }
+
+    void print_worker_stats() {
+        for(uint32_t w = 0; w < worker_stats.size(); w++) {
+            WorkerStat& ws = worker_stats[w];
+            std::cout << "worker " << w << ": tasks " << ws.num_tasks << ", batches " << ws.num_batches
+                      << ", dependency stalls " << ws.num_dep_stalls
+                      << ", work " << ws.elapsed_work.count() << " ms, getwork " << ws.elapsed_getwork.count() << " ms" << std::endl;
+            std::cout << "    ";
+            for(int t = 1; t <= TASK_TYPE_MAX; t++) {
+                if(ws.task_type_cnt[t]) std::cout << "type" << t << ":" << ws.task_type_cnt[t] << " ";
+            }
+            std::cout << std::endl;
         }
+    }
 
-        if (queue.empty()) return false;
+    bool getWork(std::vector<CustomTaskItem*>& items, uint32_t worker_id = 0) {
+        auto start_wait = std::chrono::high_resolution_clock::now();
+        Backoff backoff;
         
-        if(num_parallel_jobs > 1) {
-            if(num_parallel_jobs_synched == 0) {
-                num_parallel_jobs_synched = num_parallel_jobs;
+        //Spin, and park when nothing comes for a while, until a job posted.
+        //If num_parallel_jobs is greater than 1, wait for at least num_parallel_jobs tasks.
+        while(1) {
+            uint64_t seen_wake_seq = wake_seq.load(std::memory_order_seq_cst);
+
+            if(fast_path()) {
+                std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
+                CustomTaskItem* item;
+                if(window.empty() && ring.pop(item)) {
+                    items.push_back(item);
+                    break;
+                }
+                if(!window.empty()) {
+                    // left from the batching mode
+                    lock.lock();
+                    if(takeReadyWork(items)) break;
+                    lock.unlock();
+                }
+                else if(finished.load(std::memory_order_acquire) && ring.empty()) {
+                    return false;
+                }
+            }
+            else {
+                std::unique_lock<std::mutex> lock(mtx);
+                CustomTaskItem* item;
+                bool scheduling = sched_window.load(std::memory_order_relaxed) != 0;
+                while(window.size() < ring.capacity() && ring.pop(item)) {
+                    window.push_back(item);
+                    if(scheduling) {
+                        for_each_task_poly(item, [&](void* p, bool) {
+                            if(inorder_resident.touch(p)) sched_stat.inorder_hits++;
+                        });
+                    }
+                }
+
+                uint32_t jobs = num_parallel_jobs.load(std::memory_order_relaxed);
+                bool is_finished = finished.load(std::memory_order_acquire);
+                bool queue_ready = !window.empty() && (jobs==1 || (num_parallel_jobs_synched!=0 || window.size()>=jobs )
+                                                      || flush_waiters.load(std::memory_order_acquire)!=0); 
+                
+                if(window.empty() && is_finished && ring.empty()) return false;
+
+                if(queue_ready || (is_finished && !window.empty())) {
+                    if(takeReadyWork(items)) break;
+                    // every queued task depends on a task of other workers
+                    if(worker_id < worker_stats.size()) worker_stats[worker_id].num_dep_stalls++;
+                }
             }
-            num_parallel_jobs_synched --;
+
+            if(backoff.should_park()) park(seen_wake_seq);
+            else backoff.pause();
         }
-    
-        auto item = queue.front();
-        queue.pop_front();        
-        items.push_back(item);
 
-        uint64_t modulus =  item->modulus;
-        for (auto it = queue.begin(); it != queue.end(); ++it) {
-            if(num_parallel_jobs_synched == 0) break;
+        auto end_wait = std::chrono::high_resolution_clock::now();
+        busywaiting_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end_wait - start_wait).count(),
+                                 std::memory_order_relaxed);
 
-            bool param_match = false;
+        if(worker_id < worker_stats.size()) {
+            worker_stats[worker_id].num_batches++;
+            worker_stats[worker_id].num_tasks += items.size();
+            for(auto item : items) {
+                if(item->task_type >= 0 && item->task_type <= TASK_TYPE_MAX) worker_stats[worker_id].task_type_cnt[item->task_type]++;
+            }
+        }
 
-            if( modulus ==  (*it)->modulus ) param_match = true;
+        return true;
+    }
 
-            if (param_match)  {
-                auto o_item = queue.front();
-                queue.pop_front();
-                items.push_back(o_item);
+    /* Take the first queued task whose polynomials are not used by other workers
+       and not used by an earlier queued task (keep the order between dependent tasks).
+       With num_parallel_jobs batching, also take the following independent tasks with the same modulus.
+       mtx must be locked (window and inflight belong to consumers) */
+    bool takeReadyWork(std::vector<CustomTaskItem*>& items) {
+        if(sched_window.load(std::memory_order_relaxed)) return scheduleReadyWork(items);
+
+        std::unordered_set<void*> blocked;
+        bool batching = false;
+        uint64_t modulus = 0;
+
+        uint32_t jobs = num_parallel_jobs.load(std::memory_order_relaxed);
+        for (auto it = window.begin(); it != window.end(); ) {
+            CustomTaskItem* item = *it;
+
+            bool dep = false;
+            for_each_task_poly(item, [&](void* p, bool) {
+                if(inflight.count(p) || blocked.count(p)) dep = true;
+            });
+
+            bool take = !dep && (items.empty() || (batching && num_parallel_jobs_synched != 0 && modulus == item->modulus));
+            if(!take) {
+                for_each_task_poly(item, [&](void* p, bool) { blocked.insert(p); });
+                if(!items.empty() && (!batching || num_parallel_jobs_synched == 0)) break;
+                ++it;
+                continue;
+            }
 
-                num_parallel_jobs_synched --;
+            if(items.empty()) {
+                modulus = item->modulus;
+                if(jobs > 1) {
+                    batching = true;
+                    if(num_parallel_jobs_synched == 0) {
+                        num_parallel_jobs_synched = jobs;
+                    }
+                }
             }
+            if(batching) num_parallel_jobs_synched --;
+
+            for_each_task_poly(item, [&](void* p, bool) { inflight[p]++; });
+            item->inflight_tracked = true;
+            items.push_back(item);
+            it = window.erase(it);
         }
 
-        // void* poly3 = item->poly3;
-        // int task_type = item->task_type;
-        // uint64_t modulus =  item->param3;
+        return !items.empty();
+    }
 
-        // // Iterate from the second element to the end to find tasks that can be processed together.
-        // for (auto it = queue.begin(); it != queue.end(); ++it) {
-        //     if(num_parallel_jobs_synched == 0) break;
+    /* Reorder scheduler
+        The first sched_window queued tasks form a DAG : a task depends on an earlier queued task
+        when it reads a polynomial the earlier one writes (RAW), or writes one the earlier one reads or writes (WAR, WAW).
+        Tasks without such an edge and without a polynomial in use by the other workers are ready (roots of the DAG).
+        Among the ready tasks take the one whose polynomials are the most in the residency model (likely still in the OCB),
+        then an NTT with the modulus of the last NTT (twiddle table loaded), then the oldest.
+        NTTs of the same type and modulus, or num_parallel_jobs tasks with the same modulus, go together.
+        A queued head bypassed sched_window times is taken first so that nothing starves.
+        mtx must be locked */
+    bool scheduleReadyWork(std::vector<CustomTaskItem*>& items) {
+        size_t limit = std::min<size_t>(window.size(), sched_window.load(std::memory_order_relaxed));
+        std::unordered_set<void*> written;
+        std::unordered_set<void*> read;
+        std::vector<size_t> ready;
+
+        for(size_t i = 0; i < limit; i++) {
+            CustomTaskItem* item = window[i];
+
+            bool dep = false;
+            for_each_task_poly(item, [&](void* p, bool write) {
+                if(inflight.count(p) || written.count(p)) dep = true;
+                if(write && read.count(p)) dep = true;
+            });
+            if(!dep) ready.push_back(i);
+            for_each_task_poly(item, [&](void* p, bool write) {
+                if(write) written.insert(p);
+                else read.insert(p);
+            });
+        }
 
-        //     void* o_poly3 = (*it)->poly3;
+        sched_stat.decisions++;
+        sched_stat.window_sum += window.size();
+        sched_stat.ready_sum += ready.size();
+        if(ready.empty()) return false;
 
-        //     bool param_match = false;
-        //     if (poly3) {
-        //         if (poly3 == o_poly3) param_match = true;
-        //     }
+        // choose the first task
+        size_t first = ready[0];
+        if(ready[0] == 0 && sched_head == window[0] && sched_head_bypassed >= limit) {
+            sched_stat.forced++;
+        }
+        else {
+            int best_hits = -1;
+            bool best_twiddle = false;
+            for(auto i : ready) {
+                CustomTaskItem* item = window[i];
+                int hits = 0;
+                for_each_task_poly(item, [&](void* p, bool) {
+                    if(sched_resident.contains(p)) hits++;
+                });
+                bool twiddle = task_is_ntt(item->task_type) && item->modulus == sched_last_ntt_modulus;
+                if(hits > best_hits || (hits == best_hits && twiddle && !best_twiddle)) {
+                    first = i;
+                    best_hits = hits;
+                    best_twiddle = twiddle;
+                }
+            }
+        }
 
-        //     if(task_type == TASK_TYPE_SwitchFormatForwardTransform || task_type == TASK_TYPE_SwitchFormatInverseTransform) {
-        //         if( modulus ==  (*it)->param3 ) param_match = true;
-        //     }
+        // batch
+        std::vector<size_t> taken(1, first);
+        CustomTaskItem* lead = window[first];
+        uint32_t jobs = num_parallel_jobs.load(std::memory_order_relaxed);
+        size_t batch = jobs > 1 ? jobs : (task_is_ntt(lead->task_type) ? SCHED_NTT_BATCH : 1);
+        for(auto i : ready) {
+            if(taken.size() >= batch) break;
+            if(i == first || window[i]->modulus != lead->modulus) continue;
+            if(task_is_ntt(lead->task_type) && window[i]->task_type != lead->task_type) continue;
+            taken.push_back(i);
+        }
+        std::sort(taken.begin(), taken.end());
 
-        //     if (param_match)  {
-        //         auto o_item = queue.front();
-        //         queue.pop_front();
-        //         items.push_back(o_item);
+        if(task_is_ntt(lead->task_type)) {
+            sched_last_ntt_modulus = lead->modulus;
+            if(taken.size() > 1) {
+                sched_stat.ntt_batches++;
+                sched_stat.ntt_batched += taken.size();
+            }
+        }
+
+        for(size_t k = 0; k < taken.size(); k++) {
+            CustomTaskItem* item = window[taken[k]];
+            if(taken[k] > k) {
+                // older tasks stay queued
+                sched_stat.reordered++;
+                sched_stat.max_distance = std::max<uint64_t>(sched_stat.max_distance, taken[k] - k);
+            }
+            for_each_task_poly(item, [&](void* p, bool) {
+                inflight[p]++;
+                sched_stat.poly_uses++;
+                if(sched_resident.touch(p)) sched_stat.resident_hits++;
+            });
+            item->inflight_tracked = true;
+            items.push_back(item);
+        }
+        sched_stat.tasks += taken.size();
 
-        //         num_parallel_jobs_synched --;
-        //     }
-        // }
+        if(taken[0] == 0) {
+            sched_head = NULL;
+            sched_head_bypassed = 0;
+        }
+        else if(sched_head == window[0]) {
+            sched_head_bypassed++;
+        }
+        else {
+            sched_head = window[0];
+            sched_head_bypassed = 1;
+        }
 
+        for(size_t k = taken.size(); k-- > 0;) {
+            window.erase(window.begin() + taken[k]);
+        }
         return true;
     }
 
     void workProcessed(CustomTaskItem*& item) {
+        uint64_t ticket = item->ticket;
+        bool release = item->release_on_done;
+        if(item->inflight_tracked) {
+            std::unique_lock<std::mutex> lock(mtx);
+            for_each_task_poly(item, [&](void* p, bool) {
+                auto found = inflight.find(p);
+                if(found != inflight.end() && --found->second == 0) inflight.erase(found);
+            });
+            lock.unlock();
+            // tasks waiting for these polynomials can go now
+            if(sleepers.load(std::memory_order_seq_cst)) wake_consumers();
+        }
         item->processed.store(true, std::memory_order_release);
+        if(release) {
+            delete item;
+            item = NULL;
+        }
+
+        std::unique_lock<std::mutex> lock(done_mtx);
+        uint64_t done = done_ticket.load(std::memory_order_relaxed);
+        if(ticket != done + 1) {
+            done_out_of_order.insert(ticket);
+            return;
+        }
+        done = ticket;
+        while(!done_out_of_order.empty() && *done_out_of_order.begin() == done + 1) {
+            done_out_of_order.erase(done_out_of_order.begin());
+            done++;
+        }
+        done_ticket.store(done, std::memory_order_release);
     }
 
     void finish() {
-        std::unique_lock<std::mutex> lock(mtx);
-        finished = true;
+        finished.store(true, std::memory_order_release);
+        wake_consumers();
+    }
+
+    /* queue takes work again after finish, only when no consumer is running (init_stat after stop_consumer_workers) */
+    void restart() {
+        finished.store(false, std::memory_order_release);
     }
 };
 
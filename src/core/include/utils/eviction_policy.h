@@ -0,0 +1,124 @@
+#ifndef EVICTION_POLICY_H
+#define EVICTION_POLICY_H
+
+#include <stdint.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Eviction policy of a shadow memory tier (on-chip buffer or HBM)
+    Entries are identified by the shadow address (key) used in the memory tracking structure.
+    next_use : position of the next access of the entry in the recorded access trace
+               (only the Belady oracle uses it, EVICTION_NEVER_USED if there is no more access) */
+
+#define EVICTION_NEVER_USED UINT64_MAX
+
+class EvictionPolicy {
+public:
+    virtual ~EvictionPolicy() {}
+
+    virtual const char* name() const = 0;
+
+    virtual void insert(uint64_t key, uint64_t next_use) = 0;
+    virtual void access(uint64_t key, uint64_t next_use) = 0;
+    virtual void remove(uint64_t key) = 0;
+
+    /* choose the victim among the entries where evictable(key) is true, 0 if there is no such entry.
+        evictable may claim the entry (memory tracking), so it is asked only for a candidate and
+        the first candidate it accepts is the victim. victim is not removed, the caller removes it */
+    virtual uint64_t victim(const std::function<bool(uint64_t)>& evictable) = 0;
+};
+
+/* First in, first out. Access does not change the order (original memory tracking rule) */
+class FifoEvictionPolicy : public EvictionPolicy {
+protected:
+    std::list<uint64_t> order;  // front : newest
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> position;
+
+public:
+    const char* name() const override {
+        return "FIFO";
+    }
+    void insert(uint64_t key, uint64_t next_use) override;
+    void access(uint64_t key, uint64_t next_use) override {}
+    void remove(uint64_t key) override;
+    uint64_t victim(const std::function<bool(uint64_t)>& evictable) override;
+};
+
+/* Least recently used : access moves the entry to the front */
+class LruEvictionPolicy : public FifoEvictionPolicy {
+public:
+    const char* name() const override {
+        return "LRU";
+    }
+    void access(uint64_t key, uint64_t next_use) override;
+};
+
+/* CLOCK (second chance) : access sets the reference bit, the hand clears it and passes the entry once */
+class ClockEvictionPolicy : public EvictionPolicy {
+private:
+    struct Slot {
+        uint64_t key;
+        bool referenced;
+    };
+    std::vector<Slot> slots;  // key 0 : free slot
+    std::vector<uint32_t> free_slots;
+    std::unordered_map<uint64_t, uint32_t> position;
+    uint32_t hand = 0;
+
+public:
+    const char* name() const override {
+        return "CLOCK";
+    }
+    void insert(uint64_t key, uint64_t next_use) override;
+    void access(uint64_t key, uint64_t next_use) override;
+    void remove(uint64_t key) override;
+    uint64_t victim(const std::function<bool(uint64_t)>& evictable) override;
+};
+
+/* Belady (OPT) : evict the entry used the farthest in the future.
+    Future comes from an access trace recorded in a previous run of the same program (EvictionOracle) */
+class BeladyEvictionPolicy : public EvictionPolicy {
+private:
+    std::set<std::pair<uint64_t, uint64_t>> order;  // (next_use, key)
+    std::unordered_map<uint64_t, uint64_t> next_uses;
+
+public:
+    const char* name() const override {
+        return "Belady";
+    }
+    void insert(uint64_t key, uint64_t next_use) override;
+    void access(uint64_t key, uint64_t next_use) override;
+    void remove(uint64_t key) override;
+    uint64_t victim(const std::function<bool(uint64_t)>& evictable) override;
+};
+
+/* Recorded access trace for Belady.
+    A shadow gets an id when it is created (ids are given in creation order, so they are the same in every run
+    of a deterministic program even though the addresses differ). The trace is the sequence of accessed ids.
+    next_use(id) : position of the next access of id after its current one */
+class EvictionOracle {
+private:
+    std::unordered_map<uint64_t, std::vector<uint64_t>> positions;  // id -> access positions
+    std::unordered_map<uint64_t, uint32_t> cursor;                  // id -> number of accesses so far
+
+public:
+    bool load(const char* path);
+    bool empty() const {
+        return positions.empty();
+    }
+
+    /* id is accessed now, returns the position of its next access */
+    uint64_t advance(uint64_t id);
+    /* next access of id without advancing */
+    uint64_t peek(uint64_t id) const;
+};
+
+std::unique_ptr<EvictionPolicy> make_eviction_policy(const std::string& name);
+
+#endif
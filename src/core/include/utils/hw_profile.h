@@ -0,0 +1,73 @@
+#ifndef HW_PROFILE_H
+#define HW_PROFILE_H
+
+#include <stdint.h>
+#include <string>
+
+/* Hardware profile of the modeled accelerator (was FPGA_N, OCB_MB, HBM_GB globals and fixed macros)
+    Memory tiers : on-chip buffer (SRAM), HBM and host memory, each with capacity, bandwidth and latency.
+    word_bits : storage word of one coefficient on the device (36-bit moduli in 36-bit words, 64 by default),
+                the emulator keeps 64-bit words on the host, only the device sizes follow the word size.
+    compute_lanes : coefficients processed per cycle by a functional unit, op times scale with N / lanes.
+    d2d : link between two devices of the multi-device mode (utils/multi_device.h), the tiers are per device.
+    The memory tracking structure (OCB_ENTRIES_NUM, HBM_ENTRIES_NUM), the shadow pools, the task scheduler window
+    and the command trace size themselves from the current profile (hw_profile).
+    A profile is loaded from a "key = value" file (same format as the replay config, '#' comments),
+    FHE_HW_PROFILE names the file read at start. set_hardware_profile changes it between runs of one process (sweeps). */
+
+#define HW_TIER_OCB 0
+#define HW_TIER_HBM 1
+#define HW_TIER_HOST 2
+#define HW_TIER_NUM 3
+
+#define HW_PROFILE_ENV "FHE_HW_PROFILE"
+
+/* reference point of the op times of the replay config (utils/replay.h) */
+#define HW_REF_RING_DIM 65536
+#define HW_REF_COMPUTE_LANES 512
+
+struct ReplayConfig;
+
+struct HardwareProfile {
+    uint32_t ring_dim = 65536;
+    uint32_t word_bits = 64;
+    uint32_t compute_lanes = HW_REF_COMPUTE_LANES;
+
+    uint64_t tier_bytes[HW_TIER_NUM];
+    double tier_gbps[HW_TIER_NUM];       // GB/s (bytes per ns) of the link into the tier
+    double tier_latency_ns[HW_TIER_NUM];
+    double d2d_gbps;
+    double d2d_latency_ns = 0;
+
+    HardwareProfile();
+
+    /* bytes of one limb of ring_dim coefficients on the device */
+    uint64_t limb_bytes(uint32_t n) const {
+        return ((uint64_t)n * word_bits + 7) / 8;
+    }
+    uint64_t poly_bytes() const {
+        return limb_bytes(ring_dim);
+    }
+    /* number of ring_dim limbs the tier holds */
+    uint32_t entries(uint32_t tier) const {
+        return (uint32_t)(tier_bytes[tier] / poly_bytes());
+    }
+
+    /* keys : ring_dim, word_bits, compute_lanes, ocb_mb, hbm_gb, host_gb,
+        ocb_bw, hbm_bw, pcie_bw, d2d_bw (GB/s), ocb_latency, hbm_latency, pcie_latency, d2d_latency (ns) */
+    bool set(const std::string& key, double value);
+    bool load(const char* path);
+
+    /* link bandwidths, latencies, polynomial size and op times (scaled by ring_dim and compute_lanes) of the replay */
+    void apply_to(ReplayConfig& config) const;
+
+    void print() const;
+};
+
+extern HardwareProfile hw_profile;
+
+/* drains the work queue, then every later shadow, tracker capacity and trace record follows profile.
+    Shadows made before keep their buffers (old pools stay mapped until they are released) */
+void set_hardware_profile(const HardwareProfile& profile);
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef MEMORY_TRACKING_H
+#define MEMORY_TRACKING_H
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -18,6 +21,8 @@
 #include <math.h>
 #include <time.h>
 #include <mutex>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <deque>
 #include <utility>
@@ -30,17 +35,52 @@
 #include <iostream>
 #include <unordered_set>
 
+#include "utils/eviction_policy.h"
+
+#include "utils/hw_profile.h"
+
 /* This is Hardware Configuration
-    Need to enter FPGA_N, OCB_MB(on-chip buffer size), HBM_GB */
+    It comes from the runtime hardware profile (utils/hw_profile.h, hw_profile),
+    ring dimension, on-chip buffer (OCB) and HBM capacities and device word size */
 
-// #define FPGA_N 65536
-// #define OCB_MB 512 // OCB = On-Chip Buffer
-// #define HBM_GB 8
-#define POLY_SIZE (8 * FPGA_N)
+#define POLY_SIZE (hw_profile.poly_bytes())
 #define MB_TO_BYTES 1048576 // 1 MB = 1024 * 1024 Bytes
 #define GB_TO_MB 1024 // 1 GB = 1024 MB
 #define MB_TO_ENTRIES_NUM (MB_TO_BYTES / POLY_SIZE)
-#define OCB_ENTRIES_NUM (OCB_MB * MB_TO_ENTRIES_NUM)
-#define HBM_ENTRIES_NUM (HBM_GB * GB_TO_MB * MB_TO_ENTRIES_NUM)
+#define OCB_ENTRIES_NUM (hw_profile.entries(HW_TIER_OCB))
+#define HBM_ENTRIES_NUM (hw_profile.entries(HW_TIER_HBM))
 // #define ROOT_ENTRIES_NUM 1
-// #define IROOT_ENTRIES_NUM 1
\ No newline at end of file
+// #define IROOT_ENTRIES_NUM 1
+
+/* Residency state of a shadow (ShadowType::residency), shared by the operations and the memory tracking structure
+    low bits : number of users of the shadow (pinned, it must not move)
+    SHADOW_EVICTING : an eviction claimed the shadow and moves it, pin waits until it is released */
+#define SHADOW_EVICTING (1u << 31)
+
+static inline void pin_shadow(std::atomic<uint32_t>& residency){
+    uint32_t cur = residency.load(std::memory_order_relaxed);
+    while(1){
+        if(cur & SHADOW_EVICTING){
+            std::this_thread::yield();
+            cur = residency.load(std::memory_order_relaxed);
+            continue;
+        }
+        if(residency.compare_exchange_weak(cur, cur + 1, std::memory_order_acquire, std::memory_order_relaxed)) return;
+    }
+}
+
+static inline void unpin_shadow(std::atomic<uint32_t>& residency){
+    residency.fetch_sub(1, std::memory_order_release);
+}
+
+/* only a shadow nobody uses can be claimed */
+static inline bool claim_shadow(std::atomic<uint32_t>& residency){
+    uint32_t expected = 0;
+    return residency.compare_exchange_strong(expected, SHADOW_EVICTING, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+static inline void release_shadow(std::atomic<uint32_t>& residency){
+    residency.fetch_and(~SHADOW_EVICTING, std::memory_order_release);
+}
+
+#endif
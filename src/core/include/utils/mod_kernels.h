@@ -0,0 +1,57 @@
+#ifndef MOD_KERNELS_H
+#define MOD_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Modular arithmetic kernels of the offload consumer (poly-impl.h consumer)
+    Every kernel has a scalar version and SIMD versions, the best one for the CPU is chosen at runtime.
+    SIMD_LEVEL_AVX2       : mod-add / mod-sub on 4 lanes
+    SIMD_LEVEL_AVX512     : mod-add / mod-sub, scalar mod-mul and bconv multiply-accumulate on 8 lanes
+                            (64-bit products from 32-bit multiplies)
+    SIMD_LEVEL_AVX512IFMA : 52-bit multiplies for moduli below SIMD_IFMA_MAX_MODULUS
+    Scalar multiplication uses Shoup's method : w' = floor(w * 2^64 / q) once per call,
+    then x * w mod q = x * w - hi(x * w') * q, one subtraction at most.
+    Inputs are reduced (< modulus), moduli are below 2^62 (native moduli are at most 60 bits).
+    res can be the same as an operand (in-place). */
+
+#define SIMD_LEVEL_SCALAR 0
+#define SIMD_LEVEL_AVX2 1
+#define SIMD_LEVEL_AVX512 2
+#define SIMD_LEVEL_AVX512IFMA 3
+
+#define SIMD_IFMA_MAX_MODULUS (1ULL << 50)
+
+/* Barrett constant floor(2^128 / modulus) of a modulus (vector x vector mod-mul, PlainModMul)
+    computed once per modulus and kept per thread */
+struct ModConst {
+    uint64_t modulus;
+    uint64_t pq0; // low word
+    uint64_t pq1; // high word
+};
+const ModConst& mod_const(uint64_t modulus);
+
+static inline uint64_t shoup_const(uint64_t scalar, uint64_t modulus) {
+    return (uint64_t)(((unsigned __int128)scalar << 64) / modulus);
+}
+
+/* res = op1 + op2, op1 - op2 */
+void mod_add(uint64_t* res, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size);
+void mod_sub(uint64_t* res, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size);
+/* res = op1 + scalar, op1 - scalar, op1 * scalar */
+void mod_add_scalar(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size);
+void mod_sub_scalar(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size);
+void mod_mul_scalar(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size);
+
+/* One source limb of the fast base conversion (TASK_TYPE_BCONV_PIPE)
+    v = data[i] (+ diff when data[i] > halfQ, centered lift of the source modulus to nm)
+    acc[i] = acc[i] + v * scalar mod nm  (the sum is reduced by modulus, the modulus of acc) */
+void bconv_mac(uint64_t* acc, const uint64_t* data, size_t size, uint64_t halfQ, uint64_t diff, uint64_t nm,
+               uint64_t scalar, uint64_t modulus);
+
+/* detected level at the start, a lower level can be forced (comparison of the kernels) */
+int get_simd_level();
+void set_simd_level(int level);
+const char* simd_level_name(int level);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MULTI_DEVICE_H
+#define MULTI_DEVICE_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Multi-device mode : limbs of a DCRTPoly are spread over num_devices emulated accelerators.
+    A limb belongs to the device of its modulus (device_of_modulus), so the limbs of the same modulus
+    (operands of an element-wise op) are always on the same device.
+    Every device has its own working queue (device_queues), memory tracking structure (on-chip buffer and HBM)
+    and command trace stream (commandrecord.dev<d>.bin, device 0 keeps the name of set_trace_output).
+    Placement policies
+    DEVICE_PLACEMENT_LIMB  : round-robin by the position of the modulus in the chain
+    DEVICE_PLACEMENT_DIGIT : Q limbs of one key-switch digit (numPerPartQ limbs) on one device, digits round-robin,
+                             P limbs round-robin
+    Moduli are registered in chain order when the CRT tables are computed (CryptoParametersRNS::PrecomputeCRTTables),
+    a modulus not registered gets the next position when it is seen first.
+    Base conversion (ModUp, ModDown) needs every source limb on every device of the target limbs,
+    the all-gather is recorded as device-to-device transfers (TASK_TYPE_DeviceTransfer, TRACE_LINK_D2D). */
+
+#define MAX_DEVICES 8
+
+#define DEVICE_PLACEMENT_LIMB 0
+#define DEVICE_PLACEMENT_DIGIT 1
+
+/* completion token of a device queue kept by a shadow (ShadowType::pending_ticket), device in the top bits */
+#define DEVICE_TICKET_SHIFT 56
+#define DEVICE_TICKET_MASK ((1ULL << DEVICE_TICKET_SHIFT) - 1)
+
+static inline uint64_t device_ticket(uint32_t device, uint64_t ticket) {
+    return ticket ? ((uint64_t)device << DEVICE_TICKET_SHIFT) | ticket : 0;
+}
+static inline uint32_t ticket_device(uint64_t tagged) {
+    return (uint32_t)(tagged >> DEVICE_TICKET_SHIFT);
+}
+
+extern uint32_t num_devices;
+extern uint32_t device_placement;
+
+uint32_t device_of_modulus_slow(uint64_t modulus);
+static inline uint32_t device_of_modulus(uint64_t modulus) {
+    return num_devices > 1 ? device_of_modulus_slow(modulus) : 0;
+}
+
+/* chain of the crypto parameters (Q limbs, then P limbs), digit_limbs : Q limbs per key-switch digit */
+void register_device_moduli(const std::vector<uint64_t>& moduli, uint32_t sizeQ, uint32_t digit_limbs);
+
+const char* device_placement_name(uint32_t policy);
+
+/* limbs moved between the devices (counted by the consumer of the destination device) */
+void inc_d2d_transfer(uint32_t src, uint32_t dst);
+void init_device_stat();
+void print_device_stat();
+
+#endif
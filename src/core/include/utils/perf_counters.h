@@ -0,0 +1,129 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Performance counters of the emulator (was cnt_* globals of math_utils.cpp)
+    Every thread counts into its own block of 64-bit counters (no shared cache line, no lock),
+    perf_snapshot adds the blocks of all threads (blocks of exited threads are kept in a retired total).
+    perf_reset (init_stat) only moves the base line, counters are never cleared under a running thread.
+    Task time histogram : processing time of every offloaded task (consumer) per task type, log2(ns) buckets.
+    Regions : named code blocks (PerfRegion, perf_region_begin/end), counter deltas and wall time
+              are summed per region path ("EvalBootstrap/CoeffsToSlots" for nested regions).
+              Deltas are taken over the whole process, with async offload the tasks still in the queue
+              at the end of the region are counted in the next one.
+    Snapshots can be subtracted to measure any code block :
+        PerfSnapshot before = perf_snapshot();
+        ...
+        PerfSnapshot delta = perf_snapshot() - before;
+        delta[PERF_CNT_NTT] */
+
+#define PERF_CNT_COPY_FROM_SHADOW 0
+#define PERF_CNT_COPY_FROM_SHADOW_OCB_REAL 1 // ORIGIN <-- OCB
+#define PERF_CNT_COPY_FROM_SHADOW_HBM_REAL 2 // ORIGIN <-- HBM
+#define PERF_CNT_COPY_FROM_ROOT_SHADOW_HBM_REAL 3
+#define PERF_CNT_COPY_FROM_INV_ROOT_SHADOW_HBM_REAL 4
+#define PERF_CNT_COPY_TO_SHADOW 5
+#define PERF_CNT_COPY_TO_ROOT_SHADOW 6
+#define PERF_CNT_COPY_TO_SHADOW_REAL 7 // ORIGIN --> OCB
+#define PERF_CNT_COPY_TO_SHADOW_REAL_EVK 8 // ORIGIN --> OCB of evaluation key limbs
+#define PERF_CNT_COPY_FROM_OTHER_SHADOW 9
+#define PERF_CNT_COPY_FROM_OTHER_SHADOW1 10 // OCB
+#define PERF_CNT_COPY_FROM_OTHER_SHADOW2 11 // OCB <-- HBM
+#define PERF_CNT_COPY_FROM_OTHER_SHADOW3 12 // OCB --> HBM
+#define PERF_CNT_COPY_FROM_OTHER_SHADOW4 13 // HBM
+#define PERF_CNT_CREATE_SHADOW 14
+#define PERF_CNT_DISCARD_SHADOW 15
+#define PERF_CNT_CREATE_ROOT_SHADOW 16
+#define PERF_CNT_COMPUTE_IMPLEMENTED 17
+#define PERF_CNT_COMPUTE_NOT_IMPLEMENTED 18
+#define PERF_CNT_NTT 19
+#define PERF_CNT_INTT 20
+#define PERF_CNT_AUTO 21
+#define PERF_CNT_ADD 22
+#define PERF_CNT_SUB 23
+#define PERF_CNT_MULT 24
+#define PERF_CNT_BCONV_UP 25
+#define PERF_CNT_BCONV_DOWN 26
+#define PERF_CNT_PRNG 27 // evk limbs expanded from a seed on the device (no transfer)
+#define PERF_CNT_PREFETCH_POSTED 28
+#define PERF_CNT_PREFETCH_HIT 29
+#define PERF_CNT_PREFETCH_LATE 30
+#define PERF_CNT_PREFETCH_WASTED 31
+#define PERF_CNT_PREFETCH_DROPPED 32
+#define PERF_CNT_D2D_TRANSFER 33 // limbs moved between devices (multi-device mode)
+#define PERF_CNT_NUM 34
+
+#define PERF_TASK_TYPES 32 // more than TASK_TYPE_MAX (utils/custom_task.h)
+#define PERF_HIST_BUCKETS 32 // bucket b : 2^b <= ns < 2^(b+1), the last one is open
+
+struct PerfSnapshot {
+    uint64_t cnt[PERF_CNT_NUM] = {0};
+    uint64_t task_ns[PERF_TASK_TYPES] = {0};
+    uint64_t task_hist[PERF_TASK_TYPES][PERF_HIST_BUCKETS] = {{0}};
+
+    uint64_t operator[](uint32_t id) const {
+        return cnt[id];
+    }
+    uint64_t tasks(uint32_t task_type) const;
+
+    PerfSnapshot& operator+=(const PerfSnapshot& o);
+    PerfSnapshot& operator-=(const PerfSnapshot& o);
+    PerfSnapshot operator-(const PerfSnapshot& o) const {
+        PerfSnapshot r = *this;
+        r -= o;
+        return r;
+    }
+};
+
+struct PerfRegionStat {
+    std::string name; // path of the nested regions, '/' separated
+    uint64_t calls = 0;
+    double elapsed_ms = 0;
+    PerfSnapshot delta;
+};
+
+/* counting, called from producers and consumers */
+void perf_inc(uint32_t id, uint64_t n = 1);
+void perf_task_time(int task_type, uint64_t ns);
+
+PerfSnapshot perf_snapshot();
+/* base line of perf_snapshot and regions cleared (init_stat) */
+void perf_reset();
+
+const char* perf_counter_name(uint32_t id);
+/* id of a counter name (names of perf_counter_name), -1 if unknown */
+int perf_counter_id(const char* name);
+
+void perf_region_begin(const char* name);
+void perf_region_end();
+std::vector<PerfRegionStat> perf_regions();
+
+/* scoped region */
+class PerfRegion {
+public:
+    explicit PerfRegion(const char* name) {
+        perf_region_begin(name);
+    }
+    ~PerfRegion() {
+        perf_region_end();
+    }
+    PerfRegion(const PerfRegion&) = delete;
+    PerfRegion& operator=(const PerfRegion&) = delete;
+};
+
+/* counters (non-zero ones unless all), task times per type, regions */
+void perf_print_counters(std::ostream& out, const PerfSnapshot& snap, bool all = false);
+void perf_print_tasks(std::ostream& out, const PerfSnapshot& snap);
+void perf_print_regions(std::ostream& out);
+/* export of a snapshot and the regions
+    json : {"counters": {...}, "tasks": {"type<t>": {"count", "total_ns", "hist"}}, "regions": [...]}
+    csv  : section,name,key,value lines (counter / task / region) */
+bool perf_write_json(const char* path, const PerfSnapshot& snap);
+bool perf_write_csv(const char* path, const PerfSnapshot& snap);
+
+#endif
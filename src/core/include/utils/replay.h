@@ -0,0 +1,125 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "utils/multi_device.h"
+#include "utils/trace.h"
+
+/* Trace replay : timing simulator of the accelerator (C++ version of replay.py)
+    Every record of the command trace (utils/trace.h) is scheduled on its resource
+    (compute unit, PCIe, HBM, SRAM, device-to-device link) after the buffers it touches are ready.
+    With reorder, a record can be put into an idle gap left on the resource before (same as the hops of replay.py),
+    otherwise each resource runs its records in trace order.
+    Multi-device traces : every device has its own compute unit, PCIe, HBM and SRAM, the D2D link is one
+    resource shared by all devices. The streams of the devices are merged in seq order. */
+
+#define REPLAY_RES_COMPUTE 0
+#define REPLAY_RES_PCIE 1
+#define REPLAY_RES_HBM 2
+#define REPLAY_RES_SRAM 3
+#define REPLAY_RES_D2D 4 // link between the devices (multi-device traces)
+#define REPLAY_RES_NUM 5
+
+#define REPLAY_OP_MAX 9 // last TRACE_OP_*
+#define REPLAY_GAP_SCAN 64 // idle gaps tried for a record before it goes to the end
+#define REPLAY_REORDER_WINDOW (1 << 20) // records held waiting for a missing seq, then the seq is taken as lost
+
+struct ReplayConfig {
+    /* compute time of a polynomial op (ns), same default table as replay.py (cycles / 0.45GHz) */
+    double compute_ns[REPLAY_OP_MAX + 1];
+
+    /* transfer : latency + bytes / bandwidth, bandwidth in GB/s (bytes per ns)
+        defaults give the per-poly times of replay.py for 0.5MB polynomial */
+    double link_gbps[REPLAY_RES_NUM];
+    double link_latency_ns[REPLAY_RES_NUM];
+
+    double ref_poly_bytes = 524288; // polynomial size of csv traces (no size in the record)
+    bool sram_on_hbm = true;        // SRAM and HBM copies share one port (replay.py)
+    bool reorder = true;            // fill idle gaps (replay.py reordering), false : in-order per resource
+    uint32_t max_gaps = 4096;       // idle gaps kept per resource, the oldest ones are dropped
+
+    ReplayConfig();
+
+    /* "key = value" lines, '#' comments. Keys are the names in replay.py (ntt_time, pcie_time, ...)
+        and pcie_bw/hbm_bw/sram_bw/d2d_bw (GB/s), *_latency (ns), ref_poly_bytes, sram_on_hbm, reorder, max_gaps */
+    bool set(const std::string& key, double value);
+    bool load(const char* path);
+};
+
+struct ReplayResourceStat {
+    uint64_t ops = 0;
+    double busy_ns = 0;
+    double end_ns = 0;
+    double data_stall_ns = 0;     // resource idle, waiting for buffers of the next record
+    double resource_stall_ns = 0; // buffers ready, record waiting for the resource
+};
+
+struct ReplayResult {
+    uint32_t devices = 1;
+    uint64_t records = 0;
+    uint64_t compute_records = 0;
+    uint64_t data_records = 0;
+    double makespan_ns = 0;      // end of the last record
+    double critical_path_ns = 0; // longest dependency chain, with unlimited resources
+    ReplayResourceStat res[REPLAY_RES_NUM]; // sum over the devices (end : max)
+    ReplayResourceStat device_res[MAX_DEVICES][REPLAY_RES_NUM]; // D2D is counted on device 0
+};
+
+const char* replay_resource_name(uint32_t res);
+
+class TraceReplay {
+public:
+    explicit TraceReplay(const ReplayConfig& config);
+
+    void step(const TraceRecord& rec);
+
+    /* binary trace (commandrecord.bin) or commandrecord.csv, records are replayed in seq order.
+        the streams of the other devices (trace_device_path) next to a binary trace are merged with it */
+    bool replay_file(const char* path);
+
+    /* binary streams merged in seq order */
+    bool replay_streams(const std::vector<std::string>& paths);
+
+    uint32_t streams() const {
+        return num_streams;
+    }
+
+    ReplayResult result() const;
+    void print(std::ostream& out) const;
+
+private:
+    struct BufferState {
+        uint64_t addr;
+        double ready_ns;
+        double cp_ns; // ready time with unlimited resources
+    };
+
+    /* open addressing table address -> BufferState (address 0 is the empty slot) */
+    std::vector<BufferState> table;
+    uint64_t table_used = 0;
+
+    struct Resource {
+        std::map<double, double> gaps; // end -> start of an idle gap
+        double frontier = 0;           // everything after is idle
+        double min_gap = 0;            // gaps shorter than the shortest record are useless
+        ReplayResourceStat stat;
+    };
+
+    ReplayConfig config;
+    Resource resources[MAX_DEVICES][REPLAY_RES_NUM];
+    ReplayResult totals;
+    uint32_t num_streams = 0;
+
+    BufferState* find(uint64_t addr);
+    void grow();
+    double schedule(Resource& res, double ready, double duration);
+    double duration(const TraceRecord& rec, uint32_t& res) const;
+    bool replay_csv(const char* path);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SHADOW_POOL_H
+#define SHADOW_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/* Slab pool of the shadow buffers (ShadowType::m_values, m_values_hbm in lattice/hal/default/poly.h)
+    Every pool is one contiguous arena of fixed size slots (one polynomial of 64-bit words, 64-byte aligned),
+    reserved once with mmap (huge pages if possible) like the modeled device memory.
+    Slots are handed out uninitialized by index, a slot is given back when the last shadow using it is released.
+    SHADOW_POOL_OCB : on-chip copy of every tracked shadow, OCB_ENTRIES_NUM + HBM_ENTRIES_NUM slots
+                      (the emulator keeps the on-chip copy of a shadow moved to HBM, m_values is the handle of the shadow)
+    SHADOW_POOL_HBM : HBM copy of the shadows on HBM, HBM_ENTRIES_NUM slots
+    When a pool is full (or the polynomial is larger than a slot), the buffer comes from the heap. */
+
+#define SHADOW_POOL_OCB 0
+#define SHADOW_POOL_HBM 1
+#define SHADOW_POOL_NUM 2
+
+#define SHADOW_SLOT_ALIGN 64
+
+/* stable addresses of the pool slots in the command trace (utils/trace.h), pool base + slot offset */
+#define SHADOW_TRACE_OCB_BASE (1ULL << 56)
+#define SHADOW_TRACE_HBM_BASE (2ULL << 56)
+
+class ShadowPool;
+
+class ShadowBuffer {
+public:
+    uint64_t* values = nullptr;
+    size_t length    = 0;
+    ShadowPool* pool = nullptr; // nullptr : heap buffer
+    uint32_t slot    = 0;
+
+    uint64_t& operator[](size_t i) {
+        return values[i];
+    }
+    const uint64_t& operator[](size_t i) const {
+        return values[i];
+    }
+    size_t size() const {
+        return length;
+    }
+};
+
+class ShadowPool {
+private:
+    char* arena = nullptr;
+    size_t arena_bytes = 0;
+    size_t slot_bytes = 0;
+    uint32_t num_slots = 0;
+    bool huge_pages = false;
+    const char* name;
+    uint64_t trace_base;
+
+    std::unique_ptr<ShadowBuffer[]> buffers;
+    /* free slots : lock-free stack of slot indices, head = (tag << 32) | (slot + 1), 0 is empty
+        slots never used are given by bump (their pages are not touched yet) */
+    std::unique_ptr<std::atomic<uint32_t>[]> next_free;
+    std::atomic<uint64_t> free_head{0};
+    std::atomic<uint32_t> bump{0};
+
+    std::atomic<uint32_t> in_use{0};
+    std::atomic<uint32_t> peak{0};
+    std::atomic<uint64_t> heap_allocs{0};
+
+public:
+    ShadowPool(const char* name, uint64_t trace_base, uint32_t num_slots, size_t slot_bytes);
+    ~ShadowPool();
+
+    /* uninitialized slot for length words, nullptr if the pool is full or the slot is too small */
+    ShadowBuffer* acquire(size_t length);
+    void release(ShadowBuffer* buffer);
+
+    bool contains(uint64_t addr) const {
+        return addr >= (uint64_t)arena && addr < (uint64_t)arena + arena_bytes;
+    }
+    uint64_t trace_addr(uint64_t addr) const {
+        return trace_base + (addr - (uint64_t)arena);
+    }
+
+    void count_heap_alloc() {
+        heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+    void print_stat();
+};
+
+/* shadow buffer of ring dimension length from the pool (heap when the pool can not give one)
+    zero : clear the buffer (otherwise it is uninitialized) */
+std::shared_ptr<ShadowBuffer> make_shadow_buffer(int pool, size_t length, bool zero = false);
+
+/* address for the command trace, pool slots get stable addresses (SHADOW_TRACE_*_BASE + offset) */
+uint64_t shadow_trace_addr(uint64_t addr);
+
+/* hardware profile changed (set_hardware_profile) : the next shadow makes new pools of the new sizes,
+    the old pools are kept for the shadows still using them */
+void reset_shadow_pools();
+
+void print_shadow_pool_stat();
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <string>
+
+/* Command trace of the emulated hardware (compute_flag)
+    Every offloaded op and shadow transfer is recorded as a fixed size binary record
+    in a per-thread buffer. Full buffers are written by a background writer thread,
+    so recording an op costs neither a syscall nor a lock.
+    trace_to_csv (or trace2csv.py) converts the binary trace to the commandrecord.csv format for replay.py
+    Multi-device mode (utils/multi_device.h) : every device has its own stream, device 0 writes the file of
+    set_trace_output and device d the file with ".dev<d>" before the extension (commandrecord.dev1.bin).
+    seq is global over the streams, so the streams can be merged in issue order. */
+
+#define TRACE_KIND_COMPUTE 'C'
+#define TRACE_KIND_DATA 'D'
+
+/* compute ops, names are the ones in commandrecord.csv */
+#define TRACE_OP_NTT 1
+#define TRACE_OP_INTT 2
+#define TRACE_OP_AUTO 3
+#define TRACE_OP_ADD 4
+#define TRACE_OP_MULT 5
+#define TRACE_OP_SUB 6
+#define TRACE_OP_BCONVUP 7
+#define TRACE_OP_BCONVDOWN 8
+#define TRACE_OP_PRNG 9 // limb expanded from a seed on the device (seeded evaluation key)
+
+/* data transfer links */
+#define TRACE_LINK_PCIE 1
+#define TRACE_LINK_HBM 2
+#define TRACE_LINK_SRAM 3
+#define TRACE_LINK_D2D 4 // device to device (multi-device mode), recorded on the stream of the destination
+
+#define TRACE_MAGIC "FHETRACE"
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_RECORDS 8192 // records per thread buffer (512KB)
+#define TRACE_MMAP_WINDOW (64 * 1048576) // mapped output window in mmap mode
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+/* buf : shadow buffer addresses
+    compute : result, operand, operand (0 if not used)
+    data : destination, source */
+struct TraceRecord {
+    uint64_t seq; // global order of the records
+    uint64_t timestamp_ns;
+    uint64_t buf[3];
+    uint64_t modulus;
+    uint32_t bytes;
+    uint8_t kind;
+    uint8_t op;
+    uint16_t thread_id;
+    uint16_t device;
+    uint16_t reserved16;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 64, "TraceRecord must be 64 bytes");
+
+void trace_record(uint8_t kind, uint8_t op, uint64_t buf0, uint64_t buf1, uint64_t buf2, uint64_t modulus,
+                  uint32_t bytes, uint32_t device = 0);
+
+/* output file of the trace (default commandrecord.bin), call it before tracing starts.
+    the streams of the other devices are named after it (trace_device_path)
+    use_mmap : write the output through a mapped window instead of write() */
+void set_trace_output(const char* path, bool use_mmap);
+
+/* file of the stream of device : path with ".dev<device>" before the extension (path itself for device 0) */
+std::string trace_device_path(const std::string& path, uint32_t device);
+
+/* hand the buffer of the calling thread to the writer and wait until every handed buffer is written.
+    Buffers of other living threads are written when they are full or when the thread exits. */
+void trace_flush();
+
+/* flush and close the outputs, called at exit too */
+void trace_close();
+
+const char* trace_op_name(uint8_t kind, uint8_t op);
+
+/* binary trace -> commandrecord.csv lines ("C, NTT, a, b, c" / "D, PCIE, dst, src") in record order */
+bool trace_to_csv(const char* bin_path, const char* csv_path);
+
+#endif
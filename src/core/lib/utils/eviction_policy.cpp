@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include "utils/eviction_policy.h"
+
+/* FIFO */
+void FifoEvictionPolicy::insert(uint64_t key, uint64_t next_use) {
+    remove(key);
+    order.push_front(key);
+    position[key] = order.begin();
+}
+
+void FifoEvictionPolicy::remove(uint64_t key) {
+    auto it = position.find(key);
+    if (it == position.end()) return;
+    order.erase(it->second);
+    position.erase(it);
+}
+
+/* scan from the oldest entry, entries in use stay where they are */
+uint64_t FifoEvictionPolicy::victim(const std::function<bool(uint64_t)>& evictable) {
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        if (evictable(*it)) return *it;
+    }
+    return 0;
+}
+
+/* LRU */
+void LruEvictionPolicy::access(uint64_t key, uint64_t next_use) {
+    auto it = position.find(key);
+    if (it == position.end()) return;
+    order.splice(order.begin(), order, it->second);
+}
+
+/* CLOCK */
+void ClockEvictionPolicy::insert(uint64_t key, uint64_t next_use) {
+    remove(key);
+    uint32_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = Slot{key, false};
+    }
+    else {
+        slot = slots.size();
+        slots.push_back(Slot{key, false});
+    }
+    position[key] = slot;
+}
+
+void ClockEvictionPolicy::access(uint64_t key, uint64_t next_use) {
+    auto it = position.find(key);
+    if (it != position.end()) slots[it->second].referenced = true;
+}
+
+void ClockEvictionPolicy::remove(uint64_t key) {
+    auto it = position.find(key);
+    if (it == position.end()) return;
+    slots[it->second] = Slot{0, false};
+    free_slots.push_back(it->second);
+    position.erase(it);
+}
+
+/* two rounds at most : the first round clears the reference bits */
+uint64_t ClockEvictionPolicy::victim(const std::function<bool(uint64_t)>& evictable) {
+    if (slots.empty()) return 0;
+    for (size_t step = 0; step < 2 * slots.size(); step++) {
+        Slot& s = slots[hand];
+        hand    = (hand + 1) % slots.size();
+        if (s.key == 0) continue;
+        if (s.referenced) {
+            s.referenced = false;
+            continue;
+        }
+        if (evictable(s.key)) return s.key;
+    }
+    return 0;
+}
+
+/* Belady */
+void BeladyEvictionPolicy::insert(uint64_t key, uint64_t next_use) {
+    remove(key);
+    order.insert(std::make_pair(next_use, key));
+    next_uses[key] = next_use;
+}
+
+void BeladyEvictionPolicy::access(uint64_t key, uint64_t next_use) {
+    auto it = next_uses.find(key);
+    if (it == next_uses.end()) return;
+    order.erase(std::make_pair(it->second, key));
+    it->second = next_use;
+    order.insert(std::make_pair(next_use, key));
+}
+
+void BeladyEvictionPolicy::remove(uint64_t key) {
+    auto it = next_uses.find(key);
+    if (it == next_uses.end()) return;
+    order.erase(std::make_pair(it->second, key));
+    next_uses.erase(it);
+}
+
+uint64_t BeladyEvictionPolicy::victim(const std::function<bool(uint64_t)>& evictable) {
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        if (evictable(it->second)) return it->second;
+    }
+    return 0;
+}
+
+/* Oracle : the file is the sequence of accessed shadow ids (uint32_t) */
+bool EvictionOracle::load(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return false;
+
+    positions.clear();
+    cursor.clear();
+    uint32_t ids[4096];
+    uint64_t pos = 0;
+    size_t n;
+    while ((n = fread(ids, sizeof(uint32_t), 4096, fp)) > 0) {
+        for (size_t i = 0; i < n; i++)
+            positions[ids[i]].push_back(pos++);
+    }
+    fclose(fp);
+    return true;
+}
+
+uint64_t EvictionOracle::advance(uint64_t id) {
+    uint32_t& k = cursor[id];
+    k++;
+    return peek(id);
+}
+
+uint64_t EvictionOracle::peek(uint64_t id) const {
+    auto it = positions.find(id);
+    if (it == positions.end()) return EVICTION_NEVER_USED;
+    auto c     = cursor.find(id);
+    uint32_t k = (c == cursor.end()) ? 0 : c->second;
+    return k < it->second.size() ? it->second[k] : EVICTION_NEVER_USED;
+}
+
+std::unique_ptr<EvictionPolicy> make_eviction_policy(const std::string& name) {
+    if (name == "FIFO" || name == "fifo") return std::unique_ptr<EvictionPolicy>(new FifoEvictionPolicy());
+    if (name == "LRU" || name == "lru") return std::unique_ptr<EvictionPolicy>(new LruEvictionPolicy());
+    if (name == "CLOCK" || name == "clock") return std::unique_ptr<EvictionPolicy>(new ClockEvictionPolicy());
+    if (name == "Belady" || name == "belady" || name == "OPT" || name == "opt")
+        return std::unique_ptr<EvictionPolicy>(new BeladyEvictionPolicy());
+    return nullptr;
+}
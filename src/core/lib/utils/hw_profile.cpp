@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+
+#include "utils/hw_profile.h"
+#include "utils/memory_tracking.h"
+#include "utils/multi_device.h"
+#include "utils/replay.h"
+
+HardwareProfile::HardwareProfile() {
+    tier_bytes[HW_TIER_OCB]  = 8ULL * MB_TO_BYTES;
+    tier_bytes[HW_TIER_HBM]  = 8ULL * GB_TO_MB * MB_TO_BYTES;
+    tier_bytes[HW_TIER_HOST] = 64ULL * GB_TO_MB * MB_TO_BYTES;
+
+    /* same links as the replay defaults (per-poly times of replay.py for 0.5MB polynomial) */
+    tier_gbps[HW_TIER_OCB]  = 524288 / 271.22;   // 1843488 MB/s
+    tier_gbps[HW_TIER_HBM]  = 524288 / 1086.95;  // 460000 MB/s
+    tier_gbps[HW_TIER_HOST] = 524288 / 7934.49;  // pcie 5.0 x16
+    d2d_gbps                = 524288 / 7934.49;  // peer-to-peer over pcie
+    for (uint32_t i = 0; i < HW_TIER_NUM; i++)
+        tier_latency_ns[i] = 0;
+}
+
+bool HardwareProfile::set(const std::string& key, double value) {
+    static const std::pair<const char*, uint32_t> tier_keys[] = {
+        {"ocb", HW_TIER_OCB}, {"hbm", HW_TIER_HBM}, {"pcie", HW_TIER_HOST}};
+
+    if (key == "ring_dim") {
+        uint32_t n = (uint32_t)value;
+        if (n == 0 || (n & (n - 1))) return false;
+        ring_dim = n;
+        return true;
+    }
+    if (key == "word_bits") {
+        if (value < 1 || value > 64) return false;
+        word_bits = (uint32_t)value;
+        return true;
+    }
+    if (key == "compute_lanes") {
+        if (value < 1) return false;
+        compute_lanes = (uint32_t)value;
+        return true;
+    }
+    if (key == "ocb_mb") {
+        if (value < 0) return false;
+        tier_bytes[HW_TIER_OCB] = (uint64_t)(value * MB_TO_BYTES);
+        return true;
+    }
+    if (key == "hbm_gb" || key == "host_gb") {
+        if (value < 0) return false;
+        tier_bytes[key == "hbm_gb" ? HW_TIER_HBM : HW_TIER_HOST] = (uint64_t)(value * GB_TO_MB * MB_TO_BYTES);
+        return true;
+    }
+    if (key == "d2d_bw") {
+        if (value <= 0) return false;
+        d2d_gbps = value;
+        return true;
+    }
+    if (key == "d2d_latency") {
+        if (value < 0) return false;
+        d2d_latency_ns = value;
+        return true;
+    }
+    for (auto& k : tier_keys) {
+        std::string name(k.first);
+        if (key == name + "_bw") {
+            if (value <= 0) return false;
+            tier_gbps[k.second] = value;
+            return true;
+        }
+        if (key == name + "_latency") {
+            if (value < 0) return false;
+            tier_latency_ns[k.second] = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HardwareProfile::load(const char* path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    std::string line;
+    uint32_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                std::cerr << path << ":" << line_no << ": expected key = value" << std::endl;
+            continue;
+        }
+        std::string key = line.substr(0, eq);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t\r") + 1);
+        if (!set(key, atof(line.c_str() + eq + 1))) {
+            std::cerr << path << ":" << line_no << ": unknown or invalid key " << key << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void HardwareProfile::apply_to(ReplayConfig& config) const {
+    config.link_gbps[REPLAY_RES_SRAM]       = tier_gbps[HW_TIER_OCB];
+    config.link_gbps[REPLAY_RES_HBM]        = tier_gbps[HW_TIER_HBM];
+    config.link_gbps[REPLAY_RES_PCIE]       = tier_gbps[HW_TIER_HOST];
+    config.link_latency_ns[REPLAY_RES_SRAM] = tier_latency_ns[HW_TIER_OCB];
+    config.link_latency_ns[REPLAY_RES_HBM]  = tier_latency_ns[HW_TIER_HBM];
+    config.link_latency_ns[REPLAY_RES_PCIE] = tier_latency_ns[HW_TIER_HOST];
+    config.link_gbps[REPLAY_RES_D2D]        = d2d_gbps;
+    config.link_latency_ns[REPLAY_RES_D2D]  = d2d_latency_ns;
+    config.ref_poly_bytes                   = (double)poly_bytes();
+
+    /* op times of the config are for HW_REF_RING_DIM coefficients on HW_REF_COMPUTE_LANES lanes */
+    double scale = ((double)ring_dim / HW_REF_RING_DIM) * ((double)HW_REF_COMPUTE_LANES / compute_lanes);
+    for (uint32_t i = 0; i <= REPLAY_OP_MAX; i++)
+        config.compute_ns[i] *= scale;
+}
+
+void HardwareProfile::print() const {
+    static const char* tier_names[HW_TIER_NUM] = {"OCB", "HBM", "host"};
+    std::cout << "hardware profile: N " << ring_dim << ", word " << word_bits << " bits, " << compute_lanes
+              << " lanes, poly " << poly_bytes() << " bytes" << std::endl;
+    for (uint32_t i = 0; i < HW_TIER_NUM; i++) {
+        std::cout << "  " << tier_names[i] << ": " << tier_bytes[i] / MB_TO_BYTES << " MB (" << entries(i)
+                  << " entries), " << tier_gbps[i] << " GB/s, " << tier_latency_ns[i] << " ns" << std::endl;
+    }
+    if (num_devices > 1)
+        std::cout << "  D2D: " << d2d_gbps << " GB/s, " << d2d_latency_ns << " ns" << std::endl;
+}
+
+/* profile of the start, FHE_HW_PROFILE file over the defaults */
+static HardwareProfile initial_hardware_profile() {
+    HardwareProfile profile;
+    const char* path = getenv(HW_PROFILE_ENV);
+    if (path && *path && !profile.load(path)) {
+        std::cerr << "cannot load hardware profile " << path << ", defaults are used" << std::endl;
+        profile = HardwareProfile();
+    }
+    return profile;
+}
+
+HardwareProfile hw_profile = initial_hardware_profile();
@@ -27,124 +27,94 @@
 
 #include "utils/custom_task.h"
 #include "utils/memory_tracking.h"
+#include "utils/shadow_pool.h"
+#include "utils/trace.h"
+#include "utils/mod_kernels.h"
+#include "utils/multi_device.h"
+#include "utils/perf_counters.h"
 
-uint32_t cnt_copy_from_shadow;
-uint32_t cnt_copy_from_shadow_ocb_real;
-uint32_t cnt_copy_from_shadow_hbm_real;
-uint32_t cnt_copy_from_root_shadow_hbm_real;
-uint32_t cnt_copy_from_inv_root_shadow_hbm_real;
-uint32_t cnt_copy_to_shadow;
-uint32_t cnt_copy_to_root_shadow;
-uint32_t cnt_copy_to_shadow_real;
-uint32_t cnt_copy_from_other_shadow;
-uint32_t cnt_copy_from_other_shadow1;
-uint32_t cnt_copy_from_other_shadow2;
-uint32_t cnt_copy_from_other_shadow3;
-uint32_t cnt_copy_from_other_shadow4;
-uint32_t cnt_create_shadow;
-uint32_t cnt_discard_shadow;
-uint32_t cnt_create_root_shadow;
-uint32_t cnt_compute_implemented;
-uint32_t cnt_compute_not_implemented;
-
-uint32_t cnt_copy_to_shadow_real_evk;
-
-uint32_t cnt_ntt;
-uint32_t cnt_intt;
-uint32_t cnt_auto;
-uint32_t cnt_add;
-uint32_t cnt_sub;
-uint32_t cnt_mult;
-uint32_t cnt_bconv_up;
-uint32_t cnt_bconv_down;
+/* counters of the operations and transfers : utils/perf_counters.h (perf_snapshot) */
 
 bool compute_flag = false;
+/* Asynchronous offload: unit operations only post tasks to work_queue,
+    host waits only when it really touches the polynomial (copy_from_shadow etc.) */
+bool async_offload = false;
 
 WorkQueue work_queue;
-std::thread consumerThread;
+/* multi-device mode (set_device_placement) : one queue per device, device 0 is work_queue */
+static WorkQueue extra_device_queues[MAX_DEVICES - 1];
+WorkQueue* device_queues[MAX_DEVICES];
+static bool device_queues_set = [] {
+    device_queues[0] = &work_queue;
+    for(uint32_t d = 1; d < MAX_DEVICES; d++) device_queues[d] = &extra_device_queues[d - 1];
+    return true;
+}();
+/* consumer worker pool (set_num_consumer_workers before init_stat), num_consumer_workers per device */
+uint32_t num_consumer_workers = 1;
+std::vector<std::thread> consumerThreads;
+/* source limbs per base conversion task (DCRTPolyImpl::ApproxSwitchCRTBasis), 0 : all source limbs */
+uint32_t bconv_batch_width = 5;
+/* DCRTPoly limbs posted from OpenMP threads (lattice/hal/default/dcrtpoly.h) */
+bool limb_parallel = false;
+/* prefetch hints of the key switching and linear transforms are posted (set_prefetch) */
+bool prefetch_enabled = false;
+/* double-hoisted giant steps of the bootstrapping linear transforms (set_double_hoisting) */
+bool double_hoisting_enabled = false;
 
 extern std::unordered_set<uint64_t> evk_set;
 extern std::unordered_map<uint64_t,uint64_t> evk_map;
-extern std::chrono::duration<double, std::milli> elapsed_overhead;
+double tracking_overhead_ms();
 
 std::chrono::duration<double, std::milli> elapsed_getwork(0.0);
 std::chrono::duration<double, std::milli> elapsed_work(0.0);
 
 bool check_evk_set(uint64_t evk_addr);
+void init_eviction_stat();
+void wait_offload_all();
 
 uint64_t total_sizeQlP = 0;
 
 namespace lbcrypto{
-extern  void consumer(WorkQueue& queue);
+extern  void consumer(WorkQueue& queue, uint32_t worker_id);
+}
+
+/* task descriptor pool (CustomTaskItem), only async offload allocates descriptors */
+void print_task_pool_stat() {
+    uint64_t pools, allocations, deallocations, heap_blocks, remote;
+    TaskItemPool::get_stats(pools, allocations, deallocations, heap_blocks, remote);
+    std::cout << "task_pool: pools " << pools << ", alloc " << allocations << ", free " << deallocations
+              << " (remote " << remote << "), heap blocks " << heap_blocks << std::endl;
 }
 
 void init_stat() {
     std::cout << "init_stat" << std::endl;
-    cnt_copy_from_shadow = 0;
-    cnt_copy_from_shadow_ocb_real = 0;
-    cnt_copy_from_shadow_hbm_real = 0;
-    cnt_copy_from_root_shadow_hbm_real = 0;
-    cnt_copy_to_shadow = 0;
-    cnt_copy_to_root_shadow = 0;
-    cnt_copy_to_shadow_real = 0;
-    cnt_copy_from_other_shadow = 0;
-    cnt_copy_from_other_shadow1 = 0;
-    cnt_copy_from_other_shadow2 = 0;
-    cnt_copy_from_other_shadow3 = 0;
-    cnt_copy_from_other_shadow4 = 0;
-    cnt_create_shadow = 0;
-    cnt_discard_shadow = 0;
-    cnt_create_root_shadow = 0;
-    cnt_compute_implemented = 0;
-    cnt_compute_not_implemented = 0;
-    cnt_ntt = 0;
-    cnt_intt = 0;
-    cnt_auto = 0;
-    cnt_add = 0;
-    cnt_sub = 0;
-    cnt_mult = 0;
-    cnt_bconv_up = 0;
-    cnt_bconv_down = 0;
-
-    cnt_copy_to_shadow_real_evk = 0;
-    elapsed_overhead = std::chrono::duration<double, std::milli>(0.0);
+    perf_reset();
+
+    init_eviction_stat();
     elapsed_getwork = std::chrono::duration<double, std::milli>(0.0);
     elapsed_work = std::chrono::duration<double, std::milli>(0.0);
 
-    consumerThread = std::thread(lbcrypto::consumer, std::ref(work_queue));
+    init_device_stat();
+
+    // workers stopped before (stop_consumer_workers) : the queues take work again
+    bool restart = consumerThreads.empty();
+    for(uint32_t d = 0; d < num_devices; d++) {
+        if(restart) device_queues[d]->restart();
+        device_queues[d]->setNumWorkers(num_consumer_workers);
+        device_queues[d]->setSchedulerResidentPolys(OCB_ENTRIES_NUM);
+        for(uint32_t w = 0; w < num_consumer_workers; w++) {
+            consumerThreads.emplace_back(lbcrypto::consumer, std::ref(*device_queues[d]), w);
+        }
+    }
 }
 void init_stat_no_workqueue() {
     std::cout << "init_stat" << std::endl;
-    cnt_copy_from_shadow = 0;
-    cnt_copy_from_shadow_ocb_real = 0;
-    cnt_copy_from_shadow_hbm_real = 0;
-    cnt_copy_from_root_shadow_hbm_real = 0;
-    cnt_copy_to_shadow = 0;
-    cnt_copy_to_root_shadow = 0;
-    cnt_copy_to_shadow_real = 0;
-    cnt_copy_from_other_shadow = 0;
-    cnt_copy_from_other_shadow1 = 0;
-    cnt_copy_from_other_shadow2 = 0;
-    cnt_copy_from_other_shadow3 = 0;
-    cnt_copy_from_other_shadow4 = 0;
-    cnt_create_shadow = 0;
-    cnt_discard_shadow = 0;
-    cnt_create_root_shadow = 0;
-    cnt_compute_implemented = 0;
-    cnt_compute_not_implemented = 0;
-    cnt_ntt = 0;
-    cnt_intt = 0;
-    cnt_auto = 0;
-    cnt_add = 0;
-    cnt_sub = 0;
-    cnt_mult = 0;
-    cnt_bconv_up = 0;
-    cnt_bconv_down = 0;
+    perf_reset();
 
     total_sizeQlP = 0;
 
-    cnt_copy_to_shadow_real_evk = 0;
-    elapsed_overhead = std::chrono::duration<double, std::milli>(0.0);
+    init_eviction_stat();
+    init_device_stat();
     elapsed_getwork = std::chrono::duration<double, std::milli>(0.0);
     elapsed_work = std::chrono::duration<double, std::milli>(0.0);
 
@@ -153,34 +123,58 @@ void init_stat_no_workqueue() {
     //     pair.second = 0;
     // }
 }
+/* finish the device queues and join the consumer workers, the tasks posted before are processed */
+void stop_consumer_workers() {
+    for(uint32_t d = 0; d < num_devices; d++) device_queues[d]->finish();
+
+    for(auto& consumerThread : consumerThreads) {
+        if (consumerThread.joinable()) {
+            consumerThread.join();
+        }
+    }
+    consumerThreads.clear();
+}
+
 void print_stat() {
+    wait_offload_all();
+    PerfSnapshot stat = perf_snapshot();
     std::cout << "print_stat" << std::endl;
-    std::cout << "cnt_copy_from_shadow: " << cnt_copy_from_shadow<< std::endl;
-    std::cout << "ORIGIN <-- OCB          : " << cnt_copy_from_shadow_ocb_real<< std::endl;
-    std::cout << "ORIGIN     <--     HBM  : " << cnt_copy_from_shadow_hbm_real<< std::endl;
-    std::cout << "cnt_copy_to_shadow: " << cnt_copy_to_shadow<< std::endl;
-    std::cout << "ORIGIN --> OCB          : " << cnt_copy_to_shadow_real<<" (evk: " << cnt_copy_to_shadow_real_evk << ")" << std::endl;
-    std::cout << "cnt_copy_from_other_shadow: " << cnt_copy_from_other_shadow<< std::endl;
-    std::cout << "           OCB          : " << cnt_copy_from_other_shadow1<< std::endl;
-    std::cout << "           OCB <-- HBM  : " << cnt_copy_from_other_shadow2<< std::endl;
-    std::cout << "           OCB --> HBM  : " << cnt_copy_from_other_shadow3<< std::endl;
-    std::cout << "  total    OCB --- HBM  : " << cnt_copy_from_other_shadow2+cnt_copy_from_other_shadow3<< std::endl;
-    std::cout << "                   HBM  : " << cnt_copy_from_other_shadow4<< std::endl;
-    std::cout << "cnt_create_shadow: " << cnt_create_shadow<< std::endl;
-    std::cout << "root copy: " << cnt_copy_from_root_shadow_hbm_real << std::endl;
-    std::cout << "inv root copy: " << cnt_copy_from_inv_root_shadow_hbm_real << std::endl;
-    std::cout << "cnt_compute_implemented: " << cnt_compute_implemented<< std::endl;
+    std::cout << "cnt_copy_from_shadow: " << stat[PERF_CNT_COPY_FROM_SHADOW]<< std::endl;
+    std::cout << "ORIGIN <-- OCB          : " << stat[PERF_CNT_COPY_FROM_SHADOW_OCB_REAL]<< std::endl;
+    std::cout << "ORIGIN     <--     HBM  : " << stat[PERF_CNT_COPY_FROM_SHADOW_HBM_REAL]<< std::endl;
+    std::cout << "cnt_copy_to_shadow: " << stat[PERF_CNT_COPY_TO_SHADOW]<< std::endl;
+    std::cout << "ORIGIN --> OCB          : " << stat[PERF_CNT_COPY_TO_SHADOW_REAL]<<" (evk: " << stat[PERF_CNT_COPY_TO_SHADOW_REAL_EVK] << ")" << std::endl;
+    std::cout << "cnt_copy_from_other_shadow: " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW]<< std::endl;
+    std::cout << "           OCB          : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW1]<< std::endl;
+    std::cout << "           OCB <-- HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW2]<< std::endl;
+    std::cout << "           OCB --> HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW3]<< std::endl;
+    std::cout << "  total    OCB --- HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW2]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW3]<< std::endl;
+    std::cout << "                   HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW4]<< std::endl;
+    std::cout << "cnt_create_shadow: " << stat[PERF_CNT_CREATE_SHADOW]<< std::endl;
+    std::cout << "root copy: " << stat[PERF_CNT_COPY_FROM_ROOT_SHADOW_HBM_REAL] << std::endl;
+    std::cout << "inv root copy: " << stat[PERF_CNT_COPY_FROM_INV_ROOT_SHADOW_HBM_REAL] << std::endl;
+    std::cout << "cnt_compute_implemented: " << stat[PERF_CNT_COMPUTE_IMPLEMENTED]<< std::endl;
     std::cout << std::endl;
-    std::cout << "cnt_ntt: " << cnt_ntt << std::endl;
-    std::cout << "cnt_intt: " << cnt_intt << std::endl;
-    std::cout << "cnt_auto: " << cnt_auto << std::endl;
-    std::cout << "cnt_add: " << cnt_add << std::endl;
-    std::cout << "cnt_sub: " << cnt_sub << std::endl;
-    std::cout << "cnt_mult: " << cnt_mult << std::endl;
-    std::cout << "cnt_bconv_up: " << cnt_bconv_up << std::endl;
-    std::cout << "cnt_bconv_down: " << cnt_bconv_down << std::endl;
+    std::cout << "cnt_ntt: " << stat[PERF_CNT_NTT] << std::endl;
+    std::cout << "cnt_intt: " << stat[PERF_CNT_INTT] << std::endl;
+    std::cout << "cnt_auto: " << stat[PERF_CNT_AUTO] << std::endl;
+    std::cout << "cnt_add: " << stat[PERF_CNT_ADD] << std::endl;
+    std::cout << "cnt_sub: " << stat[PERF_CNT_SUB] << std::endl;
+    std::cout << "cnt_mult: " << stat[PERF_CNT_MULT] << std::endl;
+    std::cout << "cnt_bconv_up: " << stat[PERF_CNT_BCONV_UP] << std::endl;
+    std::cout << "cnt_bconv_down: " << stat[PERF_CNT_BCONV_DOWN] << std::endl;
+    std::cout << "cnt_prng: " << stat[PERF_CNT_PRNG] << std::endl;
     std::cout << std::endl;
-    std::cout << "elapsed_overhead: " << elapsed_overhead.count() << "ms" << std::endl;
+    std::cout << "elapsed_overhead: " << tracking_overhead_ms() << "ms" << std::endl;
+    std::cout << "consumer kernels: " << simd_level_name(get_simd_level()) << std::endl;
+    std::cout << "bconv batch width: " << bconv_batch_width << std::endl;
+    std::cout << "limb parallel: " << (limb_parallel ? "on" : "off") << std::endl;
+    std::cout << "prefetch: " << (prefetch_enabled ? "on" : "off") << ", posted " << stat[PERF_CNT_PREFETCH_POSTED]
+              << ", hit " << stat[PERF_CNT_PREFETCH_HIT] << ", late " << stat[PERF_CNT_PREFETCH_LATE] << ", wasted " << stat[PERF_CNT_PREFETCH_WASTED]
+              << ", dropped " << stat[PERF_CNT_PREFETCH_DROPPED] << std::endl;
+    std::cout << "double hoisting: " << (double_hoisting_enabled ? "on" : "off") << std::endl;
+    print_device_stat();
+    perf_print_regions(std::cout);
 
     // // double total_time = 0;
     // // double ntt_cycle = 3454; // e=512
@@ -255,31 +249,39 @@ void print_stat() {
     //     }     
     // }        
 
-    work_queue.finish();
-
-    if (consumerThread.joinable()) {
-        consumerThread.join();
+    stop_consumer_workers();
+    // trace buffers of the workers are handed over at join
+    trace_flush();
+    for(uint32_t d = 0; d < num_devices; d++) {
+        if(num_devices > 1) std::cout << "device " << d << std::endl;
+        device_queues[d]->print_worker_stats();
+        device_queues[d]->print_scheduler_stats();
     }
+    std::cout << "task times:" << std::endl;
+    perf_print_tasks(std::cout, stat);
+    print_task_pool_stat();
 
 }
 
 void print_stat_no_workqueue() {
+    wait_offload_all();
+    PerfSnapshot stat = perf_snapshot();
     // std::cout << "print_stat" << std::endl;
-    std::cout << "Total: " << cnt_copy_from_shadow_ocb_real+cnt_copy_from_shadow_hbm_real+cnt_copy_to_shadow_real+cnt_copy_from_other_shadow1+cnt_copy_from_other_shadow2+cnt_copy_from_other_shadow3+cnt_copy_from_other_shadow4 << std::endl;
-    std::cout << "PCIe : " << cnt_copy_from_shadow_ocb_real+cnt_copy_from_shadow_hbm_real+cnt_copy_to_shadow_real << std::endl;
-    std::cout << "SRAM : " << cnt_copy_from_other_shadow1 << std::endl;
-    std::cout << "HBM  : " << cnt_copy_from_other_shadow2+cnt_copy_from_other_shadow3+cnt_copy_from_other_shadow4 << std::endl;
-    std::cout << "cnt_copy_from_shadow: " << cnt_copy_from_shadow<< std::endl;
-    std::cout << "ORIGIN <-- OCB          : " << cnt_copy_from_shadow_ocb_real<< std::endl;
-    std::cout << "ORIGIN     <--     HBM  : " << cnt_copy_from_shadow_hbm_real<< std::endl;
-    std::cout << "cnt_copy_to_shadow: " << cnt_copy_to_shadow<< std::endl;
-    std::cout << "ORIGIN --> OCB          : " << cnt_copy_to_shadow_real<< std::endl;
-    std::cout << "cnt_copy_from_other_shadow: " << cnt_copy_from_other_shadow<< std::endl;
-    std::cout << "           OCB          : " << cnt_copy_from_other_shadow1<< std::endl;
+    std::cout << "Total: " << stat[PERF_CNT_COPY_FROM_SHADOW_OCB_REAL]+stat[PERF_CNT_COPY_FROM_SHADOW_HBM_REAL]+stat[PERF_CNT_COPY_TO_SHADOW_REAL]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW1]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW2]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW3]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW4] << std::endl;
+    std::cout << "PCIe : " << stat[PERF_CNT_COPY_FROM_SHADOW_OCB_REAL]+stat[PERF_CNT_COPY_FROM_SHADOW_HBM_REAL]+stat[PERF_CNT_COPY_TO_SHADOW_REAL] << std::endl;
+    std::cout << "SRAM : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW1] << std::endl;
+    std::cout << "HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW2]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW3]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW4] << std::endl;
+    std::cout << "cnt_copy_from_shadow: " << stat[PERF_CNT_COPY_FROM_SHADOW]<< std::endl;
+    std::cout << "ORIGIN <-- OCB          : " << stat[PERF_CNT_COPY_FROM_SHADOW_OCB_REAL]<< std::endl;
+    std::cout << "ORIGIN     <--     HBM  : " << stat[PERF_CNT_COPY_FROM_SHADOW_HBM_REAL]<< std::endl;
+    std::cout << "cnt_copy_to_shadow: " << stat[PERF_CNT_COPY_TO_SHADOW]<< std::endl;
+    std::cout << "ORIGIN --> OCB          : " << stat[PERF_CNT_COPY_TO_SHADOW_REAL]<< std::endl;
+    std::cout << "cnt_copy_from_other_shadow: " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW]<< std::endl;
+    std::cout << "           OCB          : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW1]<< std::endl;
     // std::cout << "           OCB <-- HBM  : " << cnt_copy_from_other_shadow2<< std::endl;
     // std::cout << "           OCB --> HBM  : " << cnt_copy_from_other_shadow3<< std::endl;
-    std::cout << "  total    OCB --- HBM  : " << cnt_copy_from_other_shadow2+cnt_copy_from_other_shadow3<< std::endl;
-    std::cout << "                   HBM  : " << cnt_copy_from_other_shadow4<< std::endl;
+    std::cout << "  total    OCB --- HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW2]+stat[PERF_CNT_COPY_FROM_OTHER_SHADOW3]<< std::endl;
+    std::cout << "                   HBM  : " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW4]<< std::endl;
     std::cout << std::endl;
     // std::cout << "cnt_create_shadow: " << cnt_create_shadow<< std::endl;
     // std::cout << "root copy: " << cnt_copy_from_root_shadow_hbm_real << std::endl;
@@ -296,18 +298,99 @@ void print_stat_no_workqueue() {
     // std::cout << "cnt_bconv_down: " << cnt_bconv_down << std::endl;
     // std::cout << std::endl;
 
-    // std::cout << "elapsed_overhead: " << elapsed_overhead.count() << "ms" << std::endl;
+    // std::cout << "elapsed_overhead: " << tracking_overhead_ms() << "ms" << std::endl;
     // std::cout << "elapsed_getwork: " << elapsed_getwork.count() << "ms" << std::endl;
     // std::cout << "elapsed_work: " << elapsed_work.count() << "ms" << std::endl;
     // std::cout << std::endl;
 
-    // elapsed_overhead = std::chrono::duration<double, std::milli>(0.0);
     // elapsed_getwork = std::chrono::duration<double, std::milli>(0.0);
     // elapsed_work = std::chrono::duration<double, std::milli>(0.0);
 }
 
+void set_num_consumer_workers(uint32_t num_workers) {
+    num_consumer_workers = num_workers ? num_workers : 1;
+}
+
+/* reorder window of the task scheduler, 0 : tasks run in posted order (WorkQueue::scheduleReadyWork) */
+void set_task_scheduler(uint32_t window) {
+    for(uint32_t d = 0; d < MAX_DEVICES; d++) device_queues[d]->setScheduler(window);
+}
+
+/* bconv lanes : source limbs accumulated by one base conversion task (TASK_TYPE_BCONV_BATCH)
+    wider batch : less tasks and accumulator traffic, more source limbs kept on the shadow at once */
+void set_bconv_batch_width(uint32_t width) {
+    bconv_batch_width = width;
+}
+
+/* limb-parallel DCRTPoly operations, useful with several consumer workers (set_num_consumer_workers)
+    the thread limit is OpenFHEParallelControls (OMP_NUM_THREADS) */
+void set_limb_parallel(bool enable) {
+    wait_offload_all();
+    limb_parallel = enable;
+}
+
+/* prefetch hints : key limbs of the next digit (EvalFastKeySwitchCoreExt) and the key of the next
+    hoisted rotation (EvalLinearTransform, EvalCoeffsToSlots) are staged while the current one computes */
+void set_prefetch(bool enable) {
+    wait_offload_all();
+    prefetch_enabled = enable;
+}
+
+/* double hoisting : c0 of a giant step stays in the extended basis (QP) and is summed there,
+    only c1 is moved down to Q for the rotation, the level ends with one KeySwitchDown
+    (FHECKKSRNS::EvalBSGSLevel, EvalLinearTransform) */
+void set_double_hoisting(bool enable) {
+    double_hoisting_enabled = enable;
+}
+
+/* hardware profile for the next run (utils/hw_profile.h), several profiles can run in one process (sweeps)
+    posted tasks finish on the old one, then shadow pools and the scheduler window are sized from the new one.
+    Entries beyond a smaller tier are evicted as new shadows come in */
+void set_hardware_profile(const HardwareProfile& profile) {
+    wait_offload_all();
+    bool resized = profile.ring_dim != hw_profile.ring_dim || profile.word_bits != hw_profile.word_bits ||
+                   profile.tier_bytes[HW_TIER_OCB] != hw_profile.tier_bytes[HW_TIER_OCB] ||
+                   profile.tier_bytes[HW_TIER_HBM] != hw_profile.tier_bytes[HW_TIER_HBM];
+    hw_profile = profile;
+    if(resized) reset_shadow_pools();
+    for(uint32_t d = 0; d < MAX_DEVICES; d++) device_queues[d]->setSchedulerResidentPolys(OCB_ENTRIES_NUM);
+}
+
+/* multi-device mode (utils/multi_device.h) : limbs are spread over devices emulated accelerators by policy
+    ("limb" : round-robin by limb, "digit" : key-switch digit per device), call before init_stat and before
+    the crypto context is made (moduli are placed when the CRT tables are computed).
+    Every device has its own queue (num_consumer_workers each), tracking structure of the hardware profile
+    sizes and trace stream */
+bool set_device_placement(uint32_t devices, const char* policy) {
+    if(devices == 0 || devices > MAX_DEVICES) {
+        std::cerr << "set_device_placement: devices must be 1 .. " << MAX_DEVICES << std::endl;
+        return false;
+    }
+    uint32_t placement;
+    if(strcmp(policy, "limb") == 0) placement = DEVICE_PLACEMENT_LIMB;
+    else if(strcmp(policy, "digit") == 0) placement = DEVICE_PLACEMENT_DIGIT;
+    else {
+        std::cerr << "set_device_placement: unknown policy " << policy << std::endl;
+        return false;
+    }
+    wait_offload_all();
+    num_devices = devices;
+    device_placement = placement;
+    return true;
+}
+
+void set_async_offload(bool enable) {
+    // drain tasks posted in the previous mode
+    wait_offload_all();
+    async_offload = enable;
+}
+
+void wait_offload_all() {
+    for(uint32_t d = 0; d < num_devices; d++) device_queues[d]->waitAll();
+}
+
 void set_num_prallel_jobs(uint32_t num_parallel) {
-    work_queue.setNumParallelJobs(num_parallel);
+    for(uint32_t d = 0; d < MAX_DEVICES; d++) device_queues[d]->setNumParallelJobs(num_parallel);
 }
 
 void print_elapsed_busywating_(){
@@ -318,94 +401,115 @@ void init_elapsed_busywaiting_(){
     work_queue.init_elapsed_busywaiting();
 }
 
+/* counters are increased by several consumer workers at the same time */
 void inc_copy_from_shadow() {
-    cnt_copy_from_shadow++;
+    perf_inc(PERF_CNT_COPY_FROM_SHADOW);
 }
 void inc_copy_from_shadow_ocb_real()    {
-    cnt_copy_from_shadow_ocb_real++;
+    perf_inc(PERF_CNT_COPY_FROM_SHADOW_OCB_REAL);
 }
 void inc_copy_from_shadow_hbm_real()    {
-    cnt_copy_from_shadow_hbm_real++;
+    perf_inc(PERF_CNT_COPY_FROM_SHADOW_HBM_REAL);
 }
 void inc_copy_from_root_shadow_hbm_real()    {
-    cnt_copy_from_root_shadow_hbm_real++;
+    perf_inc(PERF_CNT_COPY_FROM_ROOT_SHADOW_HBM_REAL);
 }
 void inc_copy_from_inv_root_shadow_hbm_real()    {
-    cnt_copy_from_inv_root_shadow_hbm_real++;
+    perf_inc(PERF_CNT_COPY_FROM_INV_ROOT_SHADOW_HBM_REAL);
 }
 void inc_copy_to_shadow()   {
-    cnt_copy_to_shadow++;
+    perf_inc(PERF_CNT_COPY_TO_SHADOW);
 }
 void inc_copy_to_root_shadow()  {
-    cnt_copy_to_root_shadow++;
+    perf_inc(PERF_CNT_COPY_TO_ROOT_SHADOW);
 }
 void inc_copy_to_shadow_real(uint64_t addr)  {
-    cnt_copy_to_shadow_real++;
+    perf_inc(PERF_CNT_COPY_TO_SHADOW_REAL);
     if(check_evk_set(addr)){
-        cnt_copy_to_shadow_real_evk++;
+        perf_inc(PERF_CNT_COPY_TO_SHADOW_REAL_EVK);
     }
 }
 void inc_copy_from_other_shadow1()   {
-    cnt_copy_from_other_shadow1++;
+    perf_inc(PERF_CNT_COPY_FROM_OTHER_SHADOW1);
 }
 void inc_copy_from_other_shadow2()   {
-    cnt_copy_from_other_shadow2++;
+    perf_inc(PERF_CNT_COPY_FROM_OTHER_SHADOW2);
 }
 void inc_copy_from_other_shadow3()   {
-    cnt_copy_from_other_shadow3++;
+    perf_inc(PERF_CNT_COPY_FROM_OTHER_SHADOW3);
 }
 void inc_copy_from_other_shadow4()   {
-    cnt_copy_from_other_shadow4++;
+    perf_inc(PERF_CNT_COPY_FROM_OTHER_SHADOW4);
 }
 void inc_copy_from_other_shadow()   {
-    cnt_copy_from_other_shadow++;
+    perf_inc(PERF_CNT_COPY_FROM_OTHER_SHADOW);
 }
 void inc_create_shadow()    {
-    cnt_create_shadow++;
+    perf_inc(PERF_CNT_CREATE_SHADOW);
 }
 void inc_discard_shadow()    {
-    cnt_discard_shadow++;
+    perf_inc(PERF_CNT_DISCARD_SHADOW);
 }
 void inc_create_root_shadow()    {
-    cnt_create_root_shadow++;
+    perf_inc(PERF_CNT_CREATE_ROOT_SHADOW);
 }
 void inc_compute_not_implemented()    {
-    cnt_compute_not_implemented++;
+    perf_inc(PERF_CNT_COMPUTE_NOT_IMPLEMENTED);
 }
 void inc_compute_implemented()    {
-    cnt_compute_implemented++;
+    perf_inc(PERF_CNT_COMPUTE_IMPLEMENTED);
 }
 
 void inc_ntt(){
-    cnt_ntt++;
+    perf_inc(PERF_CNT_NTT);
 }
 
 void inc_intt(){
-    cnt_intt++;
+    perf_inc(PERF_CNT_INTT);
 }
 
 void inc_auto(){
-    cnt_auto++;
+    perf_inc(PERF_CNT_AUTO);
 }
 
 void inc_add(){
-    cnt_add++;
+    perf_inc(PERF_CNT_ADD);
 }
 
 void inc_sub(){
-    cnt_sub++;
+    perf_inc(PERF_CNT_SUB);
 }
 
 void inc_mult(){
-    cnt_mult++;
+    perf_inc(PERF_CNT_MULT);
 }
 
 void inc_bconv_up(){
-    cnt_bconv_up++;
+    perf_inc(PERF_CNT_BCONV_UP);
 }
 
 void inc_bconv_down(){
-    cnt_bconv_down++;
+    perf_inc(PERF_CNT_BCONV_DOWN);
+}
+
+void inc_prng(){
+    perf_inc(PERF_CNT_PRNG);
+}
+
+void inc_prefetch_posted(){
+    perf_inc(PERF_CNT_PREFETCH_POSTED);
+}
+void inc_prefetch_hit(){
+    perf_inc(PERF_CNT_PREFETCH_HIT);
+}
+void inc_prefetch_late(){
+    perf_inc(PERF_CNT_PREFETCH_LATE);
+}
+void inc_prefetch_wasted(){
+    perf_inc(PERF_CNT_PREFETCH_WASTED);
+}
+void inc_prefetch_dropped(){
+    perf_inc(PERF_CNT_PREFETCH_DROPPED);
 }
 
 
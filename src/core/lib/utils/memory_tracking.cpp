@@ -1,39 +1,81 @@
 #include "utils/memory_tracking.h"
+#include "utils/shadow_pool.h"
+#include "utils/multi_device.h"
+
+#include <shared_mutex>
 
-uint32_t FPGA_N = 65536;
-uint32_t OCB_MB = 8;
-uint32_t HBM_GB = 8;
 uint32_t ROOT_ENTRIES_NUM = 1;
 uint32_t IROOT_ENTRIES_NUM = 1;
-uint32_t cnt_cur_ocb_entries = 0;
-uint32_t cnt_cur_hbm_entries = 0;
-std::mutex ocb_entries_m;
-std::chrono::duration<double, std::milli> elapsed_overhead;
+std::atomic<uint64_t> tracking_overhead_ns{0}; // time spent in the memory tracking structure
 /*  This is memory tracking structure.
-    For performance, information about the shadow buffer is stored in deque and unordered maps.
-    Origin memory address, shadow memory address,ongoing flag are
-    in deque 'shadow_tracking_array' 'shadow_hbm_tracking_array'.
-    The map was used for washing for performance,
-    and it is possible to find where a particular buffer is in the memory tracking structure at once.
+    Every shadow buffer on the on-chip buffer(OCB) or HBM is an entry of its tier,
+    entry = (origin memory address, shadow memory address, residency state), keyed by the shadow memory address.
+    A tier is split into TRACKING_SHARDS shards by the shadow address, every shard has its own lock, entries and
+    eviction policy (utils/eviction_policy.h), so operations on different shadows do not wait for each other.
+    Victim of a full tier is chosen by the policy of one shard (shards are tried in turn),
+    FIFO by default, set_eviction_policy selects another one (LRU, CLOCK, Belady) at runtime.
+    An entry is evicted only when the evictor can claim it (claim_shadow), a shadow used by an operation is pinned.
+    Every device of the multi-device mode (utils/multi_device.h) has its own tiers (DeviceTracker),
+    a shadow is tracked by the device it was made on (ShadowType::device).
 */
-std::deque<std::tuple<uint64_t,uint64_t,bool*>> shadow_tracking_array;
-std::deque<std::tuple<uint64_t,uint64_t,bool*>> shadow_hbm_tracking_array;
-std::unordered_map<uint64_t,std::deque<std::tuple<uint64_t,uint64_t,bool*>>::iterator> shadow_tracking_map;
-std::unordered_map<uint64_t,std::deque<std::tuple<uint64_t,uint64_t,bool*>>::iterator> shadow_hbm_tracking_map;
-bool false_flag = false;
+#define TRACKING_SHARDS 16
+
+struct ShadowShard {
+    std::mutex m;
+    std::unordered_map<uint64_t,std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*>> entries;
+    std::unique_ptr<EvictionPolicy> policy{new FifoEvictionPolicy()};
+};
+struct ShadowTier {
+    ShadowShard shards[TRACKING_SHARDS];
+    std::atomic<uint32_t> cursor{0}; // first shard tried by the next eviction
+    std::atomic<uint64_t> cnt_evictions{0};
+};
+struct DeviceTracker {
+    ShadowTier ocb_tier;
+    ShadowTier hbm_tier;
+    std::atomic<uint32_t> cnt_cur_ocb_entries{0};
+    std::atomic<uint32_t> cnt_cur_hbm_entries{0};
+    std::atomic<uint64_t> cnt_hbm_to_ocb{0}; // OCB <- HBM moves (swap when OCB is full)
+    /* on-chip entries pinned by prefetch hints (PrefetchToDevice), at most half of the on-chip buffer
+        so that the shadows of the running tasks can always evict something */
+    std::atomic<uint32_t> cnt_prefetch_pinned{0};
+};
+DeviceTracker trackers[MAX_DEVICES];
+
+static ShadowShard& shard_of(ShadowTier& tier, uint64_t m_values_shadow_addr){
+    return tier.shards[((m_values_shadow_addr >> 4) * 0x9E3779B97F4A7C15ULL) >> 60];
+}
+
+/* Shadow ids for the access trace and Belady oracle (shadow_id_m).
+    id is given at the first access of a shadow (creation order), and released with the polynomial */
+std::mutex shadow_id_m;
+std::unordered_map<uint64_t,uint64_t> shadow_ids;
+uint64_t next_shadow_id = 1;
+std::atomic<bool> track_shadow_ids{false};
+EvictionOracle eviction_oracle;
+FILE* eviction_access_fp = NULL;
+
+std::atomic<uint32_t> no_residency{0}; // residency of the empty entry
+void print_eviction_stat();
 std::unordered_set<uint64_t> evk_set;
 std::unordered_map<uint64_t,uint64_t> evk_map;
+/* key generation inserts on the host thread while the consumer workers look up (inc_copy_to_shadow_real) */
+std::shared_mutex evk_m;
 
 void insert_evk_map(uint64_t evk_addr){
+    std::unique_lock<std::shared_mutex> lock(evk_m);
     evk_map[evk_addr] = 0;
 }
 
 void check_evk_map(uint64_t evk_addr){
-    if(evk_map.find(evk_addr) != evk_map.end())
-        evk_map[evk_addr]++;
+    std::unique_lock<std::shared_mutex> lock(evk_m);
+    auto it = evk_map.find(evk_addr);
+    if(it != evk_map.end())
+        it->second++;
 }
 
 bool check_evk_set(uint64_t evk_addr){
+    std::shared_lock<std::shared_mutex> lock(evk_m);
     if(evk_set.find(evk_addr) == evk_set.end()){
         return false;
     }
@@ -44,205 +86,356 @@ bool check_evk_set(uint64_t evk_addr){
 }
 
 void insert_evk_set(uint64_t evk_addr){
+    std::unique_lock<std::shared_mutex> lock(evk_m);
     evk_set.insert(evk_addr);
 }
 
 /* print hardware configuration stat */
 void print_memory_stat(){
     std::cout << "print_memroy_stat" << std::endl;
-    std::cout << "FPGA_N: " << FPGA_N<< std::endl;
-    std::cout << "OCB_MB: " << OCB_MB<< std::endl;
-    std::cout << "HBM_GB: " << HBM_GB<< std::endl;
+    hw_profile.print();
     std::cout << "POLY_SIZE: " << POLY_SIZE<< std::endl;
     std::cout << "MB_TO_BYTES: " << MB_TO_BYTES<< std::endl;
     std::cout << "GB_TO_MB: " << GB_TO_MB<< std::endl;
     std::cout << "MB_TO_ENTRIES_NUM: " << MB_TO_ENTRIES_NUM<< std::endl;
     std::cout << "OCB_ENTRIES_NUM: " << OCB_ENTRIES_NUM<< std::endl;
     std::cout << "HBM_ENTRIES_NUM: " << HBM_ENTRIES_NUM<< std::endl;
-    std::cout << "cnt_cur_ocb_entries: " << cnt_cur_ocb_entries<< std::endl;
-    std::cout << "cnt_cur_hbm_entries: " << cnt_cur_hbm_entries<< std::endl;
+    for(uint32_t d = 0; d < num_devices; d++){
+        if(num_devices > 1) std::cout << "device " << d << std::endl;
+        std::cout << "cnt_cur_ocb_entries: " << trackers[d].cnt_cur_ocb_entries.load()<< std::endl;
+        std::cout << "cnt_cur_hbm_entries: " << trackers[d].cnt_cur_hbm_entries.load()<< std::endl;
+    }
+    print_eviction_stat();
+    print_shadow_pool_stat();
 }
 
 /* increase current on-chip buffer entry number */
-void inc_cur_ocb_entries(){
-    cnt_cur_ocb_entries++;
+void inc_cur_ocb_entries(uint32_t device){
+    trackers[device].cnt_cur_ocb_entries++;
 }
 /* decrease current on-chip buffer entry number */
-void dec_cur_ocb_entries(){
-    cnt_cur_ocb_entries--;
+void dec_cur_ocb_entries(uint32_t device){
+    trackers[device].cnt_cur_ocb_entries--;
 }
 /* increase current HBM entry number */
-void inc_cur_hbm_entries(){
-    cnt_cur_hbm_entries++;
+void inc_cur_hbm_entries(uint32_t device){
+    trackers[device].cnt_cur_hbm_entries++;
 }
 /* decrease current HBM entry number */
-void dec_cur_hbm_entries(){
-    cnt_cur_hbm_entries--;
+void dec_cur_hbm_entries(uint32_t device){
+    trackers[device].cnt_cur_hbm_entries--;
 }
 
-/* Enter information in the memory tracking structure when the shadow is newly created */
-void insert_shadow_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, bool &ongoing_flag){
-    auto start_work = std::chrono::high_resolution_clock::now();
-
-    shadow_tracking_array.push_front(std::make_tuple(m_values_addr,m_values_shadow_addr,&ongoing_flag));
-    shadow_tracking_map[m_values_shadow_addr] = shadow_tracking_array.begin();
-    
+static void add_tracking_overhead(std::chrono::high_resolution_clock::time_point start_work){
     auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
+    tracking_overhead_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end_work - start_work).count(),
+                                   std::memory_order_relaxed);
+}
 
-    inc_cur_ocb_entries();
+double tracking_overhead_ms(){
+    return tracking_overhead_ns.load() / 1e6;
 }
-void insert_shadow_hbm_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, bool &ongoing_flag){
-    auto start_work = std::chrono::high_resolution_clock::now();
 
-    shadow_hbm_tracking_array.push_front(std::make_tuple(m_values_addr,m_values_shadow_addr,&ongoing_flag));
-    shadow_hbm_tracking_map[m_values_shadow_addr] = shadow_hbm_tracking_array.begin();
+/* select eviction policy of OCB and HBM, entries tracked so far move to the new policy */
+bool set_eviction_policy(const char* name){
+    if(!make_eviction_policy(name)){
+        std::cout << "unknown eviction policy " << name << " (FIFO, LRU, CLOCK, Belady)" << std::endl;
+        return false;
+    }
+    for(auto& tracker : trackers){
+        ShadowTier* tiers[2] = {&tracker.ocb_tier, &tracker.hbm_tier};
+        for(auto tier : tiers){
+            for(auto& shard : tier->shards){
+                std::lock_guard<std::mutex> lock(shard.m);
+                std::unique_ptr<EvictionPolicy> policy = make_eviction_policy(name);
+                for(auto& e : shard.entries) policy->insert(e.first, EVICTION_NEVER_USED);
+                shard.policy = std::move(policy);
+            }
+        }
+    }
+    return true;
+}
 
-    auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
+/* ids count from the start of recording (or replaying) the access trace, shadow_id_m must be locked */
+static void start_shadow_ids(){
+    shadow_ids.clear();
+    next_shadow_id = 1;
+    track_shadow_ids = true;
+}
 
-    inc_cur_hbm_entries();
+/* access trace of a previous run for Belady */
+bool set_eviction_oracle(const char* path){
+    std::lock_guard<std::mutex> lock(shadow_id_m);
+    bool loaded = eviction_oracle.load(path);
+    if(loaded) start_shadow_ids();
+    else std::cout << "cannot load eviction oracle " << path << std::endl;
+    return loaded;
 }
 
-/* for 'discard_shadow' fucntion, when on-chip-buffer is full,
-    choose victim (FIFO Rule) */
-std::tuple<uint64_t,uint64_t,bool*> evict_shadow_tracking_array(){
-    auto start_work = std::chrono::high_resolution_clock::now();
+/* record the access trace (shadow id per access) of this run, input of set_eviction_oracle */
+bool set_eviction_access_trace(const char* path){
+    std::lock_guard<std::mutex> lock(shadow_id_m);
+    if(eviction_access_fp) fclose(eviction_access_fp);
+    eviction_access_fp = fopen(path, "wb");
+    if(eviction_access_fp) start_shadow_ids();
+    return eviction_access_fp != NULL;
+}
 
-    auto tmp = shadow_tracking_array.back();
+void init_eviction_stat(){
+    for(auto& tracker : trackers){
+        tracker.ocb_tier.cnt_evictions = 0;
+        tracker.hbm_tier.cnt_evictions = 0;
+        tracker.cnt_hbm_to_ocb = 0;
+    }
+    tracking_overhead_ns = 0;
+}
 
-    while(*std::get<2>(tmp)==true || std::get<1>(tmp) == 0){
-        shadow_tracking_array.pop_back();
-        if(*std::get<2>(tmp)==true){
-            shadow_tracking_array.push_front(tmp);
-            shadow_tracking_map[std::get<1>(tmp)] = shadow_tracking_array.begin();
-        }
-        tmp = shadow_tracking_array.back();
+void print_eviction_stat(){
+    if(eviction_access_fp) fflush(eviction_access_fp);
+    std::cout << "eviction policy: " << trackers[0].ocb_tier.shards[0].policy->name() << " (" << TRACKING_SHARDS << " shards)" << std::endl;
+    for(uint32_t d = 0; d < num_devices; d++){
+        DeviceTracker& tracker = trackers[d];
+        if(num_devices > 1) std::cout << " device " << d << std::endl;
+        std::cout << "  OCB --> HBM evictions : " << tracker.ocb_tier.cnt_evictions.load() << std::endl;
+        std::cout << "  HBM --> ORIGIN evictions : " << tracker.hbm_tier.cnt_evictions.load() << std::endl;
+        std::cout << "  OCB <-- HBM : " << tracker.cnt_hbm_to_ocb.load() << std::endl;
     }
-    auto it = shadow_tracking_map.find(std::get<1>(tmp));
-    if(it == shadow_tracking_map.end()){ // for debugging
-        printf("wrong evict_shadow_tracking_array\n");
-        while(1){
-            usleep(1000);
-        }
+}
+
+bool prefetch_pin_acquire(uint32_t device){
+    std::atomic<uint32_t>& pinned = trackers[device].cnt_prefetch_pinned;
+    uint32_t cur = pinned.load(std::memory_order_relaxed);
+    while(1){
+        if(cur >= OCB_ENTRIES_NUM / 2) return false;
+        if(pinned.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed)) return true;
     }
-    shadow_tracking_map.erase(it);
-    shadow_tracking_array.pop_back();
+}
 
-    auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
- 
-    dec_cur_ocb_entries();
-    return tmp;
+void prefetch_pin_release(uint32_t device){
+    trackers[device].cnt_prefetch_pinned.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/* shadow_id_m must be locked */
+static uint64_t get_shadow_id(uint64_t m_values_shadow_addr){
+    uint64_t& id = shadow_ids[m_values_shadow_addr];
+    if(id == 0) id = next_shadow_id++;
+    return id;
 }
-/* for 'discard_shadow' fucntion, HBM is full,
-    choose victim (FIFO Rule) */
-std::tuple<uint64_t,uint64_t,bool*> evict_shadow_hbm_tracking_array(){
-    auto start_work = std::chrono::high_resolution_clock::now();
 
-    auto tmp = shadow_hbm_tracking_array.back();
-    while(*std::get<2>(tmp)==true || std::get<1>(tmp) == 0){
-        shadow_hbm_tracking_array.pop_back();
-        if(*std::get<2>(tmp)==true){
-            shadow_tracking_array.push_front(tmp);
-            shadow_tracking_map[std::get<1>(tmp)] = shadow_tracking_array.begin();
+/* next use of the shadow in the oracle (without this access) */
+static uint64_t peek_next_use(uint64_t m_values_shadow_addr){
+    if(!track_shadow_ids.load(std::memory_order_relaxed)) return EVICTION_NEVER_USED;
+    std::lock_guard<std::mutex> lock(shadow_id_m);
+    if(eviction_oracle.empty()) return EVICTION_NEVER_USED;
+    return eviction_oracle.peek(get_shadow_id(m_values_shadow_addr));
+}
+
+/* The shadow is used by an operation (create_shadow, copy_to_shadow) */
+void access_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device){
+    uint64_t next_use = EVICTION_NEVER_USED;
+    if(track_shadow_ids.load(std::memory_order_relaxed)){
+        std::lock_guard<std::mutex> lock(shadow_id_m);
+        uint64_t id = get_shadow_id(m_values_shadow_addr);
+        if(eviction_access_fp){
+            uint32_t id32 = (uint32_t)id;
+            fwrite(&id32, sizeof(id32), 1, eviction_access_fp);
         }
-        tmp = shadow_hbm_tracking_array.back();
+        if(!eviction_oracle.empty()) next_use = eviction_oracle.advance(id);
     }
-    auto it = shadow_hbm_tracking_map.find(std::get<1>(tmp));
-    if(it == shadow_hbm_tracking_map.end()){ // for debugging
-        printf("wrong evict_shadow_hbm_tracking_array\n");
-        while(1){
-            usleep(1000);
+    ShadowTier* tiers[2] = {&trackers[device].ocb_tier, &trackers[device].hbm_tier};
+    for(auto tier : tiers){
+        ShadowShard& shard = shard_of(*tier, m_values_shadow_addr);
+        std::lock_guard<std::mutex> lock(shard.m);
+        if(shard.entries.count(m_values_shadow_addr)){
+            shard.policy->access(m_values_shadow_addr, next_use);
+            return;
         }
     }
-    shadow_hbm_tracking_map.erase(it);
-    shadow_hbm_tracking_array.pop_back();
+}
 
-    auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
+static void insert_tier(ShadowTier& tier, uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency){
+    uint64_t next_use = peek_next_use(m_values_shadow_addr);
+    ShadowShard& shard = shard_of(tier, m_values_shadow_addr);
+    std::lock_guard<std::mutex> lock(shard.m);
+    shard.entries[m_values_shadow_addr] = std::make_tuple(m_values_addr,m_values_shadow_addr,&residency);
+    shard.policy->insert(m_values_shadow_addr, next_use);
+}
 
-    dec_cur_hbm_entries();
+/* victim chosen by the policy of a shard, entries pinned by an operation are skipped.
+    Returned victim is claimed (SHADOW_EVICTING), the caller releases it after moving the data (release_shadow) */
+static std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> evict_tier(ShadowTier& tier){
+    uint32_t start = tier.cursor.fetch_add(1, std::memory_order_relaxed);
+    for(uint32_t i = 0; i < TRACKING_SHARDS; i++){
+        ShadowShard& shard = tier.shards[(start + i) % TRACKING_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.m);
+        if(shard.entries.empty()) continue;
+
+        uint64_t key = shard.policy->victim([&shard](uint64_t k){
+            auto it = shard.entries.find(k);
+            return it != shard.entries.end() && claim_shadow(*std::get<2>(it->second));
+        });
+        if(key == 0) continue; // every entry of the shard is in use
+
+        auto it = shard.entries.find(key);
+        auto tmp = it->second;
+        shard.entries.erase(it);
+        shard.policy->remove(key);
+        tier.cnt_evictions++;
+        return tmp;
+    }
+    return std::make_tuple(0,0,&no_residency);
+}
+
+static std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> select_tier(ShadowTier& tier, uint64_t m_values_shadow_addr){
+    ShadowShard& shard = shard_of(tier, m_values_shadow_addr);
+    std::lock_guard<std::mutex> lock(shard.m);
+    auto it = shard.entries.find(m_values_shadow_addr);
+    if(it == shard.entries.end()) return std::make_tuple(0,0,&no_residency);
+    auto tmp = it->second;
+    shard.entries.erase(it);
+    shard.policy->remove(m_values_shadow_addr);
+    return tmp;
+}
+
+/* Enter information in the memory tracking structure when the shadow is newly created */
+void insert_shadow_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency, uint32_t device){
+    auto start_work = std::chrono::high_resolution_clock::now();
+
+    insert_tier(trackers[device].ocb_tier, m_values_addr, m_values_shadow_addr, residency);
+    inc_cur_ocb_entries(device);
+
+    add_tracking_overhead(start_work);
+}
+void insert_shadow_hbm_tracking_array(uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency, uint32_t device){
+    auto start_work = std::chrono::high_resolution_clock::now();
+
+    insert_tier(trackers[device].hbm_tier, m_values_addr, m_values_shadow_addr, residency);
+    inc_cur_hbm_entries(device);
+
+    add_tracking_overhead(start_work);
+}
+
+/* for 'discard_shadow' fucntion, when on-chip-buffer is full,
+    choose victim (eviction policy) */
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> evict_shadow_tracking_array(uint32_t device){
+    auto start_work = std::chrono::high_resolution_clock::now();
+
+    auto tmp = evict_tier(trackers[device].ocb_tier);
+    if(std::get<1>(tmp)) dec_cur_ocb_entries(device);
+
+    add_tracking_overhead(start_work);
+    return tmp;
+}
+/* for 'discard_shadow' fucntion, HBM is full,
+    choose victim (eviction policy) */
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> evict_shadow_hbm_tracking_array(uint32_t device){
+    auto start_work = std::chrono::high_resolution_clock::now();
+
+    auto tmp = evict_tier(trackers[device].hbm_tier);
+    if(std::get<1>(tmp)) dec_cur_hbm_entries(device);
+
+    add_tracking_overhead(start_work);
     return tmp;
 }
 
 /* not use */
-std::tuple<uint64_t,uint64_t,bool*> select_shadow_tracking_array(uint64_t m_values_shadow_addr){
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> select_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device){
     auto start_work = std::chrono::high_resolution_clock::now();
     
-    auto it = shadow_tracking_map.find(m_values_shadow_addr);
-    if(it == shadow_tracking_map.end()) std::cout << "wrong select_shadow_tracking_array" << std::endl;
-    auto tmp = *(it->second);
-    *(it->second) = std::make_tuple(0,0,&false_flag);
-    shadow_tracking_map.erase(it);
+    auto tmp = select_tier(trackers[device].ocb_tier, m_values_shadow_addr);
+    if(std::get<1>(tmp) == 0) std::cout << "wrong select_shadow_tracking_array" << std::endl;
+    else dec_cur_ocb_entries(device);
 
-    auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
-
-    dec_cur_ocb_entries();
+    add_tracking_overhead(start_work);
     return tmp;
 }
 
 /* for copy_to_shadow function, when shadow buffer in HBM
     we need to find shadow buffer information in memory tracking structure */
-std::tuple<uint64_t,uint64_t,bool*> select_shadow_hbm_tracking_array(uint64_t m_values_shadow_addr){
+std::tuple<uint64_t,uint64_t,std::atomic<uint32_t>*> select_shadow_hbm_tracking_array(uint64_t m_values_shadow_addr, uint32_t device){
     auto start_work = std::chrono::high_resolution_clock::now();
     
-    auto it = shadow_hbm_tracking_map.find(m_values_shadow_addr);
-    if(it == shadow_hbm_tracking_map.end()) std::cout << "wrong select_shadow_hbm_tracking_array" << std::endl;
-    auto tmp = *(it->second);
-    *(it->second) = std::make_tuple(0,0,&false_flag);
-    shadow_hbm_tracking_map.erase(it);
-
-    auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
+    auto tmp = select_tier(trackers[device].hbm_tier, m_values_shadow_addr);
+    if(std::get<1>(tmp) == 0) std::cout << "wrong select_shadow_hbm_tracking_array" << std::endl;
+    else{
+        dec_cur_hbm_entries(device);
+        trackers[device].cnt_hbm_to_ocb++;
+    }
 
-    dec_cur_hbm_entries();
+    add_tracking_overhead(start_work);
     return tmp;
 }
 
 /* Openfhe automatically releases memory because it uses smart pointers.
     Therefore, when the memory for the polynomial is released,
-    Remove the memory information from the memory tracking data structure */
-void clean_shadow_tracking_array(uint64_t m_values_shadow_addr){
+    Remove the memory information from the memory tracking data structure
+    (the shadow is pinned by the caller, no eviction is moving it) */
+void clean_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device){
     auto start_work = std::chrono::high_resolution_clock::now();
 
-    ocb_entries_m.lock();
-    auto it = shadow_tracking_map.find(m_values_shadow_addr);
-    if(it != shadow_tracking_map.end()){
-        *(it->second) = std::make_tuple(0,0,&false_flag);
-        shadow_tracking_map.erase(it);
+    if(track_shadow_ids.load(std::memory_order_relaxed)){
+        std::lock_guard<std::mutex> lock(shadow_id_m);
+        shadow_ids.erase(m_values_shadow_addr);
+    }
+    DeviceTracker& tracker = trackers[device];
+    if(std::get<1>(select_tier(tracker.ocb_tier, m_values_shadow_addr))) dec_cur_ocb_entries(device);
+    else if(std::get<1>(select_tier(tracker.hbm_tier, m_values_shadow_addr))) dec_cur_hbm_entries(device);
 
-        auto end_work = std::chrono::high_resolution_clock::now();
-        elapsed_overhead += end_work - start_work;
+    add_tracking_overhead(start_work);
+}
 
-        dec_cur_ocb_entries();
-        ocb_entries_m.unlock();
-        return;
+/* A polynomial is moved (move constructor or assignment), its shadow goes to the new polynomial without a copy.
+    The entry of the old shadow becomes the entry of the new one in the same tier, the eviction policy keeps its position
+    only in FIFO order of the shard (entry is inserted again). Both shadows are pinned by the caller */
+void move_shadow_tracking_array(uint64_t from_shadow_addr, uint64_t m_values_addr, uint64_t m_values_shadow_addr, std::atomic<uint32_t> &residency, uint32_t device){
+    auto start_work = std::chrono::high_resolution_clock::now();
+
+    if(track_shadow_ids.load(std::memory_order_relaxed)){
+        std::lock_guard<std::mutex> lock(shadow_id_m);
+        auto it = shadow_ids.find(from_shadow_addr);
+        if(it != shadow_ids.end()){
+            uint64_t id = it->second;
+            shadow_ids.erase(it);
+            shadow_ids[m_values_shadow_addr] = id;
+        }
+    }
+    ShadowTier* tiers[2] = {&trackers[device].ocb_tier, &trackers[device].hbm_tier};
+    for(auto tier : tiers){
+        if(std::get<1>(select_tier(*tier, from_shadow_addr))){
+            insert_tier(*tier, m_values_addr, m_values_shadow_addr, residency);
+            break;
+        }
     }
-    auto it_ = shadow_hbm_tracking_map.find(m_values_shadow_addr);
-    if(it_ != shadow_hbm_tracking_map.end()){
-        *(it_->second) = std::make_tuple(0,0,&false_flag);
-        shadow_hbm_tracking_map.erase(it_);
 
-        auto end_work = std::chrono::high_resolution_clock::now();
-        elapsed_overhead += end_work - start_work;
+    add_tracking_overhead(start_work);
+}
 
-        dec_cur_hbm_entries();
-        ocb_entries_m.unlock();
-        return;
-    }
+/* A limb changed its modulus and goes to the device of the new modulus (TASK_TYPE_DeviceTransfer),
+    its entry moves to the same tier of the new device. The shadow is pinned by the caller */
+void migrate_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t from_device, uint32_t to_device){
+    auto start_work = std::chrono::high_resolution_clock::now();
 
-    auto end_work = std::chrono::high_resolution_clock::now();
-    elapsed_overhead += end_work - start_work;
+    auto tmp = select_tier(trackers[from_device].ocb_tier, m_values_shadow_addr);
+    if(std::get<1>(tmp)){
+        dec_cur_ocb_entries(from_device);
+        insert_tier(trackers[to_device].ocb_tier, std::get<0>(tmp), std::get<1>(tmp), *std::get<2>(tmp));
+        inc_cur_ocb_entries(to_device);
+    }
+    else{
+        tmp = select_tier(trackers[from_device].hbm_tier, m_values_shadow_addr);
+        if(std::get<1>(tmp)){
+            dec_cur_hbm_entries(from_device);
+            insert_tier(trackers[to_device].hbm_tier, std::get<0>(tmp), std::get<1>(tmp), *std::get<2>(tmp));
+            inc_cur_hbm_entries(to_device);
+        }
+    }
 
-    ocb_entries_m.unlock();
-    return;
+    add_tracking_overhead(start_work);
 }
 
 /* for checking that the on-chip buffer is full */
-bool check_full_ocb_entries(){
-    if(cnt_cur_ocb_entries >= OCB_ENTRIES_NUM){
+bool check_full_ocb_entries(uint32_t device){
+    if(trackers[device].cnt_cur_ocb_entries >= OCB_ENTRIES_NUM){
         return true;
     }
     else{
@@ -251,8 +444,8 @@ bool check_full_ocb_entries(){
 }
 
 /* for checking that the HBM is full */
-bool check_full_hbm_entries(){
-    if(cnt_cur_hbm_entries >= HBM_ENTRIES_NUM){
+bool check_full_hbm_entries(uint32_t device){
+    if(trackers[device].cnt_cur_hbm_entries >= HBM_ENTRIES_NUM){
         // std::cout << "HBM is full" << std::endl;
         return true;
     }
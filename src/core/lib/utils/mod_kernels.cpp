@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <unordered_map>
+
+#include "utils/mod_kernels.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MOD_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+extern void divide_uint192_inplace(uint64_t *numerator, uint64_t denominator, uint64_t *quotient);
+
+const ModConst& mod_const(uint64_t modulus) {
+    thread_local std::unordered_map<uint64_t, ModConst> consts;
+    thread_local const ModConst* last = nullptr;
+    if(last && last->modulus == modulus) return *last;
+
+    auto it = consts.find(modulus);
+    if(it == consts.end()){
+        uint64_t numerator[3]{ 0, 0, 1 };
+        uint64_t quotient[3]{ 0, 0, 0 };
+        divide_uint192_inplace(numerator, modulus, quotient);
+        it = consts.emplace(modulus, ModConst{modulus, quotient[0], quotient[1]}).first;
+    }
+    last = &it->second;
+    return *last;
+}
+
+/* scalar kernels */
+namespace {
+
+static inline uint64_t shoup_mul(uint64_t x, uint64_t scalar, uint64_t scalar_shoup, uint64_t modulus) {
+    uint64_t q = (uint64_t)(((unsigned __int128)x * scalar_shoup) >> 64);
+    uint64_t r = x * scalar - q * modulus;
+    return r >= modulus ? r - modulus : r;
+}
+
+void mod_add_scalar_impl(uint64_t* res, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
+    for(size_t i = 0; i < size; i++){
+        uint64_t sum = op1[i] + op2[i];
+        res[i] = sum >= modulus ? sum - modulus : sum;
+    }
+}
+
+void mod_sub_scalar_impl(uint64_t* res, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
+    for(size_t i = 0; i < size; i++){
+        uint64_t x = op1[i];
+        uint64_t temp = x - op2[i];
+        res[i] = temp + (modulus & (uint64_t)(-(int64_t)(temp > x)));
+    }
+}
+
+void mod_add_const_scalar_impl(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+    for(size_t i = 0; i < size; i++){
+        uint64_t sum = op1[i] + scalar;
+        res[i] = sum >= modulus ? sum - modulus : sum;
+    }
+}
+
+void mod_sub_const_scalar_impl(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+    for(size_t i = 0; i < size; i++){
+        uint64_t x = op1[i];
+        uint64_t temp = x - scalar;
+        res[i] = temp + (modulus & (uint64_t)(-(int64_t)(temp > x)));
+    }
+}
+
+void mod_mul_const_scalar_impl(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+    uint64_t scalar_shoup = shoup_const(scalar, modulus);
+    for(size_t i = 0; i < size; i++)
+        res[i] = shoup_mul(op1[i], scalar, scalar_shoup, modulus);
+}
+
+/* v * scalar is reduced by Shoup for any 64-bit v, so the old v % nm of the bconv down case is not needed */
+void bconv_mac_scalar_impl(uint64_t* acc, const uint64_t* data, size_t size, uint64_t halfQ, uint64_t diff, uint64_t nm,
+                           uint64_t scalar, uint64_t modulus) {
+    uint64_t scalar_shoup = shoup_const(scalar, nm);
+    for(size_t i = 0; i < size; i++){
+        uint64_t v = data[i];
+        if(v > halfQ) v += diff;
+        uint64_t sum = acc[i] + shoup_mul(v, scalar, scalar_shoup, nm);
+        acc[i] = sum >= modulus ? sum - modulus : sum;
+    }
+}
+
+#ifdef MOD_KERNELS_X86
+
+/* AVX2 has no unsigned 64-bit compare, values are below 2^62 so the sign bit of (sum - q) or (x - y) tells the borrow */
+__attribute__((target("avx2")))
+void mod_add_avx2(uint64_t* res, const uint64_t* op1, const uint64_t* op2, const uint64_t* scalar, uint64_t modulus, size_t size) {
+    const __m256i q = _mm256_set1_epi64x(modulus);
+    __m256i s = scalar ? _mm256_set1_epi64x(*scalar) : _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(op1 + i));
+        if(!scalar) s = _mm256_loadu_si256((const __m256i*)(op2 + i));
+        __m256i sum = _mm256_add_epi64(a, s);
+        __m256i t = _mm256_sub_epi64(sum, q);
+        __m256i r = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(t), _mm256_castsi256_pd(sum), _mm256_castsi256_pd(t)));
+        _mm256_storeu_si256((__m256i*)(res + i), r);
+    }
+    if(scalar) mod_add_const_scalar_impl(res + i, op1 + i, *scalar, modulus, size - i);
+    else mod_add_scalar_impl(res + i, op1 + i, op2 + i, modulus, size - i);
+}
+
+__attribute__((target("avx2")))
+void mod_sub_avx2(uint64_t* res, const uint64_t* op1, const uint64_t* op2, const uint64_t* scalar, uint64_t modulus, size_t size) {
+    const __m256i q = _mm256_set1_epi64x(modulus);
+    __m256i s = scalar ? _mm256_set1_epi64x(*scalar) : _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(op1 + i));
+        if(!scalar) s = _mm256_loadu_si256((const __m256i*)(op2 + i));
+        __m256i d = _mm256_sub_epi64(a, s);
+        __m256i borrow = _mm256_srai_epi32(_mm256_shuffle_epi32(d, 0xF5), 31); // sign of each 64-bit lane
+        __m256i r = _mm256_add_epi64(d, _mm256_and_si256(q, borrow));
+        _mm256_storeu_si256((__m256i*)(res + i), r);
+    }
+    if(scalar) mod_sub_const_scalar_impl(res + i, op1 + i, *scalar, modulus, size - i);
+    else mod_sub_scalar_impl(res + i, op1 + i, op2 + i, modulus, size - i);
+}
+
+__attribute__((target("avx512f")))
+void mod_add_avx512(uint64_t* res, const uint64_t* op1, const uint64_t* op2, const uint64_t* scalar, uint64_t modulus, size_t size) {
+    const __m512i q = _mm512_set1_epi64(modulus);
+    __m512i s = scalar ? _mm512_set1_epi64(*scalar) : _mm512_setzero_si512();
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m512i a = _mm512_loadu_si512(op1 + i);
+        if(!scalar) s = _mm512_loadu_si512(op2 + i);
+        __m512i sum = _mm512_add_epi64(a, s);
+        __mmask8 over = _mm512_cmpge_epu64_mask(sum, q);
+        _mm512_storeu_si512(res + i, _mm512_mask_sub_epi64(sum, over, sum, q));
+    }
+    if(scalar) mod_add_const_scalar_impl(res + i, op1 + i, *scalar, modulus, size - i);
+    else mod_add_scalar_impl(res + i, op1 + i, op2 + i, modulus, size - i);
+}
+
+__attribute__((target("avx512f")))
+void mod_sub_avx512(uint64_t* res, const uint64_t* op1, const uint64_t* op2, const uint64_t* scalar, uint64_t modulus, size_t size) {
+    const __m512i q = _mm512_set1_epi64(modulus);
+    __m512i s = scalar ? _mm512_set1_epi64(*scalar) : _mm512_setzero_si512();
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m512i a = _mm512_loadu_si512(op1 + i);
+        if(!scalar) s = _mm512_loadu_si512(op2 + i);
+        __mmask8 borrow = _mm512_cmplt_epu64_mask(a, s);
+        __m512i d = _mm512_sub_epi64(a, s);
+        _mm512_storeu_si512(res + i, _mm512_mask_add_epi64(d, borrow, d, q));
+    }
+    if(scalar) mod_sub_const_scalar_impl(res + i, op1 + i, *scalar, modulus, size - i);
+    else mod_sub_scalar_impl(res + i, op1 + i, op2 + i, modulus, size - i);
+}
+
+/* 64-bit Shoup on AVX-512F, 64x64 products from four 32x32 products (_mm512_mul_epu32)
+    Zero-masked forms with all lanes set : the plain _mm512_mul_epu32 / _mm512_srli_epi64 / _mm512_slli_epi64
+    of GCC start from _mm512_undefined_epi32 () which gives -Wmaybe-uninitialized under -Wall */
+#define AVX512_ALL_LANES ((__mmask8)0xFF)
+
+__attribute__((target("avx512f")))
+static inline __m512i mul_epu32_avx512(__m512i a, __m512i b) {
+    return _mm512_maskz_mul_epu32(AVX512_ALL_LANES, a, b);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i srli64_avx512(__m512i a, unsigned int n) {
+    return _mm512_maskz_srli_epi64(AVX512_ALL_LANES, a, n);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i mulhi64_avx512(__m512i a, __m512i b) {
+    const __m512i lo32 = _mm512_set1_epi64(0xffffffffULL);
+    __m512i a_hi = srli64_avx512(a, 32);
+    __m512i b_hi = srli64_avx512(b, 32);
+    __m512i ll = mul_epu32_avx512(a, b);
+    __m512i lh = mul_epu32_avx512(a, b_hi);
+    __m512i hl = mul_epu32_avx512(a_hi, b);
+    __m512i hh = mul_epu32_avx512(a_hi, b_hi);
+    __m512i mid = _mm512_add_epi64(_mm512_add_epi64(srli64_avx512(ll, 32), _mm512_and_si512(lh, lo32)),
+                                   _mm512_and_si512(hl, lo32));
+    __m512i hi = _mm512_add_epi64(hh, _mm512_add_epi64(srli64_avx512(lh, 32), srli64_avx512(hl, 32)));
+    return _mm512_add_epi64(hi, srli64_avx512(mid, 32));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i mullo64_avx512(__m512i a, __m512i b) {
+    __m512i cross = _mm512_add_epi64(mul_epu32_avx512(a, srli64_avx512(b, 32)), mul_epu32_avx512(srli64_avx512(a, 32), b));
+    return _mm512_add_epi64(mul_epu32_avx512(a, b), _mm512_maskz_slli_epi64(AVX512_ALL_LANES, cross, 32));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i shoup_mul_avx512(__m512i x, __m512i w, __m512i w_shoup, __m512i q) {
+    __m512i q_est = mulhi64_avx512(x, w_shoup);
+    __m512i r = _mm512_sub_epi64(mullo64_avx512(x, w), mullo64_avx512(q_est, q));
+    return _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, q), r, q);
+}
+
+__attribute__((target("avx512f")))
+void mod_mul_scalar_avx512(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+    const __m512i q = _mm512_set1_epi64(modulus);
+    const __m512i w = _mm512_set1_epi64(scalar);
+    const __m512i w_shoup = _mm512_set1_epi64(shoup_const(scalar, modulus));
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m512i x = _mm512_loadu_si512(op1 + i);
+        _mm512_storeu_si512(res + i, shoup_mul_avx512(x, w, w_shoup, q));
+    }
+    mod_mul_const_scalar_impl(res + i, op1 + i, scalar, modulus, size - i);
+}
+
+__attribute__((target("avx512f")))
+void bconv_mac_avx512(uint64_t* acc, const uint64_t* data, size_t size, uint64_t halfQ, uint64_t diff, uint64_t nm,
+                      uint64_t scalar, uint64_t modulus) {
+    const __m512i q = _mm512_set1_epi64(nm);
+    const __m512i m = _mm512_set1_epi64(modulus);
+    const __m512i h = _mm512_set1_epi64(halfQ);
+    const __m512i d = _mm512_set1_epi64(diff);
+    const __m512i w = _mm512_set1_epi64(scalar);
+    const __m512i w_shoup = _mm512_set1_epi64(shoup_const(scalar, nm));
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m512i v = _mm512_loadu_si512(data + i);
+        v = _mm512_mask_add_epi64(v, _mm512_cmpgt_epu64_mask(v, h), v, d);
+        __m512i sum = _mm512_add_epi64(_mm512_loadu_si512(acc + i), shoup_mul_avx512(v, w, w_shoup, q));
+        _mm512_storeu_si512(acc + i, _mm512_mask_sub_epi64(sum, _mm512_cmpge_epu64_mask(sum, m), sum, m));
+    }
+    bconv_mac_scalar_impl(acc + i, data + i, size - i, halfQ, diff, nm, scalar, modulus);
+}
+
+/* 52-bit Shoup : w' = floor(w * 2^52 / q), q_est = hi52(x * w'), r = lo52(x * w) - lo52(q_est * q) in [0, 2q)
+    needs x < 2^52 and q < 2^51 */
+#define IFMA_MASK52 ((1ULL << 52) - 1)
+
+__attribute__((target("avx512f,avx512ifma")))
+static inline __m512i shoup_mul_ifma(__m512i x, __m512i w, __m512i w_shoup, __m512i q) {
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i q_est = _mm512_madd52hi_epu64(zero, x, w_shoup);
+    __m512i xw = _mm512_madd52lo_epu64(zero, x, w);
+    __m512i qq = _mm512_madd52lo_epu64(zero, q_est, q);
+    __m512i r = _mm512_and_si512(_mm512_sub_epi64(xw, qq), _mm512_set1_epi64(IFMA_MASK52));
+    return _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, q), r, q);
+}
+
+__attribute__((target("avx512f,avx512ifma")))
+void mod_mul_scalar_ifma(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+    const __m512i q = _mm512_set1_epi64(modulus);
+    const __m512i w = _mm512_set1_epi64(scalar);
+    const __m512i w_shoup = _mm512_set1_epi64((uint64_t)(((unsigned __int128)scalar << 52) / modulus));
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m512i x = _mm512_loadu_si512(op1 + i);
+        _mm512_storeu_si512(res + i, shoup_mul_ifma(x, w, w_shoup, q));
+    }
+    mod_mul_const_scalar_impl(res + i, op1 + i, scalar, modulus, size - i);
+}
+
+__attribute__((target("avx512f,avx512ifma")))
+void bconv_mac_ifma(uint64_t* acc, const uint64_t* data, size_t size, uint64_t halfQ, uint64_t diff, uint64_t nm,
+                    uint64_t scalar, uint64_t modulus) {
+    const __m512i q = _mm512_set1_epi64(nm);
+    const __m512i m = _mm512_set1_epi64(modulus);
+    const __m512i h = _mm512_set1_epi64(halfQ);
+    const __m512i d = _mm512_set1_epi64(diff);
+    const __m512i w = _mm512_set1_epi64(scalar);
+    const __m512i w_shoup = _mm512_set1_epi64((uint64_t)(((unsigned __int128)scalar << 52) / nm));
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m512i v = _mm512_loadu_si512(data + i);
+        v = _mm512_mask_add_epi64(v, _mm512_cmpgt_epu64_mask(v, h), v, d);
+        __m512i sum = _mm512_add_epi64(_mm512_loadu_si512(acc + i), shoup_mul_ifma(v, w, w_shoup, q));
+        _mm512_storeu_si512(acc + i, _mm512_mask_sub_epi64(sum, _mm512_cmpge_epu64_mask(sum, m), sum, m));
+    }
+    bconv_mac_scalar_impl(acc + i, data + i, size - i, halfQ, diff, nm, scalar, modulus);
+}
+
+#endif
+
+int detect_simd_level() {
+#ifdef MOD_KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma")) return SIMD_LEVEL_AVX512IFMA;
+    if(__builtin_cpu_supports("avx512f")) return SIMD_LEVEL_AVX512;
+    if(__builtin_cpu_supports("avx2")) return SIMD_LEVEL_AVX2;
+#endif
+    return SIMD_LEVEL_SCALAR;
+}
+
+const int detected_simd_level = detect_simd_level();
+int simd_level = detected_simd_level;
+
+} // namespace
+
+int get_simd_level() {
+    return simd_level;
+}
+
+/* a level above the detected one is not allowed */
+void set_simd_level(int level) {
+    if(level < SIMD_LEVEL_SCALAR) level = SIMD_LEVEL_SCALAR;
+    simd_level = level < detected_simd_level ? level : detected_simd_level;
+}
+
+const char* simd_level_name(int level) {
+    switch(level) {
+        case SIMD_LEVEL_AVX2: return "AVX2";
+        case SIMD_LEVEL_AVX512: return "AVX-512";
+        case SIMD_LEVEL_AVX512IFMA: return "AVX-512 IFMA";
+        default: return "scalar";
+    }
+}
+
+void mod_add(uint64_t* res, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
+#ifdef MOD_KERNELS_X86
+    if(simd_level >= SIMD_LEVEL_AVX512) return mod_add_avx512(res, op1, op2, nullptr, modulus, size);
+    if(simd_level >= SIMD_LEVEL_AVX2) return mod_add_avx2(res, op1, op2, nullptr, modulus, size);
+#endif
+    mod_add_scalar_impl(res, op1, op2, modulus, size);
+}
+
+void mod_sub(uint64_t* res, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
+#ifdef MOD_KERNELS_X86
+    if(simd_level >= SIMD_LEVEL_AVX512) return mod_sub_avx512(res, op1, op2, nullptr, modulus, size);
+    if(simd_level >= SIMD_LEVEL_AVX2) return mod_sub_avx2(res, op1, op2, nullptr, modulus, size);
+#endif
+    mod_sub_scalar_impl(res, op1, op2, modulus, size);
+}
+
+void mod_add_scalar(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+#ifdef MOD_KERNELS_X86
+    if(simd_level >= SIMD_LEVEL_AVX512) return mod_add_avx512(res, op1, nullptr, &scalar, modulus, size);
+    if(simd_level >= SIMD_LEVEL_AVX2) return mod_add_avx2(res, op1, nullptr, &scalar, modulus, size);
+#endif
+    mod_add_const_scalar_impl(res, op1, scalar, modulus, size);
+}
+
+void mod_sub_scalar(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+#ifdef MOD_KERNELS_X86
+    if(simd_level >= SIMD_LEVEL_AVX512) return mod_sub_avx512(res, op1, nullptr, &scalar, modulus, size);
+    if(simd_level >= SIMD_LEVEL_AVX2) return mod_sub_avx2(res, op1, nullptr, &scalar, modulus, size);
+#endif
+    mod_sub_const_scalar_impl(res, op1, scalar, modulus, size);
+}
+
+void mod_mul_scalar(uint64_t* res, const uint64_t* op1, uint64_t scalar, uint64_t modulus, size_t size) {
+    scalar = scalar >= modulus ? scalar % modulus : scalar;
+#ifdef MOD_KERNELS_X86
+    if(simd_level >= SIMD_LEVEL_AVX512IFMA && modulus < SIMD_IFMA_MAX_MODULUS)
+        return mod_mul_scalar_ifma(res, op1, scalar, modulus, size);
+    if(simd_level >= SIMD_LEVEL_AVX512) return mod_mul_scalar_avx512(res, op1, scalar, modulus, size);
+#endif
+    mod_mul_const_scalar_impl(res, op1, scalar, modulus, size);
+}
+
+void bconv_mac(uint64_t* acc, const uint64_t* data, size_t size, uint64_t halfQ, uint64_t diff, uint64_t nm,
+               uint64_t scalar, uint64_t modulus) {
+    scalar = scalar >= nm ? scalar % nm : scalar;
+#ifdef MOD_KERNELS_X86
+    /* source values (< 2 * halfQ + 2) plus diff must stay below 2^52 */
+    if(simd_level >= SIMD_LEVEL_AVX512IFMA && nm < SIMD_IFMA_MAX_MODULUS && modulus < SIMD_IFMA_MAX_MODULUS &&
+       halfQ < SIMD_IFMA_MAX_MODULUS && diff < SIMD_IFMA_MAX_MODULUS)
+        return bconv_mac_ifma(acc, data, size, halfQ, diff, nm, scalar, modulus);
+    if(simd_level >= SIMD_LEVEL_AVX512) return bconv_mac_avx512(acc, data, size, halfQ, diff, nm, scalar, modulus);
+#endif
+    bconv_mac_scalar_impl(acc, data, size, halfQ, diff, nm, scalar, modulus);
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "utils/multi_device.h"
+#include "utils/perf_counters.h"
+
+uint32_t num_devices = 1;
+uint32_t device_placement = DEVICE_PLACEMENT_LIMB;
+
+namespace {
+
+/* modulus -> device, set once per modulus and never changed (shadows keep the device they are made on) */
+std::shared_mutex placement_m;
+std::unordered_map<uint64_t, uint32_t> placement;
+uint32_t next_position = 0; // position of the next modulus seen first (not registered)
+
+std::atomic<uint64_t> cnt_d2d[MAX_DEVICES][MAX_DEVICES];
+
+}  // namespace
+
+/* placement_m must be locked exclusively */
+static uint32_t place_modulus(uint64_t modulus, uint32_t device) {
+    auto it = placement.find(modulus);
+    if (it != placement.end()) return it->second;
+    placement[modulus] = device;
+    return device;
+}
+
+uint32_t device_of_modulus_slow(uint64_t modulus) {
+    if (modulus == 0) return 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(placement_m);
+        auto it = placement.find(modulus);
+        if (it != placement.end()) return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(placement_m);
+    if (placement.count(modulus)) return placement[modulus];
+    return place_modulus(modulus, next_position++ % num_devices);
+}
+
+void register_device_moduli(const std::vector<uint64_t>& moduli, uint32_t sizeQ, uint32_t digit_limbs) {
+    if (num_devices <= 1) return;
+    std::unique_lock<std::shared_mutex> lock(placement_m);
+    if (digit_limbs == 0) digit_limbs = 1;
+    for (uint32_t i = 0; i < moduli.size(); i++) {
+        uint32_t device;
+        if (device_placement == DEVICE_PLACEMENT_DIGIT && i < sizeQ)
+            device = (i / digit_limbs) % num_devices;
+        else if (device_placement == DEVICE_PLACEMENT_DIGIT)
+            device = (i - sizeQ) % num_devices;
+        else
+            device = i % num_devices;
+        place_modulus(moduli[i], device);
+    }
+    if (next_position < moduli.size()) next_position = moduli.size();
+}
+
+const char* device_placement_name(uint32_t policy) {
+    switch (policy) {
+        case DEVICE_PLACEMENT_LIMB: return "limb";
+        case DEVICE_PLACEMENT_DIGIT: return "digit";
+    }
+    return "unknown";
+}
+
+void inc_d2d_transfer(uint32_t src, uint32_t dst) {
+    cnt_d2d[src][dst].fetch_add(1, std::memory_order_relaxed);
+    perf_inc(PERF_CNT_D2D_TRANSFER);
+}
+
+void init_device_stat() {
+    for (auto& row : cnt_d2d)
+        for (auto& cnt : row)
+            cnt.store(0, std::memory_order_relaxed);
+}
+
+void print_device_stat() {
+    if (num_devices <= 1) return;
+    uint64_t limbs[MAX_DEVICES] = {0};
+    {
+        std::shared_lock<std::shared_mutex> lock(placement_m);
+        for (auto& p : placement)
+            limbs[p.second]++;
+    }
+    std::cout << "devices: " << num_devices << ", placement " << device_placement_name(device_placement) << std::endl;
+    uint64_t total = 0;
+    for (uint32_t d = 0; d < num_devices; d++) {
+        std::cout << "  device " << d << ": " << limbs[d] << " moduli, D2D in";
+        for (uint32_t s = 0; s < num_devices; s++) {
+            uint64_t n = cnt_d2d[s][d].load(std::memory_order_relaxed);
+            total += n;
+            std::cout << " " << n;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "  D2D transfers : " << total << std::endl;
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "utils/custom_task.h"
+#include "utils/perf_counters.h"
+
+static_assert(TASK_TYPE_MAX < PERF_TASK_TYPES, "PERF_TASK_TYPES must cover every task type");
+
+static const char* counter_names[PERF_CNT_NUM] = {
+    "copy_from_shadow",
+    "copy_from_shadow_ocb_real",
+    "copy_from_shadow_hbm_real",
+    "copy_from_root_shadow_hbm_real",
+    "copy_from_inv_root_shadow_hbm_real",
+    "copy_to_shadow",
+    "copy_to_root_shadow",
+    "copy_to_shadow_real",
+    "copy_to_shadow_real_evk",
+    "copy_from_other_shadow",
+    "copy_from_other_shadow1",
+    "copy_from_other_shadow2",
+    "copy_from_other_shadow3",
+    "copy_from_other_shadow4",
+    "create_shadow",
+    "discard_shadow",
+    "create_root_shadow",
+    "compute_implemented",
+    "compute_not_implemented",
+    "ntt",
+    "intt",
+    "auto",
+    "add",
+    "sub",
+    "mult",
+    "bconv_up",
+    "bconv_down",
+    "prng",
+    "prefetch_posted",
+    "prefetch_hit",
+    "prefetch_late",
+    "prefetch_wasted",
+    "prefetch_dropped",
+    "d2d_transfer",
+};
+
+namespace {
+
+/* counters of one thread, only the owner writes (relaxed load + store, no read-modify-write) */
+struct PerfBlock {
+    std::atomic<uint64_t> cnt[PERF_CNT_NUM];
+    std::atomic<uint64_t> task_ns[PERF_TASK_TYPES];
+    std::atomic<uint64_t> task_hist[PERF_TASK_TYPES][PERF_HIST_BUCKETS];
+
+    PerfBlock() {
+        clear();
+    }
+    void clear() {
+        for (auto& c : cnt) c.store(0, std::memory_order_relaxed);
+        for (auto& c : task_ns) c.store(0, std::memory_order_relaxed);
+        for (auto& row : task_hist)
+            for (auto& c : row) c.store(0, std::memory_order_relaxed);
+    }
+    void add_to(PerfSnapshot& snap) const {
+        for (uint32_t i = 0; i < PERF_CNT_NUM; i++) snap.cnt[i] += cnt[i].load(std::memory_order_relaxed);
+        for (uint32_t t = 0; t < PERF_TASK_TYPES; t++) {
+            snap.task_ns[t] += task_ns[t].load(std::memory_order_relaxed);
+            for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++)
+                snap.task_hist[t][b] += task_hist[t][b].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+static inline void bump(std::atomic<uint64_t>& c, uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/* blocks of the living threads, totals of the exited ones, base line of perf_reset.
+    Blocks are reused by later threads (never freed, other threads may be exiting while main exits) */
+struct PerfRegistry {
+    std::mutex m;
+    std::vector<PerfBlock*> live;
+    std::vector<PerfBlock*> free_blocks;
+    PerfSnapshot retired;
+    PerfSnapshot base;
+    std::map<std::string, PerfRegionStat> regions;
+};
+
+PerfRegistry& registry() {
+    static PerfRegistry* r = new PerfRegistry;
+    return *r;
+}
+
+struct LocalPerf {
+    PerfBlock* block = NULL;
+
+    struct Open {
+        std::string path;
+        PerfSnapshot start;
+        std::chrono::steady_clock::time_point start_time;
+    };
+    std::vector<Open> regions; // open regions of the thread, innermost last
+
+    PerfBlock& get() {
+        if (block) return *block;
+        PerfRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.m);
+        if (r.free_blocks.empty()) {
+            block = new PerfBlock;
+        }
+        else {
+            block = r.free_blocks.back();
+            r.free_blocks.pop_back();
+        }
+        r.live.push_back(block);
+        return *block;
+    }
+
+    ~LocalPerf() {
+        if (!block) return;
+        PerfRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.m);
+        block->add_to(r.retired);
+        block->clear();
+        for (size_t i = 0; i < r.live.size(); i++) {
+            if (r.live[i] == block) {
+                r.live[i] = r.live.back();
+                r.live.pop_back();
+                break;
+            }
+        }
+        r.free_blocks.push_back(block);
+        block = NULL;
+    }
+};
+
+thread_local LocalPerf local_perf;
+
+/* registry lock must be held */
+PerfSnapshot raw_snapshot_locked(PerfRegistry& r) {
+    PerfSnapshot snap = r.retired;
+    for (auto block : r.live) block->add_to(snap);
+    return snap;
+}
+
+}  // namespace
+
+uint64_t PerfSnapshot::tasks(uint32_t task_type) const {
+    uint64_t n = 0;
+    for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) n += task_hist[task_type][b];
+    return n;
+}
+
+PerfSnapshot& PerfSnapshot::operator+=(const PerfSnapshot& o) {
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) cnt[i] += o.cnt[i];
+    for (uint32_t t = 0; t < PERF_TASK_TYPES; t++) {
+        task_ns[t] += o.task_ns[t];
+        for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) task_hist[t][b] += o.task_hist[t][b];
+    }
+    return *this;
+}
+
+PerfSnapshot& PerfSnapshot::operator-=(const PerfSnapshot& o) {
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) cnt[i] -= o.cnt[i];
+    for (uint32_t t = 0; t < PERF_TASK_TYPES; t++) {
+        task_ns[t] -= o.task_ns[t];
+        for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) task_hist[t][b] -= o.task_hist[t][b];
+    }
+    return *this;
+}
+
+void perf_inc(uint32_t id, uint64_t n) {
+    bump(local_perf.get().cnt[id], n);
+}
+
+void perf_task_time(int task_type, uint64_t ns) {
+    if (task_type < 0 || task_type >= PERF_TASK_TYPES) return;
+    uint32_t bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (bucket >= PERF_HIST_BUCKETS) bucket = PERF_HIST_BUCKETS - 1;
+    PerfBlock& block = local_perf.get();
+    bump(block.task_ns[task_type], ns);
+    bump(block.task_hist[task_type][bucket], 1);
+}
+
+PerfSnapshot perf_snapshot() {
+    PerfRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    return raw_snapshot_locked(r) - r.base;
+}
+
+void perf_reset() {
+    PerfRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    r.base = raw_snapshot_locked(r);
+    r.regions.clear();
+}
+
+const char* perf_counter_name(uint32_t id) {
+    return id < PERF_CNT_NUM ? counter_names[id] : "unknown";
+}
+
+int perf_counter_id(const char* name) {
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+        if (strcmp(name, counter_names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+void perf_region_begin(const char* name) {
+    LocalPerf& local = local_perf;
+    LocalPerf::Open open;
+    open.path = local.regions.empty() ? std::string(name) : local.regions.back().path + "/" + name;
+    open.start = perf_snapshot();
+    open.start_time = std::chrono::steady_clock::now();
+    local.regions.push_back(std::move(open));
+}
+
+void perf_region_end() {
+    LocalPerf& local = local_perf;
+    if (local.regions.empty()) return;
+    LocalPerf::Open& open = local.regions.back();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - open.start_time;
+
+    PerfRegistry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.m);
+        PerfSnapshot delta = raw_snapshot_locked(r) - r.base - open.start;
+        PerfRegionStat& stat = r.regions[open.path];
+        stat.name = open.path;
+        stat.calls++;
+        stat.elapsed_ms += elapsed.count();
+        stat.delta += delta;
+    }
+    local.regions.pop_back();
+}
+
+std::vector<PerfRegionStat> perf_regions() {
+    PerfRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    std::vector<PerfRegionStat> out;
+    for (auto& p : r.regions) out.push_back(p.second);
+    return out;
+}
+
+void perf_print_counters(std::ostream& out, const PerfSnapshot& snap, bool all) {
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+        if (all || snap.cnt[i]) out << "  " << counter_names[i] << ": " << snap.cnt[i] << std::endl;
+    }
+}
+
+void perf_print_tasks(std::ostream& out, const PerfSnapshot& snap) {
+    for (uint32_t t = 0; t < PERF_TASK_TYPES; t++) {
+        uint64_t n = snap.tasks(t);
+        if (!n) continue;
+        out << "  type" << t << ": " << n << " tasks, avg " << snap.task_ns[t] / n << " ns, log2(ns)";
+        for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+            if (snap.task_hist[t][b]) out << " " << b << ":" << snap.task_hist[t][b];
+        }
+        out << std::endl;
+    }
+}
+
+void perf_print_regions(std::ostream& out) {
+    for (auto& region : perf_regions()) {
+        out << "  region " << region.name << ": " << region.calls << " calls, " << region.elapsed_ms << " ms,";
+        for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+            if (region.delta.cnt[i]) out << " " << counter_names[i] << " " << region.delta.cnt[i];
+        }
+        out << std::endl;
+    }
+}
+
+static void write_json_counters(std::ostream& out, const PerfSnapshot& snap) {
+    out << "{";
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+        out << (i ? ", " : "") << "\"" << counter_names[i] << "\": " << snap.cnt[i];
+    }
+    out << "}";
+}
+
+bool perf_write_json(const char* path, const PerfSnapshot& snap) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    out << "{\n  \"counters\": ";
+    write_json_counters(out, snap);
+    out << ",\n  \"tasks\": {";
+    bool first = true;
+    for (uint32_t t = 0; t < PERF_TASK_TYPES; t++) {
+        uint64_t n = snap.tasks(t);
+        if (!n) continue;
+        out << (first ? "\n" : ",\n") << "    \"type" << t << "\": {\"count\": " << n << ", \"total_ns\": " << snap.task_ns[t]
+            << ", \"hist\": [";
+        for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) out << (b ? ", " : "") << snap.task_hist[t][b];
+        out << "]}";
+        first = false;
+    }
+    out << (first ? "}" : "\n  }") << ",\n  \"regions\": [";
+    first = true;
+    for (auto& region : perf_regions()) {
+        out << (first ? "\n" : ",\n") << "    {\"name\": \"" << region.name << "\", \"calls\": " << region.calls
+            << ", \"elapsed_ms\": " << region.elapsed_ms << ", \"counters\": ";
+        write_json_counters(out, region.delta);
+        out << "}";
+        first = false;
+    }
+    out << (first ? "]" : "\n  ]") << "\n}\n";
+    return out.good();
+}
+
+bool perf_write_csv(const char* path, const PerfSnapshot& snap) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    out << "section,name,key,value\n";
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) out << "counter,," << counter_names[i] << "," << snap.cnt[i] << "\n";
+    for (uint32_t t = 0; t < PERF_TASK_TYPES; t++) {
+        uint64_t n = snap.tasks(t);
+        if (!n) continue;
+        out << "task,type" << t << ",count," << n << "\n";
+        out << "task,type" << t << ",total_ns," << snap.task_ns[t] << "\n";
+        for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+            if (snap.task_hist[t][b]) out << "task,type" << t << ",hist" << b << "," << snap.task_hist[t][b] << "\n";
+        }
+    }
+    for (auto& region : perf_regions()) {
+        out << "region," << region.name << ",calls," << region.calls << "\n";
+        out << "region," << region.name << ",elapsed_ms," << region.elapsed_ms << "\n";
+        for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+            if (region.delta.cnt[i]) out << "region," << region.name << "," << counter_names[i] << "," << region.delta.cnt[i] << "\n";
+        }
+    }
+    return out.good();
+}
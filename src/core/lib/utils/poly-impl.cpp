@@ -22,89 +22,32 @@
 
 #include <iostream>
 #include "math/hal/basicint.h"
+#include "utils/mod_kernels.h"
+#include "utils/prng/blake2engine.h"
 
-extern void divide_uint192_inplace(uint64_t *numerator, uint64_t denominator, uint64_t *quotient);
-
+/* scalar multiplications are Shoup multiplications of utils/mod_kernels.h (SIMD when the CPU has it) */
 void PlainModMulScalar(uint64_t* res, const uint64_t* op1, uint64_t modulus, uint64_t scalar, size_t size) {
-    uint64_t numerator[3]{ 0, 0, 1 };
-    uint64_t quotient[3]{ 0, 0, 0 };
-    divide_uint192_inplace(numerator, modulus, quotient);
-    uint64_t pq0 = quotient[0];
-    uint64_t pq1 = quotient[1];
-    
-    scalar = scalar >= modulus ? scalar % modulus : scalar;
-    
-    for(size_t i=0; i<size; i++){
-        const uint64_t x = op1[i];
-        unsigned long long z[2];
-
-        uint128_t product = static_cast<unsigned uint128_t>(x) * scalar;
-        z[0] = static_cast<unsigned long long>(product);                        
-        z[1] = static_cast<unsigned long long>(product >> 64);
-
-        unsigned long long tmp1, tmp2[2], tmp3, carry;
-
-        // Multiply input and const_ratio
-        // Round 1
-        // multiply_uint64_hw64(z[0], pq0, &carry);
-        carry = static_cast<unsigned long long>(                                        
-        ((static_cast<uint128_t>(z[0])                              
-        * static_cast<uint128_t>(pq0)) >> 64));                    
-
-        // multiply_uint64(z[0], pq1, tmp2);
-        product = static_cast<uint128_t>(z[0]) * pq1;
-        tmp2[0] = static_cast<unsigned long long>(product);                        
-        tmp2[1] = static_cast<unsigned long long>(product >> 64);
-
-        // tmp3 = tmp2[1] + add_uint64(tmp2[0], carry, &tmp1);
-        tmp1 = tmp2[0] + carry;
-        tmp3 = tmp2[1] + static_cast<unsigned char>(tmp1 < tmp2[0]);
-
-        // Round 2
-        // multiply_uint64(z[1], pq0, tmp2);
-        product = static_cast<uint128_t>(z[1]) * pq0;
-        tmp2[0] = static_cast<unsigned long long>(product);                        
-        tmp2[1] = static_cast<unsigned long long>(product >> 64);
-
-        // carry = tmp2[1] + add_uint64(tmp1, tmp2[0], &tmp1);
-        tmp1 = tmp1 + tmp2[0];
-        carry = tmp2[1] + static_cast<unsigned char>(tmp1 < tmp2[0]);
-
-        // This is all we care about
-        tmp1 = z[1] * pq1 + tmp3 + carry;
-
-        // Barrett subtraction
-        tmp3 = z[0] - tmp1 * modulus;
-
-        // One more subtraction is enough
-        res[i] = tmp3 >= modulus ? tmp3 - modulus : tmp3;
-    }
+    mod_mul_scalar(res, op1, scalar, modulus, size);
 }
 
-void PlainModMulEqScalar_one(uint64_t* op1, uint64_t modulus, uint64_t scalar, uint64_t pq0, uint64_t pq1) {
-    // uint64_t numerator[3]{ 0, 0, 1 };
-    // uint64_t quotient[3]{ 0, 0, 0 };
-    // divide_uint192_inplace(numerator, modulus, quotient);
-    // uint64_t pq0 = quotient[0];
-    // uint64_t pq1 = quotient[1];
-
-    scalar = scalar >= modulus ? scalar % modulus : scalar;
-
-    const uint64_t x = op1[0];
-    unsigned long long z[2];
+void PlainModMulEqScalar(uint64_t* op1, uint64_t modulus, uint64_t scalar, size_t size) {
+    mod_mul_scalar(op1, op1, scalar, modulus, size);
+}
 
-    uint128_t product = static_cast<uint128_t>(x) * scalar;
+/* 128-bit product reduced by base 2^64 Barrett reduction (SEAL), pq0/pq1 : floor(2^128 / modulus) */
+static inline uint64_t barrett_mul(uint64_t x, uint64_t y, uint64_t pq0, uint64_t pq1, uint64_t modulus) {
+    unsigned long long z[2], tmp1, tmp2[2], tmp3, carry;
+    // multiply_uint64(x, y, z);
+    uint128_t product = static_cast<uint128_t>(x) * y;
     z[0] = static_cast<unsigned long long>(product);                        
     z[1] = static_cast<unsigned long long>(product >> 64);
 
-    unsigned long long tmp1, tmp2[2], tmp3, carry;
-
     // Multiply input and const_ratio
     // Round 1
     // multiply_uint64_hw64(z[0], pq0, &carry);
     carry = static_cast<unsigned long long>(                                        
     ((static_cast<uint128_t>(z[0])                              
-    * static_cast<uint128_t>(pq0)) >> 64));                    
+    * static_cast<uint128_t>(pq0)) >> 64));  
 
     // multiply_uint64(z[0], pq1, tmp2);
     product = static_cast<uint128_t>(z[0]) * pq1;
@@ -131,115 +74,44 @@ void PlainModMulEqScalar_one(uint64_t* op1, uint64_t modulus, uint64_t scalar, u
     // Barrett subtraction
     tmp3 = z[0] - tmp1 * modulus;
 
-    // One more subtraction is enough
-    op1[0] = tmp3 >= modulus ? tmp3 - modulus : tmp3;
-    
+    // Claim: One more subtraction is enough
+    return tmp3 >= modulus? tmp3 - modulus: tmp3;
 }
 
-void PlainModMulEqScalar(uint64_t* op1, uint64_t modulus, uint64_t scalar, size_t size) {
-    uint64_t numerator[3]{ 0, 0, 1 };
-    uint64_t quotient[3]{ 0, 0, 0 };
-    divide_uint192_inplace(numerator, modulus, quotient);
-    uint64_t pq0 = quotient[0];
-    uint64_t pq1 = quotient[1];
-
-    scalar = scalar >= modulus ? scalar % modulus : scalar;
-
-    for(size_t i=0; i<size; i++){
-        const uint64_t x = op1[i];
-        unsigned long long z[2];
-
-        uint128_t product = static_cast<uint128_t>(x) * scalar;
-        z[0] = static_cast<unsigned long long>(product);                        
-        z[1] = static_cast<unsigned long long>(product >> 64);
-
-        unsigned long long tmp1, tmp2[2], tmp3, carry;
-
-        // Multiply input and const_ratio
-        // Round 1
-        // multiply_uint64_hw64(z[0], pq0, &carry);
-        carry = static_cast<unsigned long long>(                                        
-        ((static_cast<uint128_t>(z[0])                              
-        * static_cast<uint128_t>(pq0)) >> 64));                    
-
-        // multiply_uint64(z[0], pq1, tmp2);
-        product = static_cast<uint128_t>(z[0]) * pq1;
-        tmp2[0] = static_cast<unsigned long long>(product);                        
-        tmp2[1] = static_cast<unsigned long long>(product >> 64);
-
-        // tmp3 = tmp2[1] + add_uint64(tmp2[0], carry, &tmp1);
-        tmp1 = tmp2[0] + carry;
-        tmp3 = tmp2[1] + static_cast<unsigned char>(tmp1 < tmp2[0]);
-
-        // Round 2
-        // multiply_uint64(z[1], pq0, tmp2);
-        product = static_cast<uint128_t>(z[1]) * pq0;
-        tmp2[0] = static_cast<unsigned long long>(product);                        
-        tmp2[1] = static_cast<unsigned long long>(product >> 64);
-
-        // carry = tmp2[1] + add_uint64(tmp1, tmp2[0], &tmp1);
-        tmp1 = tmp1 + tmp2[0];
-        carry = tmp2[1] + static_cast<unsigned char>(tmp1 < tmp2[0]);
+void PlainModMul(uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
+    const ModConst& mc = mod_const(modulus); // Barrett constant is computed once per modulus
 
-        // This is all we care about
-        tmp1 = z[1] * pq1 + tmp3 + carry;
+    for(size_t i=0; i<size; i++){ // SEAL_ITERATE(iter(operand1, operand2, result), coeff_count, [&](auto I)
+        op1[i] = barrett_mul(op1[i], op2[i], mc.pq0, mc.pq1, modulus);
+    }
+}
 
-        // Barrett subtraction
-        tmp3 = z[0] - tmp1 * modulus;
+/* acc += op1 * op2 (TASK_TYPE_MulAddInPlace, TASK_TYPE_MulAddDual), the product never leaves the register */
+void PlainModMulAdd(uint64_t* acc, const uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
+    const ModConst& mc = mod_const(modulus);
 
-        // One more subtraction is enough
-        op1[i] = tmp3 >= modulus ? tmp3 - modulus : tmp3;
+    for(size_t i=0; i<size; i++){
+        uint64_t sum = acc[i] + barrett_mul(op1[i], op2[i], mc.pq0, mc.pq1, modulus);
+        acc[i] = sum >= modulus ? sum - modulus : sum;
     }
 }
 
-void PlainModMul(uint64_t* op1, const uint64_t* op2, uint64_t modulus, size_t size) {
-    uint64_t numerator[3]{ 0, 0, 1 };
-    uint64_t quotient[3]{ 0, 0, 0 };
-    divide_uint192_inplace(numerator, modulus, quotient);
-    uint64_t pq0 = quotient[0];
-    uint64_t pq1 = quotient[1];
-
-    for(size_t i=0; i<size; i++){ // SEAL_ITERATE(iter(operand1, operand2, result), coeff_count, [&](auto I)
-        // Reduces z using base 2^64 Barrett reduction
-        unsigned long long z[2], tmp1, tmp2[2], tmp3, carry;
-        // multiply_uint64(get<0>(I), get<1>(I), z);
-        uint128_t product = static_cast<uint128_t>(op1[i]) * op2[i];
-        z[0] = static_cast<unsigned long long>(product);                        
-        z[1] = static_cast<unsigned long long>(product >> 64);
-
-        // Multiply input and const_ratio
-        // Round 1
-        // multiply_uint64_hw64(z[0], pq0, &carry);
-        carry = static_cast<unsigned long long>(                                        
-        ((static_cast<uint128_t>(z[0])                              
-        * static_cast<uint128_t>(pq0)) >> 64));  
-
-        // multiply_uint64(z[0], pq1, tmp2);
-        product = static_cast<uint128_t>(z[0]) * pq1;
-        tmp2[0] = static_cast<unsigned long long>(product);                        
-        tmp2[1] = static_cast<unsigned long long>(product >> 64);
-
-        // tmp3 = tmp2[1] + add_uint64(tmp2[0], carry, &tmp1);
-        tmp1 = tmp2[0] + carry;
-        tmp3 = tmp2[1] + static_cast<unsigned char>(tmp1 < tmp2[0]);
-
-        // Round 2
-        // multiply_uint64(z[1], pq0, tmp2);
-        product = static_cast<uint128_t>(z[1]) * pq0;
-        tmp2[0] = static_cast<unsigned long long>(product);                        
-        tmp2[1] = static_cast<unsigned long long>(product >> 64);
-
-        // carry = tmp2[1] + add_uint64(tmp1, tmp2[0], &tmp1);
-        tmp1 = tmp1 + tmp2[0];
-        carry = tmp2[1] + static_cast<unsigned char>(tmp1 < tmp2[0]);
-
-        // This is all we care about
-        tmp1 = z[1] * pq1 + tmp3 + carry;
-
-        // Barrett subtraction
-        tmp3 = z[0] - tmp1 * modulus;
-
-        // Claim: One more subtraction is enough
-        op1[i] = tmp3 >= modulus? tmp3 - modulus: tmp3;
+/* res = uniform limb mod modulus expanded from a seed (TASK_TYPE_SeededUniform, seeded evaluation key)
+    seed : 16 words of BLAKE2 seed, stream : which limb of which key part (different stream, different limb)
+    two 32-bit outputs make one candidate, candidates >= modulus are rejected, so the limb is same for same seed */
+void PlainSeededUniform(uint64_t* res, const uint32_t* seed, uint64_t stream, uint64_t modulus, size_t size) {
+    std::array<uint32_t, 16> key;
+    for(size_t i=0; i<16; i++) key[i] = seed[i];
+    key[14] ^= (uint32_t)(stream >> 32);
+    key[15] ^= (uint32_t)stream;
+    lbcrypto::Blake2Engine engine(key, 0);
+
+    uint64_t mask = (modulus & (modulus - 1)) ? (~0ULL >> __builtin_clzll(modulus)) : modulus - 1;
+    for(size_t i=0; i<size; i++){
+        uint64_t v;
+        do {
+            v = (((uint64_t)engine() << 32) | engine()) & mask;
+        } while(v >= modulus);
+        res[i] = v;
     }
-}
\ No newline at end of file
+}
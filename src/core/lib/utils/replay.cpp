@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <utility>
+
+#include "utils/replay.h"
+
+ReplayConfig::ReplayConfig() {
+    for (uint32_t i = 0; i <= REPLAY_OP_MAX; i++)
+        compute_ns[i] = 0;
+    compute_ns[TRACE_OP_NTT]       = 3454 / 0.45;
+    compute_ns[TRACE_OP_INTT]      = 3343 / 0.45;
+    compute_ns[TRACE_OP_AUTO]      = 2578 / 0.45;
+    compute_ns[TRACE_OP_ADD]       = 149 / 0.45;
+    compute_ns[TRACE_OP_MULT]      = 233 / 0.45;
+    compute_ns[TRACE_OP_SUB]       = 146 / 0.45;
+    compute_ns[TRACE_OP_BCONVUP]   = 275 / 0.45;
+    compute_ns[TRACE_OP_BCONVDOWN] = 359 / 0.45;
+    compute_ns[TRACE_OP_PRNG]      = 149 / 0.45;  // one streaming pass like add
+
+    for (uint32_t i = 0; i < REPLAY_RES_NUM; i++) {
+        link_gbps[i]       = 0;
+        link_latency_ns[i] = 0;
+    }
+    link_gbps[REPLAY_RES_PCIE] = ref_poly_bytes / 7934.49;  // pcie 5.0 x16
+    link_gbps[REPLAY_RES_HBM]  = ref_poly_bytes / 1086.95;  // 460000 MB/s
+    link_gbps[REPLAY_RES_SRAM] = ref_poly_bytes / 271.22;   // 1843488 MB/s
+    link_gbps[REPLAY_RES_D2D]  = ref_poly_bytes / 7934.49;  // peer-to-peer over pcie
+}
+
+bool ReplayConfig::set(const std::string& key, double value) {
+    static const std::pair<const char*, uint32_t> compute_keys[] = {
+        {"ntt_time", TRACE_OP_NTT}, {"intt_time", TRACE_OP_INTT}, {"auto_time", TRACE_OP_AUTO},
+        {"add_time", TRACE_OP_ADD}, {"mult_time", TRACE_OP_MULT}, {"sub_time", TRACE_OP_SUB},
+        {"bconv_up_time", TRACE_OP_BCONVUP}, {"bconv_down_time", TRACE_OP_BCONVDOWN}, {"prng_time", TRACE_OP_PRNG}};
+    static const std::pair<const char*, uint32_t> link_keys[] = {
+        {"pcie", REPLAY_RES_PCIE}, {"hbm", REPLAY_RES_HBM}, {"sram", REPLAY_RES_SRAM}, {"d2d", REPLAY_RES_D2D}};
+
+    for (auto& k : compute_keys) {
+        if (key == k.first) {
+            compute_ns[k.second] = value;
+            return true;
+        }
+    }
+    for (auto& k : link_keys) {
+        std::string name(k.first);
+        if (key == name + "_time") {  // per-poly time of replay.py
+            if (value <= 0) return false;
+            link_gbps[k.second] = ref_poly_bytes / value;
+            return true;
+        }
+        if (key == name + "_bw") {
+            if (value <= 0) return false;
+            link_gbps[k.second] = value;
+            return true;
+        }
+        if (key == name + "_latency") {
+            link_latency_ns[k.second] = value;
+            return true;
+        }
+    }
+    if (key == "ref_poly_bytes") {
+        if (value <= 0) return false;
+        ref_poly_bytes = value;
+        return true;
+    }
+    if (key == "sram_on_hbm") {
+        sram_on_hbm = value != 0;
+        return true;
+    }
+    if (key == "reorder") {
+        reorder = value != 0;
+        return true;
+    }
+    if (key == "max_gaps") {
+        max_gaps = (uint32_t)value;
+        return true;
+    }
+    return false;
+}
+
+bool ReplayConfig::load(const char* path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    std::string line;
+    uint32_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                std::cerr << path << ":" << line_no << ": expected key = value" << std::endl;
+            continue;
+        }
+        std::string key = line.substr(0, eq);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t\r") + 1);
+        if (!set(key, atof(line.c_str() + eq + 1))) {
+            std::cerr << path << ":" << line_no << ": unknown or invalid key " << key << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* replay_resource_name(uint32_t res) {
+    switch (res) {
+        case REPLAY_RES_COMPUTE: return "compute";
+        case REPLAY_RES_PCIE: return "PCIe";
+        case REPLAY_RES_HBM: return "HBM";
+        case REPLAY_RES_SRAM: return "SRAM";
+        case REPLAY_RES_D2D: return "D2D";
+    }
+    return "unknown";
+}
+
+TraceReplay::TraceReplay(const ReplayConfig& _config) : config(_config) {
+    table.assign(1 << 16, BufferState{0, 0, 0});
+
+    /* gaps shorter than the shortest record of the resource can not be filled */
+    double min_compute = 0;
+    for (uint32_t i = 1; i <= REPLAY_OP_MAX; i++) {
+        if (config.compute_ns[i] > 0 && (min_compute == 0 || config.compute_ns[i] < min_compute))
+            min_compute = config.compute_ns[i];
+    }
+    for (uint32_t d = 0; d < MAX_DEVICES; d++) {
+        resources[d][REPLAY_RES_COMPUTE].min_gap = min_compute;
+        for (uint32_t r = REPLAY_RES_PCIE; r < REPLAY_RES_NUM; r++) {
+            resources[d][r].min_gap = config.link_latency_ns[r] + config.ref_poly_bytes / config.link_gbps[r];
+        }
+        if (config.sram_on_hbm)
+            resources[d][REPLAY_RES_HBM].min_gap =
+                std::min(resources[d][REPLAY_RES_HBM].min_gap, resources[d][REPLAY_RES_SRAM].min_gap);
+    }
+}
+
+TraceReplay::BufferState* TraceReplay::find(uint64_t addr) {
+    uint64_t mask = table.size() - 1;
+    uint64_t i    = ((addr >> 3) * 0x9E3779B97F4A7C15ULL) >> 20;
+    while (1) {
+        BufferState& s = table[i & mask];
+        if (s.addr == addr) return &s;
+        if (s.addr == 0) {
+            s.addr = addr;
+            table_used++;
+            return &s;
+        }
+        i++;
+    }
+}
+
+void TraceReplay::grow() {
+    std::vector<BufferState> old;
+    old.swap(table);
+    table.assign(old.size() * 2, BufferState{0, 0, 0});
+    table_used = 0;
+    for (auto& s : old) {
+        if (s.addr) *find(s.addr) = s;
+    }
+}
+
+double TraceReplay::duration(const TraceRecord& rec, uint32_t& res) const {
+    if (rec.kind == TRACE_KIND_COMPUTE) {
+        res = REPLAY_RES_COMPUTE;
+        return rec.op <= REPLAY_OP_MAX ? config.compute_ns[rec.op] : 0;
+    }
+
+    uint32_t link = REPLAY_RES_PCIE;
+    if (rec.op == TRACE_LINK_HBM) link = REPLAY_RES_HBM;
+    if (rec.op == TRACE_LINK_SRAM) link = REPLAY_RES_SRAM;
+    if (rec.op == TRACE_LINK_D2D) link = REPLAY_RES_D2D;
+    res = (link == REPLAY_RES_SRAM && config.sram_on_hbm) ? REPLAY_RES_HBM : link;
+
+    double bytes = rec.bytes ? rec.bytes : config.ref_poly_bytes;
+    return config.link_latency_ns[link] + bytes / config.link_gbps[link];
+}
+
+/* Find the start time of a record which is ready at 'ready'.
+    reorder : earliest idle gap that fits, otherwise the end of the resource */
+double TraceReplay::schedule(Resource& res, double ready, double dur) {
+    if (config.reorder && !res.gaps.empty()) {
+        uint32_t scanned = 0;
+        for (auto it = res.gaps.upper_bound(ready); it != res.gaps.end() && scanned < REPLAY_GAP_SCAN; ++it, scanned++) {
+            double gap_end   = it->first;
+            double gap_start = it->second;
+            double start     = std::max(gap_start, ready);
+            if (start + dur > gap_end) continue;
+
+            res.gaps.erase(it);
+            if (start - gap_start >= res.min_gap) res.gaps[start] = gap_start;            // front
+            if (gap_end - (start + dur) >= res.min_gap) res.gaps[gap_end] = start + dur;  // back
+            while (res.gaps.size() > config.max_gaps)
+                res.gaps.erase(res.gaps.begin());
+            return start;
+        }
+    }
+
+    double start = std::max(res.frontier, ready);
+    if (config.reorder && start - res.frontier >= res.min_gap) {
+        res.gaps[start] = res.frontier;
+        while (res.gaps.size() > config.max_gaps)
+            res.gaps.erase(res.gaps.begin());
+    }
+    res.frontier = start + dur;
+    return start;
+}
+
+void TraceReplay::step(const TraceRecord& rec) {
+    if ((table_used + 3) * 2 > table.size()) grow();
+
+    uint32_t r;
+    double dur = duration(rec, r);
+    uint32_t device = rec.device < MAX_DEVICES ? rec.device : 0;
+    if (device >= totals.devices) totals.devices = device + 1;
+    Resource& res = resources[r == REPLAY_RES_D2D ? 0 : device][r];  // one D2D link for all devices
+
+    uint32_t num_bufs = (rec.kind == TRACE_KIND_COMPUTE) ? 3 : 2;
+    BufferState* bufs[3];
+    uint32_t n     = 0;
+    double ready   = 0;
+    double cp      = 0;
+    for (uint32_t i = 0; i < num_bufs; i++) {
+        if (rec.buf[i] == 0) continue;
+        bufs[n] = find(rec.buf[i]);
+        ready   = std::max(ready, bufs[n]->ready_ns);
+        cp      = std::max(cp, bufs[n]->cp_ns);
+        n++;
+    }
+
+    double frontier = res.frontier;
+    double start    = schedule(res, ready, dur);
+    double end      = start + dur;
+
+    if (start < frontier) {
+        // filled an idle gap counted before
+        res.stat.data_stall_ns -= dur;
+        res.stat.resource_stall_ns += start - ready;
+    }
+    else if (ready > frontier) {
+        res.stat.data_stall_ns += ready - frontier;
+    }
+    else {
+        res.stat.resource_stall_ns += start - ready;
+    }
+    res.stat.ops++;
+    res.stat.busy_ns += dur;
+    res.stat.end_ns = std::max(res.stat.end_ns, end);
+
+    cp += dur;
+    for (uint32_t i = 0; i < n; i++) {
+        bufs[i]->ready_ns = end;
+        bufs[i]->cp_ns    = cp;
+    }
+
+    totals.records++;
+    if (rec.kind == TRACE_KIND_COMPUTE)
+        totals.compute_records++;
+    else
+        totals.data_records++;
+    totals.makespan_ns      = std::max(totals.makespan_ns, end);
+    totals.critical_path_ns = std::max(totals.critical_path_ns, cp);
+}
+
+ReplayResult TraceReplay::result() const {
+    ReplayResult result = totals;
+    for (uint32_t d = 0; d < result.devices; d++) {
+        for (uint32_t r = 0; r < REPLAY_RES_NUM; r++) {
+            const ReplayResourceStat& s = resources[d][r].stat;
+            result.device_res[d][r]     = s;
+            result.res[r].ops += s.ops;
+            result.res[r].busy_ns += s.busy_ns;
+            result.res[r].end_ns = std::max(result.res[r].end_ns, s.end_ns);
+            result.res[r].data_stall_ns += s.data_stall_ns;
+            result.res[r].resource_stall_ns += s.resource_stall_ns;
+        }
+    }
+    return result;
+}
+
+bool TraceReplay::replay_file(const char* path) {
+    char magic[8] = {0};
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "replay: cannot open " << path << std::endl;
+        return false;
+    }
+    in.read(magic, sizeof(magic));
+    in.close();
+    if (::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        num_streams = 1;
+        return replay_csv(path);
+    }
+
+    /* streams of the other devices (commandrecord.dev<d>.bin) of a multi-device trace */
+    std::vector<std::string> paths(1, path);
+    for (uint32_t d = 1; d < MAX_DEVICES; d++) {
+        std::string dev_path = trace_device_path(path, d);
+        struct stat st;
+        if (::stat(dev_path.c_str(), &st) == 0) paths.push_back(dev_path);
+    }
+    return replay_streams(paths);
+}
+
+namespace {
+
+struct TraceStream {
+    void* map;
+    size_t size;
+    const TraceRecord* records;
+    uint64_t num_records;
+    uint64_t pos;
+};
+
+bool map_stream(const char* path, TraceStream& stream) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "replay: cannot open " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    const TraceFileHeader* header = (const TraceFileHeader*)map;
+    if (::memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->record_size != sizeof(TraceRecord)) {
+        std::cerr << "replay: " << path << " is not a trace with records of " << sizeof(TraceRecord) << " bytes"
+                  << std::endl;
+        munmap(map, st.st_size);
+        return false;
+    }
+    stream.map         = map;
+    stream.size        = st.st_size;
+    stream.records     = (const TraceRecord*)((const char*)map + sizeof(TraceFileHeader));
+    stream.num_records = (st.st_size - sizeof(TraceFileHeader)) / sizeof(TraceRecord);
+    stream.pos         = 0;
+    return true;
+}
+
+}  // namespace
+
+/* Records of a thread buffer are written together, so a stream is in seq order only per thread,
+    and seq is global over the devices, so a stream alone has holes for the records of the other devices.
+    The next record is taken from the stream with the lowest seq at its position and held in a heap until
+    its seq comes. A seq missing for REPLAY_REORDER_WINDOW records was lost (dropped at exit, stream missing),
+    the replay goes on from the lowest seq held, so the heap stays bounded. */
+bool TraceReplay::replay_streams(const std::vector<std::string>& paths) {
+    std::vector<TraceStream> streams(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!map_stream(paths[i].c_str(), streams[i])) {
+            for (size_t j = 0; j < i; j++)
+                munmap(streams[j].map, streams[j].size);
+            return false;
+        }
+    }
+    num_streams = paths.size();
+
+    typedef std::pair<uint64_t, uint32_t> SeqStream;  // seq at the position, stream
+    std::priority_queue<SeqStream, std::vector<SeqStream>, std::greater<SeqStream>> cursors;
+    uint64_t next_seq = UINT64_MAX;
+    for (uint32_t i = 0; i < streams.size(); i++) {
+        const TraceStream& stream = streams[i];
+        for (uint64_t r = 0; r < stream.num_records; r++)
+            next_seq = std::min(next_seq, stream.records[r].seq);
+        if (stream.num_records) cursors.push(SeqStream(stream.records[0].seq, i));
+    }
+
+    typedef std::pair<uint64_t, const TraceRecord*> SeqRecord;
+    std::priority_queue<SeqRecord, std::vector<SeqRecord>, std::greater<SeqRecord>> pending;
+    while (!cursors.empty()) {
+        uint32_t i = cursors.top().second;
+        cursors.pop();
+        TraceStream& stream    = streams[i];
+        const TraceRecord& rec = stream.records[stream.pos++];
+        if (stream.pos < stream.num_records) cursors.push(SeqStream(stream.records[stream.pos].seq, i));
+
+        if (rec.seq == next_seq && pending.empty()) {
+            step(rec);
+            next_seq++;
+            continue;
+        }
+        pending.push(SeqRecord(rec.seq, &rec));
+        if (pending.size() > REPLAY_REORDER_WINDOW) next_seq = std::max(next_seq, pending.top().first);
+        // seq below next_seq : record came after its seq was taken as lost
+        while (!pending.empty() && pending.top().first <= next_seq) {
+            step(*pending.top().second);
+            next_seq = std::max(next_seq, pending.top().first + 1);
+            pending.pop();
+        }
+    }
+    while (!pending.empty()) {
+        step(*pending.top().second);
+        pending.pop();
+    }
+
+    for (auto& stream : streams)
+        munmap(stream.map, stream.size);
+    return true;
+}
+
+bool TraceReplay::replay_csv(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+
+    char line[256];
+    TraceRecord rec;
+    ::memset(&rec, 0, sizeof(rec));
+    while (fgets(line, sizeof(line), fp)) {
+        char kind = line[0];
+        if (kind != TRACE_KIND_COMPUTE && kind != TRACE_KIND_DATA) continue;
+
+        char* p = line + 1;
+        while (*p == ',' || *p == ' ') p++;
+        char* name = p;
+        while (*p && *p != ',') p++;
+        if (!*p) continue;
+        *p++ = '\0';
+
+        rec.kind = kind;
+        rec.op   = 0;
+        for (uint8_t op = 1; op <= REPLAY_OP_MAX; op++) {
+            if (::strcmp(name, trace_op_name(kind, op)) == 0) {
+                rec.op = op;
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < 3; i++) {
+            while (*p == ',' || *p == ' ') p++;
+            rec.buf[i] = strtoull(p, &p, 10);
+        }
+        step(rec);
+    }
+    fclose(fp);
+    return true;
+}
+
+void TraceReplay::print(std::ostream& out) const {
+    ReplayResult r = result();
+    out << std::fixed << std::setprecision(0);
+    out << "records         : " << r.records << " (compute " << r.compute_records << ", data " << r.data_records << ")"
+        << std::endl;
+    if (r.devices > 1) out << "devices         : " << r.devices << " (" << num_streams << " streams)" << std::endl;
+    out << "makespan        : " << r.makespan_ns << " ns" << std::endl;
+    out << "critical path   : " << r.critical_path_ns << " ns (unlimited resources)" << std::endl;
+    for (uint32_t d = 0; d < r.devices; d++) {
+        for (uint32_t i = 0; i < REPLAY_RES_NUM; i++) {
+            const ReplayResourceStat& s = r.device_res[d][i];
+            if (!s.ops) continue;
+            std::string name(replay_resource_name(i));
+            if (r.devices > 1 && i != REPLAY_RES_D2D) name = "dev" + std::to_string(d) + " " + name;
+            double util = r.makespan_ns > 0 ? 100.0 * s.busy_ns / r.makespan_ns : 0;
+            out << std::left << std::setw(r.devices > 1 ? 13 : 8) << name << std::right << ": ops " << s.ops
+                << ", busy " << s.busy_ns << " ns (" << std::setprecision(1) << util << "%)" << std::setprecision(0)
+                << ", end " << s.end_ns << " ns, data stall " << s.data_stall_ns << " ns, resource stall "
+                << s.resource_stall_ns << " ns" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+#include "utils/memory_tracking.h"
+#include "utils/shadow_pool.h"
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+
+#define HUGE_PAGE_BYTES (2ULL * 1024 * 1024)
+
+ShadowPool::ShadowPool(const char* _name, uint64_t _trace_base, uint32_t _num_slots, size_t _slot_bytes)
+    : name(_name), trace_base(_trace_base) {
+    slot_bytes = (_slot_bytes + SHADOW_SLOT_ALIGN - 1) / SHADOW_SLOT_ALIGN * SHADOW_SLOT_ALIGN;
+    num_slots = _num_slots;
+    arena_bytes = slot_bytes * num_slots;
+    if(arena_bytes == 0) return;
+
+    /* explicit huge pages first (only when enough pages are reserved, so no NORESERVE),
+        then normal pages with transparent huge pages */
+    size_t huge_bytes = (arena_bytes + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+    void* p = MAP_FAILED;
+    if(MAP_HUGETLB) p = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED){
+        huge_pages = true;
+        arena_bytes = huge_bytes;
+    }
+    else{
+        p = mmap(NULL, arena_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(p == MAP_FAILED){
+            std::cout << "shadow pool " << name << ": cannot reserve " << arena_bytes << " bytes, heap is used" << std::endl;
+            arena_bytes = 0;
+            num_slots = 0;
+            return;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(p, arena_bytes, MADV_HUGEPAGE);
+#endif
+    }
+    arena = (char*)p;
+
+    buffers.reset(new ShadowBuffer[num_slots]);
+    next_free.reset(new std::atomic<uint32_t>[num_slots]);
+    for(uint32_t i = 0; i < num_slots; i++){
+        buffers[i].values = (uint64_t*)(arena + (size_t)i * slot_bytes);
+        buffers[i].pool = this;
+        buffers[i].slot = i;
+        next_free[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+ShadowPool::~ShadowPool() {
+    if(arena) munmap(arena, arena_bytes);
+}
+
+ShadowBuffer* ShadowPool::acquire(size_t length) {
+    if(length * sizeof(uint64_t) > slot_bytes) return nullptr;
+
+    uint32_t slot;
+    uint64_t head = free_head.load(std::memory_order_acquire);
+    while(1){
+        if((uint32_t)head == 0){
+            // no released slot, take a new one
+            slot = bump.fetch_add(1, std::memory_order_relaxed);
+            if(slot >= num_slots){
+                bump.store(num_slots, std::memory_order_relaxed);
+                return nullptr;
+            }
+            break;
+        }
+        slot = (uint32_t)head - 1;
+        uint64_t next = ((head >> 32) + 1) << 32 | next_free[slot].load(std::memory_order_relaxed);
+        if(free_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)) break;
+    }
+
+    uint32_t used = in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint32_t cur_peak = peak.load(std::memory_order_relaxed);
+    while(cur_peak < used && !peak.compare_exchange_weak(cur_peak, used, std::memory_order_relaxed)) {}
+
+    ShadowBuffer* buffer = &buffers[slot];
+    buffer->length = length;
+    return buffer;
+}
+
+void ShadowPool::release(ShadowBuffer* buffer) {
+    uint32_t slot = buffer->slot;
+    in_use.fetch_sub(1, std::memory_order_relaxed);
+    uint64_t head = free_head.load(std::memory_order_relaxed);
+    while(1){
+        next_free[slot].store((uint32_t)head, std::memory_order_relaxed);
+        uint64_t next = ((head >> 32) + 1) << 32 | (slot + 1);
+        if(free_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) break;
+    }
+}
+
+void ShadowPool::print_stat() {
+    std::cout << "  " << name << ": slots " << num_slots << " x " << slot_bytes << " bytes"
+              << (huge_pages ? " (huge pages)" : "") << ", in use " << in_use.load() << ", peak " << peak.load()
+              << ", heap buffers " << heap_allocs.load() << std::endl;
+}
+
+namespace {
+
+std::atomic<ShadowPool*> shadow_pools[SHADOW_POOL_NUM];
+std::mutex shadow_pools_m;
+/* pools of the previous hardware profiles, shadows made before still hold their slots */
+std::vector<ShadowPool*> retired_pools;
+std::atomic<uint32_t> pool_generation{0};
+
+/* pools are made at the first shadow after the hardware profile (hw_profile) is set.
+    They are never destroyed, shadows of static polynomials can be released after main.
+    Slots hold the 64-bit host words of ring_dim coefficients whatever the device word size is.
+    Every generation gets its own trace addresses (SHADOW_TRACE_*_BASE + generation << 48) */
+void init_shadow_pools() {
+    uint32_t hbm_slots = HBM_ENTRIES_NUM;
+    size_t slot_bytes = sizeof(uint64_t) * hw_profile.ring_dim;
+    uint64_t generation = (uint64_t)pool_generation.load() << 48;
+    shadow_pools[SHADOW_POOL_OCB].store(new ShadowPool("OCB", SHADOW_TRACE_OCB_BASE + generation, OCB_ENTRIES_NUM + hbm_slots, slot_bytes),
+                                        std::memory_order_release);
+    shadow_pools[SHADOW_POOL_HBM].store(new ShadowPool("HBM", SHADOW_TRACE_HBM_BASE + generation, hbm_slots, slot_bytes),
+                                        std::memory_order_release);
+}
+
+ShadowPool* get_shadow_pool(int pool) {
+    ShadowPool* slab = shadow_pools[pool].load(std::memory_order_acquire);
+    if(slab) return slab;
+    std::lock_guard<std::mutex> lock(shadow_pools_m);
+    if(!shadow_pools[pool].load(std::memory_order_relaxed)) init_shadow_pools();
+    return shadow_pools[pool].load(std::memory_order_relaxed);
+}
+
+void release_shadow_buffer(ShadowBuffer* buffer) {
+    if(buffer->pool){
+        buffer->pool->release(buffer);
+    }
+    else{
+        free(buffer->values);
+        delete buffer;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<ShadowBuffer> make_shadow_buffer(int pool, size_t length, bool zero) {
+    ShadowPool* slab = get_shadow_pool(pool);
+    ShadowBuffer* buffer = slab->acquire(length);
+    if(!buffer){
+        slab->count_heap_alloc();
+        size_t bytes = (length * sizeof(uint64_t) + SHADOW_SLOT_ALIGN - 1) / SHADOW_SLOT_ALIGN * SHADOW_SLOT_ALIGN;
+        buffer = new ShadowBuffer();
+        buffer->values = (uint64_t*)aligned_alloc(SHADOW_SLOT_ALIGN, bytes ? bytes : SHADOW_SLOT_ALIGN);
+        buffer->length = length;
+    }
+    if(zero) memset(buffer->values, 0, length * sizeof(uint64_t));
+    return std::shared_ptr<ShadowBuffer>(buffer, release_shadow_buffer);
+}
+
+uint64_t shadow_trace_addr(uint64_t addr) {
+    for(auto& slab : shadow_pools){
+        ShadowPool* pool = slab.load(std::memory_order_acquire);
+        if(pool && pool->contains(addr)) return pool->trace_addr(addr);
+    }
+    if(pool_generation.load(std::memory_order_relaxed)){
+        std::lock_guard<std::mutex> lock(shadow_pools_m);
+        for(ShadowPool* pool : retired_pools){
+            if(pool->contains(addr)) return pool->trace_addr(addr);
+        }
+    }
+    return addr;
+}
+
+void reset_shadow_pools() {
+    std::lock_guard<std::mutex> lock(shadow_pools_m);
+    for(auto& slab : shadow_pools){
+        ShadowPool* pool = slab.exchange(nullptr, std::memory_order_acq_rel);
+        if(pool) retired_pools.push_back(pool);
+    }
+    pool_generation++;
+}
+
+void print_shadow_pool_stat() {
+    std::cout << "shadow pool" << std::endl;
+    for(auto& slab : shadow_pools){
+        ShadowPool* pool = slab.load(std::memory_order_acquire);
+        if(pool) pool->print_stat();
+    }
+}
@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+
+#include "utils/trace.h"
+#include "utils/multi_device.h"
+
+namespace {
+
+void trace_exit();
+
+struct TraceBuffer {
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+    uint32_t num_records = 0;
+};
+
+/* Background writer.
+    Producers hand full buffers over (one lock per TRACE_BUFFER_RECORDS records),
+    writer thread writes them and gives the buffers back to the free list. */
+class TraceWriter {
+private:
+    std::mutex mtx;
+    std::condition_variable cv_full;
+    std::condition_variable cv_written;
+    std::deque<TraceBuffer*> full_buffers;
+    std::vector<TraceBuffer*> free_buffers;
+    uint64_t num_pending = 0; // handed over, not written yet
+
+    std::thread writer_thread;
+    bool opened = false;
+    bool stop = false;
+    bool exiting = false; // output is closed by exit (or cannot be opened), later records are dropped
+
+    std::string path = "commandrecord.bin";
+    bool use_mmap = false;
+    int fd = -1;
+    uint64_t file_off = 0;
+    char* window = NULL;
+    uint64_t window_off = 0;
+
+    void map_window(uint64_t off) {
+        if (window) munmap(window, TRACE_MMAP_WINDOW);
+        window = NULL;
+        window_off = off;
+        if (ftruncate(fd, window_off + TRACE_MMAP_WINDOW) != 0) return;
+        void* p = mmap(NULL, TRACE_MMAP_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, fd, window_off);
+        if (p != MAP_FAILED) window = (char*)p;
+    }
+
+    void write_bytes(const char* data, uint64_t size) {
+        while (size) {
+            if (use_mmap) {
+                if (!window || file_off >= window_off + TRACE_MMAP_WINDOW) map_window(file_off);
+                if (!window) {
+                    // mapping failed, fall back to write()
+                    use_mmap = false;
+                    if (ftruncate(fd, file_off) != 0) return;
+                    lseek(fd, file_off, SEEK_SET);
+                    continue;
+                }
+                uint64_t n = std::min<uint64_t>(size, window_off + TRACE_MMAP_WINDOW - file_off);
+                ::memcpy(window + (file_off - window_off), data, n);
+                data += n;
+                size -= n;
+                file_off += n;
+            }
+            else {
+                ssize_t n = ::write(fd, data, size);
+                if (n <= 0) {
+                    if (n < 0 && errno == EINTR) continue;
+                    std::cerr << "trace: write to " << path << " failed" << std::endl;
+                    return;
+                }
+                data += n;
+                size -= n;
+                file_off += n;
+            }
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (1) {
+            cv_full.wait(lock, [&] { return stop || !full_buffers.empty(); });
+            if (full_buffers.empty() && stop) break;
+
+            TraceBuffer* buffer = full_buffers.front();
+            full_buffers.pop_front();
+            lock.unlock();
+            write_bytes((const char*)buffer->records, sizeof(TraceRecord) * buffer->num_records);
+            buffer->num_records = 0;
+            lock.lock();
+
+            free_buffers.push_back(buffer);
+            num_pending--;
+            cv_written.notify_all();
+        }
+    }
+
+    /* mtx must be locked */
+    void open_locked() {
+        static bool registered = false;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "trace: cannot open " << path << ", trace is dropped" << std::endl;
+            exiting = true;
+            return;
+        }
+        file_off = 0;
+        TraceFileHeader header;
+        ::memset(&header, 0, sizeof(header));
+        ::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.version = TRACE_VERSION;
+        header.record_size = sizeof(TraceRecord);
+        write_bytes((const char*)&header, sizeof(header));
+
+        stop = false;
+        opened = true;
+        writer_thread = std::thread(&TraceWriter::run, this);
+        if (!registered) {
+            registered = true;
+            std::atexit(trace_exit);
+        }
+    }
+
+public:
+    void set_output(const char* _path, bool _use_mmap) {
+        close();
+        std::unique_lock<std::mutex> lock(mtx);
+        path = _path;
+        use_mmap = _use_mmap;
+    }
+
+    TraceBuffer* get_buffer() {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!opened && !exiting) open_locked();
+        if (free_buffers.empty()) return new TraceBuffer;
+        TraceBuffer* buffer = free_buffers.back();
+        free_buffers.pop_back();
+        return buffer;
+    }
+
+    void submit(TraceBuffer* buffer) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (exiting) {
+            buffer->num_records = 0;
+            free_buffers.push_back(buffer);
+            return;
+        }
+        if (!opened) open_locked();
+        full_buffers.push_back(buffer);
+        num_pending++;
+        cv_full.notify_one();
+    }
+
+    void wait_written() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_written.wait(lock, [&] { return num_pending == 0; });
+    }
+
+    void close(bool at_exit = false) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (at_exit) exiting = true;
+            if (!opened) return;
+            stop = true;
+            cv_full.notify_one();
+        }
+        writer_thread.join();
+
+        std::unique_lock<std::mutex> lock(mtx);
+        if (window) munmap(window, TRACE_MMAP_WINDOW);
+        window = NULL;
+        if (use_mmap && ftruncate(fd, file_off) != 0) {
+            std::cerr << "trace: cannot truncate " << path << std::endl;
+        }
+        ::close(fd);
+        fd = -1;
+        opened = false;
+    }
+};
+
+/* order and thread ids are shared by the streams of all devices */
+std::atomic<uint64_t> next_seq{0};
+std::atomic<uint16_t> next_thread_id{0};
+
+/* one writer per device stream, never destroyed, other threads can hand their buffers over while main is exiting */
+TraceWriter** make_trace_writers() {
+    static TraceWriter* writers[MAX_DEVICES];
+    for (uint32_t d = 0; d < MAX_DEVICES; d++) {
+        writers[d] = new TraceWriter;
+        if (d) writers[d]->set_output(trace_device_path("commandrecord.bin", d).c_str(), false);
+    }
+    return writers;
+}
+
+TraceWriter& trace_writer(uint32_t device = 0) {
+    static TraceWriter** writers = make_trace_writers();
+    return *writers[device];
+}
+
+struct LocalTrace {
+    TraceBuffer* buffer[MAX_DEVICES] = {NULL};
+    int32_t thread_id = -1;
+
+    ~LocalTrace() {
+        for (uint32_t d = 0; d < MAX_DEVICES; d++) {
+            if (buffer[d] && buffer[d]->num_records) trace_writer(d).submit(buffer[d]);
+            buffer[d] = NULL;
+        }
+    }
+};
+
+thread_local LocalTrace local_trace;
+
+/* thread buffer of main is already handed over (thread_local destruction comes before exit handlers) */
+void trace_exit() {
+    for (uint32_t d = 0; d < MAX_DEVICES; d++) {
+        trace_writer(d).wait_written();
+        trace_writer(d).close(true);
+    }
+}
+
+}  // namespace
+
+std::string trace_device_path(const std::string& path, uint32_t device) {
+    if (device == 0) return path;
+    size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+    return path.substr(0, dot) + ".dev" + std::to_string(device) + path.substr(dot);
+}
+
+void trace_record(uint8_t kind, uint8_t op, uint64_t buf0, uint64_t buf1, uint64_t buf2, uint64_t modulus,
+                  uint32_t bytes, uint32_t device) {
+    LocalTrace& local = local_trace;
+    if (device >= MAX_DEVICES) device = 0;
+    TraceBuffer*& buffer = local.buffer[device];
+    if (!buffer) {
+        buffer = trace_writer(device).get_buffer();
+        if (local.thread_id < 0) local.thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TraceRecord& rec = buffer->records[buffer->num_records++];
+    rec.seq = next_seq.fetch_add(1, std::memory_order_relaxed);
+    rec.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count();
+    rec.buf[0] = buf0;
+    rec.buf[1] = buf1;
+    rec.buf[2] = buf2;
+    rec.modulus = modulus;
+    rec.bytes = bytes;
+    rec.kind = kind;
+    rec.op = op;
+    rec.thread_id = (uint16_t)local.thread_id;
+    rec.device = (uint16_t)device;
+    rec.reserved16 = 0;
+    rec.reserved = 0;
+
+    if (buffer->num_records == TRACE_BUFFER_RECORDS) {
+        trace_writer(device).submit(buffer);
+        buffer = trace_writer(device).get_buffer();
+    }
+}
+
+void set_trace_output(const char* path, bool use_mmap) {
+    trace_flush();
+    for (uint32_t d = 0; d < MAX_DEVICES; d++)
+        trace_writer(d).set_output(trace_device_path(path, d).c_str(), use_mmap);
+}
+
+void trace_flush() {
+    LocalTrace& local = local_trace;
+    for (uint32_t d = 0; d < MAX_DEVICES; d++) {
+        if (local.buffer[d] && local.buffer[d]->num_records) {
+            trace_writer(d).submit(local.buffer[d]);
+            local.buffer[d] = NULL;
+        }
+        trace_writer(d).wait_written();
+    }
+}
+
+void trace_close() {
+    trace_flush();
+    for (uint32_t d = 0; d < MAX_DEVICES; d++)
+        trace_writer(d).close();
+}
+
+const char* trace_op_name(uint8_t kind, uint8_t op) {
+    if (kind == TRACE_KIND_DATA) {
+        switch (op) {
+            case TRACE_LINK_PCIE: return "PCIE";
+            case TRACE_LINK_HBM: return "HBM";
+            case TRACE_LINK_SRAM: return "SRAM";
+            case TRACE_LINK_D2D: return "D2D";
+        }
+    }
+    else {
+        switch (op) {
+            case TRACE_OP_NTT: return "NTT";
+            case TRACE_OP_INTT: return "INTT";
+            case TRACE_OP_AUTO: return "Auto";
+            case TRACE_OP_ADD: return "Add";
+            case TRACE_OP_MULT: return "Mult";
+            case TRACE_OP_SUB: return "Sub";
+            case TRACE_OP_BCONVUP: return "Bconvup";
+            case TRACE_OP_BCONVDOWN: return "Bconvdown";
+            case TRACE_OP_PRNG: return "Prng";
+        }
+    }
+    return "Unknown";
+}
+
+bool trace_to_csv(const char* bin_path, const char* csv_path) {
+    std::ifstream in(bin_path, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    TraceFileHeader header;
+    if (!in.read((char*)&header, sizeof(header)) || ::memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.record_size != sizeof(TraceRecord)) {
+        std::cerr << "trace: " << bin_path << " is not a trace file" << std::endl;
+        return false;
+    }
+
+    std::vector<TraceRecord> records;
+    TraceRecord rec;
+    while (in.read((char*)&rec, sizeof(rec))) {
+        records.push_back(rec);
+    }
+    // each thread buffer is written as a whole, restore the global order
+    std::stable_sort(records.begin(), records.end(),
+                     [](const TraceRecord& a, const TraceRecord& b) { return a.seq < b.seq; });
+
+    std::ofstream out(csv_path, std::ios::trunc);
+    if (!out.is_open()) return false;
+    for (auto& r : records) {
+        out << (char)r.kind << ", " << trace_op_name(r.kind, r.op) << ", " << r.buf[0] << ", " << r.buf[1];
+        if (r.kind == TRACE_KIND_COMPUTE) out << ", " << r.buf[2];
+        out << "\n";
+    }
+    return true;
+}
@@ -593,6 +593,136 @@ TEST(UTDCRTPoly, DCRT_mod_ops_on_two_elements) {
     RUN_BIG_DCRTPOLYS(DCRT_mod_ops_on_two_elements, "DCRT DCRT_mod_ops_on_two_elements");
 }
 
+/* source limbs per base conversion task (dcrtpoly-impl.h) */
+void set_bconv_batch_width(uint32_t width);
+
+namespace {
+
+/* CRT constants of the conversion from the basis "from" to the basis "to"
+    hatInv[i] = (F/f_i)^-1 mod f_i, hatMod[i][j] = (F/f_i) mod t_j */
+void BConvConstants(const std::shared_ptr<ILDCRTParams<BigInteger>>& from,
+                    const std::shared_ptr<ILDCRTParams<BigInteger>>& to, std::vector<NativeInteger>& hatInv,
+                    std::vector<NativeInteger>& hatInvPrecon, std::vector<std::vector<NativeInteger>>& hatMod) {
+    BigInteger F(1);
+    for (auto& p : from->GetParams())
+        F *= BigInteger(p->GetModulus().ConvertToInt());
+    size_t sizeF = from->GetParams().size();
+    size_t sizeT = to->GetParams().size();
+    hatInv.resize(sizeF);
+    hatInvPrecon.resize(sizeF);
+    hatMod.assign(sizeF, std::vector<NativeInteger>(sizeT));
+    for (size_t i = 0; i < sizeF; i++) {
+        NativeInteger fi = from->GetParams()[i]->GetModulus();
+        BigInteger hat   = F / BigInteger(fi.ConvertToInt());
+        hatInv[i]        = NativeInteger(hat.Mod(BigInteger(fi.ConvertToInt())).ConvertToInt()).ModInverse(fi);
+        hatInvPrecon[i]  = hatInv[i].PrepModMulConst(fi);
+        for (size_t j = 0; j < sizeT; j++)
+            hatMod[i][j] = NativeInteger(
+                hat.Mod(BigInteger(to->GetParams()[j]->GetModulus().ConvertToInt())).ConvertToInt());
+    }
+}
+
+/* base conversion of x (coefficient format) the way it was before TASK_TYPE_BCONV_BATCH : one bconv_pipe
+    task per (source limb, target limb) pair */
+DCRTPoly BConvPerPair(const DCRTPoly& x, const std::shared_ptr<ILDCRTParams<BigInteger>>& to,
+                      const std::vector<NativeInteger>& hatInv,
+                      const std::vector<std::vector<NativeInteger>>& hatMod) {
+    DCRTPoly ans(to, Format::COEFFICIENT, true);
+    for (size_t i = 0; i < x.GetNumOfElements(); i++) {
+        NativePoly xi = x.GetElementAtIndex(i) * hatInv[i];
+        for (size_t j = 0; j < ans.GetNumOfElements(); j++) {
+            NativePoly src = xi;
+            auto& target   = ans.GetAllElements()[j];
+            src.bconv_pipe(target.GetModulus(), target.GetRootOfUnity(), 0, 0, hatMod[i][j], target);
+        }
+    }
+    return ans;
+}
+
+/* limb by limb, DCRTPoly::operator== is not used on the emulator */
+void ExpectSameDCRT(const DCRTPoly& a, const DCRTPoly& b, const std::string& msg) {
+    ASSERT_EQ(a.GetNumOfElements(), b.GetNumOfElements()) << msg;
+    for (size_t i = 0; i < a.GetNumOfElements(); i++) {
+        ASSERT_EQ(a.GetElementAtIndex(i).GetModulus(), b.GetElementAtIndex(i).GetModulus()) << msg;
+        for (size_t j = 0; j < a.GetRingDimension(); j++)
+            ASSERT_EQ(a.GetElementAtIndex(i).at(j), b.GetElementAtIndex(i).at(j))
+                << msg << " tower " << i << " index " << j;
+    }
+}
+
+}  // namespace
+
+/* ApproxSwitchCRTBasis and ApproxModDown with the batched base conversion, every batch width
+    gives the same result as the per-pair conversion. Limb counts are not multiples of the batch width */
+TEST(UTDCRTPoly, DCRT_bconv_batch_width) {
+    usint m     = 64;
+    usint sizeQ = 7;
+    usint sizeP = 6;
+
+    std::vector<NativeInteger> moduliQ, rootsQ, moduliP, rootsP;
+    NativeInteger q = FirstPrime<NativeInteger>(55, m);
+    for (usint i = 0; i < sizeQ + sizeP; i++) {
+        auto& moduli = (i < sizeQ) ? moduliQ : moduliP;
+        auto& roots  = (i < sizeQ) ? rootsQ : rootsP;
+        moduli.push_back(q);
+        roots.push_back(RootOfUnity<NativeInteger>(m, q));
+        q = PreviousPrime<NativeInteger>(q, m);
+    }
+    std::vector<NativeInteger> moduliQP(moduliQ), rootsQP(rootsQ);
+    moduliQP.insert(moduliQP.end(), moduliP.begin(), moduliP.end());
+    rootsQP.insert(rootsQP.end(), rootsP.begin(), rootsP.end());
+    auto paramsQ  = std::make_shared<ILDCRTParams<BigInteger>>(m, moduliQ, rootsQ);
+    auto paramsP  = std::make_shared<ILDCRTParams<BigInteger>>(m, moduliP, rootsP);
+    auto paramsQP = std::make_shared<ILDCRTParams<BigInteger>>(m, moduliQP, rootsQP);
+
+    std::vector<NativeInteger> QHatInvModq, QHatInvModqPrecon, PHatInvModp, PHatInvModpPrecon;
+    std::vector<std::vector<NativeInteger>> QHatModp, PHatModq;
+    BConvConstants(paramsQ, paramsP, QHatInvModq, QHatInvModqPrecon, QHatModp);
+    BConvConstants(paramsP, paramsQ, PHatInvModp, PHatInvModpPrecon, PHatModq);
+    std::vector<DoubleNativeInt> modpBarrettMu(sizeP), modqBarrettMu(sizeQ);
+
+    BigInteger P(1);
+    for (auto& p : moduliP)
+        P *= BigInteger(p.ConvertToInt());
+    std::vector<NativeInteger> PInvModq(sizeQ), PInvModqPrecon(sizeQ);
+    for (usint i = 0; i < sizeQ; i++) {
+        PInvModq[i]       = NativeInteger(P.Mod(BigInteger(moduliQ[i].ConvertToInt())).ConvertToInt()).ModInverse(moduliQ[i]);
+        PInvModqPrecon[i] = PInvModq[i].PrepModMulConst(moduliQ[i]);
+    }
+
+    DCRTPoly::DugType dug;
+    DCRTPoly x(dug, paramsQ, Format::COEFFICIENT);
+    DCRTPoly y(dug, paramsQP, Format::EVALUATION);
+
+    // per-pair references
+    DCRTPoly switchRef = BConvPerPair(x, paramsP, QHatInvModq, QHatModp);
+
+    DCRTPoly partP(paramsP, Format::COEFFICIENT, true);
+    for (usint j = 0; j < sizeP; j++) {
+        partP.GetAllElements()[j] = y.GetElementAtIndex(sizeQ + j);
+        partP.GetAllElements()[j].SetFormat(Format::COEFFICIENT);
+    }
+    DCRTPoly partPSwitched = BConvPerPair(partP, paramsQ, PHatInvModp, PHatModq);
+    DCRTPoly modDownRef(paramsQ, Format::EVALUATION, true);
+    for (usint i = 0; i < sizeQ; i++) {
+        partPSwitched.GetAllElements()[i].SetFormat(Format::EVALUATION);
+        modDownRef.GetAllElements()[i] =
+            (y.GetElementAtIndex(i) - partPSwitched.GetElementAtIndex(i)) * PInvModq[i];
+    }
+
+    for (uint32_t width : {1u, 5u, 0u, sizeQ + sizeP}) {
+        set_bconv_batch_width(width);
+        DCRTPoly switched =
+            x.ApproxSwitchCRTBasis(paramsQ, paramsP, QHatInvModq, QHatInvModqPrecon, QHatModp, modpBarrettMu);
+        ExpectSameDCRT(switched, switchRef, "ApproxSwitchCRTBasis, batch width " + std::to_string(width));
+
+        DCRTPoly modDown = y.ApproxModDown(paramsQ, paramsP, PInvModq, PInvModqPrecon, PHatInvModp,
+                                           PHatInvModpPrecon, PHatModq, modqBarrettMu, {}, {}, 0, {});
+        ExpectSameDCRT(modDown, modDownRef, "ApproxModDown, batch width " + std::to_string(width));
+    }
+    set_bconv_batch_width(5);
+}
+
 // only need to try this with one
 void testDCRTPolyConstructorNegative(std::vector<NativePoly>& towers) {
     DCRTPoly expectException(towers);
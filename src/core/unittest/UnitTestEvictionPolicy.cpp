@@ -0,0 +1,167 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  Eviction policies of the shadow tiers (FIFO, LRU, CLOCK, Belady with its oracle) on a small on-chip buffer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "include/gtest/gtest.h"
+
+#include "utils/eviction_policy.h"
+
+namespace {
+
+/* textbook reference string (ids + 1, key 0 is the empty entry of the policies) on an OCB of 3 entries :
+    FIFO 15 misses, LRU 12, OPT 9 */
+const std::vector<uint64_t> ev_accesses = {8, 1, 2, 3, 1, 4, 1, 5, 3, 4, 1, 4, 3, 2, 3, 1, 2, 8, 1, 2};
+const size_t ev_ocb_entries             = 3;
+
+struct EvictionRun {
+    uint32_t misses = 0;
+    std::vector<uint64_t> victims;
+};
+
+/* the memory tracking rule : a hit is an access, a miss on a full OCB evicts the victim and inserts the key */
+EvictionRun run_ocb(EvictionPolicy& policy, EvictionOracle* oracle) {
+    EvictionRun run;
+    std::vector<uint64_t> resident;
+    for (uint64_t key : ev_accesses) {
+        uint64_t next_use = oracle ? oracle->advance(key) : EVICTION_NEVER_USED;
+        if (std::find(resident.begin(), resident.end(), key) != resident.end()) {
+            policy.access(key, next_use);
+            continue;
+        }
+        run.misses++;
+        if (resident.size() == ev_ocb_entries) {
+            uint64_t victim = policy.victim([](uint64_t) { return true; });
+            EXPECT_NE(victim, 0u) << policy.name();
+            run.victims.push_back(victim);
+            policy.remove(victim);
+            resident.erase(std::find(resident.begin(), resident.end(), victim));
+        }
+        policy.insert(key, next_use);
+        resident.push_back(key);
+    }
+    return run;
+}
+
+/* access trace file of the oracle (sequence of uint32_t ids) */
+std::string write_access_trace(const std::vector<uint64_t>& accesses) {
+    char path[] = "/tmp/evictionXXXXXX";
+    int fd      = mkstemp(path);
+    if (fd < 0) return std::string();
+    std::vector<uint32_t> ids(accesses.begin(), accesses.end());
+    bool ok = write(fd, ids.data(), ids.size() * sizeof(uint32_t)) == (ssize_t)(ids.size() * sizeof(uint32_t));
+    close(fd);
+    return ok ? std::string(path) : std::string();
+}
+
+}  // namespace
+
+TEST(UTEvictionPolicy, fifo) {
+    auto policy = make_eviction_policy("FIFO");
+    ASSERT_TRUE(policy != nullptr);
+    EvictionRun run = run_ocb(*policy, nullptr);
+    EXPECT_EQ(run.misses, 15u);
+    EXPECT_EQ(run.victims, std::vector<uint64_t>({8, 1, 2, 3, 4, 1, 5, 3, 4, 1, 2, 3}));
+}
+
+TEST(UTEvictionPolicy, lru) {
+    auto policy = make_eviction_policy("LRU");
+    ASSERT_TRUE(policy != nullptr);
+    EvictionRun run = run_ocb(*policy, nullptr);
+    EXPECT_EQ(run.misses, 12u);
+    EXPECT_EQ(run.victims, std::vector<uint64_t>({8, 2, 3, 4, 1, 5, 1, 4, 3}));
+}
+
+/* inserted entries start without the reference bit, a hit sets it */
+TEST(UTEvictionPolicy, clock) {
+    auto policy = make_eviction_policy("CLOCK");
+    ASSERT_TRUE(policy != nullptr);
+    EvictionRun run = run_ocb(*policy, nullptr);
+    EXPECT_EQ(run.misses, 11u);
+    EXPECT_EQ(run.victims, std::vector<uint64_t>({8, 2, 3, 4, 5, 1, 4, 3}));
+}
+
+/* Belady with the oracle of the same access sequence is OPT : the fewest misses */
+TEST(UTEvictionPolicy, belady_oracle) {
+    std::string path = write_access_trace(ev_accesses);
+    ASSERT_FALSE(path.empty());
+    EvictionOracle oracle;
+    ASSERT_TRUE(oracle.load(path.c_str()));
+    unlink(path.c_str());
+
+    // next access positions of the oracle
+    EXPECT_EQ(oracle.peek(8), 0u);
+    EXPECT_EQ(oracle.peek(6), EVICTION_NEVER_USED);
+
+    auto policy = make_eviction_policy("Belady");
+    ASSERT_TRUE(policy != nullptr);
+    EvictionRun run = run_ocb(*policy, &oracle);
+    EXPECT_EQ(run.misses, 9u);
+    EXPECT_EQ(run.victims, std::vector<uint64_t>({8, 2, 1, 5, 4, 3}));
+    // every access is consumed
+    for (uint64_t key : ev_accesses)
+        EXPECT_EQ(oracle.peek(key), EVICTION_NEVER_USED);
+
+    for (const char* name : {"FIFO", "LRU", "CLOCK"}) {
+        auto other = make_eviction_policy(name);
+        EXPECT_LE(run.misses, run_ocb(*other, nullptr).misses) << name;
+    }
+}
+
+/* entries the tracker can not claim (pinned) are passed over, the next candidate is the victim */
+TEST(UTEvictionPolicy, pinned_entries) {
+    for (const char* name : {"FIFO", "LRU", "CLOCK", "Belady"}) {
+        auto policy = make_eviction_policy(name);
+        ASSERT_TRUE(policy != nullptr) << name;
+        for (uint64_t key = 1; key <= 3; key++)
+            policy->insert(key, 10 * (4 - key));  // Belady : 1 is used last
+        uint64_t first = policy->victim([](uint64_t) { return true; });
+        EXPECT_EQ(first, 1u) << name;
+        uint64_t second = policy->victim([first](uint64_t key) { return key != first; });
+        EXPECT_EQ(second, 2u) << name;
+        EXPECT_EQ(policy->victim([](uint64_t) { return false; }), 0u) << name;
+        policy->remove(first);
+        policy->remove(second);
+        policy->remove(3);
+        EXPECT_EQ(policy->victim([](uint64_t) { return true; }), 0u) << name;
+    }
+    EXPECT_TRUE(make_eviction_policy("random") == nullptr);
+}
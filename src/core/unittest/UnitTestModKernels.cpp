@@ -0,0 +1,177 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  The SIMD modular kernels of the offload consumer against the scalar kernels
+ */
+
+#include <random>
+#include <vector>
+#include "include/gtest/gtest.h"
+
+#include "utils/mod_kernels.h"
+
+namespace {
+
+/* moduli near 2^60 and 2^62, below the IFMA limit (2^50) and small ones */
+const uint64_t kernel_moduli[] = {(1ULL << 60) - 93, 1152921504606748673ULL, (1ULL << 62) - 57,
+                                  (1ULL << 50) - 27, 1125899906826241ULL, 65537, 12289};
+/* vector widths are 4 and 8, the tails go to the scalar code */
+const size_t kernel_sizes[] = {1, 3, 7, 8, 9, 15, 17, 31, 33, 1021, 1024};
+
+std::vector<uint64_t> random_residues(std::mt19937_64& rng, size_t size, uint64_t modulus) {
+    std::vector<uint64_t> v(size);
+    for (auto& x : v)
+        x = rng() % modulus;
+    // the extremes
+    if (size > 2) {
+        v[0] = 0;
+        v[1] = modulus - 1;
+    }
+    return v;
+}
+
+/* restores the detected level */
+class SimdLevelGuard {
+public:
+    SimdLevelGuard() : level(get_simd_level()) {}
+    ~SimdLevelGuard() {
+        set_simd_level(level);
+    }
+    int level;
+};
+
+/* f(level) for every level the CPU has, the result is compared with the scalar level */
+template <typename F>
+void for_each_simd_level(F f) {
+    SimdLevelGuard guard;
+    set_simd_level(SIMD_LEVEL_SCALAR);
+    auto expected = f();
+    for (int level = SIMD_LEVEL_AVX2; level <= guard.level; level++) {
+        set_simd_level(level);
+        ASSERT_EQ(get_simd_level(), level);
+        EXPECT_EQ(f(), expected) << "level " << simd_level_name(level);
+    }
+}
+
+}  // namespace
+
+TEST(UTModKernels, mod_add_sub) {
+    std::mt19937_64 rng(1);
+    for (auto q : kernel_moduli) {
+        for (auto n : kernel_sizes) {
+            auto a = random_residues(rng, n, q);
+            auto b = random_residues(rng, n, q);
+            uint64_t s = rng() % q;
+            SCOPED_TRACE("modulus " + std::to_string(q) + ", size " + std::to_string(n));
+
+            for_each_simd_level([&] {
+                std::vector<uint64_t> r(n);
+                mod_add(r.data(), a.data(), b.data(), q, n);
+                return r;
+            });
+            for_each_simd_level([&] {
+                std::vector<uint64_t> r(n);
+                mod_sub(r.data(), a.data(), b.data(), q, n);
+                return r;
+            });
+            for_each_simd_level([&] {
+                std::vector<uint64_t> r(n);
+                mod_add_scalar(r.data(), a.data(), s, q, n);
+                return r;
+            });
+            for_each_simd_level([&] {
+                std::vector<uint64_t> r(n);
+                mod_sub_scalar(r.data(), a.data(), s, q, n);
+                return r;
+            });
+            // in place
+            for_each_simd_level([&] {
+                std::vector<uint64_t> r = a;
+                mod_add(r.data(), r.data(), b.data(), q, n);
+                mod_sub(r.data(), r.data(), a.data(), q, n);
+                return r;
+            });
+        }
+    }
+}
+
+TEST(UTModKernels, mod_mul_scalar) {
+    std::mt19937_64 rng(2);
+    for (auto q : kernel_moduli) {
+        for (auto n : kernel_sizes) {
+            auto a = random_residues(rng, n, q);
+            SCOPED_TRACE("modulus " + std::to_string(q) + ", size " + std::to_string(n));
+            // scalar reduced, q - 1, and above the modulus
+            for (uint64_t s : {rng() % q, q - 1, (uint64_t)1, q + 12345}) {
+                for_each_simd_level([&] {
+                    std::vector<uint64_t> r(n);
+                    mod_mul_scalar(r.data(), a.data(), s, q, n);
+                    return r;
+                });
+            }
+        }
+    }
+    // reference for the scalar level
+    uint64_t q = kernel_moduli[0];
+    std::vector<uint64_t> a = random_residues(rng, 64, q), r(64);
+    uint64_t s = rng() % q;
+    SimdLevelGuard guard;
+    set_simd_level(SIMD_LEVEL_SCALAR);
+    mod_mul_scalar(r.data(), a.data(), s, q, a.size());
+    for (size_t i = 0; i < a.size(); i++)
+        ASSERT_EQ(r[i], (uint64_t)((unsigned __int128)a[i] * s % q));
+}
+
+/* base conversion of one source limb : up (source modulus below the target) and down */
+TEST(UTModKernels, bconv_mac) {
+    std::mt19937_64 rng(3);
+    for (auto nm : kernel_moduli) {
+        for (auto om : kernel_moduli) {
+            if (om == nm)
+                continue;
+            uint64_t halfQ = om >> 1;
+            uint64_t diff  = (nm > om) ? nm - om : nm - (om % nm);
+            for (auto n : kernel_sizes) {
+                auto data = random_residues(rng, n, om);
+                auto acc  = random_residues(rng, n, nm);
+                uint64_t s = rng() % nm;
+                SCOPED_TRACE("source " + std::to_string(om) + ", target " + std::to_string(nm) + ", size " +
+                             std::to_string(n));
+                for_each_simd_level([&] {
+                    std::vector<uint64_t> r = acc;
+                    bconv_mac(r.data(), data.data(), n, halfQ, diff, nm, s, nm);
+                    return r;
+                });
+            }
+        }
+    }
+}
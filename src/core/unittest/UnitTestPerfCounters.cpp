@@ -0,0 +1,245 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/*
+  Perf counter registry : per-thread blocks, totals of the exited threads, snapshots and perf_reset,
+  nested regions and the JSON/CSV output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "include/gtest/gtest.h"
+
+#include "utils/perf_counters.h"
+
+#define PC_THREADS 6
+#define PC_ROUNDS 10000
+#define PC_TASK_TYPE (PERF_TASK_TYPES - 1) // no task of the emulator has this type
+
+/* counters used by the test, the idle consumer workers do not touch them */
+#define PC_CNT_A PERF_CNT_D2D_TRANSFER
+#define PC_CNT_B PERF_CNT_PRNG
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static std::string temp_path(const char* suffix) {
+    char name[] = "/tmp/perf_counters_XXXXXX";
+    int fd      = mkstemp(name);
+    if (fd >= 0) close(fd);
+    unlink(name);
+    return std::string(name) + suffix;
+}
+
+static const PerfRegionStat* find_region(const std::vector<PerfRegionStat>& regions, const std::string& name) {
+    for (auto& region : regions) {
+        if (region.name == name) return &region;
+    }
+    return nullptr;
+}
+
+/* names and ids go both ways */
+TEST(UTPerfCounters, names) {
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+        EXPECT_STRNE(perf_counter_name(i), "unknown") << i;
+        EXPECT_EQ(perf_counter_id(perf_counter_name(i)), (int)i);
+    }
+    EXPECT_STREQ(perf_counter_name(PERF_CNT_NUM), "unknown");
+    EXPECT_EQ(perf_counter_id("no_such_counter"), -1);
+}
+
+/* counts of threads which exited before the snapshot (retired totals) and of threads still alive
+    at the snapshot (live blocks) are both in it, and an exiting thread is not counted twice */
+TEST(UTPerfCounters, threads) {
+    PerfSnapshot before = perf_snapshot();
+
+    /* first wave : exits before the snapshot */
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < PC_THREADS; t++) {
+        threads.emplace_back([t]() {
+            for (uint32_t i = 0; i < PC_ROUNDS; i++) perf_inc(PC_CNT_A, 1);
+            perf_inc(PC_CNT_B, t + 1);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    threads.clear();
+
+    PerfSnapshot delta = perf_snapshot() - before;
+    EXPECT_EQ(delta[PC_CNT_A], (uint64_t)PC_THREADS * PC_ROUNDS);
+    EXPECT_EQ(delta[PC_CNT_B], (uint64_t)PC_THREADS * (PC_THREADS + 1) / 2);
+
+    /* second wave : reuses the blocks of the first one, alive while the snapshot is taken */
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t done = 0;
+    bool release  = false;
+    for (uint32_t t = 0; t < PC_THREADS; t++) {
+        threads.emplace_back([&]() {
+            for (uint32_t i = 0; i < PC_ROUNDS; i++) perf_inc(PC_CNT_A, 2);
+            std::unique_lock<std::mutex> lock(m);
+            done++;
+            cv.notify_all();
+            cv.wait(lock, [&]() { return release; });
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&]() { return done == PC_THREADS; });
+    }
+
+    delta = perf_snapshot() - before;
+    EXPECT_EQ(delta[PC_CNT_A], (uint64_t)PC_THREADS * PC_ROUNDS * 3);
+    EXPECT_EQ(delta[PC_CNT_B], (uint64_t)PC_THREADS * (PC_THREADS + 1) / 2);
+
+    {
+        std::lock_guard<std::mutex> lock(m);
+        release = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads) thread.join();
+
+    delta = perf_snapshot() - before;
+    EXPECT_EQ(delta[PC_CNT_A], (uint64_t)PC_THREADS * PC_ROUNDS * 3);
+    EXPECT_EQ(delta[PC_CNT_B], (uint64_t)PC_THREADS * (PC_THREADS + 1) / 2);
+}
+
+/* task times land in the log2 bucket, the last bucket is open */
+TEST(UTPerfCounters, task_histogram) {
+    PerfSnapshot before = perf_snapshot();
+
+    std::thread worker([]() { perf_task_time(PC_TASK_TYPE, 1000); });
+    worker.join();
+    perf_task_time(PC_TASK_TYPE, 1000);
+    perf_task_time(PC_TASK_TYPE, 0);
+    perf_task_time(PC_TASK_TYPE, 1ULL << 40);
+    perf_task_time(-1, 1000);
+    perf_task_time(PERF_TASK_TYPES, 1000);
+
+    PerfSnapshot delta = perf_snapshot() - before;
+    EXPECT_EQ(delta.tasks(PC_TASK_TYPE), 4u);
+    EXPECT_EQ(delta.task_ns[PC_TASK_TYPE], 2000 + (1ULL << 40));
+    EXPECT_EQ(delta.task_hist[PC_TASK_TYPE][9], 2u);  // 512 <= 1000 < 1024
+    EXPECT_EQ(delta.task_hist[PC_TASK_TYPE][0], 1u);
+    EXPECT_EQ(delta.task_hist[PC_TASK_TYPE][PERF_HIST_BUCKETS - 1], 1u);
+}
+
+/* regions nest by path, sum over the calls and see the counts of the other threads,
+    the JSON and CSV files carry the snapshot and the regions */
+TEST(UTPerfCounters, regions_and_output) {
+    {
+        PerfRegion outer("ut_perf_outer");
+        perf_inc(PC_CNT_A, 5);
+        for (uint32_t call = 0; call < 2; call++) {
+            PerfRegion inner("ut_perf_inner");
+            std::thread worker([]() { perf_inc(PC_CNT_A, 7); });
+            worker.join();
+        }
+        perf_inc(PC_CNT_B, 3);
+    }
+
+    std::vector<PerfRegionStat> regions = perf_regions();
+    const PerfRegionStat* outer         = find_region(regions, "ut_perf_outer");
+    const PerfRegionStat* inner         = find_region(regions, "ut_perf_outer/ut_perf_inner");
+    ASSERT_TRUE(outer != nullptr);
+    ASSERT_TRUE(inner != nullptr);
+    EXPECT_EQ(outer->calls, 1u);
+    EXPECT_EQ(inner->calls, 2u);
+    EXPECT_EQ(outer->delta[PC_CNT_A], 19u);
+    EXPECT_EQ(outer->delta[PC_CNT_B], 3u);
+    EXPECT_EQ(inner->delta[PC_CNT_A], 14u);
+    EXPECT_EQ(inner->delta[PC_CNT_B], 0u);
+    EXPECT_GE(outer->elapsed_ms, inner->elapsed_ms);
+    EXPECT_TRUE(find_region(regions, "ut_perf_inner") == nullptr);
+
+    perf_task_time(PC_TASK_TYPE, 1000);
+    PerfSnapshot snap = perf_snapshot();
+    std::string a     = perf_counter_name(PC_CNT_A);
+    std::string type  = "type" + std::to_string(PC_TASK_TYPE);
+
+    std::string json_path = temp_path(".json");
+    ASSERT_TRUE(perf_write_json(json_path.c_str(), snap));
+    std::string json = read_file(json_path);
+    unlink(json_path.c_str());
+    EXPECT_NE(json.find("\"counters\": {"), std::string::npos);
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+        std::string entry = "\"" + std::string(perf_counter_name(i)) + "\": " + std::to_string(snap[i]);
+        EXPECT_NE(json.find(entry), std::string::npos) << entry;
+    }
+    EXPECT_NE(json.find("\"" + type + "\": {\"count\": " + std::to_string(snap.tasks(PC_TASK_TYPE))), std::string::npos);
+    EXPECT_NE(json.find("{\"name\": \"ut_perf_outer/ut_perf_inner\", \"calls\": 2"), std::string::npos);
+    EXPECT_NE(json.find("\"" + a + "\": 14}"), std::string::npos);
+
+    std::string csv_path = temp_path(".csv");
+    ASSERT_TRUE(perf_write_csv(csv_path.c_str(), snap));
+    std::string csv = read_file(csv_path);
+    unlink(csv_path.c_str());
+    EXPECT_EQ(csv.find("section,name,key,value\n"), 0u);
+    for (uint32_t i = 0; i < PERF_CNT_NUM; i++) {
+        std::string line = "counter,," + std::string(perf_counter_name(i)) + "," + std::to_string(snap[i]) + "\n";
+        EXPECT_NE(csv.find(line), std::string::npos) << line;
+    }
+    EXPECT_NE(csv.find("task," + type + ",count," + std::to_string(snap.tasks(PC_TASK_TYPE)) + "\n"), std::string::npos);
+    EXPECT_NE(csv.find("region,ut_perf_outer,calls,1\n"), std::string::npos);
+    EXPECT_NE(csv.find("region,ut_perf_outer/ut_perf_inner,calls,2\n"), std::string::npos);
+    EXPECT_NE(csv.find("region,ut_perf_outer/ut_perf_inner," + a + ",14\n"), std::string::npos);
+    EXPECT_NE(csv.find("region,ut_perf_outer," + a + ",19\n"), std::string::npos);
+}
+
+/* perf_reset moves the base line (live and retired counts) and drops the regions */
+TEST(UTPerfCounters, reset) {
+    std::thread worker([]() { perf_inc(PC_CNT_A, 11); });
+    worker.join();
+    perf_inc(PC_CNT_A, 4);
+    {
+        PerfRegion region("ut_perf_reset");
+    }
+
+    perf_reset();
+    EXPECT_EQ(perf_snapshot()[PC_CNT_A], 0u);
+    EXPECT_TRUE(find_region(perf_regions(), "ut_perf_reset") == nullptr);
+
+    perf_inc(PC_CNT_A, 2);
+    worker = std::thread([]() { perf_inc(PC_CNT_A, 3); });
+    worker.join();
+    EXPECT_EQ(perf_snapshot()[PC_CNT_A], 5u);
+}
@@ -0,0 +1,177 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  Slab pool of the shadow buffers : slots of one arena, reuse of released slots, zeroed shadows
+  and concurrent acquire/release (tagged free stack)
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "include/gtest/gtest.h"
+
+#include "utils/hw_profile.h"
+#include "utils/shadow_pool.h"
+
+#define SP_THREADS 8
+#define SP_ROUNDS 200000
+
+/* slots are SHADOW_SLOT_ALIGN aligned and next to each other, a full slot write stays in its slot,
+    the pool gives nullptr when it is full or the length does not fit */
+TEST(UTShadowPool, slots) {
+    const uint32_t num_slots = 4;
+    const size_t length      = 125;  // 1000 bytes, slot of 1024
+    ShadowPool pool("test", SHADOW_TRACE_OCB_BASE, num_slots, length * sizeof(uint64_t));
+
+    std::vector<ShadowBuffer*> buffers;
+    for (uint32_t i = 0; i < num_slots; i++) {
+        ShadowBuffer* buffer = pool.acquire(length);
+        ASSERT_TRUE(buffer != nullptr) << "slot " << i;
+        EXPECT_EQ(buffer->size(), length);
+        EXPECT_EQ(buffer->pool, &pool);
+        EXPECT_EQ((uint64_t)buffer->values % SHADOW_SLOT_ALIGN, 0u);
+        EXPECT_TRUE(pool.contains((uint64_t)buffer->values));
+        buffers.push_back(buffer);
+    }
+    EXPECT_TRUE(pool.acquire(length) == nullptr);
+    EXPECT_TRUE(pool.acquire(1) == nullptr);
+
+    uint64_t base = (uint64_t)buffers[0]->values;
+    for (uint32_t i = 0; i < num_slots; i++) {
+        EXPECT_EQ((uint64_t)buffers[i]->values, base + i * 1024) << "slot " << i;
+        EXPECT_EQ(pool.trace_addr((uint64_t)buffers[i]->values), SHADOW_TRACE_OCB_BASE + i * 1024);
+        for (size_t j = 0; j < 128; j++)  // up to the end of the slot
+            buffers[i]->values[j] = ((uint64_t)i << 32) | j;
+    }
+    for (uint32_t i = 0; i < num_slots; i++) {
+        for (size_t j = 0; j < 128; j++)
+            ASSERT_EQ(buffers[i]->values[j], ((uint64_t)i << 32) | j) << "slot " << i << " word " << j;
+    }
+
+    // released slots come back last in, first out, with the length of the new request
+    pool.release(buffers[1]);
+    pool.release(buffers[3]);
+    ShadowBuffer* again = pool.acquire(16);
+    ASSERT_TRUE(again != nullptr);
+    EXPECT_EQ(again, buffers[3]);
+    EXPECT_EQ(again->size(), 16u);
+    again = pool.acquire(length);
+    EXPECT_EQ(again, buffers[1]);
+    EXPECT_TRUE(pool.acquire(length) == nullptr);
+
+    // slot too small : the caller takes the heap
+    pool.release(buffers[0]);
+    EXPECT_TRUE(pool.acquire(129) == nullptr);
+    EXPECT_EQ(pool.acquire(128), buffers[0]);
+}
+
+/* create_shadow(zero) : a shadow buffer made with zero is cleared even on a used slot, and on the heap */
+TEST(UTShadowPool, zeroed_shadow) {
+    const size_t length = 1024;
+    uint64_t* dirty;
+    {
+        auto buffer = make_shadow_buffer(SHADOW_POOL_HBM, length);
+        dirty       = buffer->values;
+        for (size_t i = 0; i < length; i++)
+            (*buffer)[i] = ~(uint64_t)i;
+    }
+    auto buffer = make_shadow_buffer(SHADOW_POOL_HBM, length, true);
+    if (buffer->pool) EXPECT_EQ(buffer->values, dirty);  // the released slot is taken again
+    for (size_t i = 0; i < length; i++)
+        ASSERT_EQ((*buffer)[i], 0u) << "word " << i;
+
+    // larger than a slot (ring dimension of the hardware profile)
+    const size_t large = 4 * (size_t)hw_profile.ring_dim;
+    auto heap          = make_shadow_buffer(SHADOW_POOL_HBM, large, true);
+    EXPECT_TRUE(heap->pool == nullptr);
+    EXPECT_EQ(heap->size(), large);
+    for (size_t i = 0; i < large; i++)
+        ASSERT_EQ((*heap)[i], 0u) << "word " << i;
+}
+
+/* threads acquire and release slots of a small pool : a slot is never given to two threads at a time
+    (ABA on the free stack would give it twice), and every slot is free again at the end */
+TEST(UTShadowPool, concurrent_acquire_release) {
+    const uint32_t num_slots = 4;
+    ShadowPool pool("test", SHADOW_TRACE_HBM_BASE, num_slots, 8 * sizeof(uint64_t));
+
+    std::vector<std::atomic<uint32_t>> owner(num_slots);
+    for (auto& o : owner)
+        o.store(0);
+    std::atomic<uint32_t> duplicates{0};
+    std::atomic<uint32_t> corrupted{0};
+    std::atomic<uint64_t> acquired{0};
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t <= SP_THREADS; t++) {
+        threads.emplace_back([&, t] {
+            std::vector<ShadowBuffer*> held;
+            for (uint32_t r = 0; r < SP_ROUNDS; r++) {
+                ShadowBuffer* buffer = pool.acquire(8);
+                if (buffer) {
+                    if (owner[buffer->slot].exchange(t) != 0) duplicates++;
+                    buffer->values[0] = t;
+                    held.push_back(buffer);
+                    acquired++;
+                }
+                // hold up to 2 slots, release in another order than acquired : the few slots go round the free stack all the time
+                if (!held.empty() && (!buffer || held.size() > 1 || (r & 1))) {
+                    ShadowBuffer* b = held[(r / 2) % held.size()];
+                    held.erase(held.begin() + (r / 2) % held.size());
+                    if (b->values[0] != t) corrupted++;
+                    if (owner[b->slot].exchange(0) != t) duplicates++;
+                    pool.release(b);
+                }
+            }
+            for (ShadowBuffer* b : held) {
+                owner[b->slot].store(0);
+                pool.release(b);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(duplicates.load(), 0u);
+    EXPECT_EQ(corrupted.load(), 0u);
+    EXPECT_GT(acquired.load(), (uint64_t)SP_ROUNDS);
+
+    std::vector<bool> seen(num_slots, false);
+    for (uint32_t i = 0; i < num_slots; i++) {
+        ShadowBuffer* buffer = pool.acquire(8);
+        ASSERT_TRUE(buffer != nullptr) << "slot " << i << " lost";
+        EXPECT_FALSE(seen[buffer->slot]) << "slot " << buffer->slot << " given twice";
+        seen[buffer->slot] = true;
+    }
+    EXPECT_TRUE(pool.acquire(8) == nullptr);
+}
@@ -0,0 +1,520 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  Stress tests of the lock-free task ring and the work queue of the emulated device,
+  the reorder scheduler (dependencies, residency, NTT batches, starvation),
+  and of the consumer workers on polynomials tracked in a small on-chip buffer and HBM
+ */
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "include/gtest/gtest.h"
+
+#include "lattice/lat-hal.h"
+#include "math/distrgen.h"
+#include "utils/custom_task.h"
+#include "utils/hw_profile.h"
+
+using namespace lbcrypto;
+
+void init_stat();
+void stop_consumer_workers();
+void set_num_consumer_workers(uint32_t num_workers);
+void set_async_offload(bool enable);
+void wait_offload_all();
+
+#define WQ_PRODUCERS 4
+#define WQ_CONSUMERS 4
+#define WQ_ITEMS_PER_PRODUCER 20000
+#define WQ_POLYS 16 // polynomials shared by the tasks (dependencies between workers)
+#define WQ_SCHED_WINDOW 16
+#define WQ_SCHED_TASKS 2000
+
+static std::vector<std::unique_ptr<CustomTaskItem>> make_items(uint32_t n, uint32_t num_moduli) {
+    std::vector<std::unique_ptr<CustomTaskItem>> items;
+    for (uint32_t i = 0; i < n; i++) {
+        items.emplace_back(new CustomTaskItem(TASK_TYPE_PlusInPlace));
+        items.back()->param1  = i;
+        items.back()->modulus = 1 + i % num_moduli;
+    }
+    return items;
+}
+
+/* small ring (wraps and fills all the time), every pushed item is popped exactly once */
+TEST(UTWorkQueue, task_ring_mpmc) {
+    TaskRing ring(64);
+    const uint32_t total = WQ_PRODUCERS * WQ_ITEMS_PER_PRODUCER;
+    auto items           = make_items(total, 1);
+    std::vector<std::atomic<uint32_t>> seen(total);
+    for (auto& s : seen)
+        s.store(0);
+    std::atomic<uint32_t> popped{0};
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < WQ_PRODUCERS; p++) {
+        threads.emplace_back([&, p] {
+            for (uint32_t i = p; i < total; i += WQ_PRODUCERS) {
+                while (!ring.push(items[i].get()))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (uint32_t c = 0; c < WQ_CONSUMERS; c++) {
+        threads.emplace_back([&] {
+            CustomTaskItem* item;
+            while (popped.load() < total) {
+                if (ring.pop(item)) {
+                    seen[item->param1].fetch_add(1);
+                    popped.fetch_add(1);
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(popped.load(), total);
+    EXPECT_TRUE(ring.empty());
+    for (uint32_t i = 0; i < total; i++)
+        ASSERT_EQ(seen[i].load(), 1u) << "item " << i;
+}
+
+/* several producers and workers : every task is processed exactly once, tasks sharing a polynomial
+    never run at the same time, every completion token is done (out-of-order completion included),
+    and a batch of num_parallel_jobs tasks has one modulus */
+static void work_queue_stress(uint32_t num_parallel_jobs, uint32_t items_per_producer) {
+    WorkQueue queue;
+    queue.setNumWorkers(WQ_CONSUMERS);
+    queue.setNumParallelJobs(num_parallel_jobs);
+
+    const uint32_t total = WQ_PRODUCERS * items_per_producer;
+    auto items           = make_items(total, 3);
+    char polys[WQ_POLYS];
+    for (uint32_t i = 0; i < total; i++)
+        items[i]->poly = &polys[i % WQ_POLYS];
+
+    std::vector<std::atomic<uint32_t>> seen(total);
+    for (auto& s : seen)
+        s.store(0);
+    std::atomic<uint32_t> busy[WQ_POLYS];
+    for (auto& b : busy)
+        b.store(0);
+    std::atomic<uint32_t> overlaps{0};
+    std::atomic<uint32_t> bad_batches{0};
+    std::atomic<uint64_t> last_ticket{0};
+
+    std::vector<std::thread> consumers;
+    for (uint32_t w = 0; w < WQ_CONSUMERS; w++) {
+        consumers.emplace_back([&, w] {
+            queue.markConsumerThread();
+            std::vector<CustomTaskItem*> batch;
+            while (queue.getWork(batch, w)) {
+                if (batch.size() > num_parallel_jobs)
+                    bad_batches.fetch_add(1);
+                for (auto item : batch) {
+                    if (item->modulus != batch[0]->modulus)
+                        bad_batches.fetch_add(1);
+                }
+                for (auto item : batch) {
+                    uint32_t p = (char*)item->poly - polys;
+                    if (busy[p].fetch_add(1) != 0)
+                        overlaps.fetch_add(1);
+                    seen[item->param1].fetch_add(1);
+                    std::this_thread::yield();
+                    busy[p].fetch_sub(1);
+                    queue.workProcessed(item);
+                }
+                batch.clear();
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < WQ_PRODUCERS; p++) {
+        producers.emplace_back([&, p] {
+            uint64_t ticket = 0;
+            for (uint32_t i = p; i < total; i += WQ_PRODUCERS)
+                ticket = queue.submitWork(items[i].get());
+            uint64_t last = last_ticket.load();
+            while (ticket > last && !last_ticket.compare_exchange_weak(last, ticket)) {
+            }
+        });
+    }
+    for (auto& t : producers)
+        t.join();
+    queue.finish();
+    for (auto& t : consumers)
+        t.join();
+
+    EXPECT_EQ(overlaps.load(), 0u);
+    EXPECT_EQ(bad_batches.load(), 0u);
+    EXPECT_EQ(last_ticket.load(), (uint64_t)total);
+    EXPECT_TRUE(queue.isDone(total));
+    for (uint32_t i = 0; i < total; i++) {
+        ASSERT_EQ(seen[i].load(), 1u) << "item " << i;
+        ASSERT_TRUE(items[i]->processed.load());
+    }
+}
+
+TEST(UTWorkQueue, work_queue_mpmc) {
+    work_queue_stress(1, WQ_ITEMS_PER_PRODUCER);
+}
+
+TEST(UTWorkQueue, work_queue_mpmc_parallel_jobs) {
+    // batches are held until num_parallel_jobs tasks of a modulus are queued, fewer tasks
+    work_queue_stress(4, WQ_ITEMS_PER_PRODUCER / 8);
+}
+
+/* one worker, the tasks posted first : num_parallel_jobs batching gives full batches of the same modulus
+    in posted order, the last partial batch is given out when the queue finishes */
+TEST(UTWorkQueue, work_queue_parallel_jobs_batches) {
+    WorkQueue queue;
+    queue.setNumParallelJobs(4);
+
+    const uint32_t total = 18;
+    auto items           = make_items(total, 1);
+    char polys[total];
+    for (uint32_t i = 0; i < total; i++) {
+        items[i]->poly    = &polys[i];
+        items[i]->modulus = (i < 8) ? 7 : 11;
+        queue.submitWork(items[i].get());
+    }
+
+    std::vector<uint32_t> sizes;
+    std::vector<CustomTaskItem*> batch;
+    uint32_t next = 0;
+    for (uint32_t b = 0; b < 4; b++) {
+        ASSERT_TRUE(queue.getWork(batch));
+        sizes.push_back(batch.size());
+        for (auto item : batch) {
+            EXPECT_EQ(item->param1, next++);
+            EXPECT_EQ(item->modulus, batch[0]->modulus);
+            queue.workProcessed(item);
+        }
+        batch.clear();
+    }
+    EXPECT_EQ(sizes, std::vector<uint32_t>({4, 4, 4, 4}));
+
+    // 2 tasks left, fewer than num_parallel_jobs
+    queue.finish();
+    ASSERT_TRUE(queue.getWork(batch));
+    EXPECT_EQ(batch.size(), 2u);
+    for (auto item : batch) {
+        EXPECT_EQ(item->param1, next++);
+        queue.workProcessed(item);
+    }
+    batch.clear();
+    EXPECT_FALSE(queue.getWork(batch));
+    EXPECT_TRUE(queue.isDone(total));
+}
+
+/* one worker, the tasks posted first : order (param1) in which the scheduler gives them out */
+static std::vector<uint64_t> sched_dispatch(WorkQueue& queue, std::vector<std::unique_ptr<CustomTaskItem>>& items,
+                                            std::vector<size_t>* batch_sizes = nullptr) {
+    for (auto& item : items)
+        queue.submitWork(item.get());
+    queue.finish();
+
+    std::vector<uint64_t> order;
+    std::vector<CustomTaskItem*> batch;
+    while (queue.getWork(batch)) {
+        if (batch_sizes)
+            batch_sizes->push_back(batch.size());
+        for (auto item : batch) {
+            order.push_back(item->param1);
+            queue.workProcessed(item);
+        }
+        batch.clear();
+    }
+    return order;
+}
+
+/* tasks of random types on a few polynomials : in-place ops (poly written, poly2 read), Plus (poly read,
+    poly2 written) and NTTs of two moduli (poly written) */
+static std::vector<std::unique_ptr<CustomTaskItem>> make_sched_items(uint32_t n, char* polys, uint32_t num_polys) {
+    std::mt19937 rng(12345);
+    const int types[] = {TASK_TYPE_PlusInPlace, TASK_TYPE_Plus, TASK_TYPE_SwitchFormatForwardTransform,
+                         TASK_TYPE_SwitchFormatInverseTransform};
+    std::vector<std::unique_ptr<CustomTaskItem>> items;
+    for (uint32_t i = 0; i < n; i++) {
+        int type = types[rng() % 4];
+        items.emplace_back(new CustomTaskItem(type));
+        items.back()->param1  = i;
+        items.back()->modulus = 1 + rng() % 2;
+        items.back()->poly    = &polys[rng() % num_polys];
+        if (!task_is_ntt(type)) {
+            char* poly2 = &polys[rng() % num_polys];
+            if (poly2 != items.back()->poly)
+                items.back()->poly2 = poly2;
+        }
+    }
+    return items;
+}
+
+/* a and b conflict when they share a polynomial and one of them writes it */
+static bool sched_conflict(const CustomTaskItem* a, const CustomTaskItem* b) {
+    bool conflict = false;
+    for_each_task_poly(a, [&](void* p, bool write_a) {
+        for_each_task_poly(b, [&](void* q, bool write_b) {
+            if (p == q && (write_a || write_b))
+                conflict = true;
+        });
+    });
+    return conflict;
+}
+
+/* the scheduler reorders, but every task is given out once and a task never goes before
+    an earlier posted task it conflicts with (RAW, WAR, WAW) */
+TEST(UTWorkQueue, scheduler_keeps_dependencies) {
+    WorkQueue queue;
+    queue.setScheduler(WQ_SCHED_WINDOW);
+    queue.setSchedulerResidentPolys(4);
+
+    char polys[WQ_POLYS];
+    auto items = make_sched_items(WQ_SCHED_TASKS, polys, WQ_POLYS);
+    std::vector<uint64_t> order = sched_dispatch(queue, items);
+
+    ASSERT_EQ(order.size(), (size_t)WQ_SCHED_TASKS);
+    std::vector<int64_t> position(WQ_SCHED_TASKS, -1);
+    for (size_t k = 0; k < order.size(); k++) {
+        ASSERT_EQ(position[order[k]], -1) << "task " << order[k] << " given out twice";
+        position[order[k]] = k;
+    }
+    for (uint32_t j = 0; j < WQ_SCHED_TASKS; j++) {
+        for (uint32_t i = (j > WQ_SCHED_WINDOW * 4 ? j - WQ_SCHED_WINDOW * 4 : 0); i < j; i++) {
+            if (sched_conflict(items[i].get(), items[j].get()))
+                ASSERT_LT(position[i], position[j]) << "task " << j << " went before task " << i;
+        }
+    }
+
+    const SchedulerStat& stat = queue.getSchedulerStat();
+    EXPECT_EQ(stat.tasks, (uint64_t)WQ_SCHED_TASKS);
+    EXPECT_GT(stat.reordered, 0u);
+    EXPECT_LT(stat.max_distance, (uint64_t)WQ_SCHED_WINDOW);
+    EXPECT_GT(stat.ntt_batches, 0u);
+    EXPECT_TRUE(queue.isDone(WQ_SCHED_TASKS));
+}
+
+/* the same with WQ_CONSUMERS workers : conflicting tasks do not overlap and keep their posted order */
+TEST(UTWorkQueue, scheduler_workers) {
+    WorkQueue queue;
+    queue.setNumWorkers(WQ_CONSUMERS);
+    queue.setScheduler(WQ_SCHED_WINDOW);
+
+    char polys[WQ_POLYS];
+    auto items = make_sched_items(WQ_SCHED_TASKS, polys, WQ_POLYS);
+    std::vector<uint64_t> start(WQ_SCHED_TASKS, 0);
+    std::vector<uint64_t> end(WQ_SCHED_TASKS, 0);
+    std::vector<std::atomic<uint32_t>> seen(WQ_SCHED_TASKS);
+    for (auto& s : seen)
+        s.store(0);
+    std::atomic<uint64_t> clock{1};
+
+    std::vector<std::thread> consumers;
+    for (uint32_t w = 0; w < WQ_CONSUMERS; w++) {
+        consumers.emplace_back([&, w] {
+            queue.markConsumerThread();
+            std::vector<CustomTaskItem*> batch;
+            while (queue.getWork(batch, w)) {
+                for (auto item : batch) {
+                    start[item->param1] = clock.fetch_add(1);
+                    seen[item->param1].fetch_add(1);
+                    std::this_thread::yield();
+                    end[item->param1] = clock.fetch_add(1);
+                    queue.workProcessed(item);
+                }
+                batch.clear();
+            }
+        });
+    }
+    for (auto& item : items)
+        queue.submitWork(item.get());
+    queue.finish();
+    for (auto& t : consumers)
+        t.join();
+
+    for (uint32_t j = 0; j < WQ_SCHED_TASKS; j++) {
+        ASSERT_EQ(seen[j].load(), 1u) << "task " << j;
+        for (uint32_t i = (j > WQ_SCHED_WINDOW * 4 ? j - WQ_SCHED_WINDOW * 4 : 0); i < j; i++) {
+            if (sched_conflict(items[i].get(), items[j].get()))
+                ASSERT_LT(end[i], start[j]) << "task " << j << " started before task " << i << " ended";
+        }
+    }
+    EXPECT_TRUE(queue.isDone(WQ_SCHED_TASKS));
+}
+
+/* a task on a polynomial of the residency model goes first, the model in posted order would have lost it,
+    window 0 keeps the posted order */
+TEST(UTWorkQueue, scheduler_residency) {
+    char polys[3]; // a, b, c
+    const uint32_t poly_of[] = {0, 1, 2, 0};
+    for (uint32_t window : {0u, 8u}) {
+        WorkQueue queue;
+        queue.setScheduler(window);
+        queue.setSchedulerResidentPolys(2);
+
+        auto items = make_items(4, 1);
+        for (uint32_t i = 0; i < 4; i++)
+            items[i]->poly = &polys[poly_of[i]];
+        std::vector<uint64_t> order = sched_dispatch(queue, items);
+
+        if (window == 0) {
+            EXPECT_EQ(order, std::vector<uint64_t>({0, 1, 2, 3}));
+            continue;
+        }
+        EXPECT_EQ(order, std::vector<uint64_t>({0, 3, 1, 2}));
+        const SchedulerStat& stat = queue.getSchedulerStat();
+        EXPECT_EQ(stat.tasks, 4u);
+        EXPECT_EQ(stat.reordered, 1u);
+        EXPECT_EQ(stat.max_distance, 2u);
+        EXPECT_EQ(stat.poly_uses, 4u);
+        EXPECT_EQ(stat.resident_hits, 1u);
+        EXPECT_EQ(stat.inorder_hits, 0u);
+    }
+}
+
+/* independent NTTs go in batches of one type and modulus, at most SCHED_NTT_BATCH tasks */
+TEST(UTWorkQueue, scheduler_ntt_batches) {
+    WorkQueue queue;
+    queue.setScheduler(WQ_SCHED_WINDOW);
+
+    const uint32_t total = 12;
+    char polys[total];
+    std::vector<std::unique_ptr<CustomTaskItem>> items;
+    for (uint32_t i = 0; i < total; i++) {
+        items.emplace_back(new CustomTaskItem(TASK_TYPE_SwitchFormatForwardTransform));
+        items.back()->param1  = i;
+        items.back()->modulus = (i % 2) ? 7 : 5;
+        items.back()->poly    = &polys[i];
+    }
+    items.emplace_back(new CustomTaskItem(TASK_TYPE_SwitchFormatInverseTransform));
+    items.back()->param1  = total;
+    items.back()->modulus = 5;
+    items.back()->poly    = &polys[0];
+
+    std::vector<size_t> sizes;
+    std::vector<uint64_t> order = sched_dispatch(queue, items, &sizes);
+
+    // 6 NTTs of modulus 5, then the inverse NTT (waited for the NTT on its polynomial, now resident),
+    // then the 6 of modulus 7
+    EXPECT_EQ(sizes, std::vector<size_t>({6, 1, 6}));
+    EXPECT_EQ(order, std::vector<uint64_t>({0, 2, 4, 6, 8, 10, 12, 1, 3, 5, 7, 9, 11}));
+    EXPECT_EQ(queue.getSchedulerStat().ntt_batches, 2u);
+    EXPECT_EQ(queue.getSchedulerStat().ntt_batched, 12u);
+}
+
+/* a queued head bypassed window times by tasks on resident polynomials is taken first */
+TEST(UTWorkQueue, scheduler_no_starvation) {
+    WorkQueue queue;
+    queue.setScheduler(2);
+
+    char polys[2]; // r : resident, x : the starving task
+    auto items = make_items(6, 1);
+    for (uint32_t i = 0; i < 6; i++)
+        items[i]->poly = &polys[i == 1 ? 1 : 0];
+    std::vector<uint64_t> order = sched_dispatch(queue, items);
+
+    EXPECT_EQ(order, std::vector<uint64_t>({0, 2, 3, 1, 4, 5}));
+    EXPECT_EQ(queue.getSchedulerStat().forced, 1u);
+}
+
+/* the same ops with one worker on the default profile and with WQ_CONSUMERS workers, async offload and
+    tiers of a few entries, so the workers touch the tracking structure (pin, insert, evict) at the same time */
+TEST(UTWorkQueue, consumer_workers_shadow_tracking) {
+    const usint m      = 2048;
+    const usint towers = 12;
+    const usint polys  = 8;
+    std::vector<NativeInteger> moduli, roots;
+    NativeInteger q = FirstPrime<NativeInteger>(50, m);
+    for (usint i = 0; i < towers; i++) {
+        moduli.push_back(q);
+        roots.push_back(RootOfUnity<NativeInteger>(m, q));
+        q = NextPrime<NativeInteger>(q, m);
+    }
+    auto params = std::make_shared<ILDCRTParams<BigInteger>>(m, moduli, roots);
+
+    DCRTPoly::DugType dug;
+    std::vector<DCRTPoly> init;
+    for (usint k = 0; k < 2 * polys; k++)
+        init.emplace_back(dug, params, Format::EVALUATION);
+
+    // ops sharing polynomials, tasks of one polynomial keep their order
+    auto run = [&]() {
+        std::vector<DCRTPoly> a(init.begin(), init.begin() + polys);
+        std::vector<DCRTPoly> b(init.begin() + polys, init.end());
+        for (usint r = 0; r < 3; r++) {
+            for (usint k = 0; k < polys; k++) {
+                a[k] += b[k];
+                a[k] *= b[(k + 1) % polys];
+                b[k] -= a[(k + 3) % polys];
+            }
+        }
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+    };
+    std::vector<DCRTPoly> expected = run();
+
+    HardwareProfile saved   = hw_profile;
+    HardwareProfile profile = hw_profile;
+    profile.tier_bytes[HW_TIER_OCB] = 6 * profile.poly_bytes();
+    profile.tier_bytes[HW_TIER_HBM] = 12 * profile.poly_bytes();
+
+    stop_consumer_workers();
+    set_num_consumer_workers(WQ_CONSUMERS);
+    set_hardware_profile(profile);
+    init_stat();
+    set_async_offload(true);
+
+    std::vector<DCRTPoly> result = run();
+    wait_offload_all();
+    for (usint k = 0; k < result.size(); k++) {
+        for (usint i = 0; i < towers; i++) {
+            const NativePoly& x = result[k].GetElementAtIndex(i);
+            const NativePoly& y = expected[k].GetElementAtIndex(i);
+            for (usint j = 0; j < m / 2; j++)
+                ASSERT_EQ(x.at(j), y.at(j)) << "polynomial " << k << " tower " << i << " index " << j;
+        }
+    }
+    result.clear();
+
+    set_async_offload(false);
+    stop_consumer_workers();
+    set_num_consumer_workers(1);
+    set_hardware_profile(saved);
+    init_stat();
+}
@@ -53,10 +53,7 @@ void print_stat();
 void print_memory_stat();
 void set_num_prallel_jobs(uint32_t num_parallel);
 
-extern uint32_t OCB_MB;
 extern uint32_t BOOT_SCHEME;
-extern uint32_t cnt_copy_from_other_shadow2;
-extern uint32_t cnt_copy_from_other_shadow3;
 
 int main(int argc, char* argv[]) {
     // We run the example with 8 slots and ring dimension 4096 to illustrate how to run bootstrapping with a sparse plaintext.
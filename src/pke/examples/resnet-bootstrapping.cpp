@@ -38,6 +38,8 @@ Example for CKKS bootstrapping with sparse packing
 #define PROFILE
 
 #include "openfhe.h"
+#include "utils/hw_profile.h"
+#include "utils/perf_counters.h"
 #include <thread>
 #include <cstdlib>
 
@@ -46,6 +48,7 @@ using namespace std;
 
 usint Initialize(CryptoContext<DCRTPoly>& cryptoContext, KeyPair<lbcrypto::DCRTPoly>& keyPair, uint32_t numSlots);
 void BootstrapExample(CryptoContext<DCRTPoly> cryptoContext, KeyPair<lbcrypto::DCRTPoly> keyPair, uint32_t numSlots, usint depth);
+void BatchBootstrapExample(CryptoContext<DCRTPoly> cryptoContext, KeyPair<lbcrypto::DCRTPoly> keyPair, uint32_t numSlots, uint32_t num);
 
 void init_stat();
 void init_stat_no_workqueue();
@@ -55,28 +58,22 @@ void print_memory_stat();
 void set_num_prallel_jobs(uint32_t num_parallel);
 void print_elapsed_busywating_();
 void init_elapsed_busywaiting_();
+void set_async_offload(bool enable);
+void set_num_consumer_workers(uint32_t num_workers);
+bool set_eviction_policy(const char* name);
+bool set_eviction_oracle(const char* path);
+bool set_eviction_access_trace(const char* path);
+void set_task_scheduler(uint32_t window);
+void set_bconv_batch_width(uint32_t width);
+void set_limb_parallel(bool enable);
+void set_prefetch(bool enable);
+void set_double_hoisting(bool enable);
+void set_hardware_profile(const HardwareProfile& profile);
+bool set_device_placement(uint32_t devices, const char* policy);
 
-extern uint32_t FPGA_N;
-extern uint32_t OCB_MB;
-extern uint32_t HBM_GB;
 extern uint32_t BOOT_SCHEME;
-extern uint32_t cnt_copy_from_shadow_ocb_real;
-extern uint32_t cnt_copy_from_shadow_hbm_real;
-extern uint32_t cnt_copy_to_shadow_real;
-extern uint32_t cnt_copy_from_other_shadow1;
-extern uint32_t cnt_copy_from_other_shadow2;
-extern uint32_t cnt_copy_from_other_shadow3;
-extern uint32_t cnt_copy_from_other_shadow4;
 extern size_t AUXMODSIZE;
 
-extern uint32_t cnt_ntt;
-extern uint32_t cnt_intt;
-extern uint32_t cnt_auto;
-extern uint32_t cnt_add;
-extern uint32_t cnt_sub;
-extern uint32_t cnt_mult;
-extern uint32_t cnt_bconv_up;
-extern uint32_t cnt_bconv_down;
 
 extern bool compute_flag;
 extern void clear_tracking_object();
@@ -108,15 +105,39 @@ void print_moduli_chain(const DCRTPoly& poly){
 }
 
 int main(int argc, char* argv[]){
-    // FPGA_N = atoi(argv[1]);
-    OCB_MB = atoi(argv[1]); // On-Chip Buffer Size
-    HBM_GB = 16; 
-    // BOOT_SCHEME = 1; // Normal: 1, on-the-fly only evk b: 2, on-the-fly all: 3
+    /* hardware profile : FHE_HW_PROFILE file (or defaults), on-chip buffer size and HBM size of the arguments */
+    HardwareProfile profile = hw_profile;
+    profile.set("ocb_mb", atof(argv[1])); // On-Chip Buffer Size
+    profile.set("hbm_gb", 16);
+    set_hardware_profile(profile);
     uint32_t BOOT_NUM = atoi(argv[2]); // Number of bootstrapping : 1~4
-    uint32_t BATSEQ = atoi(argv[3]); // Batching: 1, Sequential: 2
-
-    // std::cout << "OCB_MB: " << OCB_MB << " BOOT_SCHEME: " << BOOT_SCHEME << " BOOT_NUM: " << BOOT_NUM << " BATSEQ: " << BATSEQ << std::endl;
-
+    uint32_t BATSEQ = atoi(argv[3]); // Batching: 1, Sequential: 2, Batched API (EvalBootstrap of a vector, keys shared): 3
+    bool ASYNC = (argc > 5) ? atoi(argv[5]) : false; // Async offload: 1, Blocking offload: 0 (default)
+    uint32_t WORKERS = (argc > 6) ? atoi(argv[6]) : 1; // Number of consumer workers
+    std::string EVICTION = (argc > 7) ? argv[7] : "FIFO"; // Eviction policy: FIFO (default), LRU, CLOCK, Belady
+    /* Belady: access trace recorded by a previous run (argv[8]), others: record the access trace to argv[8] */
+    const char* EVICTION_TRACE = (argc > 8) ? argv[8] : "evictiontrace.bin";
+    uint32_t SCHED_WINDOW = (argc > 9) ? atoi(argv[9]) : 0; // Reorder window of the task scheduler (0: posted order)
+    uint32_t BCONV_WIDTH = (argc > 10) ? atoi(argv[10]) : 5; // Source limbs per base conversion task (0: all)
+    bool LIMB_PARALLEL = (argc > 11) ? atoi(argv[11]) : false; // Limbs of DCRTPoly ops posted from OpenMP threads: 1
+    BOOT_SCHEME = (argc > 12) ? atoi(argv[12]) : 1; // Normal: 1, seeded evk (only b and the seed of a stored): 2, 3
+    bool PREFETCH = (argc > 13) ? atoi(argv[13]) : false; // Prefetch hints of the evk limbs: 1
+    uint32_t DEVICES = (argc > 14) ? atoi(argv[14]) : 1; // Number of emulated devices the limbs are spread over
+    const char* PLACEMENT = (argc > 15) ? argv[15] : "limb"; // Limb placement: limb (round-robin), digit (key-switch digit per device)
+    bool DOUBLE_HOIST = (argc > 16) ? atoi(argv[16]) : false; // Giant steps of CoeffsToSlots/SlotsToCoeffs summed in the extended basis: 1
+
+    // std::cout << "OCB_MB: " << argv[1] << " BOOT_SCHEME: " << BOOT_SCHEME << " BOOT_NUM: " << BOOT_NUM << " BATSEQ: " << BATSEQ << std::endl;
+
+    if(!set_device_placement(DEVICES, PLACEMENT)) return 1;
+    set_num_consumer_workers(WORKERS);
+    set_task_scheduler(SCHED_WINDOW);
+    set_bconv_batch_width(BCONV_WIDTH);
+    set_limb_parallel(LIMB_PARALLEL);
+    set_prefetch(PREFETCH);
+    set_double_hoisting(DOUBLE_HOIST);
+    if(!set_eviction_policy(EVICTION.c_str())) return 1;
+    if(EVICTION == "Belady" || EVICTION == "belady") set_eviction_oracle(EVICTION_TRACE);
+    else if(argc > 8) set_eviction_access_trace(EVICTION_TRACE);
     init_stat();
     print_memory_stat();
     uint32_t numSlots = 1<<14; // Fully-Packed (numSlots = (logN)/2) / also logN/4+1 < slot -> fully packed
@@ -255,9 +276,14 @@ int main(int argc, char* argv[]){
 
     init_stat_no_workqueue();
     init_elapsed_busywaiting_();
+    PerfSnapshot boot_start = perf_snapshot();
+    set_async_offload(ASYNC);
     std::vector<std::thread> threads;
 
-    if(BATSEQ == 2){ // Sequential
+    if(BATSEQ == 3){ // Batched API, each rotation key applied to all ciphertexts before the next one
+        BatchBootstrapExample(cc, keys, numSlots, BOOT_NUM);
+    }
+    else if(BATSEQ == 2){ // Sequential
 
         for(size_t i=0; i<BOOT_NUM; i++)
         {
@@ -325,22 +351,29 @@ int main(int argc, char* argv[]){
     print_stat();
     print_elapsed_busywating_();
     print_memory_stat();
+    PerfSnapshot stat = perf_snapshot() - boot_start;
+    perf_write_json("boot_counters.json", stat);
+    if(compute_flag) {
+        // binary command trace -> commandrecord.csv for replay.py
+        trace_close();
+        trace_to_csv("commandrecord.bin", "commandrecord.csv");
+    }
 
     // std::cout << "logN: " << logN << " logp: " << logp << " logq: " << logq << " dnum: " << dnum << std::endl;
     std::ofstream file("boot_result2.csv", std::ios::app);
     if (file.is_open()) {
-        file << OCB_MB << ", " << BOOT_NUM << ", " <<
+        file << hw_profile.tier_bytes[HW_TIER_OCB] / MB_TO_BYTES << ", " << BOOT_NUM << ", " <<
             /*BATSEQ << ", " <<*/ dnum
-            << ", " << cnt_copy_from_shadow_ocb_real
-            << ", " << cnt_copy_from_shadow_hbm_real
-            << ", " << cnt_copy_to_shadow_real
-            << ", " << cnt_copy_from_other_shadow1
-            << ", " << cnt_copy_from_other_shadow2
-            << ", " << cnt_copy_from_other_shadow3
-            << ", " << cnt_copy_from_other_shadow4
-            << ", " << cnt_ntt << ", " << cnt_intt << ", " << cnt_auto
-            << ", " << cnt_add << ", " << cnt_sub << ", " << cnt_mult 
-            << ", " << cnt_bconv_up << ", " << cnt_bconv_down << std::endl;
+            << ", " << stat[PERF_CNT_COPY_FROM_SHADOW_OCB_REAL]
+            << ", " << stat[PERF_CNT_COPY_FROM_SHADOW_HBM_REAL]
+            << ", " << stat[PERF_CNT_COPY_TO_SHADOW_REAL]
+            << ", " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW1]
+            << ", " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW2]
+            << ", " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW3]
+            << ", " << stat[PERF_CNT_COPY_FROM_OTHER_SHADOW4]
+            << ", " << stat[PERF_CNT_NTT] << ", " << stat[PERF_CNT_INTT] << ", " << stat[PERF_CNT_AUTO]
+            << ", " << stat[PERF_CNT_ADD] << ", " << stat[PERF_CNT_SUB] << ", " << stat[PERF_CNT_MULT]
+            << ", " << stat[PERF_CNT_BCONV_UP] << ", " << stat[PERF_CNT_BCONV_DOWN] << std::endl;
         file.close();
     }
 
@@ -456,3 +489,29 @@ void BootstrapExample(CryptoContext<DCRTPoly> cryptoContext, KeyPair<lbcrypto::D
     // // result->SetLength(numSlots>10?10:numSlots);
     // // std::cout << "Output after bootstrapping4 \n\t" << result << std::endl;
 }
+
+void BatchBootstrapExample(CryptoContext<DCRTPoly> cryptoContext, KeyPair<lbcrypto::DCRTPoly> keyPair, uint32_t numSlots, uint32_t num) {
+    compute_flag = true;
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<> dis(0.0, 1.0);
+
+    // num depleted ciphertexts of random inputs
+    std::vector<Ciphertext<DCRTPoly>> ciphs;
+    for (uint32_t n = 0; n < num; n++) {
+        std::vector<double> x;
+        for (size_t i = 0; i < numSlots; i++) {
+            x.push_back(dis(gen));
+        }
+        Plaintext ptxt = cryptoContext->MakeCKKSPackedPlaintext(x, 1, 3, nullptr, numSlots);
+        ciphs.push_back(cryptoContext->Encrypt(keyPair.publicKey, ptxt));
+    }
+    std::cout << "Initial number of levels remaining: " << ciphs[0]->GetLevel() << ", batch of " << num << std::endl;
+
+    auto ciphertextsAfter = cryptoContext->EvalBootstrap(ciphs);
+
+    for (auto& ciphertextAfter : ciphertextsAfter) {
+        std::cout << "Number of levels remaining after bootstrapping: " << ciphertextAfter->GetLevel() << std::endl;
+        decrypt_and_print(ciphertextAfter, cryptoContext, keyPair, 10);
+    }
+}
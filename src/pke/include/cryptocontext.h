@@ -2480,6 +2480,34 @@ public:
         return EvalLinearWSumMutable(ciphertextVec, constantsVec);
     }
 
+    /**
+   * EvalSumOfProducts - sum of ciphertextVec1[i] * ciphertextVec2[i] (inner product of two
+   * vectors of ciphertexts). The products are accumulated with three elements and relinearized
+   * once, n key switchings become one. Supported only in CKKS.
+   *
+   * @param ciphertextVec1& a list of multipliers
+   * @param ciphertextVec2& a list of multiplicands of the same size
+   * @return new ciphertext containing the sum of products
+   */
+    Ciphertext<Element> EvalSumOfProducts(const std::vector<ConstCiphertext<Element>>& ciphertextVec1,
+                                          const std::vector<ConstCiphertext<Element>>& ciphertextVec2) const {
+        return GetScheme()->EvalSumOfProducts(ciphertextVec1, ciphertextVec2);
+    }
+
+    /**
+   * EvalSumOfProductsNoRelin - sum of ciphertextVec1[i] * ciphertextVec2[i] without
+   * relinearization (three elements), for sums continued by the caller (EvalAdd,
+   * EvalLinearWSum) before one Relinearize. Supported only in CKKS.
+   *
+   * @param ciphertextVec1& a list of multipliers
+   * @param ciphertextVec2& a list of multiplicands of the same size
+   * @return new ciphertext containing the sum of products
+   */
+    Ciphertext<Element> EvalSumOfProductsNoRelin(const std::vector<ConstCiphertext<Element>>& ciphertextVec1,
+                                                 const std::vector<ConstCiphertext<Element>>& ciphertextVec2) const {
+        return GetScheme()->EvalSumOfProductsNoRelin(ciphertextVec1, ciphertextVec2);
+    }
+
     //------------------------------------------------------------------------------
     // Advanced SHE EVAL POLYNOMIAL
     //------------------------------------------------------------------------------
@@ -3262,6 +3290,23 @@ public:
         return GetScheme()->EvalBootstrap(ciphertext, numIterations, precision);
     }
 
+    /**
+   * Bootstrapping of a batch of ciphertexts. Same result as EvalBootstrap of every ciphertext,
+   * but CoeffsToSlots, approximate modular reduction and SlotsToCoeffs are run stage by stage
+   * for the whole batch: every rotation key is applied to all ciphertexts before the next key,
+   * so the key is loaded once per batch instead of once per ciphertext.
+   * All ciphertexts must have the same key and number of slots.
+   *
+   * @param ciphertexts the input ciphertexts.
+   * @param numIterations number of iterations to run iterative bootstrapping (Meta-BTS).
+   * @param precision precision of initial bootstrapping algorithm.
+   * @return the refreshed ciphertexts, in the order of the input.
+   */
+    std::vector<Ciphertext<Element>> EvalBootstrap(const std::vector<Ciphertext<Element>>& ciphertexts,
+                                                   uint32_t numIterations = 1, uint32_t precision = 0) const {
+        return GetScheme()->EvalBootstrap(ciphertexts, numIterations, precision);
+    }
+
     //------------------------------------------------------------------------------
     // Scheme switching Methods
     //------------------------------------------------------------------------------
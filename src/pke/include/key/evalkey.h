@@ -224,6 +224,36 @@ public:
         OPENFHE_THROW(not_implemented_error, "GetAinDCRT operation not supported");
     }
 
+    /**
+   * Setter function to store the seed of the A vector (seeded evaluation key).
+   * Throws exception, to be overridden by derived class.
+   *
+   * @param &seed is the 16-word BLAKE2 seed, A is expanded from it limb by limb.
+   */
+    virtual void SetASeed(const std::vector<uint32_t>& seed) {
+        OPENFHE_THROW(not_implemented_error, "SetASeed operation not supported");
+    }
+
+    /**
+   * Getter function to access the seed of the A vector.
+   *
+   * @return  seed, empty if A is stored as it is.
+   */
+    virtual const std::vector<uint32_t>& GetASeed() const {
+        static const std::vector<uint32_t> noSeed;
+        return noSeed;
+    }
+
+    /**
+   * Getter function to access Relinearization Element Vector A, a seeded A is expanded from its seed.
+   * Throws exception, to be overridden by derived class.
+   *
+   * @return Element vector A.
+   */
+    virtual std::vector<Element> GetAVectorExpanded() const {
+        OPENFHE_THROW(not_implemented_error, "GetAVectorExpanded operation not supported");
+    }
+
     virtual void ClearKeys() {
         OPENFHE_THROW(not_implemented_error, "ClearKeys operation is not supported");
     }
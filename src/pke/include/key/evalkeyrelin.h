@@ -68,7 +68,8 @@ public:
    *@param &rhs key to copy from
    */
     explicit EvalKeyRelinImpl(const EvalKeyRelinImpl<Element>& rhs) : EvalKeyImpl<Element>(rhs.GetCryptoContext()) {
-        m_rKey = rhs.m_rKey;
+        m_rKey  = rhs.m_rKey;
+        m_aSeed = rhs.m_aSeed;
     }
 
     /**
@@ -77,7 +78,8 @@ public:
    *@param &rhs key to move from
    */
     explicit EvalKeyRelinImpl(EvalKeyRelinImpl<Element>&& rhs) : EvalKeyImpl<Element>(rhs.GetCryptoContext()) {
-        m_rKey = std::move(rhs.m_rKey);
+        m_rKey  = std::move(rhs.m_rKey);
+        m_aSeed = std::move(rhs.m_aSeed);
     }
 
     operator bool() const {
@@ -92,6 +94,7 @@ public:
     const EvalKeyRelinImpl<Element>& operator=(const EvalKeyRelinImpl<Element>& rhs) {
         this->context = rhs.context;
         this->m_rKey  = rhs.m_rKey;
+        this->m_aSeed = rhs.m_aSeed;
         return *this;
     }
 
@@ -104,6 +107,7 @@ public:
         this->context = rhs.context;
         rhs.context   = 0;
         m_rKey        = std::move(rhs.m_rKey);
+        m_aSeed       = std::move(rhs.m_aSeed);
         return *this;
     }
 
@@ -231,9 +235,42 @@ public:
         return m_dcrtKeys.at(1);
     }
 
+    /**
+   * Setter function to store the seed of the A vector (seeded evaluation key).
+   * Overrides base class implementation.
+   * A of part j is regenerated on the device from the seed, stream (j << 16) | limb index.
+   *
+   * @param &seed is the 16-word BLAKE2 seed.
+   */
+    virtual void SetASeed(const std::vector<uint32_t>& seed) {
+        m_aSeed = seed;
+    }
+
+    /**
+   * Getter function to access the seed of the A vector.
+   * Overrides base class implementation.
+   *
+   * @return  seed, empty if A is stored as it is.
+   */
+    virtual const std::vector<uint32_t>& GetASeed() const {
+        return m_aSeed;
+    }
+
+    /**
+   * Getter function to access Relinearization Element Vector A, a seeded A is expanded from its seed
+   * (same streams as the key generation). For the threshold HE, where A takes part in the arithmetic.
+   * Overrides base class implementation.
+   *
+   * @return Element vector A.
+   */
+    virtual std::vector<Element> GetAVectorExpanded() const {
+        return GetAVector();
+    }
+
     virtual void ClearKeys() {
         m_rKey.clear();
         m_dcrtKeys.clear();
+        m_aSeed.clear();
     }
 
     bool key_compare(const EvalKeyImpl<Element>& other) const {
@@ -242,6 +279,9 @@ public:
         if (!CryptoObject<Element>::operator==(other))
             return false;
 
+        if (this->m_aSeed != oth.m_aSeed)
+            return false;
+
         if (this->m_rKey.size() != oth.m_rKey.size())
             return false;
         for (size_t i = 0; i < this->m_rKey.size(); i++) {
@@ -259,6 +299,8 @@ public:
     void save(Archive& ar, std::uint32_t const version) const {
         ar(::cereal::base_class<EvalKeyImpl<Element>>(this));
         ar(::cereal::make_nvp("k", m_rKey));
+        // seeded key : A vector is empty, only the seed is stored
+        ar(::cereal::make_nvp("s", m_aSeed));
     }
 
     template <class Archive>
@@ -269,12 +311,14 @@ public:
         }
         ar(::cereal::base_class<EvalKeyImpl<Element>>(this));
         ar(::cereal::make_nvp("k", m_rKey));
+        if (version >= 2)
+            ar(::cereal::make_nvp("s", m_aSeed));
     }
     std::string SerializedObjectName() const {
         return "EvalKeyRelin";
     }
     static uint32_t SerializedVersion() {
-        return 1;
+        return 2;
     }
 
 private:
@@ -283,8 +327,14 @@ private:
 
     // Used for hybrid key switching
     std::vector<DCRTPoly> m_dcrtKeys;
+
+    // seed of the A vector (seeded hybrid key switching key), empty : A is stored in m_rKey
+    std::vector<uint32_t> m_aSeed;
 };
 
+template <>
+std::vector<DCRTPoly> EvalKeyRelinImpl<DCRTPoly>::GetAVectorExpanded() const;
+
 }  // namespace lbcrypto
 
 #endif
@@ -45,4 +45,8 @@ CEREAL_REGISTER_TYPE(lbcrypto::EvalKeyRelinImpl<lbcrypto::DCRTPoly>);
 CEREAL_REGISTER_POLYMORPHIC_RELATION(lbcrypto::EvalKeyImpl<lbcrypto::DCRTPoly>,
                                      lbcrypto::EvalKeyRelinImpl<lbcrypto::DCRTPoly>);
 
+// version 2 : the seed of a seeded A vector is stored
+CEREAL_CLASS_VERSION(lbcrypto::EvalKeyRelinImpl<lbcrypto::DCRTPoly>,
+                     lbcrypto::EvalKeyRelinImpl<lbcrypto::DCRTPoly>::SerializedVersion());
+
 #endif
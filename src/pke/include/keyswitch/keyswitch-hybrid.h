@@ -108,6 +108,16 @@ public:
         const std::shared_ptr<std::vector<DCRTPoly>> digits, const EvalKey<DCRTPoly> evalKey,
         const std::shared_ptr<ParmType> paramsQl) const override;
 
+    /**
+   * Prefetch hint of the key limbs used by EvalFastKeySwitchCoreExt at level sizeQl
+   * (Ql and P limbs of b, and of a when the key is not seeded), see PolyImpl::PrefetchToDevice.
+   *
+   * @param evalKey key switching key
+   * @param sizeQl number of Q limbs of the ciphertext
+   * @param digit digit of the key, -1 : every digit
+   */
+    static void PrefetchEvalKey(const EvalKey<DCRTPoly> evalKey, usint sizeQl, int32_t digit = -1);
+
     /////////////////////////////////////////
     // SERIALIZATION
     /////////////////////////////////////////
@@ -57,6 +57,17 @@ public:
     Ciphertext<DCRTPoly> EvalLinearWSumMutable(std::vector<Ciphertext<DCRTPoly>>& ciphertexts,
                                                const std::vector<double>& constants) const override;
 
+    //------------------------------------------------------------------------------
+    // SUM OF PRODUCTS
+    //------------------------------------------------------------------------------
+
+    Ciphertext<DCRTPoly> EvalSumOfProductsNoRelin(
+        const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts1,
+        const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts2) const override;
+
+    Ciphertext<DCRTPoly> EvalSumOfProducts(const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts1,
+                                           const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts2) const override;
+
     //------------------------------------------------------------------------------
     // EVAL POLYNOMIAL
     //------------------------------------------------------------------------------
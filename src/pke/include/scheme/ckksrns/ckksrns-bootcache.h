@@ -0,0 +1,108 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef LBCRYPTO_CRYPTO_CKKSRNS_BOOTCACHE_H
+#define LBCRYPTO_CRYPTO_CKKSRNS_BOOTCACHE_H
+
+#include <stdint.h>
+#include <string>
+
+#include "scheme/ckksrns/ckksrns-fhe.h"
+
+/* On-disk cache of the bootstrapping precomputations (plaintexts of CoeffsToSlots / SlotsToCoeffs)
+    EvalBootstrapSetup encodes thousands of plaintexts at full QP, with the cache directory set
+    (set_boot_precom_cache or FHE_BOOT_CACHE) the setup maps the file of its parameters and only copies
+    the limbs into the plaintexts (no encoding, no NTT). The file is written by the first setup that computes them.
+    File : <dir>/bootprecom-<key>.bin, key = hash of the moduli chain (Q and P), ring dimension, scaling technique,
+           secret key distribution, level budget, dim1 and slots (any change gives another file)
+    Layout : BootCacheHeader, num_records BootCacheRecord, then the data of every plaintext at its offset
+             (num_limbs moduli, num_limbs roots of unity, num_limbs * ring_dim values, all uint64_t, EVALUATION format)
+    The file is written to a temporary name and renamed, worker processes never see a partial file. */
+
+#define BOOT_CACHE_ENV "FHE_BOOT_CACHE"
+#define BOOT_CACHE_MAGIC "FHEBOOTC"
+#define BOOT_CACHE_VERSION 1
+
+/* BootCacheRecord::matrix */
+#define BOOT_CACHE_U0HATT_FFT 0 // CKKSBootstrapPrecom::m_U0hatTPreFFT
+#define BOOT_CACHE_U0_FFT 1 // m_U0PreFFT
+#define BOOT_CACHE_U0HATT 2 // m_U0hatTPre (level budget 1, row 0)
+#define BOOT_CACHE_U0 3 // m_U0Pre
+#define BOOT_CACHE_MATRICES 4
+
+struct BootCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t key;
+    uint32_t ring_dim;
+    uint32_t slots;
+    uint64_t num_records;
+};
+
+/* one entry of a precomputed matrix, num_limbs 0 : empty entry (nullptr plaintext) */
+struct BootCacheRecord {
+    uint32_t matrix;
+    uint32_t row;
+    uint32_t col;
+    uint32_t num_limbs;
+    uint32_t level;
+    uint32_t noise_scale_deg;
+    uint32_t slots;
+    uint32_t reserved;
+    double scaling_factor;
+    uint64_t offset; // of the data from the start of the file
+};
+
+/* directory of the cache files, nullptr or "" : no cache (default FHE_BOOT_CACHE) */
+void set_boot_precom_cache(const char* dir);
+
+namespace lbcrypto {
+
+/* hash of the parameters the precomputations depend on */
+uint64_t BootPrecomKey(const CryptoContextImpl<DCRTPoly>& cc, const std::vector<uint32_t>& levelBudget,
+                       const std::vector<uint32_t>& dim1, uint32_t slots);
+
+/* cache file of a key, "" if no cache directory is set */
+std::string BootPrecomCachePath(uint64_t key);
+
+/* precomputed plaintexts of the file into precom, false if the file does not exist, is not of this key
+    or does not fit precom (rows and entries of m_paramsEnc/m_paramsDec, limbs of the level, values below
+    the moduli), precom is not changed and the setup computes the plaintexts again */
+bool LoadBootPrecom(const CryptoContextImpl<DCRTPoly>& cc, const std::string& path, uint64_t key,
+                    CKKSBootstrapPrecom& precom);
+
+bool SaveBootPrecom(const CryptoContextImpl<DCRTPoly>& cc, const std::string& path, uint64_t key,
+                    const CKKSBootstrapPrecom& precom);
+
+}  // namespace lbcrypto
+
+#endif
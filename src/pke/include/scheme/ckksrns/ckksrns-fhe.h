@@ -135,6 +135,9 @@ public:
     Ciphertext<DCRTPoly> EvalBootstrap(ConstCiphertext<DCRTPoly> ciphertext, uint32_t numIterations,
                                        uint32_t precision) const override;
 
+    std::vector<Ciphertext<DCRTPoly>> EvalBootstrap(const std::vector<Ciphertext<DCRTPoly>>& ciphertexts,
+                                                    uint32_t numIterations, uint32_t precision) const override;
+
     //------------------------------------------------------------------------------
     // Find Rotation Indices
     //------------------------------------------------------------------------------
@@ -185,6 +188,13 @@ public:
     Ciphertext<DCRTPoly> EvalSlotsToCoeffs(const std::vector<std::vector<ConstPlaintext>>& A,
                                            ConstCiphertext<DCRTPoly> ctxt) const;
 
+    // batched versions, each rotation key is applied to all ciphertexts (same level and slots) before the next one
+    std::vector<Ciphertext<DCRTPoly>> EvalCoeffsToSlots(const std::vector<std::vector<ConstPlaintext>>& A,
+                                                        const std::vector<ConstCiphertext<DCRTPoly>>& ctxts) const;
+
+    std::vector<Ciphertext<DCRTPoly>> EvalSlotsToCoeffs(const std::vector<std::vector<ConstPlaintext>>& A,
+                                                        const std::vector<ConstCiphertext<DCRTPoly>>& ctxts) const;
+
     //------------------------------------------------------------------------------
     // SERIALIZATION
     //------------------------------------------------------------------------------
@@ -217,6 +227,14 @@ private:
                                        const CryptoContextImpl<DCRTPoly>& cc);
     static uint32_t GetModDepthInternal(SecretKeyDist secretKeyDist);
 
+    // single iteration bootstrapping of a batch, steps done for the whole batch one after the other
+    std::vector<Ciphertext<DCRTPoly>> EvalBootstrapInternal(
+        const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts) const;
+
+    void EvalBSGSLevel(const std::vector<ConstPlaintext>& A, const std::vector<int32_t>& rotIn,
+                       const std::vector<int32_t>& rotOut, int32_t g, int32_t b, int32_t numRotations,
+                       std::vector<Ciphertext<DCRTPoly>>& ctxts) const;
+
     void AdjustCiphertext(Ciphertext<DCRTPoly>& ciphertext, double correction) const;
 
     void ApplyDoubleAngleIterations(Ciphertext<DCRTPoly>& ciphertext, uint32_t numIt) const;
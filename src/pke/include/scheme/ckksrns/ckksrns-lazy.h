@@ -0,0 +1,136 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef LBCRYPTO_CRYPTO_CKKSRNS_LAZY_H
+#define LBCRYPTO_CRYPTO_CKKSRNS_LAZY_H
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "cryptocontext.h"
+
+/* Lazy evaluation of a static CKKS circuit
+    The ops are recorded into a DAG of placeholder nodes (no computation), the optimization passes rewrite the DAG
+    once and Execute runs it for every new set of input ciphertexts with the CryptoContext ops
+    (LeveledSHECKKSRNS, KeySwitchHYBRID underneath).
+        CKKSLazyCircuit circuit(cc);
+        auto x = circuit.Input(), w = circuit.Input();
+        auto y = circuit.Add(circuit.Rescale(circuit.Mult(x, w)), circuit.Rescale(circuit.Mult(circuit.Rotate(x, 1), w)));
+        circuit.Output(y);
+        circuit.Optimize();
+        auto out = circuit.Execute({ctX, ctW});
+    Passes
+    LAZY_PASS_RESCALE : Add/Sub of two rescaled values (single use) becomes one rescale of the sum,
+                        a sum of products is rescaled once after the accumulation. The levels are only known
+                        at Execute, operands of another level or noise scale degree are rescaled one by one
+    LAZY_PASS_RELIN   : products are kept with three elements while they are only added, subtracted, rescaled or
+                        multiplied by constants/plaintexts, one relinearization where two elements are needed
+                        (Mult, Rotate, outputs)
+    LAZY_PASS_HOIST   : rotations of the same value share one digit decomposition (EvalFastRotationPrecompute)
+    Nodes not needed by an output are removed after the passes, values are released after their last use. */
+
+#define LAZY_OP_INPUT 0
+#define LAZY_OP_ADD 1
+#define LAZY_OP_SUB 2
+#define LAZY_OP_MULT 3 // ciphertext * ciphertext
+#define LAZY_OP_MULT_CONST 4
+#define LAZY_OP_MULT_PLAIN 5
+#define LAZY_OP_ROTATE 6
+#define LAZY_OP_RESCALE 7
+#define LAZY_OP_RELIN 8 // inserted by LAZY_PASS_RELIN
+#define LAZY_OP_NUM 9
+
+#define LAZY_PASS_RESCALE 1
+#define LAZY_PASS_RELIN 2
+#define LAZY_PASS_HOIST 4
+#define LAZY_PASS_ALL (LAZY_PASS_RESCALE | LAZY_PASS_RELIN | LAZY_PASS_HOIST)
+
+namespace lbcrypto {
+
+struct LazyNode {
+    uint32_t op;
+    int32_t arg[2]  = {-1, -1}; // operand nodes
+    int32_t index   = 0;        // LAZY_OP_ROTATE : rotation index, LAZY_OP_INPUT : input position
+    double scalar   = 0;        // LAZY_OP_MULT_CONST
+    ConstPlaintext plaintext;   // LAZY_OP_MULT_PLAIN
+    bool relin      = true;     // LAZY_OP_MULT : relinearized right after the product
+    bool hoisted    = false;    // LAZY_OP_ROTATE : digits of arg[0] shared with the other rotations of arg[0]
+    bool delayed    = false;    // LAZY_OP_ADD/SUB : operands rescaled by the LAZY_OP_RESCALE user (LAZY_PASS_RESCALE)
+};
+
+class CKKSLazyCircuit {
+public:
+    explicit CKKSLazyCircuit(CryptoContext<DCRTPoly> cc) : m_cc(cc) {}
+
+    /* recording, the returned ids are the placeholders of the values */
+    uint32_t Input();
+    uint32_t Add(uint32_t a, uint32_t b);
+    uint32_t Sub(uint32_t a, uint32_t b);
+    uint32_t Mult(uint32_t a, uint32_t b);
+    uint32_t Mult(uint32_t a, double constant);
+    uint32_t Mult(uint32_t a, ConstPlaintext plaintext);
+    uint32_t Rotate(uint32_t a, int32_t index);
+    uint32_t Rescale(uint32_t a);
+    void Output(uint32_t a);
+
+    /* rewrites the DAG (LAZY_PASS_* bits), the ids returned by the recording are not valid after it */
+    void Optimize(uint32_t passes = LAZY_PASS_ALL);
+
+    /* one ciphertext per Input in the order of the Input calls, one result per Output */
+    std::vector<Ciphertext<DCRTPoly>> Execute(const std::vector<ConstCiphertext<DCRTPoly>>& inputs) const;
+
+    const std::vector<LazyNode>& GetNodes() const {
+        return m_nodes;
+    }
+    /* ops per type, relinearizations (LAZY_OP_MULT with relin, LAZY_OP_RELIN) and hoisted rotations */
+    void Print(std::ostream& out) const;
+
+private:
+    uint32_t Append(const LazyNode& node);
+    void CheckNode(uint32_t a) const;
+    std::vector<uint32_t> CountUses() const;
+
+    void DelayRescale();
+    void LazyRelinearize();
+    void HoistRotations();
+    void RemoveDeadNodes();
+
+    CryptoContext<DCRTPoly> m_cc;
+    std::vector<LazyNode> m_nodes; // topological order (operands before their users)
+    std::vector<uint32_t> m_outputs;
+    uint32_t m_numInputs = 0;
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -128,6 +128,39 @@ public:
         OPENFHE_THROW(not_implemented_error, errMsg);
     }
 
+    //------------------------------------------------------------------------------
+    // SUM OF PRODUCTS
+    //------------------------------------------------------------------------------
+
+    /**
+   * Virtual function for computing the sum of the products of two vectors of
+   * ciphertexts (inner product of the vectors) without relinearization.
+   *
+   * @param ciphertextVec1 vector of multipliers.
+   * @param ciphertextVec2 vector of multiplicands (same size).
+   * @return A ciphertext with three elements containing the sum of products.
+   */
+    virtual Ciphertext<Element> EvalSumOfProductsNoRelin(
+        const std::vector<ConstCiphertext<Element>>& ciphertextVec1,
+        const std::vector<ConstCiphertext<Element>>& ciphertextVec2) const {
+        std::string errMsg = "EvalSumOfProductsNoRelin is not implemented for this scheme.";
+        OPENFHE_THROW(not_implemented_error, errMsg);
+    }
+
+    /**
+   * Virtual function for computing the sum of the products of two vectors of
+   * ciphertexts (inner product of the vectors), relinearized once.
+   *
+   * @param ciphertextVec1 vector of multipliers.
+   * @param ciphertextVec2 vector of multiplicands (same size).
+   * @return A ciphertext containing the sum of products.
+   */
+    virtual Ciphertext<Element> EvalSumOfProducts(const std::vector<ConstCiphertext<Element>>& ciphertextVec1,
+                                                  const std::vector<ConstCiphertext<Element>>& ciphertextVec2) const {
+        std::string errMsg = "EvalSumOfProducts is not implemented for this scheme.";
+        OPENFHE_THROW(not_implemented_error, errMsg);
+    }
+
     //------------------------------------------------------------------------------
     // EVAL POLYNOMIAL
     //------------------------------------------------------------------------------
@@ -118,6 +118,21 @@ public:
         OPENFHE_THROW(not_implemented_error, "EvalBootstrap is not implemented for this scheme");
     }
 
+    /**
+   * Bootstrapping of a batch of ciphertexts (same crypto context, key and number of slots).
+   * The steps are run for the whole batch one after the other, so every rotation key
+   * is used for all ciphertexts of the batch while it is loaded.
+   *
+   * @param ciphertexts the input ciphertexts.
+   * @param numIterations number of iterations to run iterative bootstrapping (Meta-BTS).
+   * @param precision precision of initial bootstrapping algorithm.
+   * @return the refreshed ciphertexts, in the order of the input.
+   */
+    virtual std::vector<Ciphertext<Element>> EvalBootstrap(const std::vector<Ciphertext<Element>>& ciphertexts,
+                                                           uint32_t numIterations, uint32_t precision) const {
+        OPENFHE_THROW(not_implemented_error, "EvalBootstrap is not implemented for this scheme");
+    }
+
     /**
    * Sets all parameters for switching from CKKS to FHEW
    *
@@ -1085,6 +1085,31 @@ public:
         return m_AdvancedSHE->EvalLinearWSumMutable(ciphertextVec, constantVec);
     }
 
+    /////////////////////////////////////
+    // Advanced SHE SUM OF PRODUCTS
+    /////////////////////////////////////
+
+    virtual Ciphertext<Element> EvalSumOfProductsNoRelin(
+        const std::vector<ConstCiphertext<Element>>& ciphertextVec1,
+        const std::vector<ConstCiphertext<Element>>& ciphertextVec2) const {
+        VerifyAdvancedSHEEnabled(__func__);
+        if (!ciphertextVec1.size())
+            OPENFHE_THROW(config_error, "Input ciphertext vector is empty");
+        if (ciphertextVec1.size() != ciphertextVec2.size())
+            OPENFHE_THROW(config_error, "Input ciphertext vectors are of different sizes");
+        return m_AdvancedSHE->EvalSumOfProductsNoRelin(ciphertextVec1, ciphertextVec2);
+    }
+
+    virtual Ciphertext<Element> EvalSumOfProducts(const std::vector<ConstCiphertext<Element>>& ciphertextVec1,
+                                                  const std::vector<ConstCiphertext<Element>>& ciphertextVec2) const {
+        VerifyAdvancedSHEEnabled(__func__);
+        if (!ciphertextVec1.size())
+            OPENFHE_THROW(config_error, "Input ciphertext vector is empty");
+        if (ciphertextVec1.size() != ciphertextVec2.size())
+            OPENFHE_THROW(config_error, "Input ciphertext vectors are of different sizes");
+        return m_AdvancedSHE->EvalSumOfProducts(ciphertextVec1, ciphertextVec2);
+    }
+
     /////////////////////////////////////
     // Advanced SHE EVAL POLYNOMIAL
     /////////////////////////////////////
@@ -1358,6 +1383,12 @@ public:
         return m_FHE->EvalBootstrap(ciphertext, numIterations, precision);
     }
 
+    std::vector<Ciphertext<Element>> EvalBootstrap(const std::vector<Ciphertext<Element>>& ciphertexts,
+                                                   uint32_t numIterations = 1, uint32_t precision = 0) const {
+        VerifyFHEEnabled(__func__);
+        return m_FHE->EvalBootstrap(ciphertexts, numIterations, precision);
+    }
+
     // SCHEMESWITCHING methods
 
     std::pair<BinFHEContext, LWEPrivateKey> EvalCKKStoFHEWSetup(const CryptoContextImpl<Element>& cc,
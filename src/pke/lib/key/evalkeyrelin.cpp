@@ -33,5 +33,21 @@
 
 // the code below is from evalkeyrelin-impl.cpp
 namespace lbcrypto {
+
+template <>
+std::vector<DCRTPoly> EvalKeyRelinImpl<DCRTPoly>::GetAVectorExpanded() const {
+    if (m_aSeed.empty())
+        return GetAVector();
+    // A of part j lives on the parameters of B of part j, stream (j << 16) | limb index
+    const std::vector<DCRTPoly>& bv = GetBVector();
+    std::vector<DCRTPoly> av(bv.size());
+    for (size_t j = 0; j < bv.size(); j++) {
+        av[j] = DCRTPoly(bv[j].GetParams(), Format::EVALUATION, true);
+        for (size_t i = 0; i < bv[j].GetNumOfElements(); i++)
+            av[j].ElementAtIndex(i).GenerateSeeded(m_aSeed, (j << 16) | i);
+    }
+    return av;
+}
+
 template class EvalKeyRelinImpl<DCRTPoly>;
 }  // namespace lbcrypto
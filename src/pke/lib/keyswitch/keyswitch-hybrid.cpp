@@ -8,13 +8,19 @@
 #include "scheme/ckksrns/ckksrns-cryptoparameters.h"
 #include "ciphertext.h"
 
+/* evaluation key scheme
+    1 : a and b of the keys are stored and transferred
+    2 : seeded keys, only b and a 16-word seed are stored, a is regenerated limb by limb on the device
+        (TASK_TYPE_SeededUniform) when the key is used
+    3 : same as 2, b depends on the secret key and can not be made from a public seed */
 uint32_t BOOT_SCHEME = 0;
 
 void insert_evk_set(uint64_t evk_addr);
 void insert_evk_map(uint64_t evk_addr);
 void check_evk_map(uint64_t evk_addr);
-extern void clean_shadow_tracking_array(uint64_t m_values_shadow_addr);
+extern void clean_shadow_tracking_array(uint64_t m_values_shadow_addr, uint32_t device);
 extern bool         compute_flag;
+extern bool         prefetch_enabled;
 extern uint64_t     total_sizeQlP;
 
 namespace lbcrypto {
@@ -73,9 +79,31 @@ EvalKey<DCRTPoly> KeySwitchHYBRID::KeySwitchGenInternal(const PrivateKey<DCRTPol
     std::vector<NativeInteger> PModq = cryptoParams->GetPModq();
     size_t numPerPartQ               = cryptoParams->GetNumPerPartQ();
 
+    /* seeded key : a of every part comes from one seed
+        threshold HE reuses the seed of ekPrev (shared a), MultiAddEvalKeys keeps it,
+        MultiAddEvalMultKeys and MultiMultEvalKey compute on a and expand it (GetAVectorExpanded) */
+    std::vector<uint32_t> aSeed;
+    if (ekPrev != nullptr) {
+        aSeed = ekPrev->GetASeed();
+    }
+    else if (BOOT_SCHEME >= 2) {
+        auto& prng = PseudoRandomNumberGenerator::GetPRNG();
+        aSeed.resize(16);
+        for (auto& w : aSeed)
+            w = prng();
+    }
+
     for (size_t part = 0; part < numPartQ; ++part) {
-        DCRTPoly a = (ekPrev == nullptr) ? DCRTPoly(dug, paramsQP, Format::EVALUATION) :    // single-key HE
-                                           ekPrev->GetAVector()[part];                      // threshold HE
+        DCRTPoly a;
+        if (!aSeed.empty()) {
+            a = DCRTPoly(paramsQP, Format::EVALUATION, true);
+            for (size_t i = 0; i < sizeQP; ++i)
+                a.ElementAtIndex(i).GenerateSeeded(aSeed, (part << 16) | i);
+        }
+        else {
+            a = (ekPrev == nullptr) ? DCRTPoly(dug, paramsQP, Format::EVALUATION) :    // single-key HE
+                                      ekPrev->GetAVector()[part];                      // threshold HE
+        }
         DCRTPoly e(dgg, paramsQP, Format::EVALUATION);
         DCRTPoly b(paramsQP, Format::EVALUATION, true);
 
@@ -97,18 +125,25 @@ EvalKey<DCRTPoly> KeySwitchHYBRID::KeySwitchGenInternal(const PrivateKey<DCRTPol
                 b.SetElementAtIndex(i, -ai * sNewi + PModq[i] * sOldi + ns * ei);
             }
         }
-        av[part] = a;
+        // seeded key keeps an empty a, it is never transferred
+        if (aSeed.empty())
+            av[part] = a;
         bv[part] = b;
+        // key limbs stay on the device, they are pulled back only when the key is serialized
         for (size_t i = 0; i < sizeQP; ++i){
-            insert_evk_set((uint64_t)&(av[part].GetElementAtIndex(i).m_values));
-            av[part].GetElementAtIndex(i).copy_from_shadow();
+            if (aSeed.empty())
+                insert_evk_set((uint64_t)&(av[part].GetElementAtIndex(i).m_values));
             insert_evk_set((uint64_t)&(bv[part].GetElementAtIndex(i).m_values));
-            bv[part].GetElementAtIndex(i).copy_from_shadow();
         }
     }
 
+    // seeded key : no A vector at all, only the seed
+    if (!aSeed.empty())
+        av.clear();
     ek->SetAVector(std::move(av));
     ek->SetBVector(std::move(bv));
+    if (!aSeed.empty())
+        ek->SetASeed(aSeed);
     ek->SetKeyTag(newKey->GetKeyTag());
     return ek;
 }
@@ -412,12 +447,36 @@ std::shared_ptr<std::vector<DCRTPoly>> KeySwitchHYBRID::EvalFastKeySwitchCore(
     return std::make_shared<std::vector<DCRTPoly>>(std::initializer_list<DCRTPoly>{std::move(ct0), std::move(ct1)});
 }
 
+void KeySwitchHYBRID::PrefetchEvalKey(const EvalKey<DCRTPoly> evalKey, usint sizeQl, int32_t digit) {
+    if (!prefetch_enabled)
+        return;
+    const std::vector<DCRTPoly>& bv = evalKey->GetBVector();
+    bool seeded                     = !evalKey->GetASeed().empty();
+    const std::vector<DCRTPoly>* av = seeded ? nullptr : &evalKey->GetAVector();
+
+    const auto cryptoParams = std::dynamic_pointer_cast<CryptoParametersRNS>(evalKey->GetCryptoParameters());
+    usint sizeQ             = cryptoParams->GetElementParams()->GetParams().size();
+    usint sizeP             = cryptoParams->GetParamsP()->GetParams().size();
+
+    usint first = (digit < 0) ? 0 : digit;
+    usint last  = (digit < 0) ? bv.size() : std::min<usint>(digit + 1, bv.size());
+    for (usint j = first; j < last; j++) {
+        for (usint i = 0; i < sizeQl + sizeP; i++) {
+            usint idx = (i < sizeQl) ? i : sizeQ + (i - sizeQl);
+            bv[j].GetElementAtIndex(idx).PrefetchToDevice();
+            if (av)
+                (*av)[j].GetElementAtIndex(idx).PrefetchToDevice();
+        }
+    }
+}
+
 std::shared_ptr<std::vector<DCRTPoly>> KeySwitchHYBRID::EvalFastKeySwitchCoreExt(
     const std::shared_ptr<std::vector<DCRTPoly>> digits, const EvalKey<DCRTPoly> evalKey,
     const std::shared_ptr<ParmType> paramsQl) const {
     const auto cryptoParams         = std::dynamic_pointer_cast<CryptoParametersRNS>(evalKey->GetCryptoParameters());
     const std::vector<DCRTPoly>& bv = evalKey->GetBVector();
     const std::vector<DCRTPoly>& av = evalKey->GetAVector();
+    const std::vector<uint32_t>& aSeed = evalKey->GetASeed();
 
     const std::shared_ptr<ParmType> paramsP   = cryptoParams->GetParamsP();
     const std::shared_ptr<ParmType> paramsQlP = (*digits)[0].GetParams();
@@ -429,24 +488,41 @@ std::shared_ptr<std::vector<DCRTPoly>> KeySwitchHYBRID::EvalFastKeySwitchCoreExt
     DCRTPoly cTilda0(paramsQlP, Format::EVALUATION, true);
     DCRTPoly cTilda1(paramsQlP, Format::EVALUATION, true);
 
+    // key limbs of the next digit are staged while the current digit computes
+    PrefetchEvalKey(evalKey, sizeQl, 0);
     for (uint32_t j = 0; j < digits->size(); j++) {
+        if (j + 1 < digits->size())
+            PrefetchEvalKey(evalKey, sizeQl, j + 1);
         const DCRTPoly& cj = (*digits)[j];
         const DCRTPoly& bj = bv[j];
-        const DCRTPoly& aj = av[j];
 
+        /* seeded key : only the limbs of a in QlP are made again from the seed (same streams as the key generation),
+            a never crosses PCIe and takes no HBM space, the limbs are dropped after the digit */
+        DCRTPoly aSeeded;
+        if (!aSeed.empty()) {
+            aSeeded = DCRTPoly(paramsQlP, Format::EVALUATION, true);
+            for (usint i = 0; i < sizeQlP; i++) {
+                usint idx = (i < sizeQl) ? i : sizeQ + (i - sizeQl);
+                aSeeded.ElementAtIndex(i).GenerateSeeded(aSeed, ((uint64_t)j << 16) | idx);
+            }
+        }
+        const DCRTPoly& aj = aSeed.empty() ? av[j] : aSeeded;
+        // limb of aj for the limb i of QlP : aj is on QlP when it is seeded, on QP otherwise
+        usint aOffsetP = aSeed.empty() ? sizeQ : sizeQl;
+
+        /* cTilda0 += cj * bj, cTilda1 += cj * aj in place on the shadows (TASK_TYPE_MulAddDual),
+            no temporary product or sum polynomial per limb */
         for (usint i = 0; i < sizeQl; i++) {
             const auto& cji = cj.GetElementAtIndex(i);
             const auto& aji = aj.GetElementAtIndex(i);
             const auto& bji = bj.GetElementAtIndex(i);
-            cTilda0.SetElementAtIndex(i, cTilda0.GetElementAtIndex(i) + cji * bji);
-            cTilda1.SetElementAtIndex(i, cTilda1.GetElementAtIndex(i) + cji * aji);
+            cTilda0.ElementAtIndex(i).MulAddDualInPlace(cTilda1.ElementAtIndex(i), cji, bji, aji);
         }
         for (usint i = sizeQl, idx = sizeQ; i < sizeQlP; i++, idx++) {
             const auto& cji = cj.GetElementAtIndex(i);
-            const auto& aji = aj.GetElementAtIndex(idx);
+            const auto& aji = aj.GetElementAtIndex(aOffsetP + (i - sizeQl));
             const auto& bji = bj.GetElementAtIndex(idx);
-            cTilda0.SetElementAtIndex(i, cTilda0.GetElementAtIndex(i) + cji * bji);
-            cTilda1.SetElementAtIndex(i, cTilda1.GetElementAtIndex(i) + cji * aji);
+            cTilda0.ElementAtIndex(i).MulAddDualInPlace(cTilda1.ElementAtIndex(i), cji, bji, aji);
         }
     }
     total_sizeQlP += sizeQlP;    
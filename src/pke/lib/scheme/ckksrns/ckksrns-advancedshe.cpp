@@ -104,9 +104,92 @@ Ciphertext<DCRTPoly> AdvancedSHECKKSRNS::EvalLinearWSumMutable(std::vector<Ciphe
 
     cc->ModReduceInPlace(weightedSum);
 
+    /* products given without relinearization (EvalMultNoRelin, EvalSumOfProductsNoRelin) are summed
+        with three elements, one key switching for the whole sum after the rescale (fewer limbs) */
+    if (weightedSum->GetElements().size() > 2)
+        cc->RelinearizeInPlace(weightedSum);
+
     return weightedSum;
 }
 
+//------------------------------------------------------------------------------
+// SUM OF PRODUCTS
+//------------------------------------------------------------------------------
+
+Ciphertext<DCRTPoly> AdvancedSHECKKSRNS::EvalSumOfProductsNoRelin(
+    const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts1,
+    const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts2) const {
+    for (uint32_t i = 0; i < ciphertexts1.size(); i++) {
+        if (!ciphertexts1[i] || !ciphertexts2[i])
+            OPENFHE_THROW(config_error, "Input ciphertext is nullptr");
+        if (ciphertexts1[i]->GetElements().size() != 2 || ciphertexts2[i]->GetElements().size() != 2)
+            OPENFHE_THROW(config_error, "EvalSumOfProducts: input ciphertexts must be relinearized");
+    }
+
+    const auto cryptoParams =
+        std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(ciphertexts1[0]->GetCryptoParameters());
+
+    auto cc   = ciphertexts1[0]->GetCryptoContext();
+    auto algo = cc->GetScheme();
+    auto tech = cryptoParams->GetScalingTechnique();
+
+    /* acc0 += a0 * b0, acc1 += a0 * b1 + a1 * b0, acc2 += a1 * b1 limb by limb (TASK_TYPE_MulAddDual),
+        the tensor product of a pair is never a ciphertext of its own.
+        Pairs at another level or scale than the first one are multiplied alone and added at the end */
+    Ciphertext<DCRTPoly> result;
+    Ciphertext<DCRTPoly> others;
+    std::vector<DCRTPoly> acc;
+    for (uint32_t i = 0; i < ciphertexts1.size(); i++) {
+        // levels and depth of the pair as EvalMult does
+        auto c1 = ciphertexts1[i]->Clone();
+        auto c2 = ciphertexts2[i]->Clone();
+        if (tech == FIXEDMANUAL)
+            algo->AdjustLevelsInPlace(c1, c2);
+        else if (tech != NORESCALE)
+            algo->AdjustLevelsAndDepthToOneInPlace(c1, c2);
+
+        const std::vector<DCRTPoly>& a = c1->GetElements();
+        const std::vector<DCRTPoly>& b = c2->GetElements();
+
+        if (!result) {
+            result = c1->CloneZero();
+            result->SetNoiseScaleDeg(c1->GetNoiseScaleDeg() + c2->GetNoiseScaleDeg());
+            result->SetScalingFactor(c1->GetScalingFactor() * c2->GetScalingFactor());
+            result->SetScalingFactorInt(
+                c1->GetScalingFactorInt().ModMul(c2->GetScalingFactorInt(), cryptoParams->GetPlaintextModulus()));
+            acc.assign(3, DCRTPoly(a[0].GetParams(), Format::EVALUATION, true));
+        }
+        else if (a[0].GetNumOfElements() != acc[0].GetNumOfElements() ||
+                 c1->GetNoiseScaleDeg() + c2->GetNoiseScaleDeg() != result->GetNoiseScaleDeg() ||
+                 c1->GetScalingFactor() * c2->GetScalingFactor() != result->GetScalingFactor()) {
+            auto product = algo->EvalMult(c1, c2);
+            others       = others ? cc->EvalAdd(others, product) : product;
+            continue;
+        }
+
+        for (uint32_t l = 0; l < acc[0].GetNumOfElements(); l++) {
+            acc[0].ElementAtIndex(l).MulAddDualInPlace(acc[1].ElementAtIndex(l), a[0].GetElementAtIndex(l),
+                                                       b[0].GetElementAtIndex(l), b[1].GetElementAtIndex(l));
+            acc[1].ElementAtIndex(l).MulAddDualInPlace(acc[2].ElementAtIndex(l), a[1].GetElementAtIndex(l),
+                                                       b[0].GetElementAtIndex(l), b[1].GetElementAtIndex(l));
+        }
+    }
+    result->SetElements(std::move(acc));
+
+    if (others)
+        cc->EvalAddInPlace(result, others);
+
+    return result;
+}
+
+Ciphertext<DCRTPoly> AdvancedSHECKKSRNS::EvalSumOfProducts(
+    const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts1,
+    const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts2) const {
+    auto result = EvalSumOfProductsNoRelin(ciphertexts1, ciphertexts2);
+    result->GetCryptoContext()->RelinearizeInPlace(result);
+    return result;
+}
+
 //------------------------------------------------------------------------------
 // EVAL POLYNOMIAL
 //------------------------------------------------------------------------------
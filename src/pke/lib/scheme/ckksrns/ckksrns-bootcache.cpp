@@ -0,0 +1,349 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "scheme/ckksrns/ckksrns-bootcache.h"
+
+#include "scheme/ckksrns/ckksrns-cryptoparameters.h"
+#include "cryptocontext.h"
+#include "encoding/ckkspackedencoding.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+static std::string initial_boot_precom_cache() {
+    const char* dir = getenv(BOOT_CACHE_ENV);
+    return (dir && *dir) ? std::string(dir) : std::string();
+}
+
+std::string boot_precom_cache_dir = initial_boot_precom_cache();
+
+void set_boot_precom_cache(const char* dir) {
+    boot_precom_cache_dir = (dir && *dir) ? std::string(dir) : std::string();
+}
+
+namespace lbcrypto {
+
+/* FNV-1a */
+static void hash_u64(uint64_t& h, uint64_t v) {
+    for (uint32_t i = 0; i < 8; i++) {
+        h ^= (v >> (8 * i)) & 0xff;
+        h *= 1099511628211ULL;
+    }
+}
+
+uint64_t BootPrecomKey(const CryptoContextImpl<DCRTPoly>& cc, const std::vector<uint32_t>& levelBudget,
+                       const std::vector<uint32_t>& dim1, uint32_t slots) {
+    const auto cryptoParams = std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(cc.GetCryptoParameters());
+
+    uint64_t h = 14695981039346656037ULL;
+    hash_u64(h, BOOT_CACHE_VERSION);
+    hash_u64(h, NATIVEINT);
+    hash_u64(h, cc.GetCyclotomicOrder());
+    for (const auto& q : cryptoParams->GetElementParams()->GetParams())
+        hash_u64(h, q->GetModulus().ConvertToInt());
+    for (const auto& p : cryptoParams->GetParamsP()->GetParams())
+        hash_u64(h, p->GetModulus().ConvertToInt());
+    hash_u64(h, cryptoParams->GetScalingTechnique());
+    hash_u64(h, cryptoParams->GetSecretKeyDist());
+    hash_u64(h, cryptoParams->GetPlaintextModulus());
+    for (auto b : levelBudget)
+        hash_u64(h, b);
+    for (auto d : dim1)
+        hash_u64(h, d);
+    hash_u64(h, slots);
+    return h;
+}
+
+std::string BootPrecomCachePath(uint64_t key) {
+    if (boot_precom_cache_dir.empty())
+        return std::string();
+    char name[64];
+    snprintf(name, sizeof(name), "/bootprecom-%016llx.bin", (unsigned long long)key);
+    return boot_precom_cache_dir + name;
+}
+
+/* the plaintexts of one matrix in (row, col) order, row 0 for the linear transform ones */
+static std::vector<std::vector<ConstPlaintext>> boot_cache_matrix(const CKKSBootstrapPrecom& precom, uint32_t matrix) {
+    switch (matrix) {
+        case BOOT_CACHE_U0HATT_FFT: return precom.m_U0hatTPreFFT;
+        case BOOT_CACHE_U0_FFT: return precom.m_U0PreFFT;
+        case BOOT_CACHE_U0HATT: return {precom.m_U0hatTPre};
+        case BOOT_CACHE_U0: return {precom.m_U0Pre};
+    }
+    return {};
+}
+
+/* entries per row of every matrix as EvalBootstrapSetup computes them (m_paramsEnc, m_paramsDec),
+    the remainder row is the first one in encoding and the last one in decoding */
+static std::vector<uint32_t> boot_cache_shape(const CKKSBootstrapPrecom& precom, uint32_t matrix) {
+    const std::vector<int32_t>& enc = precom.m_paramsEnc;
+    const std::vector<int32_t>& dec = precom.m_paramsDec;
+    bool isLTBootstrap = (enc[CKKS_BOOT_PARAMS::LEVEL_BUDGET] == 1) && (dec[CKKS_BOOT_PARAMS::LEVEL_BUDGET] == 1);
+
+    switch (matrix) {
+        case BOOT_CACHE_U0HATT_FFT:
+        case BOOT_CACHE_U0_FFT: {
+            if (isLTBootstrap)
+                return {};
+            const std::vector<int32_t>& params = (matrix == BOOT_CACHE_U0HATT_FFT) ? enc : dec;
+            uint32_t levelBudget               = params[CKKS_BOOT_PARAMS::LEVEL_BUDGET];
+            std::vector<uint32_t> rows(levelBudget, params[CKKS_BOOT_PARAMS::NUM_ROTATIONS]);
+            if (params[CKKS_BOOT_PARAMS::LAYERS_REM] != 0 && levelBudget > 0)
+                rows[(matrix == BOOT_CACHE_U0HATT_FFT) ? 0 : levelBudget - 1] =
+                    params[CKKS_BOOT_PARAMS::NUM_ROTATIONS_REM];
+            return rows;
+        }
+        case BOOT_CACHE_U0HATT:
+        case BOOT_CACHE_U0:
+            if (isLTBootstrap)
+                return {precom.m_slots};
+            return {};
+    }
+    return {};
+}
+
+bool SaveBootPrecom(const CryptoContextImpl<DCRTPoly>& cc, const std::string& path, uint64_t key,
+                    const CKKSBootstrapPrecom& precom) {
+    uint32_t N = cc.GetRingDimension();
+
+    std::vector<BootCacheRecord> records;
+    std::vector<ConstPlaintext> plaintexts;
+    for (uint32_t matrix = 0; matrix < BOOT_CACHE_MATRICES; matrix++) {
+        auto rows = boot_cache_matrix(precom, matrix);
+        for (uint32_t row = 0; row < rows.size(); row++) {
+            for (uint32_t col = 0; col < rows[row].size(); col++) {
+                BootCacheRecord rec;
+                memset(&rec, 0, sizeof(rec));
+                rec.matrix = matrix;
+                rec.row    = row;
+                rec.col    = col;
+                const ConstPlaintext& pt = rows[row][col];
+                if (pt) {
+                    rec.num_limbs       = pt->GetElement<DCRTPoly>().GetNumOfElements();
+                    rec.level           = pt->GetLevel();
+                    rec.noise_scale_deg = pt->GetNoiseScaleDeg();
+                    rec.slots           = pt->GetSlots();
+                    rec.scaling_factor  = pt->GetScalingFactor();
+                }
+                records.push_back(rec);
+                plaintexts.push_back(pt);
+            }
+        }
+    }
+
+    uint64_t offset = sizeof(BootCacheHeader) + records.size() * sizeof(BootCacheRecord);
+    for (auto& rec : records) {
+        rec.offset = offset;
+        offset += (uint64_t)rec.num_limbs * (2 + N) * sizeof(uint64_t);
+    }
+
+    BootCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOT_CACHE_MAGIC, sizeof(header.magic));
+    header.version     = BOOT_CACHE_VERSION;
+    header.record_size = sizeof(BootCacheRecord);
+    header.key         = key;
+    header.ring_dim    = N;
+    header.slots       = precom.m_slots;
+    header.num_records = records.size();
+
+    std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+    FILE* fp             = fopen(tmp_path.c_str(), "wb");
+    if (fp == NULL) {
+        std::cerr << "cannot write bootstrapping precomputations " << tmp_path << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (!records.empty())
+        ok = ok && fwrite(records.data(), sizeof(BootCacheRecord), records.size(), fp) == records.size();
+
+    std::vector<uint64_t> data;
+    for (size_t i = 0; ok && i < plaintexts.size(); i++) {
+        if (!plaintexts[i])
+            continue;
+        DCRTPoly element = plaintexts[i]->GetElement<DCRTPoly>();
+        element.SetFormat(Format::EVALUATION);
+        uint32_t num_limbs = records[i].num_limbs;
+        data.assign((uint64_t)num_limbs * (2 + N), 0);
+        for (uint32_t l = 0; l < num_limbs; l++) {
+            const NativePoly& limb = element.GetElementAtIndex(l);
+            data[l]                = limb.GetParams()->GetModulus().ConvertToInt();
+            data[num_limbs + l]    = limb.GetParams()->GetRootOfUnity().ConvertToInt();
+            const auto& values     = limb.GetValues();
+            uint64_t* dst          = &data[2 * num_limbs + (uint64_t)l * N];
+            for (uint32_t j = 0; j < N; j++)
+                dst[j] = values[j].ConvertToInt();
+        }
+        ok = fwrite(data.data(), sizeof(uint64_t), data.size(), fp) == data.size();
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "cannot write bootstrapping precomputations " << path << std::endl;
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadBootPrecom(const CryptoContextImpl<DCRTPoly>& cc, const std::string& path, uint64_t key,
+                    CKKSBootstrapPrecom& precom) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(BootCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    uint64_t size = st.st_size;
+    void* p       = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    const uint8_t* base = (const uint8_t*)p;
+
+    uint32_t M = cc.GetCyclotomicOrder();
+    uint32_t N = cc.GetRingDimension();
+
+    /* the limbs of a plaintext at level l are Q_0..Q_{sizeQ-l-1} and all of P */
+    const auto cryptoParams = std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(cc.GetCryptoParameters());
+    const auto& paramsQ     = cryptoParams->GetElementParams()->GetParams();
+    const auto& paramsP     = cryptoParams->GetParamsP()->GetParams();
+    uint32_t sizeQ          = paramsQ.size();
+    uint32_t sizeP          = paramsP.size();
+
+    const BootCacheHeader* header = (const BootCacheHeader*)base;
+    bool ok = memcmp(header->magic, BOOT_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+              header->version == BOOT_CACHE_VERSION && header->record_size == sizeof(BootCacheRecord) &&
+              header->key == key && header->ring_dim == N && header->slots == precom.m_slots &&
+              header->num_records <= (size - sizeof(BootCacheHeader)) / sizeof(BootCacheRecord);
+
+    std::vector<std::vector<ConstPlaintext>> matrices[BOOT_CACHE_MATRICES];
+    /* plaintexts of the same limbs share their parameters like the ones of the precomputation */
+    std::map<std::vector<uint64_t>, std::shared_ptr<DCRTPoly::Params>> params_map;
+    const BootCacheRecord* records = (const BootCacheRecord*)(base + sizeof(BootCacheHeader));
+    for (uint64_t r = 0; ok && r < header->num_records; r++) {
+        const BootCacheRecord& rec = records[r];
+        uint64_t bytes             = (uint64_t)rec.num_limbs * (2 + N) * sizeof(uint64_t);
+        if (rec.matrix >= BOOT_CACHE_MATRICES || rec.offset > size || bytes > size - rec.offset) {
+            ok = false;
+            break;
+        }
+        auto& rows = matrices[rec.matrix];
+        if (rows.size() <= rec.row)
+            rows.resize(rec.row + 1);
+        if (rows[rec.row].size() <= rec.col)
+            rows[rec.row].resize(rec.col + 1);
+        if (rec.num_limbs == 0)
+            continue;
+        if (rec.level >= sizeQ || rec.num_limbs != sizeQ - rec.level + sizeP) {
+            ok = false;
+            break;
+        }
+
+        const uint64_t* data = (const uint64_t*)(base + rec.offset);
+        for (uint32_t l = 0; ok && l < rec.num_limbs; l++) {
+            uint32_t numQ = rec.num_limbs - sizeP;
+            const auto& q = (l < numQ) ? paramsQ[l] : paramsP[l - numQ];
+            ok            = data[l] == q->GetModulus().ConvertToInt() &&
+                 data[rec.num_limbs + l] == q->GetRootOfUnity().ConvertToInt();
+        }
+        if (!ok)
+            break;
+        std::vector<uint64_t> chain(data, data + 2 * rec.num_limbs);
+        auto& params = params_map[chain];
+        if (!params) {
+            std::vector<NativeInteger> moduli(rec.num_limbs);
+            std::vector<NativeInteger> roots(rec.num_limbs);
+            for (uint32_t l = 0; l < rec.num_limbs; l++) {
+                moduli[l] = NativeInteger(data[l]);
+                roots[l]  = NativeInteger(data[rec.num_limbs + l]);
+            }
+            params = std::make_shared<DCRTPoly::Params>(M, moduli, roots);
+        }
+
+        DCRTPoly element(params, Format::EVALUATION);
+        for (uint32_t l = 0; ok && l < rec.num_limbs; l++) {
+            const uint64_t* values = data + 2 * rec.num_limbs + (uint64_t)l * N;
+            uint64_t modulus       = data[l];
+            NativeVector vec(N, params->GetParams()[l]->GetModulus());
+            for (uint32_t j = 0; j < N; j++) {
+                if (values[j] >= modulus) {
+                    ok = false;
+                    break;
+                }
+                vec[j] = NativeInteger(values[j]);
+            }
+            NativePoly limb(params->GetParams()[l], Format::EVALUATION);
+            limb.SetValues(std::move(vec), Format::EVALUATION);
+            element.SetElementAtIndex(l, std::move(limb));
+        }
+
+        if (!ok)
+            break;
+
+        Plaintext pt = Plaintext(std::make_shared<CKKSPackedEncoding>(
+            params, cc.GetEncodingParams(), std::vector<std::complex<double>>(), rec.noise_scale_deg, rec.level,
+            rec.scaling_factor, rec.slots));
+        pt->GetElement<DCRTPoly>() = std::move(element);
+        rows[rec.row][rec.col]     = pt;
+    }
+    munmap(p, size);
+
+    /* a file of other level budgets or slots than the ones of precom (rows, entries) is not used */
+    for (uint32_t matrix = 0; ok && matrix < BOOT_CACHE_MATRICES; matrix++) {
+        std::vector<uint32_t> shape = boot_cache_shape(precom, matrix);
+        ok                          = matrices[matrix].size() == shape.size();
+        for (uint32_t row = 0; ok && row < shape.size(); row++)
+            ok = matrices[matrix][row].size() == shape[row];
+    }
+    if (!ok)
+        return false;
+
+    precom.m_U0hatTPreFFT = matrices[BOOT_CACHE_U0HATT_FFT];
+    precom.m_U0PreFFT     = matrices[BOOT_CACHE_U0_FFT];
+    precom.m_U0hatTPre    = matrices[BOOT_CACHE_U0HATT].empty() ? std::vector<ConstPlaintext>() :
+                                                                   matrices[BOOT_CACHE_U0HATT][0];
+    precom.m_U0Pre = matrices[BOOT_CACHE_U0].empty() ? std::vector<ConstPlaintext>() : matrices[BOOT_CACHE_U0][0];
+    return true;
+}
+
+}  // namespace lbcrypto
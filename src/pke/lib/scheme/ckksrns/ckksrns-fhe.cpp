@@ -32,6 +32,7 @@
 #define PROFILE
 
 #include "scheme/ckksrns/ckksrns-fhe.h"
+#include "scheme/ckksrns/ckksrns-bootcache.h"
 
 #include "key/privatekey.h"
 #include "scheme/ckksrns/ckksrns-cryptoparameters.h"
@@ -47,7 +48,9 @@
 #include "utils/exception.h"
 #include "utils/parallel.h"
 #include "utils/utilities.h"
+#include "utils/perf_counters.h"
 #include "scheme/ckksrns/ckksrns-utils.h"
+#include "keyswitch/keyswitch-hybrid.h"
 
 #include <cmath>
 #include <memory>
@@ -55,6 +58,8 @@
 
 extern void init_stat_no_workqueue();
 extern void print_stat_no_workqueue();
+extern bool prefetch_enabled;
+extern bool double_hoisting_enabled;
 
 namespace lbcrypto {
 
@@ -181,6 +186,12 @@ void FHECKKSRNS::EvalBootstrapSetup(const CryptoContextImpl<DCRTPoly>& cc, std::
     bool isLTBootstrap = (precom->m_paramsEnc[CKKS_BOOT_PARAMS::LEVEL_BUDGET] == 1) &&
                          (precom->m_paramsDec[CKKS_BOOT_PARAMS::LEVEL_BUDGET] == 1);
 
+    // plaintexts of a previous setup with the same parameters (scheme/ckksrns/ckksrns-bootcache.h)
+    uint64_t cacheKey     = BootPrecomKey(cc, newBudget, dim1, slots);
+    std::string cachePath = BootPrecomCachePath(cacheKey);
+    if (!cachePath.empty() && LoadBootPrecom(cc, cachePath, cacheKey, *precom))
+        return;
+
     if (isLTBootstrap) {
         // allocate all vectors
         std::vector<std::vector<std::complex<double>>> U0(slots, std::vector<std::complex<double>>(slots));
@@ -210,6 +221,9 @@ void FHECKKSRNS::EvalBootstrapSetup(const CryptoContextImpl<DCRTPoly>& cc, std::
         precom->m_U0hatTPreFFT = EvalCoeffsToSlotsPrecompute(cc, ksiPows, rotGroup, false, scaleEnc, lEnc);
         precom->m_U0PreFFT     = EvalSlotsToCoeffsPrecompute(cc, ksiPows, rotGroup, false, scaleDec, lDec);
     }
+
+    if (!cachePath.empty())
+        SaveBootPrecom(cc, cachePath, cacheKey, *precom);
 }
 
 std::shared_ptr<std::map<usint, EvalKey<DCRTPoly>>> FHECKKSRNS::EvalBootstrapKeyGen(
@@ -238,10 +252,8 @@ std::shared_ptr<std::map<usint, EvalKey<DCRTPoly>>> FHECKKSRNS::EvalBootstrapKey
     return evalKeys;
 }
 
-Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphertext, uint32_t numIterations,
-                                               uint32_t precision) const {
-    const auto cryptoParams = std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(ciphertext->GetCryptoParameters());
-
+static void CheckBootstrapParams(const std::shared_ptr<CryptoParametersCKKSRNS>& cryptoParams,
+                                 uint32_t numIterations) {
     if (cryptoParams->GetKeySwitchTechnique() != HYBRID)
         OPENFHE_THROW(config_error, "CKKS Bootstrapping is only supported for the Hybrid key switching method.");
 #if NATIVEINT == 128 && !defined(__EMSCRIPTEN__)
@@ -252,16 +264,16 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
     if (numIterations != 1 && numIterations != 2) {
         OPENFHE_THROW(config_error, "CKKS Iterative Bootstrapping is only supported for 1 or 2 iterations.");
     }
+}
 
-#ifdef BOOTSTRAPTIMING
-    TimeVar t;
-    double timeEncode(0.0);
-    double timeModReduce(0.0);
-    double timeDecode(0.0);
-#endif
+Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphertext, uint32_t numIterations,
+                                               uint32_t precision) const {
+    // counters of the steps below are summed per region (utils/perf_counters.h)
+    PerfRegion region("EvalBootstrap");
+    const auto cryptoParams = std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(ciphertext->GetCryptoParameters());
+    CheckBootstrapParams(cryptoParams, numIterations);
 
     auto cc        = ciphertext->GetCryptoContext();
-    uint32_t M     = cc->GetCyclotomicOrder();
     uint32_t L0    = cryptoParams->GetElementParams()->GetParams().size();
     auto initSizeQ = ciphertext->GetElements()[0].GetNumOfElements();
 
@@ -312,7 +324,97 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         return finalCiphertext;
     }
 
-    uint32_t slots = ciphertext->GetSlots();
+    return EvalBootstrapInternal(std::vector<ConstCiphertext<DCRTPoly>>{ciphertext})[0];
+}
+
+std::vector<Ciphertext<DCRTPoly>> FHECKKSRNS::EvalBootstrap(const std::vector<Ciphertext<DCRTPoly>>& ciphertexts,
+                                                            uint32_t numIterations, uint32_t precision) const {
+    if (ciphertexts.empty())
+        return std::vector<Ciphertext<DCRTPoly>>();
+
+    PerfRegion region("EvalBootstrap");
+    const auto cryptoParams =
+        std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(ciphertexts[0]->GetCryptoParameters());
+    CheckBootstrapParams(cryptoParams, numIterations);
+
+    auto cc = ciphertexts[0]->GetCryptoContext();
+    for (const auto& ciphertext : ciphertexts) {
+        if (ciphertext->GetCryptoContext() != cc || ciphertext->GetKeyTag() != ciphertexts[0]->GetKeyTag())
+            OPENFHE_THROW(config_error, "Batched bootstrapping needs ciphertexts of the same crypto context and key.");
+        if (ciphertext->GetSlots() != ciphertexts[0]->GetSlots())
+            OPENFHE_THROW(config_error, "Batched bootstrapping needs ciphertexts with the same number of slots.");
+    }
+
+    if (numIterations > 1) {
+        // Meta-BTS steps of the single ciphertext version, both bootstrappings are run for the whole batch
+        auto algo                  = cc->GetScheme();
+        uint32_t L0                = cryptoParams->GetElementParams()->GetParams().size();
+        uint32_t powerOfTwoModulus = 1 << precision;
+        size_t numCt               = ciphertexts.size();
+
+        auto ctInitialBootstrap = cc->EvalBootstrap(ciphertexts, numIterations - 1, precision);
+
+        std::vector<Ciphertext<DCRTPoly>> result(numCt);
+        std::vector<Ciphertext<DCRTPoly>> ctBootstrappingError;
+        std::vector<size_t> errorIndex;
+        for (size_t c = 0; c < numCt; c++) {
+            auto initSizeQ = ciphertexts[c]->GetElements()[0].GetNumOfElements();
+
+            Ciphertext<DCRTPoly> ctScaledUp = ciphertexts[c]->Clone();
+            algo->MultByIntegerInPlace(ctScaledUp, powerOfTwoModulus);
+            ctScaledUp->SetLevel(L0 - ctScaledUp->GetElements()[0].GetNumOfElements());
+
+            algo->ModReduceInternalInPlace(ctInitialBootstrap[c], BASE_NUM_LEVELS_TO_DROP);
+            algo->MultByIntegerInPlace(ctInitialBootstrap[c], powerOfTwoModulus);
+
+            auto ctBootstrappedScaledDown = ctInitialBootstrap[c]->Clone();
+            auto bootstrappingSizeQ       = ctBootstrappedScaledDown->GetElements()[0].GetNumOfElements();
+
+            // If we start with more towers, than we obtain from bootstrapping, return the original ciphertext.
+            if (bootstrappingSizeQ <= initSizeQ) {
+                result[c] = ciphertexts[c]->Clone();
+                continue;
+            }
+            for (auto& cv : ctBootstrappedScaledDown->GetElements()) {
+                cv.DropLastElements(bootstrappingSizeQ - initSizeQ);
+            }
+            ctBootstrappedScaledDown->SetLevel(L0 - ctBootstrappedScaledDown->GetElements()[0].GetNumOfElements());
+
+            ctBootstrappingError.push_back(cc->EvalSub(ctBootstrappedScaledDown, ctScaledUp));
+            errorIndex.push_back(c);
+        }
+
+        auto ctBootstrappedError = cc->EvalBootstrap(ctBootstrappingError, 1, 0);
+        for (size_t i = 0; i < errorIndex.size(); i++) {
+            size_t c = errorIndex[i];
+            algo->ModReduceInternalInPlace(ctBootstrappedError[i], BASE_NUM_LEVELS_TO_DROP);
+            result[c] = cc->EvalSub(ctInitialBootstrap[c], ctBootstrappedError[i]);
+            cc->EvalMultInPlace(result[c], static_cast<double>(1) / powerOfTwoModulus);
+        }
+        return result;
+    }
+
+    return EvalBootstrapInternal(std::vector<ConstCiphertext<DCRTPoly>>(ciphertexts.begin(), ciphertexts.end()));
+}
+
+std::vector<Ciphertext<DCRTPoly>> FHECKKSRNS::EvalBootstrapInternal(
+    const std::vector<ConstCiphertext<DCRTPoly>>& ciphertexts) const {
+    const auto cryptoParams =
+        std::dynamic_pointer_cast<CryptoParametersCKKSRNS>(ciphertexts[0]->GetCryptoParameters());
+
+#ifdef BOOTSTRAPTIMING
+    TimeVar t;
+    double timeEncode(0.0);
+    double timeModReduce(0.0);
+    double timeDecode(0.0);
+#endif
+
+    auto cc      = ciphertexts[0]->GetCryptoContext();
+    uint32_t M   = cc->GetCyclotomicOrder();
+    uint32_t L0  = cryptoParams->GetElementParams()->GetParams().size();
+    size_t numCt = ciphertexts.size();
+
+    uint32_t slots = ciphertexts[0]->GetSlots();
 
     auto pair = m_bootPrecomMap.find(slots);
     if (pair == m_bootPrecomMap.end()) {
@@ -374,29 +476,34 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
     // Increasing the modulus
     std::cout << "Raising the modulus..." << std::endl;
 
-    Ciphertext<DCRTPoly> raised = ciphertext->Clone();
-    auto algo                   = cc->GetScheme();
-    algo->ModReduceInternalInPlace(raised, raised->GetNoiseScaleDeg() - 1);
+    // Every step below is done for all ciphertexts of the batch before the next step,
+    // so a rotation key is used for the whole batch while it is on the device (one load per batch)
+    auto algo = cc->GetScheme();
+    std::vector<Ciphertext<DCRTPoly>> raised(numCt);
+    for (size_t c = 0; c < numCt; c++) {
+        raised[c] = ciphertexts[c]->Clone();
+        algo->ModReduceInternalInPlace(raised[c], raised[c]->GetNoiseScaleDeg() - 1);
 
-    AdjustCiphertext(raised, correction);
-    auto ctxtDCRT = raised->GetElements();
+        AdjustCiphertext(raised[c], correction);
+        auto ctxtDCRT = raised[c]->GetElements();
 
-    // We only use the level 0 ciphertext here. All other towers are automatically ignored to make
-    // CKKS bootstrapping faster.
-    for (size_t i = 0; i < ctxtDCRT.size(); i++) {
-        DCRTPoly temp(elementParamsRaisedPtr, COEFFICIENT);
-        ctxtDCRT[i].SetFormat(COEFFICIENT);
-        temp = ctxtDCRT[i].GetElementAtIndex(0);
-        temp.SetFormat(EVALUATION);
-        ctxtDCRT[i] = temp;
-    }
+        // We only use the level 0 ciphertext here. All other towers are automatically ignored to make
+        // CKKS bootstrapping faster.
+        for (size_t i = 0; i < ctxtDCRT.size(); i++) {
+            DCRTPoly temp(elementParamsRaisedPtr, COEFFICIENT);
+            ctxtDCRT[i].SetFormat(COEFFICIENT);
+            temp = ctxtDCRT[i].GetElementAtIndex(0);
+            temp.SetFormat(EVALUATION);
+            ctxtDCRT[i] = temp;
+        }
 
-    raised->SetElements(ctxtDCRT);
-    raised->SetLevel(L0 - ctxtDCRT[0].GetNumOfElements());
+        raised[c]->SetElements(ctxtDCRT);
+        raised[c]->SetLevel(L0 - ctxtDCRT[0].GetNumOfElements());
+    }
 
 #ifdef BOOTSTRAPTIMING
     std::cerr << "\nNumber of levels at the beginning of bootstrapping: "
-              << raised->GetElements()[0].GetNumOfElements() - 1 << std::endl;
+              << raised[0]->GetElements()[0].GetNumOfElements() - 1 << std::endl;
 #endif
 
     //------------------------------------------------------------------------------
@@ -421,13 +528,14 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
 
     double constantEvalMult = pre * (1.0 / (k * N));
 
-    cc->EvalMultInPlace(raised, constantEvalMult);
+    for (auto& ct : raised)
+        cc->EvalMultInPlace(ct, constantEvalMult);
 
     // no linear transformations are needed for Chebyshev series as the range has been normalized to [-1,1]
     double coeffLowerBound = -1;
     double coeffUpperBound = 1;
 
-    Ciphertext<DCRTPoly> ctxtDec;
+    std::vector<Ciphertext<DCRTPoly>> ctxtDec(numCt);
 
     bool isLTBootstrap = (precom->m_paramsEnc[CKKS_BOOT_PARAMS::LEVEL_BUDGET] == 1) &&
                          (precom->m_paramsDec[CKKS_BOOT_PARAMS::LEVEL_BUDGET] == 1);
@@ -445,63 +553,80 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         //------------------------------------------------------------------------------
         
         std::cout << "fully packed case - Running CoeffToSlot..." << std::endl;
+        perf_region_begin("CoeffsToSlots");
 
         // need to call internal modular reduction so it also works for FLEXIBLEAUTO
-        algo->ModReduceInternalInPlace(raised, BASE_NUM_LEVELS_TO_DROP);
+        for (auto& ct : raised)
+            algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
 
         // only one linear transform is needed as the other one can be derived
-        auto ctxtEnc = (isLTBootstrap) ? EvalLinearTransform(precom->m_U0hatTPre, raised) :
-                                         EvalCoeffsToSlots(precom->m_U0hatTPreFFT, raised);
-
-        auto evalKeyMap = cc->GetEvalAutomorphismKeyMap(ctxtEnc->GetKeyTag());
-        auto conj       = Conjugate(ctxtEnc, evalKeyMap);
-        auto ctxtEncI   = cc->EvalSub(ctxtEnc, conj);
-        cc->EvalAddInPlace(ctxtEnc, conj);
-        algo->MultByMonomialInPlace(ctxtEncI, 3 * M / 4);
-
-        if (cryptoParams->GetScalingTechnique() == FIXEDMANUAL) {
-            while (ctxtEnc->GetNoiseScaleDeg() > 1) {
-                cc->ModReduceInPlace(ctxtEnc);
-                cc->ModReduceInPlace(ctxtEncI);
-            }
+        std::vector<Ciphertext<DCRTPoly>> ctxtEnc(numCt);
+        if (isLTBootstrap) {
+            for (size_t c = 0; c < numCt; c++)
+                ctxtEnc[c] = EvalLinearTransform(precom->m_U0hatTPre, raised[c]);
         }
         else {
-            if (ctxtEnc->GetNoiseScaleDeg() == 2) {
-                algo->ModReduceInternalInPlace(ctxtEnc, BASE_NUM_LEVELS_TO_DROP);
-                algo->ModReduceInternalInPlace(ctxtEncI, BASE_NUM_LEVELS_TO_DROP);
+            ctxtEnc = EvalCoeffsToSlots(precom->m_U0hatTPreFFT,
+                                        std::vector<ConstCiphertext<DCRTPoly>>(raised.begin(), raised.end()));
+        }
+
+        auto evalKeyMap = cc->GetEvalAutomorphismKeyMap(ctxtEnc[0]->GetKeyTag());
+        std::vector<Ciphertext<DCRTPoly>> ctxtEncI(numCt);
+        for (size_t c = 0; c < numCt; c++) {
+            auto conj   = Conjugate(ctxtEnc[c], evalKeyMap);
+            ctxtEncI[c] = cc->EvalSub(ctxtEnc[c], conj);
+            cc->EvalAddInPlace(ctxtEnc[c], conj);
+            algo->MultByMonomialInPlace(ctxtEncI[c], 3 * M / 4);
+
+            if (cryptoParams->GetScalingTechnique() == FIXEDMANUAL) {
+                while (ctxtEnc[c]->GetNoiseScaleDeg() > 1) {
+                    cc->ModReduceInPlace(ctxtEnc[c]);
+                    cc->ModReduceInPlace(ctxtEncI[c]);
+                }
+            }
+            else {
+                if (ctxtEnc[c]->GetNoiseScaleDeg() == 2) {
+                    algo->ModReduceInternalInPlace(ctxtEnc[c], BASE_NUM_LEVELS_TO_DROP);
+                    algo->ModReduceInternalInPlace(ctxtEncI[c], BASE_NUM_LEVELS_TO_DROP);
+                }
             }
         }
 
         //------------------------------------------------------------------------------
         // Running Approximate Mod Reduction
         //------------------------------------------------------------------------------
+        perf_region_end();
         std::cout << "fully packed case - Running Approximate Mod Reduction..." << std::endl;
-
-        // Evaluate Chebyshev series for the sine wave
-        ctxtEnc  = cc->EvalChebyshevSeries(ctxtEnc, coefficients, coeffLowerBound, coeffUpperBound);
-        ctxtEncI = cc->EvalChebyshevSeries(ctxtEncI, coefficients, coeffLowerBound, coeffUpperBound);
-
-        // Double-angle iterations
-        if ((cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY) ||
-            (cryptoParams->GetSecretKeyDist() == SPARSE_TERNARY)) {
-            if (cryptoParams->GetScalingTechnique() != FIXEDMANUAL) {
-                algo->ModReduceInternalInPlace(ctxtEnc, BASE_NUM_LEVELS_TO_DROP);
-                algo->ModReduceInternalInPlace(ctxtEncI, BASE_NUM_LEVELS_TO_DROP);
+        perf_region_begin("ApproxMod");
+
+        // only the relinearization key is used here, the ciphertexts are evaluated one by one
+        for (size_t c = 0; c < numCt; c++) {
+            // Evaluate Chebyshev series for the sine wave
+            ctxtEnc[c]  = cc->EvalChebyshevSeries(ctxtEnc[c], coefficients, coeffLowerBound, coeffUpperBound);
+            ctxtEncI[c] = cc->EvalChebyshevSeries(ctxtEncI[c], coefficients, coeffLowerBound, coeffUpperBound);
+
+            // Double-angle iterations
+            if ((cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY) ||
+                (cryptoParams->GetSecretKeyDist() == SPARSE_TERNARY)) {
+                if (cryptoParams->GetScalingTechnique() != FIXEDMANUAL) {
+                    algo->ModReduceInternalInPlace(ctxtEnc[c], BASE_NUM_LEVELS_TO_DROP);
+                    algo->ModReduceInternalInPlace(ctxtEncI[c], BASE_NUM_LEVELS_TO_DROP);
+                }
+                uint32_t numIter;
+                if (cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY)
+                    numIter = R_UNIFORM;
+                else
+                    numIter = R_SPARSE;
+                ApplyDoubleAngleIterations(ctxtEnc[c], numIter);
+                ApplyDoubleAngleIterations(ctxtEncI[c], numIter);
             }
-            uint32_t numIter;
-            if (cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY)
-                numIter = R_UNIFORM;
-            else
-                numIter = R_SPARSE;
-            ApplyDoubleAngleIterations(ctxtEnc, numIter);
-            ApplyDoubleAngleIterations(ctxtEncI, numIter);
-        }
 
-        algo->MultByMonomialInPlace(ctxtEncI, M / 4);
-        cc->EvalAddInPlace(ctxtEnc, ctxtEncI);
+            algo->MultByMonomialInPlace(ctxtEncI[c], M / 4);
+            cc->EvalAddInPlace(ctxtEnc[c], ctxtEncI[c]);
 
-        // scale the message back up after Chebyshev interpolation
-        algo->MultByIntegerInPlace(ctxtEnc, scalar);
+            // scale the message back up after Chebyshev interpolation
+            algo->MultByIntegerInPlace(ctxtEnc[c], scalar);
+        }
 
 #ifdef BOOTSTRAPTIMING
         timeModReduce = TOC(t);
@@ -516,17 +641,27 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         //------------------------------------------------------------------------------
         // Running SlotToCoeff
         //------------------------------------------------------------------------------
+        perf_region_end();
         std::cout << "fully packed case - Running SlotToCoeff..." << std::endl;
+        perf_region_begin("SlotsToCoeffs");
 
         // In the case of FLEXIBLEAUTO, we need one extra tower
         // TODO: See if we can remove the extra level in FLEXIBLEAUTO
         if (cryptoParams->GetScalingTechnique() != FIXEDMANUAL) {
-            algo->ModReduceInternalInPlace(ctxtEnc, BASE_NUM_LEVELS_TO_DROP);
+            for (auto& ct : ctxtEnc)
+                algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
         }
 
         // Only one linear transform is needed
-        ctxtDec = (isLTBootstrap) ? EvalLinearTransform(precom->m_U0Pre, ctxtEnc) :
-                                    EvalSlotsToCoeffs(precom->m_U0PreFFT, ctxtEnc);
+        if (isLTBootstrap) {
+            for (size_t c = 0; c < numCt; c++)
+                ctxtDec[c] = EvalLinearTransform(precom->m_U0Pre, ctxtEnc[c]);
+        }
+        else {
+            ctxtDec = EvalSlotsToCoeffs(precom->m_U0PreFFT,
+                                        std::vector<ConstCiphertext<DCRTPoly>>(ctxtEnc.begin(), ctxtEnc.end()));
+        }
+        perf_region_end();
     }
     else {
         //------------------------------------------------------------------------------
@@ -539,8 +674,10 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         std::cout << "sparsely packed case - Running PartialSum..." << std::endl;
 
         for (uint32_t j = 1; j < N / (2 * slots); j <<= 1) {
-            auto temp = cc->EvalRotate(raised, j * slots);
-            cc->EvalAddInPlace(raised, temp);
+            for (auto& ct : raised) {
+                auto temp = cc->EvalRotate(ct, j * slots);
+                cc->EvalAddInPlace(ct, temp);
+            }
         }
 
 #ifdef BOOTSTRAPTIMING
@@ -551,24 +688,35 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         // Running CoeffsToSlots
         //------------------------------------------------------------------------------
         std::cout << "sparsely packed case - Running CoeffsToSlots..." << std::endl;
+        perf_region_begin("CoeffsToSlots");
 
-        algo->ModReduceInternalInPlace(raised, BASE_NUM_LEVELS_TO_DROP);
+        for (auto& ct : raised)
+            algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
 
-        auto ctxtEnc = (isLTBootstrap) ? EvalLinearTransform(precom->m_U0hatTPre, raised) :
-                                         EvalCoeffsToSlots(precom->m_U0hatTPreFFT, raised);
+        std::vector<Ciphertext<DCRTPoly>> ctxtEnc(numCt);
+        if (isLTBootstrap) {
+            for (size_t c = 0; c < numCt; c++)
+                ctxtEnc[c] = EvalLinearTransform(precom->m_U0hatTPre, raised[c]);
+        }
+        else {
+            ctxtEnc = EvalCoeffsToSlots(precom->m_U0hatTPreFFT,
+                                        std::vector<ConstCiphertext<DCRTPoly>>(raised.begin(), raised.end()));
+        }
 
-        auto evalKeyMap = cc->GetEvalAutomorphismKeyMap(ctxtEnc->GetKeyTag());
-        auto conj       = Conjugate(ctxtEnc, evalKeyMap);
-        cc->EvalAddInPlace(ctxtEnc, conj);
+        auto evalKeyMap = cc->GetEvalAutomorphismKeyMap(ctxtEnc[0]->GetKeyTag());
+        for (auto& ct : ctxtEnc) {
+            auto conj = Conjugate(ct, evalKeyMap);
+            cc->EvalAddInPlace(ct, conj);
 
-        if (cryptoParams->GetScalingTechnique() == FIXEDMANUAL) {
-            while (ctxtEnc->GetNoiseScaleDeg() > 1) {
-                cc->ModReduceInPlace(ctxtEnc);
+            if (cryptoParams->GetScalingTechnique() == FIXEDMANUAL) {
+                while (ct->GetNoiseScaleDeg() > 1) {
+                    cc->ModReduceInPlace(ct);
+                }
             }
-        }
-        else {
-            if (ctxtEnc->GetNoiseScaleDeg() == 2) {
-                algo->ModReduceInternalInPlace(ctxtEnc, BASE_NUM_LEVELS_TO_DROP);
+            else {
+                if (ct->GetNoiseScaleDeg() == 2) {
+                    algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
+                }
             }
         }
 
@@ -585,27 +733,31 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         //------------------------------------------------------------------------------
         // Running Approximate Mod Reduction
         //------------------------------------------------------------------------------
+        perf_region_end();
         std::cout << "sparsely packed case - Running Approximate Mod Reduction..." << std::endl;
+        perf_region_begin("ApproxMod");
 
-        // Evaluate Chebyshev series for the sine wave
-        ctxtEnc = cc->EvalChebyshevSeries(ctxtEnc, coefficients, coeffLowerBound, coeffUpperBound);
+        for (auto& ct : ctxtEnc) {
+            // Evaluate Chebyshev series for the sine wave
+            ct = cc->EvalChebyshevSeries(ct, coefficients, coeffLowerBound, coeffUpperBound);
 
-        // Double-angle iterations
-        if ((cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY) ||
-            (cryptoParams->GetSecretKeyDist() == SPARSE_TERNARY)) {
-            if (cryptoParams->GetScalingTechnique() != FIXEDMANUAL) {
-                algo->ModReduceInternalInPlace(ctxtEnc, BASE_NUM_LEVELS_TO_DROP);
+            // Double-angle iterations
+            if ((cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY) ||
+                (cryptoParams->GetSecretKeyDist() == SPARSE_TERNARY)) {
+                if (cryptoParams->GetScalingTechnique() != FIXEDMANUAL) {
+                    algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
+                }
+                uint32_t numIter;
+                if (cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY)
+                    numIter = R_UNIFORM;
+                else
+                    numIter = R_SPARSE;
+                ApplyDoubleAngleIterations(ct, numIter);
             }
-            uint32_t numIter;
-            if (cryptoParams->GetSecretKeyDist() == UNIFORM_TERNARY)
-                numIter = R_UNIFORM;
-            else
-                numIter = R_SPARSE;
-            ApplyDoubleAngleIterations(ctxtEnc, numIter);
-        }
 
-        // scale the message back up after Chebyshev interpolation
-        algo->MultByIntegerInPlace(ctxtEnc, scalar);
+            // scale the message back up after Chebyshev interpolation
+            algo->MultByIntegerInPlace(ct, scalar);
+        }
 
 #ifdef BOOTSTRAPTIMING
         timeModReduce = TOC(t);
@@ -620,25 +772,37 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
         //------------------------------------------------------------------------------
         // Running SlotsToCoeffs
         //------------------------------------------------------------------------------
+        perf_region_end();
         std::cout << "sparsely packed case - Running SlotsToCoeffs..." << std::endl;
+        perf_region_begin("SlotsToCoeffs");
 
         // In the case of FLEXIBLEAUTO, we need one extra tower
         // TODO: See if we can remove the extra level in FLEXIBLEAUTO
         if (cryptoParams->GetScalingTechnique() != FIXEDMANUAL) {
-            algo->ModReduceInternalInPlace(ctxtEnc, BASE_NUM_LEVELS_TO_DROP);
+            for (auto& ct : ctxtEnc)
+                algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
         }
 
         // linear transform for decoding
-        ctxtDec = (isLTBootstrap) ? EvalLinearTransform(precom->m_U0Pre, ctxtEnc) :
-                                    EvalSlotsToCoeffs(precom->m_U0PreFFT, ctxtEnc);
+        if (isLTBootstrap) {
+            for (size_t c = 0; c < numCt; c++)
+                ctxtDec[c] = EvalLinearTransform(precom->m_U0Pre, ctxtEnc[c]);
+        }
+        else {
+            ctxtDec = EvalSlotsToCoeffs(precom->m_U0PreFFT,
+                                        std::vector<ConstCiphertext<DCRTPoly>>(ctxtEnc.begin(), ctxtEnc.end()));
+        }
+        perf_region_end();
 
-        cc->EvalAddInPlace(ctxtDec, cc->EvalRotate(ctxtDec, slots));
+        for (auto& ct : ctxtDec)
+            cc->EvalAddInPlace(ct, cc->EvalRotate(ct, slots));
     }
 
 #if NATIVEINT != 128
     // 64-bit only: scale back the message to its original scale.
     uint64_t corFactor = (uint64_t)1 << std::llround(correction);
-    algo->MultByIntegerInPlace(ctxtDec, corFactor);
+    for (auto& ct : ctxtDec)
+        algo->MultByIntegerInPlace(ct, corFactor);
 #endif
 
 #ifdef BOOTSTRAPTIMING
@@ -647,11 +811,13 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalBootstrap(ConstCiphertext<DCRTPoly> ciphert
     std::cout << "Decoding time: " << timeDecode / 1000.0 << " s" << std::endl;
 #endif
 
-    auto bootstrappingNumTowers = ctxtDec->GetElements()[0].GetNumOfElements();
+    for (size_t c = 0; c < numCt; c++) {
+        auto bootstrappingNumTowers = ctxtDec[c]->GetElements()[0].GetNumOfElements();
 
-    // If we start with more towers, than we obtain from bootstrapping, return the original ciphertext.
-    if (bootstrappingNumTowers <= initSizeQ) {
-        return ciphertext->Clone();
+        // If we start with more towers, than we obtain from bootstrapping, return the original ciphertext.
+        if (bootstrappingNumTowers <= ciphertexts[c]->GetElements()[0].GetNumOfElements()) {
+            ctxtDec[c] = ciphertexts[c]->Clone();
+        }
     }
 
     return ctxtDec;
@@ -1495,6 +1661,45 @@ std::vector<std::vector<ConstPlaintext>> FHECKKSRNS::EvalSlotsToCoeffsPrecompute
 // EVALUATION: CoeffsToSlots and SlotsToCoeffs
 //------------------------------------------------------------------------------
 
+/* prefetch hint of the key of a hoisted rotation (bootstrapping uses hybrid key switching only),
+    the key of rotation j + 1 is staged while rotation j computes */
+static void PrefetchRotationKey(const std::map<usint, EvalKey<DCRTPoly>>& evalKeyMap, int32_t index, uint32_t M,
+                                usint sizeQl) {
+    if (!prefetch_enabled || index == 0)
+        return;
+    auto it = evalKeyMap.find(FindAutomorphismIndex2nComplex(index, M));
+    if (it != evalKeyMap.end())
+        KeySwitchHYBRID::PrefetchEvalKey(it->second, sizeQl);
+}
+
+/* double hoisting : c1 of an extended ciphertext moved down to Q (one ApproxModDown instead of two),
+    input of a hoisted rotation with addFirst = false only (c0 is not read, it is the same c1 in Q) */
+static Ciphertext<DCRTPoly> KeySwitchDownSecondElement(const CryptoContext<DCRTPoly>& cc,
+                                                       ConstCiphertext<DCRTPoly> ciphertext) {
+    auto c1 = ciphertext->CloneZero();
+    c1->SetElements({ciphertext->GetElements()[1]});
+    DCRTPoly c1Q = cc->KeySwitchDownFirstElement(c1);
+
+    auto result = ciphertext->CloneZero();
+    result->SetElements({c1Q, c1Q});
+    return result;
+}
+
+/* double hoisting : giant step of an extended ciphertext added to outer (extended basis),
+    c0 is rotated in the extended basis and only c1 goes down to Q for the key switching */
+static void EvalGiantStepExtInPlace(const CryptoContext<DCRTPoly>& cc, Ciphertext<DCRTPoly>& outer,
+                                    ConstCiphertext<DCRTPoly> inner, int32_t index, usint autoIndex,
+                                    const std::vector<usint>& map) {
+    auto innerQ      = KeySwitchDownSecondElement(cc, inner);
+    auto innerDigits = cc->EvalFastRotationPrecompute(innerQ);
+    auto rotated     = cc->EvalFastRotationExt(innerQ, index, innerDigits, false);
+
+    std::vector<DCRTPoly>& elements = outer->GetElements();
+    elements[0] += inner->GetElements()[0].AutomorphismTransform(autoIndex, map);
+    elements[0] += rotated->GetElements()[0];
+    elements[1] += rotated->GetElements()[1];
+}
+
 Ciphertext<DCRTPoly> FHECKKSRNS::EvalLinearTransform(const std::vector<ConstPlaintext>& A,
                                                      ConstCiphertext<DCRTPoly> ct) const {
     uint32_t slots = A.size();
@@ -1522,9 +1727,14 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalLinearTransform(const std::vector<ConstPlai
 
     std::vector<Ciphertext<DCRTPoly>> fastRotation(bStep - 1);
 
+    const auto& evalKeyMap = cc->GetEvalAutomorphismKeyMap(ct->GetKeyTag());
+    usint sizeQl           = ct->GetElements()[0].GetNumOfElements();
+
     // hoisted automorphisms
 // // #pragma omp parallel for
     for (uint32_t j = 1; j < bStep; j++) {
+        if (j + 1 < bStep)
+            PrefetchRotationKey(evalKeyMap, j + 1, M, sizeQl);
         fastRotation[j - 1] = cc->EvalFastRotationExt(ct, j, digits, true);
     }
 
@@ -1539,6 +1749,20 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalLinearTransform(const std::vector<ConstPlai
             }
         }
 
+        if (double_hoisting_enabled) {
+            // c0 summed in the extended basis, one KeySwitchDown after the last giant step
+            if (j == 0) {
+                result = inner;
+            }
+            else {
+                usint autoIndex = FindAutomorphismIndex2nComplex(bStep * j, M);
+                std::vector<usint> map(N);
+                PrecomputeAutoMap(N, autoIndex, &map);
+                EvalGiantStepExtInPlace(cc, result, inner, bStep * j, autoIndex, map);
+            }
+            continue;
+        }
+
         if (j == 0) {
             first         = cc->KeySwitchDownFirstElement(inner);
             auto elements = inner->GetElements();
@@ -1560,17 +1784,125 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalLinearTransform(const std::vector<ConstPlai
         }
     }
 
-    result        = cc->KeySwitchDown(result);
-    auto elements = result->GetElements();
-    elements[0] += first;
-    result->SetElements(elements);
+    result = cc->KeySwitchDown(result);
+    if (!double_hoisting_enabled) {
+        auto elements = result->GetElements();
+        elements[0] += first;
+        result->SetElements(elements);
+    }
 
     return result;
 }
 
-Ciphertext<DCRTPoly> FHECKKSRNS::EvalCoeffsToSlots(const std::vector<std::vector<ConstPlaintext>>& A,
-                                                   ConstCiphertext<DCRTPoly> ctxt) const {
-    uint32_t slots = ctxt->GetSlots();
+/* one level of the hoisted baby-step giant-step product (CoeffsToSlots, SlotsToCoeffs) for a batch of ciphertexts
+    of the same level, every rotation key is used for all ciphertexts of the batch before the next key
+    (the key limbs stay on the device for the batch instead of being loaded once per ciphertext).
+    The baby-step rotations of the whole batch are kept, g extended ciphertexts per ciphertext.
+    With double hoisting (set_double_hoisting) a giant step moves only c1 down to Q, c0 is summed in QP */
+void FHECKKSRNS::EvalBSGSLevel(const std::vector<ConstPlaintext>& A, const std::vector<int32_t>& rotIn,
+                               const std::vector<int32_t>& rotOut, int32_t g, int32_t b, int32_t numRotations,
+                               std::vector<Ciphertext<DCRTPoly>>& ctxts) const {
+    auto cc      = ctxts[0]->GetCryptoContext();
+    uint32_t M   = cc->GetCyclotomicOrder();
+    uint32_t N   = cc->GetRingDimension();
+    size_t numCt = ctxts.size();
+
+    const auto& evalKeyMap = cc->GetEvalAutomorphismKeyMap(ctxts[0]->GetKeyTag());
+    usint sizeQl           = ctxts[0]->GetElements()[0].GetNumOfElements();
+
+    // computes the NTTs for each CRT limb (for the hoisted automorphisms used later on)
+    std::vector<std::shared_ptr<std::vector<DCRTPoly>>> digits(numCt);
+    for (size_t c = 0; c < numCt; c++)
+        digits[c] = cc->EvalFastRotationPrecompute(ctxts[c]);
+
+    // fastRotation[j][c] : baby step j of the ciphertext c
+    std::vector<std::vector<Ciphertext<DCRTPoly>>> fastRotation(g, std::vector<Ciphertext<DCRTPoly>>(numCt));
+    for (int32_t j = 0; j < g; j++) {
+        if (j + 1 < g)
+            PrefetchRotationKey(evalKeyMap, rotIn[j + 1], M, sizeQl);
+        for (size_t c = 0; c < numCt; c++) {
+            if (rotIn[j] != 0) {
+                fastRotation[j][c] = cc->EvalFastRotationExt(ctxts[c], rotIn[j], digits[c], true);
+            }
+            else {
+                fastRotation[j][c] = cc->KeySwitchExt(ctxts[c], true);
+            }
+        }
+    }
+
+    std::vector<Ciphertext<DCRTPoly>> outer(numCt);
+    std::vector<DCRTPoly> first(numCt);
+    for (int32_t i = 0; i < b; i++) {
+        int32_t G = g * i;
+
+        // Find the automorphism index that corresponds to rotation index index.
+        usint autoIndex = 0;
+        std::vector<usint> map;
+        if (i != 0 && rotOut[i] != 0) {
+            autoIndex = FindAutomorphismIndex2nComplex(rotOut[i], M);
+            map.resize(N);
+            PrecomputeAutoMap(N, autoIndex, &map);
+        }
+
+        for (size_t c = 0; c < numCt; c++) {
+            // for the first iteration with j=0:
+            Ciphertext<DCRTPoly> inner = EvalMultExt(fastRotation[0][c], A[G]);
+            // continue the loop
+            for (int32_t j = 1; j < g; j++) {
+                if ((G + j) != numRotations) {
+                    EvalAddExtInPlace(inner, EvalMultExt(fastRotation[j][c], A[G + j]));
+                }
+            }
+
+            if (double_hoisting_enabled) {
+                // c0 summed in the extended basis, one KeySwitchDown after the last giant step
+                if (i == 0)
+                    outer[c] = inner;
+                else if (rotOut[i] != 0)
+                    EvalGiantStepExtInPlace(cc, outer[c], inner, rotOut[i], autoIndex, map);
+                else
+                    EvalAddExtInPlace(outer[c], inner);
+                continue;
+            }
+
+            if (i == 0) {
+                first[c]      = cc->KeySwitchDownFirstElement(inner);
+                auto elements = inner->GetElements();
+                elements[0].SetValuesToZero();
+                inner->SetElements(elements);
+                outer[c] = inner;
+            }
+            else {
+                if (rotOut[i] != 0) {
+                    inner = cc->KeySwitchDown(inner);
+                    first[c] += inner->GetElements()[0].AutomorphismTransform(autoIndex, map);
+                    auto innerDigits = cc->EvalFastRotationPrecompute(inner);
+                    EvalAddExtInPlace(outer[c], cc->EvalFastRotationExt(inner, rotOut[i], innerDigits, false));
+                }
+                else {
+                    first[c] += cc->KeySwitchDownFirstElement(inner);
+                    auto elements = inner->GetElements();
+                    elements[0].SetValuesToZero();
+                    inner->SetElements(elements);
+                    EvalAddExtInPlace(outer[c], inner);
+                }
+            }
+        }
+    }
+
+    for (size_t c = 0; c < numCt; c++) {
+        ctxts[c] = cc->KeySwitchDown(outer[c]);
+        if (!double_hoisting_enabled) {
+            std::vector<DCRTPoly>& elements = ctxts[c]->GetElements();
+            elements[0] += first[c];
+        }
+    }
+}
+
+
+std::vector<Ciphertext<DCRTPoly>> FHECKKSRNS::EvalCoeffsToSlots(
+    const std::vector<std::vector<ConstPlaintext>>& A, const std::vector<ConstCiphertext<DCRTPoly>>& ctxts) const {
+    uint32_t slots = ctxts[0]->GetSlots();
 
     auto pair = m_bootPrecomMap.find(slots);
     if (pair == m_bootPrecomMap.end()) {
@@ -1581,9 +1913,8 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalCoeffsToSlots(const std::vector<std::vector
     }
     const std::shared_ptr<CKKSBootstrapPrecom> precom = pair->second;
 
-    auto cc    = ctxt->GetCryptoContext();
+    auto cc    = ctxts[0]->GetCryptoContext();
     uint32_t M = cc->GetCyclotomicOrder();
-    uint32_t N = cc->GetRingDimension();
 
     int32_t levelBudget     = precom->m_paramsEnc[CKKS_BOOT_PARAMS::LEVEL_BUDGET];
     int32_t layersCollapse  = precom->m_paramsEnc[CKKS_BOOT_PARAMS::LAYERS_COLL];
@@ -1644,143 +1975,36 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalCoeffsToSlots(const std::vector<std::vector
         }
     }
 
-    Ciphertext<DCRTPoly> result = ctxt->Clone();
+    std::vector<Ciphertext<DCRTPoly>> result(ctxts.size());
+    for (size_t c = 0; c < ctxts.size(); c++)
+        result[c] = ctxts[c]->Clone();
 
     // hoisted automorphisms
     for (int32_t s = levelBudget - 1; s > stop; s--) {
         if (s != levelBudget - 1) {
-            algo->ModReduceInternalInPlace(result, BASE_NUM_LEVELS_TO_DROP);
-        }
-
-        // computes the NTTs for each CRT limb (for the hoisted automorphisms used later on)
-        auto digits = cc->EvalFastRotationPrecompute(result);
-
-        std::vector<Ciphertext<DCRTPoly>> fastRotation(g);
-// // #pragma omp parallel for
-        for (int32_t j = 0; j < g; j++) {
-            if (rot_in[s][j] != 0) {
-                fastRotation[j] = cc->EvalFastRotationExt(result, rot_in[s][j], digits, true);
-            }
-            else {
-                fastRotation[j] = cc->KeySwitchExt(result, true);
-            }
-        }
-
-        Ciphertext<DCRTPoly> outer;
-        DCRTPoly first;
-        for (int32_t i = 0; i < b; i++) {
-            // for the first iteration with j=0:
-            int32_t G                  = g * i;
-            Ciphertext<DCRTPoly> inner = EvalMultExt(fastRotation[0], A[s][G]);
-            // continue the loop
-            for (int32_t j = 1; j < g; j++) {
-                if ((G + j) != int32_t(numRotations)) {
-                    EvalAddExtInPlace(inner, EvalMultExt(fastRotation[j], A[s][G + j]));
-                }
-            }
-
-            if (i == 0) {
-                first         = cc->KeySwitchDownFirstElement(inner);
-                auto elements = inner->GetElements();
-                elements[0].SetValuesToZero();
-                inner->SetElements(elements);
-                outer = inner;
-            }
-            else {
-                if (rot_out[s][i] != 0) {
-                    inner = cc->KeySwitchDown(inner);
-                    // Find the automorphism index that corresponds to rotation index index.
-                    usint autoIndex = FindAutomorphismIndex2nComplex(rot_out[s][i], M);
-                    std::vector<usint> map(N);
-                    PrecomputeAutoMap(N, autoIndex, &map);
-                    first += inner->GetElements()[0].AutomorphismTransform(autoIndex, map);
-                    auto innerDigits = cc->EvalFastRotationPrecompute(inner);
-                    EvalAddExtInPlace(outer, cc->EvalFastRotationExt(inner, rot_out[s][i], innerDigits, false));
-                }
-                else {
-                    first += cc->KeySwitchDownFirstElement(inner);
-                    auto elements = inner->GetElements();
-                    elements[0].SetValuesToZero();
-                    inner->SetElements(elements);
-                    EvalAddExtInPlace(outer, inner);
-                }
-            }
+            for (auto& ct : result)
+                algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
         }
-        result                          = cc->KeySwitchDown(outer);
-        std::vector<DCRTPoly>& elements = result->GetElements();
-        elements[0] += first;
+        EvalBSGSLevel(A[s], rot_in[s], rot_out[s], g, b, numRotations, result);
     }
 
     if (flagRem) {
-        algo->ModReduceInternalInPlace(result, BASE_NUM_LEVELS_TO_DROP);
-
-        // computes the NTTs for each CRT limb (for the hoisted automorphisms used later on)
-        auto digits = cc->EvalFastRotationPrecompute(result);
-        std::vector<Ciphertext<DCRTPoly>> fastRotation(gRem);
-
-// // #pragma omp parallel for
-        for (int32_t j = 0; j < gRem; j++) {
-            if (rot_in[stop][j] != 0) {
-                fastRotation[j] = cc->EvalFastRotationExt(result, rot_in[stop][j], digits, true);
-            }
-            else {
-                fastRotation[j] = cc->KeySwitchExt(result, true);
-            }
-        }
-
-        Ciphertext<DCRTPoly> outer;
-        DCRTPoly first;
-        for (int32_t i = 0; i < bRem; i++) {
-            Ciphertext<DCRTPoly> inner;
-            // for the first iteration with j=0:
-            int32_t GRem = gRem * i;
-            inner        = EvalMultExt(fastRotation[0], A[stop][GRem]);
-            // continue the loop
-            for (int32_t j = 1; j < gRem; j++) {
-                if ((GRem + j) != int32_t(numRotationsRem)) {
-                    EvalAddExtInPlace(inner, EvalMultExt(fastRotation[j], A[stop][GRem + j]));
-                }
-            }
-
-            if (i == 0) {
-                first         = cc->KeySwitchDownFirstElement(inner);
-                auto elements = inner->GetElements();
-                elements[0].SetValuesToZero();
-                inner->SetElements(elements);
-                outer = inner;
-            }
-            else {
-                if (rot_out[stop][i] != 0) {
-                    inner = cc->KeySwitchDown(inner);
-                    // Find the automorphism index that corresponds to rotation index index.
-                    usint autoIndex = FindAutomorphismIndex2nComplex(rot_out[stop][i], M);
-                    std::vector<usint> map(N);
-                    PrecomputeAutoMap(N, autoIndex, &map);
-                    first += inner->GetElements()[0].AutomorphismTransform(autoIndex, map);
-                    auto innerDigits = cc->EvalFastRotationPrecompute(inner);
-                    EvalAddExtInPlace(outer, cc->EvalFastRotationExt(inner, rot_out[stop][i], innerDigits, false));
-                }
-                else {
-                    first += cc->KeySwitchDownFirstElement(inner);
-                    auto elements = inner->GetElements();
-                    elements[0].SetValuesToZero();
-                    inner->SetElements(elements);
-                    EvalAddExtInPlace(outer, inner);
-                }
-            }
-        }
-
-        result                          = cc->KeySwitchDown(outer);
-        std::vector<DCRTPoly>& elements = result->GetElements();
-        elements[0] += first;
+        for (auto& ct : result)
+            algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
+        EvalBSGSLevel(A[stop], rot_in[stop], rot_out[stop], gRem, bRem, numRotationsRem, result);
     }
 
     return result;
 }
 
-Ciphertext<DCRTPoly> FHECKKSRNS::EvalSlotsToCoeffs(const std::vector<std::vector<ConstPlaintext>>& A,
+Ciphertext<DCRTPoly> FHECKKSRNS::EvalCoeffsToSlots(const std::vector<std::vector<ConstPlaintext>>& A,
                                                    ConstCiphertext<DCRTPoly> ctxt) const {
-    uint32_t slots = ctxt->GetSlots();
+    return EvalCoeffsToSlots(A, std::vector<ConstCiphertext<DCRTPoly>>{ctxt})[0];
+}
+
+std::vector<Ciphertext<DCRTPoly>> FHECKKSRNS::EvalSlotsToCoeffs(
+    const std::vector<std::vector<ConstPlaintext>>& A, const std::vector<ConstCiphertext<DCRTPoly>>& ctxts) const {
+    uint32_t slots = ctxts[0]->GetSlots();
 
     auto pair = m_bootPrecomMap.find(slots);
     if (pair == m_bootPrecomMap.end()) {
@@ -1792,10 +2016,9 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalSlotsToCoeffs(const std::vector<std::vector
 
     const std::shared_ptr<CKKSBootstrapPrecom> precom = pair->second;
 
-    auto cc = ctxt->GetCryptoContext();
+    auto cc = ctxts[0]->GetCryptoContext();
 
     uint32_t M = cc->GetCyclotomicOrder();
-    uint32_t N = cc->GetRingDimension();
 
     int32_t levelBudget     = precom->m_paramsDec[CKKS_BOOT_PARAMS::LEVEL_BUDGET];
     int32_t layersCollapse  = precom->m_paramsDec[CKKS_BOOT_PARAMS::LAYERS_COLL];
@@ -1857,140 +2080,34 @@ Ciphertext<DCRTPoly> FHECKKSRNS::EvalSlotsToCoeffs(const std::vector<std::vector
     }
 
     //  No need for Encrypted Bit Reverse
-    Ciphertext<DCRTPoly> result = ctxt->Clone();
+    std::vector<Ciphertext<DCRTPoly>> result(ctxts.size());
+    for (size_t c = 0; c < ctxts.size(); c++)
+        result[c] = ctxts[c]->Clone();
 
     // hoisted automorphisms
     for (int32_t s = 0; s < levelBudget - flagRem; s++) {
         if (s != 0) {
-            algo->ModReduceInternalInPlace(result, BASE_NUM_LEVELS_TO_DROP);
-        }
-        // computes the NTTs for each CRT limb (for the hoisted automorphisms used later on)
-        auto digits = cc->EvalFastRotationPrecompute(result);
-
-        std::vector<Ciphertext<DCRTPoly>> fastRotation(g);
-// // #pragma omp parallel for
-        for (int32_t j = 0; j < g; j++) {
-            if (rot_in[s][j] != 0) {
-                fastRotation[j] = cc->EvalFastRotationExt(result, rot_in[s][j], digits, true);
-            }
-            else {
-                fastRotation[j] = cc->KeySwitchExt(result, true);
-            }
-        }
-
-        Ciphertext<DCRTPoly> outer;
-        DCRTPoly first;
-        for (int32_t i = 0; i < b; i++) {
-            Ciphertext<DCRTPoly> inner;
-            // for the first iteration with j=0:
-            int32_t G = g * i;
-            inner     = EvalMultExt(fastRotation[0], A[s][G]);
-            // continue the loop
-            for (int32_t j = 1; j < g; j++) {
-                if ((G + j) != int32_t(numRotations)) {
-                    EvalAddExtInPlace(inner, EvalMultExt(fastRotation[j], A[s][G + j]));
-                }
-            }
-
-            if (i == 0) {
-                first         = cc->KeySwitchDownFirstElement(inner);
-                auto elements = inner->GetElements();
-                elements[0].SetValuesToZero();
-                inner->SetElements(elements);
-                outer = inner;
-            }
-            else {
-                if (rot_out[s][i] != 0) {
-                    inner = cc->KeySwitchDown(inner);
-                    // Find the automorphism index that corresponds to rotation index index.
-                    usint autoIndex = FindAutomorphismIndex2nComplex(rot_out[s][i], M);
-                    std::vector<usint> map(N);
-                    PrecomputeAutoMap(N, autoIndex, &map);
-                    first += inner->GetElements()[0].AutomorphismTransform(autoIndex, map);
-                    auto innerDigits = cc->EvalFastRotationPrecompute(inner);
-                    EvalAddExtInPlace(outer, cc->EvalFastRotationExt(inner, rot_out[s][i], innerDigits, false));
-                }
-                else {
-                    first += cc->KeySwitchDownFirstElement(inner);
-                    auto elements = inner->GetElements();
-                    elements[0].SetValuesToZero();
-                    inner->SetElements(elements);
-                    EvalAddExtInPlace(outer, inner);
-                }
-            }
+            for (auto& ct : result)
+                algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
         }
-
-        result                          = cc->KeySwitchDown(outer);
-        std::vector<DCRTPoly>& elements = result->GetElements();
-        elements[0] += first;
+        EvalBSGSLevel(A[s], rot_in[s], rot_out[s], g, b, numRotations, result);
     }
 
     if (flagRem) {
-        algo->ModReduceInternalInPlace(result, BASE_NUM_LEVELS_TO_DROP);
-        // computes the NTTs for each CRT limb (for the hoisted automorphisms used later on)
-        auto digits = cc->EvalFastRotationPrecompute(result);
-        std::vector<Ciphertext<DCRTPoly>> fastRotation(gRem);
-
+        for (auto& ct : result)
+            algo->ModReduceInternalInPlace(ct, BASE_NUM_LEVELS_TO_DROP);
         int32_t s = levelBudget - flagRem;
-// // #pragma omp parallel for
-        for (int32_t j = 0; j < gRem; j++) {
-            if (rot_in[s][j] != 0) {
-                fastRotation[j] = cc->EvalFastRotationExt(result, rot_in[s][j], digits, true);
-            }
-            else {
-                fastRotation[j] = cc->KeySwitchExt(result, true);
-            }
-        }
-
-        Ciphertext<DCRTPoly> outer;
-        DCRTPoly first;
-        for (int32_t i = 0; i < bRem; i++) {
-            Ciphertext<DCRTPoly> inner;
-            // for the first iteration with j=0:
-            int32_t GRem = gRem * i;
-            inner        = EvalMultExt(fastRotation[0], A[s][GRem]);
-            // continue the loop
-            for (int32_t j = 1; j < gRem; j++) {
-                if ((GRem + j) != int32_t(numRotationsRem))
-                    EvalAddExtInPlace(inner, EvalMultExt(fastRotation[j], A[s][GRem + j]));
-            }
-
-            if (i == 0) {
-                first         = cc->KeySwitchDownFirstElement(inner);
-                auto elements = inner->GetElements();
-                elements[0].SetValuesToZero();
-                inner->SetElements(elements);
-                outer = inner;
-            }
-            else {
-                if (rot_out[s][i] != 0) {
-                    inner = cc->KeySwitchDown(inner);
-                    // Find the automorphism index that corresponds to rotation index index.
-                    usint autoIndex = FindAutomorphismIndex2nComplex(rot_out[s][i], M);
-                    std::vector<usint> map(N);
-                    PrecomputeAutoMap(N, autoIndex, &map);
-                    first += inner->GetElements()[0].AutomorphismTransform(autoIndex, map);
-                    auto innerDigits = cc->EvalFastRotationPrecompute(inner);
-                    EvalAddExtInPlace(outer, cc->EvalFastRotationExt(inner, rot_out[s][i], innerDigits, false));
-                }
-                else {
-                    first += cc->KeySwitchDownFirstElement(inner);
-                    auto elements = inner->GetElements();
-                    elements[0].SetValuesToZero();
-                    inner->SetElements(elements);
-                    EvalAddExtInPlace(outer, inner);
-                }
-            }
-        }
-
-        result                          = cc->KeySwitchDown(outer);
-        std::vector<DCRTPoly>& elements = result->GetElements();
-        elements[0] += first;
+        EvalBSGSLevel(A[s], rot_in[s], rot_out[s], gRem, bRem, numRotationsRem, result);
     }
 
     return result;
 }
 
+Ciphertext<DCRTPoly> FHECKKSRNS::EvalSlotsToCoeffs(const std::vector<std::vector<ConstPlaintext>>& A,
+                                                   ConstCiphertext<DCRTPoly> ctxt) const {
+    return EvalSlotsToCoeffs(A, std::vector<ConstCiphertext<DCRTPoly>>{ctxt})[0];
+}
+
 uint32_t FHECKKSRNS::GetBootstrapDepth(uint32_t approxModDepth, const std::vector<uint32_t>& levelBudget,
                                        SecretKeyDist secretKeyDist) {
     if (secretKeyDist == UNIFORM_TERNARY) {
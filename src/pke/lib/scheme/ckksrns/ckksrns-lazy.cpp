@@ -0,0 +1,441 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "scheme/ckksrns/ckksrns-lazy.h"
+
+#include "utils/exception.h"
+
+#include <algorithm>
+#include <string>
+
+namespace lbcrypto {
+
+static const char* lazy_op_names[LAZY_OP_NUM] = {"input",  "add",    "sub",     "mult", "mult_const",
+                                                  "mult_plain", "rotate", "rescale", "relin"};
+
+uint32_t CKKSLazyCircuit::Append(const LazyNode& node) {
+    m_nodes.push_back(node);
+    return m_nodes.size() - 1;
+}
+
+void CKKSLazyCircuit::CheckNode(uint32_t a) const {
+    if (a >= m_nodes.size())
+        OPENFHE_THROW(config_error, "Lazy circuit node " + std::to_string(a) + " does not exist");
+}
+
+uint32_t CKKSLazyCircuit::Input() {
+    LazyNode node;
+    node.op    = LAZY_OP_INPUT;
+    node.index = m_numInputs++;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Add(uint32_t a, uint32_t b) {
+    CheckNode(a);
+    CheckNode(b);
+    LazyNode node;
+    node.op     = LAZY_OP_ADD;
+    node.arg[0] = a;
+    node.arg[1] = b;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Sub(uint32_t a, uint32_t b) {
+    CheckNode(a);
+    CheckNode(b);
+    LazyNode node;
+    node.op     = LAZY_OP_SUB;
+    node.arg[0] = a;
+    node.arg[1] = b;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Mult(uint32_t a, uint32_t b) {
+    CheckNode(a);
+    CheckNode(b);
+    LazyNode node;
+    node.op     = LAZY_OP_MULT;
+    node.arg[0] = a;
+    node.arg[1] = b;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Mult(uint32_t a, double constant) {
+    CheckNode(a);
+    LazyNode node;
+    node.op     = LAZY_OP_MULT_CONST;
+    node.arg[0] = a;
+    node.scalar = constant;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Mult(uint32_t a, ConstPlaintext plaintext) {
+    CheckNode(a);
+    if (!plaintext)
+        OPENFHE_THROW(type_error, "Input plaintext is nullptr");
+    LazyNode node;
+    node.op        = LAZY_OP_MULT_PLAIN;
+    node.arg[0]    = a;
+    node.plaintext = plaintext;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Rotate(uint32_t a, int32_t index) {
+    CheckNode(a);
+    LazyNode node;
+    node.op     = LAZY_OP_ROTATE;
+    node.arg[0] = a;
+    node.index  = index;
+    return Append(node);
+}
+
+uint32_t CKKSLazyCircuit::Rescale(uint32_t a) {
+    CheckNode(a);
+    LazyNode node;
+    node.op     = LAZY_OP_RESCALE;
+    node.arg[0] = a;
+    return Append(node);
+}
+
+void CKKSLazyCircuit::Output(uint32_t a) {
+    CheckNode(a);
+    m_outputs.push_back(a);
+}
+
+/* users of every node, an output counts as one user */
+std::vector<uint32_t> CKKSLazyCircuit::CountUses() const {
+    std::vector<uint32_t> uses(m_nodes.size(), 0);
+    for (const auto& node : m_nodes) {
+        for (auto arg : node.arg) {
+            if (arg >= 0)
+                uses[arg]++;
+        }
+    }
+    for (auto o : m_outputs)
+        uses[o]++;
+    return uses;
+}
+
+/* Add(Rescale(x), Rescale(y)) -> Rescale(Add(x, y)) when the rescaled values have no other user,
+    applied in order so a whole tree of sums is rescaled once.
+    The sum is marked delayed, Execute checks that x and y share level and noise scale degree */
+void CKKSLazyCircuit::DelayRescale() {
+    std::vector<uint32_t> uses = CountUses();
+    std::vector<LazyNode> nodes;
+    std::vector<uint32_t> nodeUses;  // users of the new nodes (the ones of the node they replace)
+    std::vector<int32_t> map(m_nodes.size());
+
+    for (uint32_t i = 0; i < m_nodes.size(); i++) {
+        LazyNode node = m_nodes[i];
+        for (auto& arg : node.arg) {
+            if (arg >= 0)
+                arg = map[arg];
+        }
+
+        if ((node.op == LAZY_OP_ADD || node.op == LAZY_OP_SUB) && node.arg[0] != node.arg[1]) {
+            const LazyNode& a = nodes[node.arg[0]];
+            const LazyNode& b = nodes[node.arg[1]];
+            if (a.op == LAZY_OP_RESCALE && b.op == LAZY_OP_RESCALE && nodeUses[node.arg[0]] == 1 &&
+                nodeUses[node.arg[1]] == 1) {
+                LazyNode sum = node;
+                sum.arg[0]   = a.arg[0];
+                sum.arg[1]   = b.arg[0];
+                sum.delayed  = true;
+                nodes.push_back(sum);
+                nodeUses.push_back(1);
+
+                LazyNode rescale;
+                rescale.op     = LAZY_OP_RESCALE;
+                rescale.arg[0] = nodes.size() - 1;
+                nodes.push_back(rescale);
+                nodeUses.push_back(uses[i]);
+                map[i] = nodes.size() - 1;
+                continue;
+            }
+        }
+
+        nodes.push_back(node);
+        nodeUses.push_back(uses[i]);
+        map[i] = nodes.size() - 1;
+    }
+
+    for (auto& o : m_outputs)
+        o = map[o];
+    m_nodes = std::move(nodes);
+}
+
+/* products stay with three elements until a user needs two (Mult, Rotate, output),
+    one LAZY_OP_RELIN per value is inserted before its first such user */
+void CKKSLazyCircuit::LazyRelinearize() {
+    std::vector<LazyNode> nodes;
+    std::vector<uint32_t> degree;  // elements - 1 of the value
+    std::vector<int32_t> map(m_nodes.size());
+    std::map<int32_t, int32_t> relinOf;
+
+    auto linear = [&](int32_t arg) -> int32_t {
+        if (degree[arg] == 1)
+            return arg;
+        auto it = relinOf.find(arg);
+        if (it != relinOf.end())
+            return it->second;
+        LazyNode relin;
+        relin.op     = LAZY_OP_RELIN;
+        relin.arg[0] = arg;
+        nodes.push_back(relin);
+        degree.push_back(1);
+        relinOf[arg] = nodes.size() - 1;
+        return nodes.size() - 1;
+    };
+
+    for (uint32_t i = 0; i < m_nodes.size(); i++) {
+        LazyNode node = m_nodes[i];
+        for (auto& arg : node.arg) {
+            if (arg >= 0)
+                arg = map[arg];
+        }
+
+        uint32_t deg = 1;
+        switch (node.op) {
+            case LAZY_OP_MULT:
+                node.arg[0] = linear(node.arg[0]);
+                node.arg[1] = linear(node.arg[1]);
+                node.relin  = false;
+                deg         = 2;
+                break;
+            case LAZY_OP_ROTATE:
+                node.arg[0] = linear(node.arg[0]);
+                break;
+            case LAZY_OP_ADD:
+            case LAZY_OP_SUB:
+                deg = std::max(degree[node.arg[0]], degree[node.arg[1]]);
+                break;
+            case LAZY_OP_MULT_CONST:
+            case LAZY_OP_MULT_PLAIN:
+            case LAZY_OP_RESCALE:
+                deg = degree[node.arg[0]];
+                break;
+        }
+
+        nodes.push_back(node);
+        degree.push_back(deg);
+        map[i] = nodes.size() - 1;
+    }
+
+    for (auto& o : m_outputs)
+        o = linear(map[o]);
+    m_nodes = std::move(nodes);
+}
+
+/* rotations of the same value share the digit decomposition of the value */
+void CKKSLazyCircuit::HoistRotations() {
+    std::map<int32_t, uint32_t> rotations;
+    for (const auto& node : m_nodes) {
+        if (node.op == LAZY_OP_ROTATE)
+            rotations[node.arg[0]]++;
+    }
+    for (auto& node : m_nodes) {
+        if (node.op == LAZY_OP_ROTATE)
+            node.hoisted = rotations[node.arg[0]] > 1;
+    }
+}
+
+void CKKSLazyCircuit::RemoveDeadNodes() {
+    std::vector<bool> live(m_nodes.size(), false);
+    for (auto o : m_outputs)
+        live[o] = true;
+    for (int32_t i = m_nodes.size() - 1; i >= 0; i--) {
+        if (!live[i] && m_nodes[i].op != LAZY_OP_INPUT)
+            continue;
+        live[i] = true;  // inputs keep their position
+        for (auto arg : m_nodes[i].arg) {
+            if (arg >= 0)
+                live[arg] = true;
+        }
+    }
+
+    std::vector<LazyNode> nodes;
+    std::vector<int32_t> map(m_nodes.size(), -1);
+    for (uint32_t i = 0; i < m_nodes.size(); i++) {
+        if (!live[i])
+            continue;
+        LazyNode node = m_nodes[i];
+        for (auto& arg : node.arg) {
+            if (arg >= 0)
+                arg = map[arg];
+        }
+        nodes.push_back(node);
+        map[i] = nodes.size() - 1;
+    }
+    for (auto& o : m_outputs)
+        o = map[o];
+    m_nodes = std::move(nodes);
+}
+
+void CKKSLazyCircuit::Optimize(uint32_t passes) {
+    RemoveDeadNodes();
+    if (passes & LAZY_PASS_RESCALE) {
+        DelayRescale();
+        RemoveDeadNodes();
+    }
+    if (passes & LAZY_PASS_RELIN) {
+        LazyRelinearize();
+        RemoveDeadNodes();
+    }
+    if (passes & LAZY_PASS_HOIST)
+        HoistRotations();
+}
+
+std::vector<Ciphertext<DCRTPoly>> CKKSLazyCircuit::Execute(
+    const std::vector<ConstCiphertext<DCRTPoly>>& inputs) const {
+    if (inputs.size() != m_numInputs)
+        OPENFHE_THROW(config_error, "Lazy circuit needs " + std::to_string(m_numInputs) + " input ciphertexts, " +
+                                        std::to_string(inputs.size()) + " given");
+
+    uint32_t M = m_cc->GetCyclotomicOrder();
+
+    /* values are released after their last user */
+    std::vector<uint32_t> remaining = CountUses();
+    std::vector<Ciphertext<DCRTPoly>> values(m_nodes.size());
+    auto value = [&](int32_t a) -> ConstCiphertext<DCRTPoly> {
+        return (m_nodes[a].op == LAZY_OP_INPUT) ? inputs[m_nodes[a].index] : values[a];
+    };
+
+    std::map<int32_t, uint32_t> hoistedLeft;
+    for (const auto& node : m_nodes) {
+        if (node.op == LAZY_OP_ROTATE && node.hoisted)
+            hoistedLeft[node.arg[0]]++;
+    }
+    std::map<int32_t, std::shared_ptr<std::vector<DCRTPoly>>> digits;
+
+    /* delayed sums whose operands could not share the rescale (other level or noise scale degree),
+        they are rescaled one by one and the LAZY_OP_RESCALE user passes the sum through */
+    std::vector<bool> rescaled(m_nodes.size(), false);
+    auto delayedSum = [&](const LazyNode& node, uint32_t i) -> Ciphertext<DCRTPoly> {
+        ConstCiphertext<DCRTPoly> x = value(node.arg[0]);
+        ConstCiphertext<DCRTPoly> y = value(node.arg[1]);
+        bool share = !rescaled[node.arg[0]] && !rescaled[node.arg[1]] && x->GetLevel() == y->GetLevel() &&
+                     x->GetNoiseScaleDeg() == y->GetNoiseScaleDeg();
+        if (!share) {
+            if (!rescaled[node.arg[0]])
+                x = m_cc->Rescale(x);
+            if (!rescaled[node.arg[1]])
+                y = m_cc->Rescale(y);
+            rescaled[i] = true;
+        }
+        return (node.op == LAZY_OP_ADD) ? m_cc->EvalAdd(x, y) : m_cc->EvalSub(x, y);
+    };
+
+    for (uint32_t i = 0; i < m_nodes.size(); i++) {
+        const LazyNode& node = m_nodes[i];
+        Ciphertext<DCRTPoly> result;
+        switch (node.op) {
+            case LAZY_OP_INPUT:
+                break;
+            case LAZY_OP_ADD:
+                result = node.delayed ? delayedSum(node, i) : m_cc->EvalAdd(value(node.arg[0]), value(node.arg[1]));
+                break;
+            case LAZY_OP_SUB:
+                result = node.delayed ? delayedSum(node, i) : m_cc->EvalSub(value(node.arg[0]), value(node.arg[1]));
+                break;
+            case LAZY_OP_MULT:
+                result = node.relin ? m_cc->EvalMult(value(node.arg[0]), value(node.arg[1])) :
+                                      m_cc->EvalMultNoRelin(value(node.arg[0]), value(node.arg[1]));
+                break;
+            case LAZY_OP_MULT_CONST:
+                result = m_cc->EvalMult(value(node.arg[0]), node.scalar);
+                break;
+            case LAZY_OP_MULT_PLAIN:
+                result = m_cc->EvalMult(value(node.arg[0]), node.plaintext);
+                break;
+            case LAZY_OP_ROTATE:
+                if (node.hoisted) {
+                    auto& d = digits[node.arg[0]];
+                    if (!d)
+                        d = m_cc->EvalFastRotationPrecompute(value(node.arg[0]));
+                    // rotation index in [0, M/4), same automorphism as a negative index
+                    int32_t slots = M / 4;
+                    usint index   = ((node.index % slots) + slots) % slots;
+                    result        = m_cc->EvalFastRotation(value(node.arg[0]), index, M, d);
+                    if (--hoistedLeft[node.arg[0]] == 0)
+                        digits.erase(node.arg[0]);
+                }
+                else {
+                    result = m_cc->EvalRotate(value(node.arg[0]), node.index);
+                }
+                break;
+            case LAZY_OP_RESCALE:
+                result = rescaled[node.arg[0]] ? values[node.arg[0]] : m_cc->Rescale(value(node.arg[0]));
+                break;
+            case LAZY_OP_RELIN:
+                result = m_cc->Relinearize(value(node.arg[0]));
+                break;
+        }
+        values[i] = result;
+
+        for (auto arg : node.arg) {
+            if (arg >= 0 && --remaining[arg] == 0)
+                values[arg] = nullptr;
+        }
+    }
+
+    /* a node given twice to Output is returned as two ciphertexts */
+    std::vector<Ciphertext<DCRTPoly>> outputs;
+    std::vector<bool> returned(m_nodes.size(), false);
+    for (auto o : m_outputs) {
+        outputs.push_back((m_nodes[o].op == LAZY_OP_INPUT || returned[o]) ? value(o)->Clone() : values[o]);
+        returned[o] = true;
+    }
+    return outputs;
+}
+
+void CKKSLazyCircuit::Print(std::ostream& out) const {
+    uint32_t ops[LAZY_OP_NUM] = {0};
+    uint32_t relins = 0, hoisted = 0;
+    std::map<int32_t, uint32_t> groups;
+    for (const auto& node : m_nodes) {
+        ops[node.op]++;
+        if ((node.op == LAZY_OP_MULT && node.relin) || node.op == LAZY_OP_RELIN)
+            relins++;
+        if (node.op == LAZY_OP_ROTATE && node.hoisted) {
+            hoisted++;
+            groups[node.arg[0]]++;
+        }
+    }
+    out << "lazy circuit: " << m_nodes.size() << " nodes, " << m_outputs.size() << " outputs" << std::endl;
+    for (uint32_t op = 0; op < LAZY_OP_NUM; op++) {
+        if (ops[op])
+            out << "  " << lazy_op_names[op] << ": " << ops[op] << std::endl;
+    }
+    out << "  relinearizations: " << relins << ", hoisted rotations: " << hoisted << " (" << groups.size()
+        << " groups)" << std::endl;
+}
+
+}  // namespace lbcrypto
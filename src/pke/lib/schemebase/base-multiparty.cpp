@@ -315,6 +315,7 @@ EvalKey<Element> MultipartyBase<Element>::MultiAddEvalKeys(EvalKey<Element> eval
 
     EvalKey<Element> evalKeySum = std::make_shared<EvalKeyRelinImpl<Element>>(cc);
 
+    // A is shared by the parties, a seeded A keeps its seed
     const std::vector<Element>& a = evalKey1->GetAVector();
 
     const std::vector<Element>& b1 = evalKey1->GetBVector();
@@ -322,12 +323,14 @@ EvalKey<Element> MultipartyBase<Element>::MultiAddEvalKeys(EvalKey<Element> eval
 
     std::vector<Element> b;
 
-    for (usint i = 0; i < a.size(); i++) {
+    for (usint i = 0; i < b1.size(); i++) {
         b.push_back(b1[i] + b2[i]);
     }
 
     evalKeySum->SetAVector(a);
     evalKeySum->SetBVector(std::move(b));
+    if (!evalKey1->GetASeed().empty())
+        evalKeySum->SetASeed(evalKey1->GetASeed());
 
     return evalKeySum;
 }
@@ -339,8 +342,8 @@ EvalKey<Element> MultipartyBase<Element>::MultiAddEvalMultKeys(EvalKey<Element>
 
     EvalKey<Element> evalKeySum = std::make_shared<EvalKeyRelinImpl<Element>>(cc);
 
-    const std::vector<Element>& a1 = evalKey1->GetAVector();
-    const std::vector<Element>& a2 = evalKey2->GetAVector();
+    const std::vector<Element> a1 = evalKey1->GetAVectorExpanded();
+    const std::vector<Element> a2 = evalKey2->GetAVectorExpanded();
 
     const std::vector<Element>& b1 = evalKey1->GetBVector();
     const std::vector<Element>& b2 = evalKey2->GetBVector();
@@ -371,7 +374,7 @@ EvalKey<Element> MultipartyBase<Element>::MultiMultEvalKey(PrivateKey<Element> p
 
     EvalKey<Element> evalKeyResult = std::make_shared<EvalKeyRelinImpl<Element>>(cc);
 
-    const std::vector<Element>& a0 = evalKey->GetAVector();
+    const std::vector<Element> a0  = evalKey->GetAVectorExpanded();
     const std::vector<Element>& b0 = evalKey->GetBVector();
 
     const Element& s = privateKey->GetPrivateElement();
@@ -34,6 +34,7 @@
 #include "math/dftransform.h"
 #include "cryptocontext.h"
 #include "schemerns/rns-cryptoparameters.h"
+#include "utils/multi_device.h"
 
 namespace lbcrypto {
 
@@ -177,6 +178,12 @@ void CryptoParametersRNS::PrecomputeCRTTables(KeySwitchTechnique ksTech, Scaling
 
         m_paramsQP = std::make_shared<ILDCRTParams<BigInteger>>(2 * n, moduliQP, rootsQP);
 
+        // Place the limbs on the emulated devices (multi-device mode), Q limbs of a digit together
+        std::vector<uint64_t> moduliDevice(sizeQ + sizeP);
+        for (size_t i = 0; i < sizeQ + sizeP; i++)
+            moduliDevice[i] = moduliQP[i].ConvertToInt<uint64_t>();
+        register_device_moduli(moduliDevice, sizeQ, m_numPerPartQ);
+
         // Pre-compute CRT::FFT values for P
         ChineseRemainderTransformFTT<NativeVector>().PreCompute(rootsP, 2 * n, moduliP);
 
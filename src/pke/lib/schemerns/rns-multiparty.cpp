@@ -189,7 +189,8 @@ EvalKey<DCRTPoly> MultipartyRNS::MultiMultEvalKey(PrivateKey<DCRTPoly> privateKe
 
     EvalKey<DCRTPoly> evalKeyResult = std::make_shared<EvalKeyRelinImpl<DCRTPoly>>(evalKey->GetCryptoContext());
 
-    const std::vector<DCRTPoly>& a0 = evalKey->GetAVector();
+    // seeded key : A is expanded, the product A * s is not uniform any more and is stored as it is
+    const std::vector<DCRTPoly> a0  = evalKey->GetAVectorExpanded();
     const std::vector<DCRTPoly>& b0 = evalKey->GetBVector();
 
     std::vector<DCRTPoly> a;
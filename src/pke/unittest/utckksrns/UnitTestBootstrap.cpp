@@ -38,15 +38,24 @@
 #include "UnitTestCryptoContext.h"
 #include "utils/demangle.h"
 #include "scheme/ckksrns/ckksrns-utils.h"
+#include "scheme/ckksrns/ckksrns-bootcache.h"
 
 #include <iostream>
 #include <vector>
 #include "gtest/gtest.h"
 #include <cxxabi.h>
 #include <iterator>
+#include <fstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace lbcrypto;
 
+// giant steps of the linear transforms summed in the extended basis (core/lib/utils/math_utils.cpp)
+extern bool double_hoisting_enabled;
+void set_double_hoisting(bool enable);
+
 //===========================================================================================================
 enum TEST_CASE_TYPE {
     BOOTSTRAP_FULL = 0,
@@ -55,6 +64,9 @@ enum TEST_CASE_TYPE {
     BOOTSTRAP_KEY_SWITCH,
     BOOTSTRAP_ITERATIVE,
     BOOTSTRAP_NUM_TOWERS,
+    BOOTSTRAP_PRECOM_CACHE,
+    BOOTSTRAP_DOUBLE_HOISTING,
+    BOOTSTRAP_BATCH,
 };
 
 static std::ostream& operator<<(std::ostream& os, const TEST_CASE_TYPE& type) {
@@ -78,6 +90,15 @@ static std::ostream& operator<<(std::ostream& os, const TEST_CASE_TYPE& type) {
         case BOOTSTRAP_NUM_TOWERS:
             typeName = "BOOTSTRAP_NUM_TOWERS";
             break;
+        case BOOTSTRAP_PRECOM_CACHE:
+            typeName = "BOOTSTRAP_PRECOM_CACHE";
+            break;
+        case BOOTSTRAP_DOUBLE_HOISTING:
+            typeName = "BOOTSTRAP_DOUBLE_HOISTING";
+            break;
+        case BOOTSTRAP_BATCH:
+            typeName = "BOOTSTRAP_BATCH";
+            break;
         default:
             typeName = "UNKNOWN";
             break;
@@ -286,6 +307,31 @@ static std::vector<TEST_CASE_UTCKKSRNS_BOOT> testCases = {
     { BOOTSTRAP_NUM_TOWERS, "14", {CKKSRNS_SCHEME,  RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 }, RDIM/2},
     { BOOTSTRAP_NUM_TOWERS, "15", {CKKSRNS_SCHEME,  RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    SPARSE_TERNARY,  DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTOEXT, NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 }, RDIM/2},
     { BOOTSTRAP_NUM_TOWERS, "16", {CKKSRNS_SCHEME,  RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTOEXT, NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 }, RDIM/2},
+#endif
+    // ==========================================
+    // TestType,              Descr, Scheme,          RDim, MultDepth,  SModSize,     DSize, BatchSz, SecKeyDist,      MaxRelinSkDeg, FModSize,  SecLvl,       KSTech, ScalTech,        LDigits,      PtMod, StdDev, EvalAddCt, KSCt, MultTech, EncTech, PREMode, LvlBudget, Dim1,       Slots
+    { BOOTSTRAP_PRECOM_CACHE, "01", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 1, 1 },  { 32, 32 }, RDIM/2 },
+    { BOOTSTRAP_PRECOM_CACHE, "02", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  8,       UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 },   8 },
+#if NATIVEINT != 128
+    { BOOTSTRAP_PRECOM_CACHE, "03", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 3 },  { 0, 0 },   RDIM/2 },
+#endif
+    // ==========================================
+    // TestType,                 Descr, Scheme,          RDim, MultDepth,  SModSize,     DSize, BatchSz, SecKeyDist,      MaxRelinSkDeg, FModSize,  SecLvl,       KSTech, ScalTech,        LDigits,      PtMod, StdDev, EvalAddCt, KSCt, MultTech, EncTech, PREMode, LvlBudget, Dim1,       Slots
+    { BOOTSTRAP_DOUBLE_HOISTING, "01", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 1, 1 },  { 32, 32 }, RDIM/2 },
+    { BOOTSTRAP_DOUBLE_HOISTING, "02", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  8,       UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 1, 1 },  { 0, 0 },   8 },
+    { BOOTSTRAP_DOUBLE_HOISTING, "03", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 3 },  { 0, 0 },   RDIM/2 },
+    { BOOTSTRAP_DOUBLE_HOISTING, "04", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  8,       UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 },   8 },
+#if NATIVEINT != 128
+    { BOOTSTRAP_DOUBLE_HOISTING, "05", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    SPARSE_TERNARY,  DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 1, 1 },  { 32, 32 }, RDIM/2 },
+    { BOOTSTRAP_DOUBLE_HOISTING, "06", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    SPARSE_TERNARY,  DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 3 },  { 0, 0 },   RDIM/2 },
+#endif
+    // ==========================================
+    // TestType,       Descr, Scheme,          RDim, MultDepth,  SModSize,     DSize, BatchSz, SecKeyDist,      MaxRelinSkDeg, FModSize,  SecLvl,       KSTech, ScalTech,        LDigits,      PtMod, StdDev, EvalAddCt, KSCt, MultTech, EncTech, PREMode, LvlBudget, Dim1,       Slots
+    { BOOTSTRAP_BATCH, "01", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 1, 1 },  { 32, 32 }, RDIM/2 },
+    { BOOTSTRAP_BATCH, "02", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  8,       UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDMANUAL,     NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 },   8 },
+    { BOOTSTRAP_BATCH, "03", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    SPARSE_TERNARY,  DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FIXEDAUTO,       NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 2 },  { 0, 0 },   RDIM/2 },
+#if NATIVEINT != 128
+    { BOOTSTRAP_BATCH, "04", {CKKSRNS_SCHEME, RDIM, MULT_DEPTH, SMODSIZE,     DFLT,  DFLT,    UNIFORM_TERNARY, DFLT,          FMODSIZE,  HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    NUM_LRG_DIGS, DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT},   { 3, 3 },  { 0, 0 },   RDIM/2 },
 #endif
     // ==========================================
 };
@@ -598,6 +644,319 @@ protected:
             std::string name("EMSCRIPTEN_UNKNOWN");
 #else
             std::string name(demangle(__cxxabiv1::__cxa_current_exception_type()->name()));
+#endif
+            std::cerr << "Unknown exception of type \"" << name << "\" thrown from " << __func__ << "()" << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+    }
+
+    /* a cache directory of its own for the test, removed with its files */
+    struct BootCacheDir {
+        BootCacheDir() {
+            dir = mkdtemp(dirTemplate);
+            set_boot_precom_cache(dir);
+        }
+        ~BootCacheDir() {
+            set_boot_precom_cache(nullptr);
+            for (const auto& f : files)
+                unlink(f.c_str());
+            if (dir)
+                rmdir(dir);
+        }
+        char dirTemplate[32] = "/tmp/bootprecomXXXXXX";
+        char* dir            = nullptr;
+        std::vector<std::string> files;
+    };
+
+    /* files of the cache directory */
+    static std::vector<char> ReadBootCacheFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    static void WriteBootCacheFile(const std::string& path, const std::vector<char>& data) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    }
+
+    static ino_t BootCacheInode(const std::string& path) {
+        struct stat st;
+        return (stat(path.c_str(), &st) == 0) ? st.st_ino : 0;
+    }
+
+    /* the first record with limbs of a cache file */
+    static BootCacheRecord* FirstBootCacheRecord(std::vector<char>& data) {
+        BootCacheHeader* header  = reinterpret_cast<BootCacheHeader*>(data.data());
+        BootCacheRecord* records = reinterpret_cast<BootCacheRecord*>(data.data() + sizeof(BootCacheHeader));
+        for (uint64_t r = 0; r < header->num_records; r++) {
+            if (records[r].num_limbs != 0)
+                return &records[r];
+        }
+        return nullptr;
+    }
+
+    void UnitTest_Bootstrap_PrecomCache(const TEST_CASE_UTCKKSRNS_BOOT& testData,
+                                        const std::string& failmsg = std::string()) {
+        BootCacheDir cache;
+        ASSERT_NE(cache.dir, nullptr) << failmsg;
+        std::vector<std::string>& files = cache.files;
+        try {
+            CryptoContext<Element> cc(UnitTestGenerateContext(testData.params));
+
+            // computed by the first setup and written to the cache directory
+            cc->EvalBootstrapSetup(testData.levelBudget, testData.dim1, testData.slots);
+            std::string path =
+                BootPrecomCachePath(BootPrecomKey(*cc, testData.levelBudget, testData.dim1, testData.slots));
+            files.push_back(path);
+            std::vector<char> computedFile = ReadBootCacheFile(path);
+            ASSERT_GT(computedFile.size(), sizeof(BootCacheHeader)) << failmsg + " no cache file " + path;
+            ino_t computedInode = BootCacheInode(path);
+
+            auto keyPair = cc->KeyGen();
+            cc->EvalBootstrapKeyGen(keyPair.secretKey, testData.slots);
+            cc->EvalMultKeyGen(keyPair.secretKey);
+
+            std::vector<std::complex<double>> input(
+                Fill({0.111111, 0.222222, 0.333333, 0.444444, 0.555555, 0.666666, 0.777777, 0.888888}, testData.slots));
+            size_t encodedLength = input.size();
+
+            Plaintext plaintext = cc->MakeCKKSPackedPlaintext(input, 1, MULT_DEPTH - 1, nullptr, testData.slots);
+            auto ciphertext     = cc->Encrypt(keyPair.publicKey, plaintext);
+            auto computed       = cc->EvalBootstrap(ciphertext);
+
+            // the second setup loads the file (not written again) and bootstraps the same way
+            cc->EvalBootstrapSetup(testData.levelBudget, testData.dim1, testData.slots);
+            EXPECT_EQ(BootCacheInode(path), computedInode) << failmsg + " the cache file was not used";
+            auto loaded = cc->EvalBootstrap(ciphertext);
+
+            ASSERT_EQ(loaded->GetElements().size(), computed->GetElements().size()) << failmsg;
+            for (size_t i = 0; i < loaded->GetElements().size(); i++) {
+                ASSERT_EQ(loaded->GetElements()[i].GetNumOfElements(), computed->GetElements()[i].GetNumOfElements());
+                for (size_t l = 0; l < loaded->GetElements()[i].GetNumOfElements(); l++)
+                    EXPECT_EQ(loaded->GetElements()[i].GetElementAtIndex(l),
+                              computed->GetElements()[i].GetElementAtIndex(l))
+                        << failmsg + " loaded and computed plaintexts bootstrap differently";
+            }
+
+            Plaintext result;
+            cc->Decrypt(keyPair.secretKey, computed, &result);
+            result->SetLength(encodedLength);
+            checkEquality(result->GetCKKSPackedValue(), plaintext->GetCKKSPackedValue(), eps,
+                          failmsg + " Bootstrapping with computed plaintexts fails");
+            cc->Decrypt(keyPair.secretKey, loaded, &result);
+            result->SetLength(encodedLength);
+            checkEquality(result->GetCKKSPackedValue(), plaintext->GetCKKSPackedValue(), eps,
+                          failmsg + " Bootstrapping with loaded plaintexts fails");
+
+            // another level budget or number of slots is another file
+            std::vector<uint32_t> otherBudget =
+                (testData.levelBudget[0] == 1) ? std::vector<uint32_t>{2, 2} : std::vector<uint32_t>{1, 1};
+            cc->EvalBootstrapSetup(otherBudget, {0, 0}, testData.slots);
+            std::string otherBudgetPath =
+                BootPrecomCachePath(BootPrecomKey(*cc, otherBudget, {0, 0}, testData.slots));
+            files.push_back(otherBudgetPath);
+            EXPECT_NE(otherBudgetPath, path) << failmsg;
+            EXPECT_NE(BootCacheInode(otherBudgetPath), 0U) << failmsg + " no cache file for another level budget";
+
+            uint32_t otherSlots = (testData.slots == RDIM / 2) ? testData.slots / 2 : testData.slots * 2;
+            cc->EvalBootstrapSetup(testData.levelBudget, testData.dim1, otherSlots);
+            std::string otherSlotsPath =
+                BootPrecomCachePath(BootPrecomKey(*cc, testData.levelBudget, testData.dim1, otherSlots));
+            files.push_back(otherSlotsPath);
+            EXPECT_NE(otherSlotsPath, path) << failmsg;
+            EXPECT_NE(BootCacheInode(otherSlotsPath), 0U) << failmsg + " no cache file for other slots";
+
+            /* files that do not fit the setup are not used, the plaintexts are computed and written again:
+                the file of the other level budget under the key of this one (rows and entries),
+                a level that is not the one of the limbs, a value above its modulus */
+            std::vector<std::vector<char>> badFiles;
+            badFiles.push_back(ReadBootCacheFile(otherBudgetPath));
+            reinterpret_cast<BootCacheHeader*>(badFiles.back().data())->key =
+                reinterpret_cast<BootCacheHeader*>(computedFile.data())->key;
+            badFiles.push_back(computedFile);
+            FirstBootCacheRecord(badFiles.back())->level++;
+            badFiles.push_back(computedFile);
+            BootCacheRecord* rec = FirstBootCacheRecord(badFiles.back());
+            uint64_t* values     = reinterpret_cast<uint64_t*>(badFiles.back().data() + rec->offset);
+            values[2 * rec->num_limbs] = values[0];  // the modulus of the first limb
+
+            for (size_t k = 0; k < badFiles.size(); k++) {
+                WriteBootCacheFile(path, badFiles[k]);
+                cc->EvalBootstrapSetup(testData.levelBudget, testData.dim1, testData.slots);
+                EXPECT_TRUE(ReadBootCacheFile(path) == computedFile)
+                    << failmsg + " a bad cache file was used, case " + std::to_string(k);
+
+                auto again = cc->EvalBootstrap(ciphertext);
+                cc->Decrypt(keyPair.secretKey, again, &result);
+                result->SetLength(encodedLength);
+                checkEquality(result->GetCKKSPackedValue(), plaintext->GetCKKSPackedValue(), eps,
+                              failmsg + " Bootstrapping after a bad cache file fails, case " + std::to_string(k));
+            }
+        }
+        catch (std::exception& e) {
+            std::cerr << "Exception thrown from " << __func__ << "(): " << e.what() << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+        catch (...) {
+#if defined EMSCRIPTEN
+            std::string name("EMSCRIPTEN_UNKNOWN");
+#else
+            std::string name(demangle(__cxxabiv1::__cxa_current_exception_type()->name()));
+#endif
+            std::cerr << "Unknown exception of type \"" << name << "\" thrown from " << __func__ << "()" << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+    }
+
+    /* restores the giant step summation of the linear transforms */
+    struct DoubleHoistingGuard {
+        DoubleHoistingGuard() : saved(double_hoisting_enabled) {}
+        ~DoubleHoistingGuard() {
+            set_double_hoisting(saved);
+        }
+        bool saved;
+    };
+
+    void UnitTest_Bootstrap_DoubleHoisting(const TEST_CASE_UTCKKSRNS_BOOT& testData,
+                                           const std::string& failmsg = std::string()) {
+        DoubleHoistingGuard guard;
+        try {
+            CryptoContext<Element> cc(UnitTestGenerateContext(testData.params));
+
+            cc->EvalBootstrapSetup(testData.levelBudget, testData.dim1, testData.slots);
+
+            auto keyPair = cc->KeyGen();
+            cc->EvalBootstrapKeyGen(keyPair.secretKey, testData.slots);
+            cc->EvalMultKeyGen(keyPair.secretKey);
+
+            std::vector<std::complex<double>> input(
+                Fill({0.111111, 0.222222, 0.333333, 0.444444, 0.555555, 0.666666, 0.777777, 0.888888}, testData.slots));
+            size_t encodedLength = input.size();
+
+            Plaintext plaintext = cc->MakeCKKSPackedPlaintext(input, 1, MULT_DEPTH - 1, nullptr, testData.slots);
+            auto ciphertext     = cc->Encrypt(keyPair.publicKey, plaintext);
+
+            // giant steps key switched one by one (off) and summed in the extended basis (on)
+            std::vector<std::vector<std::complex<double>>> results;
+            std::vector<uint32_t> levels;
+            for (bool enable : {false, true}) {
+                set_double_hoisting(enable);
+                auto ciphertextAfter = cc->EvalBootstrap(ciphertext);
+                levels.push_back(ciphertextAfter->GetLevel());
+
+                Plaintext result;
+                cc->Decrypt(keyPair.secretKey, ciphertextAfter, &result);
+                result->SetLength(encodedLength);
+                results.push_back(result->GetCKKSPackedValue());
+                checkEquality(results.back(), plaintext->GetCKKSPackedValue(), eps,
+                              failmsg + " Bootstrapping with double hoisting " + (enable ? "on" : "off") + " fails");
+            }
+            EXPECT_EQ(levels[0], levels[1]) << failmsg;
+            checkEquality(results[1], results[0], eps, failmsg + " double hoisting changes the bootstrapping result");
+        }
+        catch (std::exception& e) {
+            std::cerr << "Exception thrown from " << __func__ << "(): " << e.what() << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+        catch (...) {
+#if defined EMSCRIPTEN
+            std::string name("EMSCRIPTEN_UNKNOWN");
+#else
+            std::string name(demangle(__cxxabiv1::__cxa_current_exception_type()->name()));
+#endif
+            std::cerr << "Unknown exception of type \"" << name << "\" thrown from " << __func__ << "()" << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+    }
+
+    /* every output of the batch has to be the ciphertext of the single bootstrapping */
+    static void CheckSameCiphertext(const Ciphertext<Element>& batched, const Ciphertext<Element>& single,
+                                    const std::string& failmsg) {
+        EXPECT_EQ(batched->GetLevel(), single->GetLevel()) << failmsg;
+        EXPECT_EQ(batched->GetNoiseScaleDeg(), single->GetNoiseScaleDeg()) << failmsg;
+        EXPECT_EQ(batched->GetScalingFactor(), single->GetScalingFactor()) << failmsg;
+        ASSERT_EQ(batched->GetElements().size(), single->GetElements().size()) << failmsg;
+        for (size_t i = 0; i < single->GetElements().size(); i++) {
+            ASSERT_EQ(batched->GetElements()[i].GetNumOfElements(), single->GetElements()[i].GetNumOfElements())
+                << failmsg;
+            for (size_t l = 0; l < single->GetElements()[i].GetNumOfElements(); l++)
+                EXPECT_EQ(batched->GetElements()[i].GetElementAtIndex(l), single->GetElements()[i].GetElementAtIndex(l))
+                    << failmsg;
+        }
+    }
+
+    void UnitTest_Bootstrap_Batch(const TEST_CASE_UTCKKSRNS_BOOT& testData,
+                                  const std::string& failmsg = std::string()) {
+        try {
+            CryptoContext<Element> cc(UnitTestGenerateContext(testData.params));
+
+            cc->EvalBootstrapSetup(testData.levelBudget, testData.dim1, testData.slots);
+
+            auto keyPair = cc->KeyGen();
+            cc->EvalBootstrapKeyGen(keyPair.secretKey, testData.slots);
+            cc->EvalMultKeyGen(keyPair.secretKey);
+
+            std::vector<std::complex<double>> input(
+                Fill({0.111111, 0.222222, 0.333333, 0.444444, 0.555555, 0.666666, 0.777777, 0.888888}, testData.slots));
+            size_t encodedLength = input.size();
+
+            // other values and other level for every ciphertext, to see the outputs are not mixed up
+            const std::vector<uint32_t> levels = {MULT_DEPTH - 1, MULT_DEPTH - 2, MULT_DEPTH - 4};
+            std::vector<Plaintext> plaintexts;
+            std::vector<Ciphertext<Element>> ciphertexts;
+            for (size_t c = 0; c < levels.size(); c++) {
+                auto values = input;
+                std::rotate(values.begin(), values.begin() + c, values.end());
+                plaintexts.push_back(cc->MakeCKKSPackedPlaintext(values, 1, levels[c], nullptr, testData.slots));
+                ciphertexts.push_back(cc->Encrypt(keyPair.publicKey, plaintexts.back()));
+            }
+
+            auto check = [&](const std::vector<Ciphertext<Element>>& batched, uint32_t numIterations,
+                             uint32_t precision) {
+                ASSERT_EQ(batched.size(), ciphertexts.size()) << failmsg;
+                for (size_t c = 0; c < ciphertexts.size(); c++) {
+                    std::string msg = failmsg + " ciphertext " + std::to_string(c) + " of the batch, " +
+                                      std::to_string(numIterations) + " iterations";
+                    CheckSameCiphertext(batched[c], cc->EvalBootstrap(ciphertexts[c], numIterations, precision),
+                                        msg + ": batched and single bootstrapping differ");
+
+                    Plaintext result;
+                    cc->Decrypt(keyPair.secretKey, batched[c], &result);
+                    result->SetLength(encodedLength);
+                    checkEquality(result->GetCKKSPackedValue(), plaintexts[c]->GetCKKSPackedValue(), eps,
+                                  msg + ": bootstrapping fails");
+                }
+            };
+
+            check(cc->EvalBootstrap(ciphertexts), 1, 0);
+
+            // Meta-BTS, precision measured as in UnitTest_Bootstrap_Iterative
+            Plaintext result;
+            cc->Decrypt(keyPair.secretKey, cc->EvalBootstrap(ciphertexts[0]), &result);
+            result->SetLength(encodedLength);
+            uint32_t precision =
+                std::floor(CalculateApproximationError(result->GetCKKSPackedValue(), plaintexts[0]->GetCKKSPackedValue()));
+            const double precisionBuffer = 5;
+            precision -= precisionBuffer;
+
+            uint32_t numIterations = 2;
+            check(cc->EvalBootstrap(ciphertexts, numIterations, precision), numIterations, precision);
+        }
+        catch (std::exception& e) {
+            std::cerr << "Exception thrown from " << __func__ << "(): " << e.what() << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+        catch (...) {
+#if defined EMSCRIPTEN
+            std::string name("EMSCRIPTEN_UNKNOWN");
+#else
+            std::string name(demangle(__cxxabiv1::__cxa_current_exception_type()->name()));
 #endif
             std::cerr << "Unknown exception of type \"" << name << "\" thrown from " << __func__ << "()" << std::endl;
             // make it fail
@@ -626,6 +985,15 @@ TEST_P(UTCKKSRNS_BOOT, CKKSRNS) {
         case BOOTSTRAP_NUM_TOWERS:
             UnitTest_Bootstrap_NumTowers(test, test.buildTestName());
             break;
+        case BOOTSTRAP_PRECOM_CACHE:
+            UnitTest_Bootstrap_PrecomCache(test, test.buildTestName());
+            break;
+        case BOOTSTRAP_DOUBLE_HOISTING:
+            UnitTest_Bootstrap_DoubleHoisting(test, test.buildTestName());
+            break;
+        case BOOTSTRAP_BATCH:
+            UnitTest_Bootstrap_Batch(test, test.buildTestName());
+            break;
         default:
             break;
     }
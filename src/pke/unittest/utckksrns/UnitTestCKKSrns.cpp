@@ -64,6 +64,7 @@ enum TEST_CASE_TYPE {
     ADD_PACKED_PRECISION,
     MULT_PACKED_PRECISION,
     EVALSQUARE,
+    EVAL_SUM_OF_PRODUCTS,
 };
 
 static std::ostream& operator<<(std::ostream& os, const TEST_CASE_TYPE& type) {
@@ -114,6 +115,9 @@ static std::ostream& operator<<(std::ostream& os, const TEST_CASE_TYPE& type) {
         case EVALSQUARE:
             typeName = "EVALSQUARE";
             break;
+        case EVAL_SUM_OF_PRODUCTS:
+            typeName = "EVAL_SUM_OF_PRODUCTS";
+            break;
         default:
             typeName = "UNKNOWN";
             break;
@@ -518,6 +522,12 @@ static std::vector<TEST_CASE_UTCKKSRNS> testCases = {
     { EVALSQUARE, "06", {CKKSRNS_SCHEME, RING_DIM, 7,     SMODSIZE, DSIZE, BATCH,   DFLT,       DFLT,          DFLT,     HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    DFLT,    DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT}, },
     { EVALSQUARE, "07", {CKKSRNS_SCHEME, RING_DIM, 7,     SMODSIZE, DSIZE, BATCH,   DFLT,       DFLT,          DFLT,     HEStd_NotSet, BV,     FLEXIBLEAUTOEXT, DFLT,    DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT}, },
     { EVALSQUARE, "08", {CKKSRNS_SCHEME, RING_DIM, 7,     SMODSIZE, DSIZE, BATCH,   DFLT,       DFLT,          DFLT,     HEStd_NotSet, HYBRID, FLEXIBLEAUTOEXT, DFLT,    DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT}, },
+#endif
+    // ==========================================
+    // TestType,           Descr, Scheme,         RDim, MultDepth, SModSize, DSize, BatchSz, SecKeyDist, MaxRelinSkDeg, FModSize, SecLvl,       KSTech, ScalTech,        LDigits, PtMod, StdDev, EvalAddCt, KSCt, MultTech, EncTech, PREMode
+    { EVAL_SUM_OF_PRODUCTS, "01", {CKKSRNS_SCHEME, RING_DIM, 7,     SMODSIZE, DSIZE, BATCH,   DFLT,       DFLT,          DFLT,     HEStd_NotSet, HYBRID, FIXEDMANUAL,     DFLT,    DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT}, },
+#if NATIVEINT != 128
+    { EVAL_SUM_OF_PRODUCTS, "02", {CKKSRNS_SCHEME, RING_DIM, 7,     SMODSIZE, DSIZE, BATCH,   DFLT,       DFLT,          DFLT,     HEStd_NotSet, HYBRID, FLEXIBLEAUTO,    DFLT,    DFLT,  DFLT,   DFLT,      DFLT, DFLT,     DFLT,    DFLT}, },
 #endif
 #endif
     // ==========================================
@@ -1762,6 +1772,112 @@ protected:
         }
     }
 
+    void UnitTest_EvalSumOfProducts(const TEST_CASE_UTCKKSRNS& testData,
+                                    const std::string& failmsg = std::string()) {
+        try {
+            CryptoContext<Element> cc(UnitTestGenerateContext(testData.params));
+
+            const std::vector<std::vector<std::complex<double>>> in1 = {
+                {0.5, 1.0, 1.5, 2.0, 0.25, 0.75, 1.25, 1.75},
+                {1.0, 0.5, 0.25, 2.0, 1.5, 1.0, 0.5, 0.25},
+                {2.0, 1.0, 0.5, 0.25, 1.0, 2.0, 0.75, 1.5},
+                {0.25, 0.5, 1.0, 1.5, 2.0, 0.5, 1.0, 0.75},
+            };
+            const std::vector<std::vector<std::complex<double>>> in2 = {
+                {1.0, 2.0, 0.5, 0.25, 1.5, 1.0, 0.75, 0.5},
+                {0.75, 1.25, 2.0, 0.5, 1.0, 0.25, 1.5, 1.0},
+                {0.5, 0.5, 1.0, 2.0, 0.25, 1.0, 1.25, 0.75},
+                {1.5, 0.25, 0.75, 1.0, 0.5, 2.0, 0.5, 1.25},
+            };
+
+            KeyPair<Element> kp = cc->KeyGen();
+            cc->EvalMultKeyGen(kp.secretKey);
+
+            std::vector<ConstCiphertext<Element>> v1;
+            std::vector<ConstCiphertext<Element>> v2;
+            for (size_t i = 0; i < in1.size(); i++) {
+                v1.push_back(cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(in1[i])));
+                v2.push_back(cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(in2[i])));
+            }
+
+            // the sum of the products computed pair by pair is the reference
+            auto sumOfMult = [&](const std::vector<ConstCiphertext<Element>>& c1,
+                                 const std::vector<ConstCiphertext<Element>>& c2) {
+                Ciphertext<Element> sum = cc->EvalMult(c1[0], c2[0]);
+                for (size_t i = 1; i < c1.size(); i++)
+                    sum = cc->EvalAdd(sum, cc->EvalMult(c1[i], c2[i]));
+                return sum;
+            };
+
+            Plaintext expected;
+            Plaintext results;
+            cc->Decrypt(kp.secretKey, sumOfMult(v1, v2), &expected);
+            expected->SetLength(VECTOR_SIZE);
+
+            std::vector<std::complex<double>> plainSum(VECTOR_SIZE);
+            for (size_t i = 0; i < in1.size(); i++) {
+                for (usint j = 0; j < VECTOR_SIZE; j++)
+                    plainSum[j] += in1[i][j] * in2[i][j];
+            }
+            checkEquality(plainSum, expected->GetCKKSPackedValue(), eps, failmsg + " sum of EvalMult fails");
+
+            auto cResult = cc->EvalSumOfProducts(v1, v2);
+            EXPECT_EQ(cResult->GetElements().size(), 2U) << failmsg + " EvalSumOfProducts is not relinearized";
+            cc->Decrypt(kp.secretKey, cResult, &results);
+            results->SetLength(VECTOR_SIZE);
+            checkEquality(expected->GetCKKSPackedValue(), results->GetCKKSPackedValue(), eps,
+                          failmsg + " EvalSumOfProducts fails");
+
+            // the second pair is one level below the others: it goes to the pairs multiplied alone
+            std::vector<ConstCiphertext<Element>> v1Mixed(v1);
+            auto lower = cc->EvalMult(v1[1], 1.0);
+            if (testData.params.scalTech == FIXEDMANUAL)
+                cc->RescaleInPlace(lower);
+            v1Mixed[1] = lower;
+
+            cc->Decrypt(kp.secretKey, sumOfMult(v1Mixed, v2), &expected);
+            expected->SetLength(VECTOR_SIZE);
+            cResult = cc->EvalSumOfProducts(v1Mixed, v2);
+            cc->Decrypt(kp.secretKey, cResult, &results);
+            results->SetLength(VECTOR_SIZE);
+            checkEquality(expected->GetCKKSPackedValue(), results->GetCKKSPackedValue(), eps,
+                          failmsg + " EvalSumOfProducts with pairs at different levels fails");
+
+            // products with three elements are relinearized once by EvalLinearWSum
+            std::vector<double> weights{1.5, 0.5};
+            std::vector<ConstCiphertext<Element>> products{cc->EvalMultNoRelin(v1[0], v2[0]),
+                                                           cc->EvalSumOfProductsNoRelin(v1, v2)};
+            EXPECT_EQ(products[0]->GetElements().size(), 3U) << failmsg;
+            EXPECT_EQ(products[1]->GetElements().size(), 3U) << failmsg;
+
+            std::vector<std::complex<double>> plainWSum(VECTOR_SIZE);
+            for (usint j = 0; j < VECTOR_SIZE; j++)
+                plainWSum[j] = weights[0] * in1[0][j] * in2[0][j] + weights[1] * plainSum[j];
+
+            cResult = cc->EvalLinearWSum(products, weights);
+            EXPECT_EQ(cResult->GetElements().size(), 2U) << failmsg + " EvalLinearWSum is not relinearized";
+            cc->Decrypt(kp.secretKey, cResult, &results);
+            results->SetLength(VECTOR_SIZE);
+            checkEquality(plainWSum, results->GetCKKSPackedValue(), eps,
+                          failmsg + " EvalLinearWSum of three-element products fails");
+        }
+        catch (std::exception& e) {
+            std::cerr << "Exception thrown from " << __func__ << "(): " << e.what() << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+        catch (...) {
+#if defined EMSCRIPTEN
+            std::string name("EMSCRIPTEN_UNKNOWN");
+#else
+            std::string name(demangle(__cxxabiv1::__cxa_current_exception_type()->name()));
+#endif
+            std::cerr << "Unknown exception of type \"" << name << "\" thrown from " << __func__ << "()" << std::endl;
+            // make it fail
+            EXPECT_TRUE(0 == 1) << failmsg;
+        }
+    }
+
     void UnitTest_ReEncryption(const TEST_CASE_UTCKKSRNS& testData, const std::string& failmsg = std::string()) {
         try {
             CryptoContext<Element> cc(UnitTestGenerateContext(testData.params));
@@ -2227,6 +2343,10 @@ TEST_P(UTCKKSRNS, CKKSRNS) {
             break;
         case EVALSQUARE:
             UnitTest_EvalSquare(test, test.buildTestName());
+            break;
+        case EVAL_SUM_OF_PRODUCTS:
+            UnitTest_EvalSumOfProducts(test, test.buildTestName());
+            break;
         default:
             break;
     }
@@ -0,0 +1,251 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  Lazy evaluation of a static CKKS circuit (CKKSLazyCircuit) against the same ops run eagerly
+ */
+
+#include "UnitTestUtils.h"
+
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "openfhe.h"
+#include "scheme/ckksrns/ckksrns-lazy.h"
+
+using namespace lbcrypto;
+
+namespace {
+
+constexpr uint32_t LAZY_BATCH = 8;
+constexpr double LAZY_EPS     = 0.0001;
+
+CryptoContext<DCRTPoly> LazyContext() {
+    CCParams<CryptoContextCKKSRNS> parameters;
+    parameters.SetMultiplicativeDepth(3);
+    parameters.SetScalingModSize(50);
+    parameters.SetBatchSize(LAZY_BATCH);
+    parameters.SetRingDim(64);
+    parameters.SetSecurityLevel(HEStd_NotSet);
+    parameters.SetKeySwitchTechnique(HYBRID);
+    parameters.SetNumLargeDigits(2);
+    parameters.SetScalingTechnique(FIXEDMANUAL);
+
+    CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
+    cc->Enable(PKE);
+    cc->Enable(KEYSWITCH);
+    cc->Enable(LEVELEDSHE);
+    return cc;
+}
+
+const std::vector<double> lazyX = {0.25, 0.5, 0.75, 1.0, 0.125, 0.375, 0.625, 0.875};
+const std::vector<double> lazyW = {1.0, 0.5, 0.75, 0.25, 0.5, 1.0, 0.875, 0.625};
+
+const std::vector<int32_t> lazyRotations = {1, -1, -3, 2, -2};
+
+/* x[i + k] in the batch */
+std::vector<double> RotatePlain(const std::vector<double>& v, int32_t k) {
+    std::vector<double> r(v.size());
+    for (int32_t i = 0; i < static_cast<int32_t>(v.size()); i++)
+        r[i] = v[((i + k) % LAZY_BATCH + LAZY_BATCH) % LAZY_BATCH];
+    return r;
+}
+
+/* three rotations of the input x (one negative) times w summed under delayed rescales,
+    a delayed sum of two products at different levels, rotations of an inner value and the same output twice */
+std::vector<uint32_t> RecordCircuit(CKKSLazyCircuit& circuit) {
+    auto x = circuit.Input();
+    auto w = circuit.Input();
+
+    auto m0 = circuit.Mult(x, w);
+    auto m1 = circuit.Mult(circuit.Rotate(x, 1), w);
+    auto m2 = circuit.Mult(circuit.Rotate(x, -1), w);
+    auto m3 = circuit.Mult(circuit.Rotate(x, -3), w);
+    auto s  = circuit.Add(circuit.Add(circuit.Rescale(m0), circuit.Rescale(m1)),
+                          circuit.Sub(circuit.Rescale(m2), circuit.Rescale(m3)));
+    auto t  = circuit.Rescale(circuit.Mult(s, 0.5));
+    auto r  = circuit.Add(circuit.Rotate(t, -2), circuit.Rotate(t, 2));
+
+    // x * x at the level of the inputs, (w * w) * x one level below
+    auto u     = circuit.Mult(x, x);
+    auto v     = circuit.Mult(circuit.Rescale(circuit.Mult(w, w)), x);
+    auto mixed = circuit.Add(circuit.Rescale(u), circuit.Rescale(v));
+
+    return {r, mixed, t, t};
+}
+
+std::vector<Ciphertext<DCRTPoly>> RunEager(CryptoContext<DCRTPoly>& cc, ConstCiphertext<DCRTPoly> x,
+                                           ConstCiphertext<DCRTPoly> w) {
+    auto m0 = cc->EvalMult(x, w);
+    auto m1 = cc->EvalMult(cc->EvalRotate(x, 1), w);
+    auto m2 = cc->EvalMult(cc->EvalRotate(x, -1), w);
+    auto m3 = cc->EvalMult(cc->EvalRotate(x, -3), w);
+    auto s  = cc->EvalAdd(cc->EvalAdd(cc->Rescale(m0), cc->Rescale(m1)), cc->EvalSub(cc->Rescale(m2), cc->Rescale(m3)));
+    auto t  = cc->Rescale(cc->EvalMult(s, 0.5));
+    auto r  = cc->EvalAdd(cc->EvalRotate(t, -2), cc->EvalRotate(t, 2));
+
+    auto u     = cc->EvalMult(x, x);
+    auto v     = cc->EvalMult(cc->Rescale(cc->EvalMult(w, w)), x);
+    auto mixed = cc->EvalAdd(cc->Rescale(u), cc->Rescale(v));
+
+    return {r, mixed, t, t->Clone()};
+}
+
+std::vector<std::vector<double>> ExpectedPlain() {
+    std::vector<double> t(LAZY_BATCH), mixed(LAZY_BATCH), r(LAZY_BATCH);
+    auto x1 = RotatePlain(lazyX, 1), xm1 = RotatePlain(lazyX, -1), xm3 = RotatePlain(lazyX, -3);
+    for (uint32_t i = 0; i < LAZY_BATCH; i++) {
+        t[i]     = 0.5 * (lazyX[i] * lazyW[i] + x1[i] * lazyW[i] + xm1[i] * lazyW[i] - xm3[i] * lazyW[i]);
+        mixed[i] = lazyX[i] * lazyX[i] + lazyW[i] * lazyW[i] * lazyX[i];
+    }
+    auto tm2 = RotatePlain(t, -2), t2 = RotatePlain(t, 2);
+    for (uint32_t i = 0; i < LAZY_BATCH; i++)
+        r[i] = tm2[i] + t2[i];
+    return {r, mixed, t, t};
+}
+
+std::vector<std::complex<double>> Decode(CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& sk,
+                                         ConstCiphertext<DCRTPoly> ct) {
+    Plaintext result;
+    cc->Decrypt(sk, ct, &result);
+    result->SetLength(LAZY_BATCH);
+    return result->GetCKKSPackedValue();
+}
+
+std::vector<std::complex<double>> ToComplex(const std::vector<double>& v) {
+    return std::vector<std::complex<double>>(v.begin(), v.end());
+}
+
+}  // namespace
+
+/* the optimized circuit decrypts as the eager ops, for every pass alone and all of them */
+TEST(UTCKKSRNS_LAZY, lazy_vs_eager) {
+    CryptoContext<DCRTPoly> cc = LazyContext();
+    auto kp                    = cc->KeyGen();
+    cc->EvalMultKeyGen(kp.secretKey);
+    cc->EvalRotateKeyGen(kp.secretKey, lazyRotations);
+
+    auto ctX = cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(lazyX));
+    auto ctW = cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(lazyW));
+
+    auto expected = ExpectedPlain();
+    auto eager    = RunEager(cc, ctX, ctW);
+    std::vector<std::vector<std::complex<double>>> eagerValues;
+    for (size_t k = 0; k < eager.size(); k++) {
+        eagerValues.push_back(Decode(cc, kp.secretKey, eager[k]));
+        checkEquality(eagerValues[k], ToComplex(expected[k]), LAZY_EPS, "eager, output " + std::to_string(k));
+    }
+
+    for (uint32_t passes : {0, LAZY_PASS_RESCALE, LAZY_PASS_RELIN, LAZY_PASS_HOIST, LAZY_PASS_ALL}) {
+        CKKSLazyCircuit circuit(cc);
+        for (auto o : RecordCircuit(circuit))
+            circuit.Output(o);
+        circuit.Optimize(passes);
+
+        auto lazy = circuit.Execute({ctX, ctW});
+        ASSERT_EQ(lazy.size(), eager.size());
+        for (size_t k = 0; k < lazy.size(); k++) {
+            EXPECT_EQ(lazy[k]->GetElements().size(), 2U);
+            EXPECT_EQ(lazy[k]->GetLevel(), eager[k]->GetLevel());
+            EXPECT_EQ(lazy[k]->GetNoiseScaleDeg(), eager[k]->GetNoiseScaleDeg());
+            checkEquality(Decode(cc, kp.secretKey, lazy[k]), eagerValues[k], LAZY_EPS,
+                          "passes " + std::to_string(passes) + ", output " + std::to_string(k));
+        }
+    }
+    cc->ClearEvalMultKeys();
+    cc->ClearEvalAutomorphismKeys();
+}
+
+/* the rotations of x (1, -1, -3) and of the inner value (2, -2) are hoisted, the sums are rescaled once */
+TEST(UTCKKSRNS_LAZY, optimized_graph) {
+    CryptoContext<DCRTPoly> cc = LazyContext();
+    CKKSLazyCircuit circuit(cc);
+    for (auto o : RecordCircuit(circuit))
+        circuit.Output(o);
+    circuit.Optimize(LAZY_PASS_ALL);
+
+    uint32_t hoisted = 0, negative = 0, delayed = 0, rescales = 0;
+    for (const auto& node : circuit.GetNodes()) {
+        if (node.op == LAZY_OP_ROTATE && node.hoisted) {
+            hoisted++;
+            if (node.index < 0)
+                negative++;
+        }
+        if ((node.op == LAZY_OP_ADD || node.op == LAZY_OP_SUB) && node.delayed)
+            delayed++;
+        if (node.op == LAZY_OP_RESCALE)
+            rescales++;
+    }
+    EXPECT_EQ(hoisted, 5U);
+    EXPECT_EQ(negative, 3U);
+    // s (three sums) and mixed
+    EXPECT_EQ(delayed, 4U);
+    // s, t, w * w and mixed
+    EXPECT_EQ(rescales, 4U);
+}
+
+/* a node given twice to Output gives two ciphertexts */
+TEST(UTCKKSRNS_LAZY, duplicate_outputs) {
+    CryptoContext<DCRTPoly> cc = LazyContext();
+    auto kp                    = cc->KeyGen();
+    cc->EvalMultKeyGen(kp.secretKey);
+
+    auto ctX = cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(lazyX));
+    auto ctW = cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(lazyW));
+
+    CKKSLazyCircuit circuit(cc);
+    auto x = circuit.Input();
+    auto w = circuit.Input();
+    auto p = circuit.Rescale(circuit.Mult(x, w));
+    circuit.Output(p);
+    circuit.Output(p);
+    circuit.Output(x);
+    circuit.Output(x);
+    circuit.Optimize(LAZY_PASS_ALL);
+
+    auto outs = circuit.Execute({ctX, ctW});
+    ASSERT_EQ(outs.size(), 4U);
+    EXPECT_NE(outs[0], outs[1]);
+    EXPECT_NE(outs[2], outs[3]);
+
+    std::vector<double> product(LAZY_BATCH), twice(LAZY_BATCH);
+    for (uint32_t i = 0; i < LAZY_BATCH; i++) {
+        product[i] = lazyX[i] * lazyW[i];
+        twice[i]   = 2 * product[i];
+    }
+    // changing one of the results leaves the other one
+    cc->EvalAddInPlace(outs[0], outs[1]);
+    checkEquality(Decode(cc, kp.secretKey, outs[0]), ToComplex(twice), LAZY_EPS, "first output");
+    checkEquality(Decode(cc, kp.secretKey, outs[1]), ToComplex(product), LAZY_EPS, "second output");
+    checkEquality(Decode(cc, kp.secretKey, outs[3]), ToComplex(lazyX), LAZY_EPS, "input output");
+    cc->ClearEvalMultKeys();
+}
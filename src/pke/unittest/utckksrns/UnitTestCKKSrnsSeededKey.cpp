@@ -0,0 +1,261 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2014-2022, NJIT, Duality Technologies Inc. and other contributors
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+/*
+  Seeded hybrid key switching keys (BOOT_SCHEME >= 2) : A is expanded from a seed
+ */
+
+#include "UnitTestUtils.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "openfhe.h"
+#include "ciphertext-ser.h"
+#include "cryptocontext-ser.h"
+#include "key/key-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+
+using namespace lbcrypto;
+
+// 0 : A is stored in the key, 2 : only B and the seed of A
+extern uint32_t BOOT_SCHEME;
+
+namespace {
+
+constexpr uint32_t SEED_BATCH = 8;
+constexpr double SEED_EPS     = 0.0001;
+
+/* restores the key generation scheme */
+class BootSchemeGuard {
+public:
+    explicit BootSchemeGuard(uint32_t scheme) : saved(BOOT_SCHEME) {
+        BOOT_SCHEME = scheme;
+    }
+    ~BootSchemeGuard() {
+        BOOT_SCHEME = saved;
+    }
+    uint32_t saved;
+};
+
+CryptoContext<DCRTPoly> SeededKeyContext() {
+    CCParams<CryptoContextCKKSRNS> parameters;
+    parameters.SetMultiplicativeDepth(3);
+    parameters.SetScalingModSize(50);
+    parameters.SetBatchSize(SEED_BATCH);
+    parameters.SetRingDim(64);
+    parameters.SetSecurityLevel(HEStd_NotSet);
+    parameters.SetKeySwitchTechnique(HYBRID);
+    // several parts of Q, A of every part comes from its own streams
+    parameters.SetNumLargeDigits(2);
+    parameters.SetScalingTechnique(FIXEDMANUAL);
+
+    CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
+    cc->Enable(PKE);
+    cc->Enable(KEYSWITCH);
+    cc->Enable(LEVELEDSHE);
+    cc->Enable(MULTIPARTY);
+    return cc;
+}
+
+const std::vector<double> seedInput1 = {0.25, 0.5, 0.75, 1.0, -1.0, -0.75, -0.5, 0.125};
+const std::vector<double> seedInput2 = {1.0, -0.5, 0.125, 2.0, 0.5, 0.25, -1.5, 1.0};
+
+std::vector<std::complex<double>> Decode(CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& sk,
+                                         const Ciphertext<DCRTPoly>& ct) {
+    Plaintext result;
+    cc->Decrypt(sk, ct, &result);
+    result->SetLength(SEED_BATCH);
+    return result->GetCKKSPackedValue();
+}
+
+/* rotations (EvalAtIndex) and a relinearized product (EvalMult) with the keys of the context */
+std::vector<std::vector<std::complex<double>>> RunKeySwitches(CryptoContext<DCRTPoly>& cc,
+                                                              const KeyPair<DCRTPoly>& kp) {
+    auto ct1 = cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(seedInput1));
+    auto ct2 = cc->Encrypt(kp.publicKey, cc->MakeCKKSPackedPlaintext(seedInput2));
+    return {Decode(cc, kp.secretKey, cc->EvalAtIndex(ct1, 1)), Decode(cc, kp.secretKey, cc->EvalAtIndex(ct1, -2)),
+            Decode(cc, kp.secretKey, cc->Rescale(cc->EvalMult(ct1, ct2)))};
+}
+
+std::vector<std::complex<double>> ToComplex(const std::vector<double>& v) {
+    return std::vector<std::complex<double>>(v.begin(), v.end());
+}
+
+}  // namespace
+
+/* same results with a seeded and a stored A, the seeded key has no A */
+TEST(UTCKKSRNS_SEEDED_KEY, seeded_vs_stored) {
+    CryptoContext<DCRTPoly> cc = SeededKeyContext();
+    auto kp                    = cc->KeyGen();
+
+    std::vector<std::vector<std::complex<double>>> stored, seeded;
+    {
+        BootSchemeGuard guard(0);
+        cc->EvalMultKeyGen(kp.secretKey);
+        cc->EvalAtIndexKeyGen(kp.secretKey, {1, -2});
+        EXPECT_TRUE(cc->GetEvalMultKeyVector(kp.secretKey->GetKeyTag())[0]->GetASeed().empty());
+        stored = RunKeySwitches(cc, kp);
+    }
+    cc->ClearEvalMultKeys();
+    cc->ClearEvalAutomorphismKeys();
+    {
+        BootSchemeGuard guard(2);
+        cc->EvalMultKeyGen(kp.secretKey);
+        cc->EvalAtIndexKeyGen(kp.secretKey, {1, -2});
+        auto evalMultKey = cc->GetEvalMultKeyVector(kp.secretKey->GetKeyTag())[0];
+        EXPECT_EQ(evalMultKey->GetASeed().size(), 16u);
+        EXPECT_TRUE(evalMultKey->GetAVector().empty());
+        EXPECT_EQ(evalMultKey->GetBVector().size(), 2u);
+        seeded = RunKeySwitches(cc, kp);
+    }
+
+    auto rot1 = seedInput1;
+    std::rotate(rot1.begin(), rot1.begin() + 1, rot1.end());
+    auto rotm2 = seedInput1;
+    std::rotate(rotm2.begin(), rotm2.end() - 2, rotm2.end());
+    std::vector<double> product(SEED_BATCH);
+    for (size_t i = 0; i < SEED_BATCH; i++)
+        product[i] = seedInput1[i] * seedInput2[i];
+    std::vector<std::vector<std::complex<double>>> expected = {ToComplex(rot1), ToComplex(rotm2), ToComplex(product)};
+
+    for (size_t k = 0; k < expected.size(); k++) {
+        checkEquality(stored[k], expected[k], SEED_EPS, "stored A, result " + std::to_string(k));
+        checkEquality(seeded[k], expected[k], SEED_EPS, "seeded A, result " + std::to_string(k));
+        checkEquality(seeded[k], stored[k], SEED_EPS, "seeded and stored A differ, result " + std::to_string(k));
+    }
+    cc->ClearEvalMultKeys();
+    cc->ClearEvalAutomorphismKeys();
+}
+
+/* threshold HE with seeded keys : the parties share the seed of the lead party,
+    MultiAddEvalKeys keeps the seed, MultiMultEvalKey and MultiAddEvalMultKeys expand A */
+TEST(UTCKKSRNS_SEEDED_KEY, threshold_eval_mult_key) {
+    BootSchemeGuard guard(2);
+    CryptoContext<DCRTPoly> cc = SeededKeyContext();
+
+    KeyPair<DCRTPoly> kp1 = cc->KeyGen();
+    auto evalMultKey      = cc->KeySwitchGen(kp1.secretKey, kp1.secretKey);
+    ASSERT_FALSE(evalMultKey->GetASeed().empty());
+
+    KeyPair<DCRTPoly> kp2 = cc->MultipartyKeyGen(kp1.publicKey);
+    auto evalMultKey2     = cc->MultiKeySwitchGen(kp2.secretKey, kp2.secretKey, evalMultKey);
+    EXPECT_EQ(evalMultKey2->GetASeed(), evalMultKey->GetASeed());
+    auto evalMultAB = cc->MultiAddEvalKeys(evalMultKey, evalMultKey2, kp2.publicKey->GetKeyTag());
+    EXPECT_EQ(evalMultAB->GetASeed(), evalMultKey->GetASeed());
+    auto evalMultBAB   = cc->MultiMultEvalKey(kp2.secretKey, evalMultAB, kp2.publicKey->GetKeyTag());
+    auto evalMultAAB   = cc->MultiMultEvalKey(kp1.secretKey, evalMultAB, kp2.publicKey->GetKeyTag());
+    auto evalMultFinal = cc->MultiAddEvalMultKeys(evalMultAAB, evalMultBAB, evalMultAB->GetKeyTag());
+    EXPECT_TRUE(evalMultFinal->GetASeed().empty());
+    EXPECT_EQ(evalMultFinal->GetAVector().size(), evalMultFinal->GetBVector().size());
+    cc->InsertEvalMultKey({evalMultFinal});
+
+    auto ct1 = cc->Encrypt(kp2.publicKey, cc->MakeCKKSPackedPlaintext(seedInput1));
+    auto ct2 = cc->Encrypt(kp2.publicKey, cc->MakeCKKSPackedPlaintext(seedInput2));
+    auto ctMult = cc->Rescale(cc->EvalMult(ct1, ct2));
+
+    auto partial1 = cc->MultipartyDecryptLead({ctMult}, kp1.secretKey);
+    auto partial2 = cc->MultipartyDecryptMain({ctMult}, kp2.secretKey);
+    std::vector<Ciphertext<DCRTPoly>> partials{partial1[0], partial2[0]};
+    Plaintext result;
+    cc->MultipartyDecryptFusion(partials, &result);
+    result->SetLength(SEED_BATCH);
+
+    std::vector<double> product(SEED_BATCH);
+    for (size_t i = 0; i < SEED_BATCH; i++)
+        product[i] = seedInput1[i] * seedInput2[i];
+    checkEquality(result->GetCKKSPackedValue(), ToComplex(product), SEED_EPS,
+                  "threshold EvalMult with a seeded evaluation key fails");
+    cc->ClearEvalMultKeys();
+}
+
+/* version 2 : the seed goes through the serialization, A stays empty */
+TEST(UTCKKSRNS_SEEDED_KEY, serialize_seeded_key) {
+    BootSchemeGuard guard(2);
+    CryptoContext<DCRTPoly> cc = SeededKeyContext();
+    auto kp1                   = cc->KeyGen();
+    auto kp2                   = cc->KeyGen();
+    auto key                   = cc->KeySwitchGen(kp1.secretKey, kp2.secretKey);
+
+    for (int binary = 0; binary < 2; binary++) {
+        std::stringstream s;
+        EvalKey<DCRTPoly> loaded;
+        if (binary) {
+            Serial::Serialize(key, s, SerType::BINARY);
+            Serial::Deserialize(loaded, s, SerType::BINARY);
+        }
+        else {
+            Serial::Serialize(key, s, SerType::JSON);
+            Serial::Deserialize(loaded, s, SerType::JSON);
+        }
+        ASSERT_TRUE(loaded != nullptr);
+        EXPECT_EQ(loaded->GetASeed(), key->GetASeed());
+        EXPECT_TRUE(loaded->GetAVector().empty());
+        ASSERT_EQ(loaded->GetBVector().size(), key->GetBVector().size());
+
+        auto ct = cc->Encrypt(kp1.publicKey, cc->MakeCKKSPackedPlaintext(seedInput1));
+        checkEquality(Decode(cc, kp2.secretKey, cc->KeySwitch(ct, loaded)), ToComplex(seedInput1), SEED_EPS,
+                      std::string("key switch with a loaded seeded key fails, ") + (binary ? "BINARY" : "JSON"));
+    }
+}
+
+/* keys written before the seed (version 1) have A and no seed */
+TEST(UTCKKSRNS_SEEDED_KEY, load_version_1_key) {
+    BootSchemeGuard guard(0);
+    CryptoContext<DCRTPoly> cc = SeededKeyContext();
+    auto kp1                   = cc->KeyGen();
+    auto kp2                   = cc->KeyGen();
+    auto key                   = cc->KeySwitchGen(kp1.secretKey, kp2.secretKey);
+
+    std::string json = Serial::SerializeToString(key);
+    // the EvalKeyRelin layout of version 1 : no "s" field
+    std::string version2 = "\"cereal_class_version\": " + std::to_string(EvalKeyRelinImpl<DCRTPoly>::SerializedVersion());
+    size_t at            = json.find(version2);
+    ASSERT_NE(at, std::string::npos);
+    json.replace(at, version2.size(), "\"cereal_class_version\": 1");
+    size_t seed = json.find("\"s\": []");
+    ASSERT_NE(seed, std::string::npos);
+    size_t comma = json.rfind(',', seed);
+    json.erase(comma, seed + std::string("\"s\": []").size() - comma);
+
+    std::stringstream s(json);
+    EvalKey<DCRTPoly> loaded;
+    Serial::Deserialize(loaded, s, SerType::JSON);
+    ASSERT_TRUE(loaded != nullptr);
+    EXPECT_TRUE(loaded->GetASeed().empty());
+    EXPECT_EQ(loaded->GetAVector().size(), key->GetAVector().size());
+
+    auto ct = cc->Encrypt(kp1.publicKey, cc->MakeCKKSPackedPlaintext(seedInput1));
+    checkEquality(Decode(cc, kp2.secretKey, cc->KeySwitch(ct, loaded)), ToComplex(seedInput1), SEED_EPS,
+                  "key switch with a version 1 key fails");
+}
@@ -123,6 +123,21 @@ public:
     }
 };
 
+void init_stat();
+void stop_consumer_workers();
+
+/* The polynomial operations are posted to the emulated device, its consumer workers
+    run for the whole test program */
+class DeviceEnvironment : public ::testing::Environment {
+public:
+    void SetUp() override {
+        init_stat();
+    }
+    void TearDown() override {
+        stop_consumer_workers();
+    }
+};
+
 bool TestB2     = false;
 bool TestB4     = false;
 bool TestB6     = false;
@@ -205,5 +220,7 @@ int main(int argc, char** argv) {
     std::cout << "Testing Backends: " << (TestB2 ? "2 " : "") << (TestB4 ? "4 " : "") << (TestB6 ? "6 " : "")
               << (TestNative ? "Native " : "") << std::endl;
 
+    ::testing::AddGlobalTestEnvironment(new DeviceEnvironment);
+
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,31 @@
+import struct
+import sys
+
+# binary command trace (utils/trace.h) -> commandrecord.csv for replay.py
+# usage: python3 trace2csv.py [commandrecord.bin] [commandrecord.csv]
+
+bin_path = sys.argv[1] if len(sys.argv) > 1 else 'build/bin/examples/pke/commandrecord.bin'
+csv_path = sys.argv[2] if len(sys.argv) > 2 else 'build/bin/examples/pke/commandrecord.csv'
+
+header_format = '<8sII' # magic, version, record_size
+record_format = '<QQQQQQIBBHHHI' # seq, timestamp_ns, buf[3], modulus, bytes, kind, op, thread_id, device, reserved
+record_size = struct.calcsize(record_format)
+
+compute_names = {1: 'NTT', 2: 'INTT', 3: 'Auto', 4: 'Add', 5: 'Mult', 6: 'Sub', 7: 'Bconvup', 8: 'Bconvdown', 9: 'Prng'}
+link_names = {1: 'PCIE', 2: 'HBM', 3: 'SRAM', 4: 'D2D'}
+
+with open(bin_path, 'rb') as f:
+    magic, version, size = struct.unpack(header_format, f.read(struct.calcsize(header_format)))
+    if magic != b'FHETRACE' or size != record_size:
+        sys.exit(bin_path + ' is not a trace file')
+    data = f.read()
+
+records = [struct.unpack_from(record_format, data, off) for off in range(0, len(data) - record_size + 1, record_size)]
+records.sort(key=lambda r: r[0]) # each thread buffer is written as a whole, restore the global order
+
+with open(csv_path, 'w') as out:
+    for seq, ts, buf0, buf1, buf2, modulus, nbytes, kind, op, tid, device, _, _ in records:
+        if chr(kind) == 'D':
+            out.write('D, %s, %d, %d\n' % (link_names.get(op, 'Unknown'), buf0, buf1))
+        else:
+            out.write('C, %s, %d, %d, %d\n' % (compute_names.get(op, 'Unknown'), buf0, buf1, buf2))